@@ -0,0 +1,123 @@
+/**
+ * @file BatchMachine.h
+ * @brief Header file for the batched emulator that runs many Hack machines on one ROM.
+ *
+ * This file declares `BatchMachine`, which runs N independent copies of the Hack
+ * computer that share a program, e.g. `Mult.asm` over a whole grid of `R0`/`R1`
+ * inputs. Each machine behaves exactly like a `Machine` with the same budget, but
+ * machines that are at the same instruction execute it together with SIMD operations.
+ *
+ * Key Components:
+ * - Blocks: Machines are grouped into blocks of `LANES`. The A, D and PC registers of a
+ *   block are stored structure-of-arrays, one vector of `LANES` words each.
+ * - Hot RAM: The low `hotWords` addresses (R0..R15, the variables, the VM stack) are
+ *   also stored structure-of-arrays: one vector per address holds that word of every
+ *   machine in the block, so when the machines agree on A, `M` is a single vector load
+ *   or store.
+ * - Cold RAM: Higher addresses (e.g. the screen) are kept per machine in 256-word pages
+ *   that are allocated on the first write, so untouched memory costs nothing.
+ * - Scheduling: In every block, the machines at the lowest PC run next, in lockstep,
+ *   until they diverge at a conditional jump or reach the PC of a waiting machine, which
+ *   then joins them. A machine that runs alone is executed by a scalar loop.
+ *
+ * The ALU and jump logic are written once on vectors and compiled twice, generically
+ * and for AVX2, with the faster one chosen at run time.
+ */
+#ifndef BATCHMACHINE_H
+#define BATCHMACHINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @brief How the instructions of the last `BatchMachine::run` were executed.
+ */
+struct BatchStats {
+    uint64_t instructions = 0;      // Instructions executed, summed over all machines
+    uint64_t vectorSteps = 0;       // Instructions executed for several machines at once
+    uint64_t vectorLanes = 0;       // Machines taking part in those steps, summed
+    uint64_t scalarSteps = 0;       // Instructions executed for a single machine
+};
+
+/**
+ * @brief N independent Hack machines that share one ROM.
+ *
+ * @code
+ * BatchMachine batch(assembler.machineCode(), 10000);
+ * for(size_t i = 0; i < batch.size(); i++){
+ *     batch.poke(i, 0, i % 100);
+ *     batch.poke(i, 1, i / 100);
+ * }
+ * batch.run(1000000, &pool);
+ * uint16_t product = batch.peek(42, 2);
+ * @endcode
+ */
+class BatchMachine {
+public:
+    static constexpr size_t LANES = 16;               // Machines per block: one 256-bit vector of words
+    static constexpr size_t DEFAULT_HOT_WORDS = 1024;
+
+    /**
+     * @brief Creates `count` machines with cleared registers and RAM, all at PC 0.
+     *
+     * @param program The machine words in ROM order.
+     * @param count Number of machines.
+     * @param hotWords Number of low RAM addresses stored structure-of-arrays (at most 24576).
+     * @throws std::runtime_error If the program does not fit in the 32K ROM.
+     */
+    BatchMachine(const std::vector<uint16_t>& program, size_t count, size_t hotWords = DEFAULT_HOT_WORDS);
+    ~BatchMachine();
+
+    /**
+     * @brief Runs every machine until it halts or has executed `maxCycles` more
+     *        instructions, as `Machine::run` would.
+     *
+     * @param maxCycles The budget of each machine for this call.
+     * @param pool If given, the blocks are spread over this pool.
+     */
+    void run(uint64_t maxCycles, ThreadPool* pool = nullptr);
+
+    /** @brief Number of machines. */
+    size_t size() const { return machineCount; }
+
+    /** @brief Reads a data memory word of one machine; 0 above the keyboard. */
+    uint16_t peek(size_t machine, uint16_t address) const;
+
+    /** @brief Writes a data memory word of one machine; writes above the keyboard are ignored. */
+    void poke(size_t machine, uint16_t address, uint16_t value);
+
+    uint16_t pc(size_t machine) const;
+    uint16_t a(size_t machine) const;
+    uint16_t d(size_t machine) const;
+
+    /** @brief Whether the machine reached a loop it can never leave or left the program. */
+    bool halted(size_t machine) const;
+
+    /** @brief Instructions the machine has executed. */
+    uint64_t cycles(size_t machine) const;
+
+    /** @brief How the last `run()` executed its instructions. */
+    const BatchStats& stats() const { return runStats; }
+
+    /** @brief The instruction set the lockstep steps use ("avx2" or "generic"). */
+    static const char* implementation();
+
+private:
+    struct Block;
+
+    uint16_t* hotWord(size_t machine, uint16_t address) const;
+
+    std::vector<uint16_t> rom;          // Padded to the full ROM size
+    size_t programLength;
+    size_t machineCount;
+    size_t hotWords;
+    std::vector<Block> blocks;
+    mutable std::vector<std::unique_ptr<uint16_t[]>> pages;  // Machine * PAGES + page; null until written
+    BatchStats runStats;
+};
+
+#endif // BATCHMACHINE_H
@@ -7,29 +7,48 @@
  * and C-instructions.
  * 
  * Key Components:
- * - A-instruction translation: Converts "@value" format to 16-bit binary.
- * - C-instruction translation: Converts "dest=comp;jump" format to 16-bit binary.
+ * - A-instruction translation: Converts "@value" format to a 16-bit word.
+ * - C-instruction translation: Converts "dest=comp;jump" format to a 16-bit word.
+ * - Fixed instructions: Encodes everything except A-instructions naming a label or
+ *   variable, which the assemblers resolve in their own way.
+ * - Text formatting: Renders a word as the 16 '0'/'1' characters of a .hack line.
  * 
  * The translation process is a core part of the assembler, converting human-readable
- * assembly code into machine-executable binary code.
+ * assembly code into machine-executable binary code. Instructions are encoded as
+ * `uint16_t` values; text is only produced when the output file is written.
  */
 #ifndef BINCODES_H
 #define BINCODES_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 /**
- * @brief Translates an A-instruction into binary code.
+ * @brief Encodes an A-instruction that loads the given address or constant.
  * 
- * This function converts an A-instruction (e.g., "@123" or "@LOOP") into its
- * 16-bit binary representation. The binary format for A-instructions is:
+ * The binary format for A-instructions is:
  * 0vvv vvvv vvvv vvvv
  * Where 'v' represents the 15-bit value or address.
  * 
- * @param instruction The A-instruction in the format "@value" or "@symbol".
- * @return std::string The 16-bit binary string representation of the A-instruction.
+ * @param address The value to load, in the range 0..32767.
+ * @return uint16_t The encoded A-instruction.
+ * @throws std::runtime_error If the value does not fit in 15 bits.
  */
-std::string translateAInstruction(const std::string& instruction);
+uint16_t encodeAInstruction(int address);
+
+/**
+ * @brief Translates a numeric A-instruction into binary code.
+ * 
+ * This function converts an A-instruction with a decimal constant (e.g., "@123")
+ * into its 16-bit representation. Symbolic A-instructions must be resolved to an
+ * address first and passed to `encodeAInstruction`.
+ * 
+ * @param instruction The A-instruction in the format "@value".
+ * @return uint16_t The encoded A-instruction.
+ * @throws std::runtime_error If the value is not a decimal number in 0..32767.
+ */
+uint16_t translateAInstruction(std::string_view instruction);
 
 /**
  * @brief Translates a C-instruction into binary code.
@@ -44,8 +63,46 @@ std::string translateAInstruction(const std::string& instruction);
  * - 'j' represents the jump bits
  * 
  * @param instruction The C-instruction in "dest=comp;jump" format.
- * @return std::string The 16-bit binary representation of the C-instruction.
+ * @return uint16_t The encoded C-instruction.
+ * @throws std::runtime_error If the dest, comp or jump mnemonic is unknown.
+ */
+uint16_t translateCInstruction(std::string_view instruction);
+
+/**
+ * @brief Tests whether an instruction is an A-instruction naming a label or variable.
+ * 
+ * @param instruction The instruction text, without comments or surrounding blanks.
+ * @return bool true for e.g. "@LOOP"; false for constants ("@5"), predefined symbols
+ *         ("@SCREEN") and C-instructions.
+ */
+bool isUserSymbol(std::string_view instruction);
+
+/**
+ * @brief Encodes an instruction that does not depend on the program's own symbols.
+ * 
+ * C-instructions, constants and predefined symbols are encoded the same way in every
+ * program; instructions for which `isUserSymbol` is true must be resolved by the caller.
+ * 
+ * @param instruction The instruction text, without comments or surrounding blanks.
+ * @return uint16_t The encoded instruction.
+ * @throws std::runtime_error If the instruction cannot be encoded.
+ */
+uint16_t encodeFixedInstruction(std::string_view instruction);
+
+/**
+ * @brief Writes the 16 '0'/'1' characters of a machine word, most significant bit first.
+ * 
+ * @param word The encoded instruction.
+ * @param out Destination for exactly 16 characters (no terminator is written).
+ */
+void formatBinary(uint16_t word, char* out);
+
+/**
+ * @brief Returns the 16-character binary text of a machine word, as stored in .hack files.
+ * 
+ * @param word The encoded instruction.
+ * @return std::string The binary text, e.g. "1110110000010000".
  */
-std::string translateCInstruction(const std::string& instruction);
+std::string toBinaryString(uint16_t word);
 
 #endif // BINCODES_H
@@ -0,0 +1,126 @@
+/**
+ * @file CommandLine.h
+ * @brief Helpers shared by the command-line tools (Assembler, Emulator, TestRunner, HdlSim,
+ *        Disassembler, AsmBench).
+ *
+ * Key Components:
+ * - parseNumber: Validates the numeric option values, so every tool accepts and rejects
+ *   the same text.
+ * - nextRandom / blockSeed: The generator behind `--seed`. Work is cut into blocks and
+ *   every block gets its own generator, so the results do not depend on how the blocks
+ *   are spread over threads.
+ * - Failure: The first failing block of a check spread over threads.
+ * - jsonString / jsonNumber: Format the values of the JSON reports (`AsmBench`,
+ *   `Assembler --stats`).
+ */
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @brief Parses an unsigned decimal number with an upper bound.
+ *
+ * @param text The digits.
+ * @param limit The largest accepted value.
+ * @return uint64_t The number.
+ * @throws std::invalid_argument If the text is not a number in range.
+ */
+inline uint64_t parseNumber(const std::string& text, uint64_t limit){
+    if(text.empty() || text.size() > 19 || text.find_first_not_of("0123456789") != std::string::npos){
+        throw std::invalid_argument("Invalid number: " + text);
+    }
+    uint64_t value = std::stoull(text);
+    if(value > limit){
+        throw std::invalid_argument("Number out of range: " + text);
+    }
+    return value;
+}
+
+/**
+ * @brief splitmix64: a small, fast generator, so a seed always gives the same sequence.
+ *
+ * @param state The generator's state, advanced by every call.
+ * @return uint64_t The next random number.
+ */
+inline uint64_t nextRandom(uint64_t& state){
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief The initial state of the generator for one block of work.
+ *
+ * @param seed The `--seed` of the run.
+ * @param block The index of the block.
+ * @return uint64_t The state to pass to `nextRandom`.
+ */
+inline uint64_t blockSeed(uint64_t seed, uint64_t block){
+    return seed * 0x2545F4914F6CDD1DULL + block;
+}
+
+/**
+ * @brief The first failure found by any worker; the one with the lowest block wins, so
+ *        the report does not depend on scheduling.
+ */
+struct Failure {
+    std::mutex lock;
+    std::atomic<bool> found{false};
+    uint64_t block = UINT64_MAX;
+    std::string message;
+
+    void record(uint64_t atBlock, const std::string& text){
+        std::lock_guard<std::mutex> guard(lock);
+        if(atBlock < block){
+            block = atBlock;
+            message = text;
+        }
+        found = true;
+    }
+};
+
+/**
+ * @brief Quotes a string for JSON.
+ *
+ * @param text The string.
+ * @return std::string The quoted string, with '"', '\\' and control characters escaped.
+ */
+inline std::string jsonString(const std::string& text){
+    std::string quoted = "\"";
+    for(char c : text){
+        if(c == '"' || c == '\\'){
+            quoted += '\\';
+            quoted += c;
+        }else if(static_cast<unsigned char>(c) < 0x20){
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        }else{
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+/**
+ * @brief Formats a number for JSON with up to 9 significant digits.
+ *
+ * @param value The number; it must be finite.
+ * @return std::string The number as text.
+ */
+inline std::string jsonNumber(double value){
+    std::ostringstream text;
+    text<<std::setprecision(9)<<value;
+    return text.str();
+}
+
+#endif // COMMANDLINE_H
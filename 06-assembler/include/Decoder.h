@@ -0,0 +1,74 @@
+/**
+ * @file Decoder.h
+ * @brief Header file for the table-driven disassembly of Hack machine code.
+ *
+ * This file declares the decode table behind the `Disassembler` tool. Every one of the
+ * 65,536 possible words is decoded once, ahead of time, into the assembly text that
+ * encodes it, so disassembling a word is a single indexed load.
+ *
+ * Key Components:
+ * - DecodedWord: The assembly text of one word, stored inline in a fixed-size entry.
+ * - decodeTable: The 65,536 entries, built from the opcode tables in SymbolTables.h the
+ *   first time it is used. C-instructions use the canonical spelling of each field.
+ * - disassemble: Renders a whole program as assembly source.
+ *
+ * A word that no instruction encodes to (a C-instruction with an unknown computation
+ * or without the two `1` bits after the opcode) has no text. Every other word
+ * disassembles to text that assembles back to the same word.
+ */
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief The assembly text of one machine word.
+ *
+ * The longest instruction, e.g. "AMD=D|M;JMP", has 11 characters, so an entry fits in
+ * 16 bytes and the whole table in 1 MiB.
+ */
+struct DecodedWord {
+    char text[15];   // Not terminated
+    uint8_t length;  // 0 if no instruction encodes to this word
+
+    std::string_view view() const { return std::string_view(text, length); }
+};
+
+/**
+ * @brief Returns the decode table, indexed by machine word.
+ *
+ * The table is built on the first call (thread-safe) and never changes afterwards.
+ *
+ * @return const std::array<DecodedWord, 65536>& The table.
+ */
+const std::array<DecodedWord, 65536>& decodeTable();
+
+/**
+ * @brief Returns the assembly text of one machine word.
+ *
+ * @param word The encoded instruction.
+ * @return std::string_view The instruction, e.g. "@21" or "D=D+M", or an empty view if
+ *         no instruction encodes to this word.
+ */
+inline std::string_view disassembleWord(uint16_t word){
+    return decodeTable()[word].view();
+}
+
+/**
+ * @brief Renders a program as assembly source, one instruction per line.
+ *
+ * A word without an instruction is written as a comment holding its binary text, so
+ * the source still lines up with the ROM but does not assemble to the same program.
+ *
+ * @param words The machine words in ROM order.
+ * @param addresses Append each word's ROM address as a comment.
+ * @param invalid If not null, receives the number of words without an instruction.
+ * @return std::string The assembly source.
+ */
+std::string disassemble(const std::vector<uint16_t>& words, bool addresses = false, size_t* invalid = nullptr);
+
+#endif // DECODER_H
@@ -0,0 +1,103 @@
+/**
+ * @file Framebuffer.h
+ * @brief Header file for the headless display of the Hack screen.
+ *
+ * This file declares `Framebuffer`, which turns the `SCREEN` memory map (8K words at
+ * 16384..24575) into a 512x256 black-and-white image that can be saved as PBM or PNG,
+ * so the output of programs such as `Rect.asm` and `Fill.asm` can be checked without
+ * a GUI.
+ *
+ * Key Components:
+ * - update: Brings the image up to date with the screen memory, converting only the
+ *   words that changed since the previous update.
+ * - DirtyRegion: The rows and word columns that the last update changed.
+ * - encodePbm / encodePng / writeImage: Render the image; PNG needs no external library.
+ *
+ * Changes are found by comparing the screen memory with a copy taken at the previous
+ * update, 64 bits at a time, instead of by hooking every write of the CPU loop. The
+ * emulator engines run unchanged, and a frame in which a program touched a few words
+ * costs one 16 KiB comparison and the conversion of those words.
+ */
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief The part of the screen changed by the last `Framebuffer::update`.
+ *
+ * Rows are pixel rows (0..255); columns are 16-pixel words (0..31). Both ranges are
+ * inclusive and only meaningful if `empty()` is false.
+ */
+struct DirtyRegion {
+    size_t firstRow = 0, lastRow = 0;
+    size_t firstColumn = 0, lastColumn = 0;
+    size_t words = 0;           // Screen words that changed
+
+    bool empty() const { return words == 0; }
+};
+
+/**
+ * @brief A 512x256 monochrome image kept in step with the Hack screen memory.
+ *
+ * @code
+ * Framebuffer display;
+ * machine.run(1000000);
+ * if(!display.update(machine.screen()).empty()){
+ *     display.writeImage("frame.png");
+ * }
+ * @endcode
+ */
+class Framebuffer {
+public:
+    static constexpr size_t WIDTH = 512;
+    static constexpr size_t HEIGHT = 256;
+    static constexpr size_t ROW_WORDS = WIDTH / 16;
+    static constexpr size_t ROW_BYTES = WIDTH / 8;
+
+    /**
+     * @brief Creates a blank (all white) image, matching a cleared screen.
+     */
+    Framebuffer();
+
+    /**
+     * @brief Converts the screen words that changed since the previous update.
+     *
+     * @param screen The 8K words of the screen, e.g. `Machine::screen()`.
+     * @return DirtyRegion The rows and columns that changed.
+     */
+    DirtyRegion update(const uint16_t* screen);
+
+    /** @brief The image as rows of `ROW_BYTES` bytes, leftmost pixel in the high bit, 1 = black. */
+    const std::array<uint8_t, HEIGHT * ROW_BYTES>& bitmap() const { return pixels; }
+
+    /** @brief Whether the pixel at column `x`, row `y` is black. */
+    bool pixel(size_t x, size_t y) const { return (pixels[y * ROW_BYTES + x / 8] >> (7 - x % 8)) & 1; }
+
+    /**
+     * @brief Renders the image as a binary PBM (P4) file.
+     */
+    std::string encodePbm() const;
+
+    /**
+     * @brief Renders the image as a 1-bit grayscale PNG file.
+     */
+    std::string encodePng() const;
+
+    /**
+     * @brief Writes the image, as PNG if the name ends in `.png` and as PBM otherwise.
+     *
+     * @param filename The file to write.
+     * @throws std::runtime_error If the file cannot be written.
+     */
+    void writeImage(const std::string& filename) const;
+
+private:
+    std::array<uint16_t, HEIGHT * ROW_WORDS> shadow{};   // The screen words at the last update
+    std::array<uint8_t, HEIGHT * ROW_BYTES> pixels{};
+};
+
+#endif // FRAMEBUFFER_H
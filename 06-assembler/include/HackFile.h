@@ -0,0 +1,209 @@
+/**
+ * @file HackFile.h
+ * @brief Header file for reading and writing assembled Hack programs.
+ * 
+ * This file declares the output side of the Assembler: turning the encoded
+ * machine words into a `.hack` file, and reading such a file back.
+ * 
+ * Key Components:
+ * - OutputFormat: Selects the classic text format or the packed binary format.
+ * - renderHack: Builds the complete file image in a single memory buffer.
+ * - writeHackFile: Writes that image to disk with one write call.
+ * - patchHackFile: Updates a written file in place, touching only the changed words.
+ * - readHackFile: Loads either format back into machine words.
+ * - readFile / writeFile: Whole-file I/O in one call, shared by the other file formats
+ *   of the tools (checkpoints, key logs, images).
+ * - putLittleEndian / getLittleEndian: The integer fields of those binary formats.
+ * - ObjectFile: A relocatable module for separate assembly, written by `Assembler::compile`
+ *   and merged by the `Linker`; `writeObjectFile` and `readObjectFile` store it as `.hobj`.
+ * 
+ * Binary format (all integers little-endian):
+ * - Bytes 0..3: Magic "HACK".
+ * - Bytes 4..5: Format version, currently 1.
+ * - Bytes 6..7: Reserved, written as 0.
+ * - Bytes 8..11: Number of words that follow.
+ * - Then 2 bytes per machine word, in ROM order.
+ * 
+ * Object format (.hobj, all integers little-endian):
+ * - Bytes 0..3: Magic "HOBJ".
+ * - Bytes 4..5: Format version, currently 1.
+ * - Bytes 6..7: Reserved, written as 0.
+ * - Bytes 8..27: Number of words, labels, externals, relocations and references (4 bytes each).
+ * - Words: 2 bytes each, in module order.
+ * - Labels: 4-byte address, 2-byte name length, name.
+ * - Externals: 2-byte name length, name.
+ * - Relocations: 4-byte word index each.
+ * - References: 4-byte word index, 4-byte external index.
+ */
+#ifndef HACKFILE_H
+#define HACKFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Output formats supported for assembled programs.
+ * 
+ * - Text: One 16-character line of '0'/'1' per instruction (the standard .hack format).
+ * - Binary: A 12-byte header followed by the words packed as 2 bytes each.
+ */
+enum class OutputFormat {
+    Text,
+    Binary
+};
+
+/**
+ * @brief Reads a whole file, byte for byte.
+ * 
+ * @param filename The name of the file.
+ * @return std::string The contents of the file.
+ * @throws std::runtime_error If the file cannot be opened.
+ */
+std::string readFile(const std::string& filename);
+
+/**
+ * @brief Replaces a file with the given bytes in a single write.
+ * 
+ * @param filename The name of the file.
+ * @param image The bytes to write.
+ * @throws std::runtime_error If the file cannot be opened or written.
+ */
+void writeFile(const std::string& filename, const std::string& image);
+
+/**
+ * @brief Stores the low `bytes` bytes of a value little-endian at a position of a buffer.
+ * 
+ * @param buffer The buffer; it must already hold `offset + bytes` bytes.
+ * @param offset The position of the first byte.
+ * @param value The value to store.
+ * @param bytes The width of the field, 1 to 8.
+ */
+void putLittleEndian(std::string& buffer, size_t offset, uint64_t value, int bytes);
+
+/**
+ * @brief Reads a little-endian field of `bytes` bytes from a buffer.
+ * 
+ * @param buffer The buffer; it must hold `offset + bytes` bytes.
+ * @param offset The position of the first byte.
+ * @param bytes The width of the field, 1 to 8.
+ * @return uint64_t The value of the field.
+ */
+uint64_t getLittleEndian(const std::string& buffer, size_t offset, int bytes);
+
+/**
+ * @brief Builds the complete file image for a program in one buffer.
+ * 
+ * In text format lines are separated by '\n' and the last line has no newline.
+ * 
+ * @param words The machine words in ROM order.
+ * @param format The output format to render.
+ * @return std::string The bytes of the file.
+ */
+std::string renderHack(const std::vector<uint16_t>& words, OutputFormat format);
+
+/**
+ * @brief Renders a program and writes it to disk with a single write.
+ * 
+ * @param filename The name of the output file.
+ * @param words The machine words in ROM order.
+ * @param format The output format to write.
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void writeHackFile(const std::string& filename, const std::vector<uint16_t>& words, OutputFormat format);
+
+/**
+ * @brief Updates a file written by `writeHackFile` to hold a new version of the program.
+ * 
+ * Every word has a fixed position in both formats, so only the listed words and the words
+ * from `rewriteFrom` on are written, and the file is cut or extended to its new size. If
+ * the file does not have the size expected for `previousCount` words it is rewritten.
+ * 
+ * @param filename The name of the .hack file.
+ * @param words The new machine words in ROM order.
+ * @param format The format the file was written in.
+ * @param changed Indices below `rewriteFrom` whose words changed, in ascending order.
+ * @param rewriteFrom The first index from which every word is written again.
+ * @param previousCount The number of words the file holds now.
+ * @return size_t The number of words written.
+ * @throws std::runtime_error If the file cannot be written.
+ */
+size_t patchHackFile(const std::string& filename, const std::vector<uint16_t>& words, OutputFormat format,
+                     const std::vector<uint32_t>& changed, size_t rewriteFrom, size_t previousCount);
+
+/**
+ * @brief Loads a .hack file in either format.
+ * 
+ * The format is detected from the "HACK" magic; anything else is parsed as text,
+ * one 16-digit binary number per line.
+ * 
+ * @param filename The name of the .hack file.
+ * @return std::vector<uint16_t> The machine words in ROM order.
+ * @throws std::runtime_error If the file cannot be read or is malformed.
+ */
+std::vector<uint16_t> readHackFile(const std::string& filename);
+
+/**
+ * @brief A label defined by a module, at an address relative to the module's first word.
+ */
+struct ObjectLabel {
+    std::string name;
+    uint32_t address;
+};
+
+/**
+ * @brief An A-instruction that loads the address of an external symbol.
+ */
+struct ObjectReference {
+    uint32_t word;      // Index of the instruction in the module
+    uint32_t external;  // Index into `ObjectFile::externals`
+};
+
+/**
+ * @brief One separately assembled module, ready to be linked.
+ * 
+ * Instructions that do not depend on where the module ends up in ROM (C-instructions,
+ * constants, predefined symbols) are fully encoded. The others are listed so the linker
+ * can patch them:
+ * - relocations: A-instructions that load one of the module's own labels. The word holds
+ *   the label's module-relative address; the linker adds the module's ROM base.
+ * - references: A-instructions that load a symbol the module does not define. The linker
+ *   resolves it to a label of another module or, failing that, to a variable.
+ */
+struct ObjectFile {
+    std::vector<uint16_t> words;
+    std::vector<ObjectLabel> labels;
+    std::vector<std::string> externals;        // Undefined symbols, in order of first use
+    std::vector<uint32_t> relocations;
+    std::vector<ObjectReference> references;
+};
+
+/**
+ * @brief Builds the complete .hobj image of a module in one buffer.
+ * 
+ * @param object The module to render.
+ * @return std::string The bytes of the file.
+ */
+std::string renderObject(const ObjectFile& object);
+
+/**
+ * @brief Renders a module and writes it to disk with a single write.
+ * 
+ * @param filename The name of the output file (.hobj).
+ * @param object The module to write.
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void writeObjectFile(const std::string& filename, const ObjectFile& object);
+
+/**
+ * @brief Loads a .hobj file.
+ * 
+ * Every index in the file is checked, so a linker can trust the module it gets.
+ * 
+ * @param filename The name of the .hobj file.
+ * @return ObjectFile The module.
+ * @throws std::runtime_error If the file cannot be read or is malformed.
+ */
+ObjectFile readObjectFile(const std::string& filename);
+
+#endif // HACKFILE_H
@@ -0,0 +1,309 @@
+/**
+ * @file Hdl.h
+ * @brief Header file for the HDL front end and the bit-parallel gate-level simulator.
+ *
+ * This file declares everything needed to simulate the chips of projects 1 to 5
+ * (`ALU.hdl`, `Mux4Way16.hdl`, `RAM16K.hdl`, `CPU.hdl`, ...) without the Java
+ * hardware simulator.
+ *
+ * Key Components:
+ * - parseHdl / HdlLibrary: Read `CHIP` definitions and find them by name in a set of
+ *   directories, the way the hardware simulator finds the parts of a chip.
+ * - Netlist: Flattens the `PARTS:` of a chip, recursively, down to `Nand` gates and
+ *   `DFF`s, simplifies the result (constant folding, common subexpressions, recognizing
+ *   And/Or/Xor/Mux shapes) and sorts the gates topologically.
+ * - GateSimulator: Evaluates a netlist on `Lanes`: every signal holds one bit for each
+ *   of 512 independent test vectors, so a single pass over the gate array computes 512
+ *   simulations. The inner loops use AVX2 where the CPU supports it.
+ *
+ * The primitives are `Nand` and `DFF`. `ARegister` and `DRegister` are simulated as
+ * `Register`, and `Screen` as an 8K-word RAM built from two `RAM4K`. `Keyboard` and
+ * `ROM32K` are fed from outside: their outputs become the extra input pins `keyboard`
+ * and `rom` of the compiled chip, and the ROM's address the extra output `romAddress`.
+ */
+#ifndef HDL_H
+#define HDL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One bit of 512 independent simulations, 64 per machine word.
+ *
+ * Aligned to a cache line so the simulator can use whole vector registers on it.
+ */
+struct alignas(64) Lanes {
+    static constexpr size_t WORDS = 8;
+    static constexpr size_t COUNT = WORDS * 64;
+
+    /** @brief Four words handled as one value; GCC and Clang lower its operators to SIMD instructions. */
+    typedef uint64_t Vector __attribute__((vector_size(32), may_alias));
+    static constexpr size_t VECTORS = WORDS / 4;
+
+    uint64_t word[WORDS];
+
+    /** @brief All lanes set to the same bit. */
+    static Lanes fill(bool bit){
+        Lanes lanes;
+        for(uint64_t& w : lanes.word){
+            w = bit ? ~uint64_t(0) : 0;
+        }
+        return lanes;
+    }
+
+    /** @brief The bit of a single lane. */
+    bool get(size_t lane) const { return (word[lane / 64] >> (lane % 64)) & 1; }
+
+    Vector* vectors() { return reinterpret_cast<Vector*>(word); }
+    const Vector* vectors() const { return reinterpret_cast<const Vector*>(word); }
+};
+
+inline Lanes operator&(const Lanes& x, const Lanes& y){
+    Lanes r;
+    for(size_t i = 0; i < Lanes::VECTORS; i++) r.vectors()[i] = x.vectors()[i] & y.vectors()[i];
+    return r;
+}
+
+inline Lanes operator|(const Lanes& x, const Lanes& y){
+    Lanes r;
+    for(size_t i = 0; i < Lanes::VECTORS; i++) r.vectors()[i] = x.vectors()[i] | y.vectors()[i];
+    return r;
+}
+
+inline Lanes operator^(const Lanes& x, const Lanes& y){
+    Lanes r;
+    for(size_t i = 0; i < Lanes::VECTORS; i++) r.vectors()[i] = x.vectors()[i] ^ y.vectors()[i];
+    return r;
+}
+
+inline Lanes operator~(const Lanes& x){
+    Lanes r;
+    for(size_t i = 0; i < Lanes::VECTORS; i++) r.vectors()[i] = ~x.vectors()[i];
+    return r;
+}
+
+/**
+ * @brief An input or output pin of a chip.
+ */
+struct HdlPin {
+    std::string name;
+    unsigned width = 1;
+};
+
+/**
+ * @brief One `inner=outer` connection of a part, e.g. `out[0..7]=low` or `c=false`.
+ *
+ * A range of -1 means the whole pin. `outer` is "true" or "false" for constants.
+ */
+struct HdlConnection {
+    std::string inner;
+    int innerLow = -1;
+    int innerHigh = -1;
+    std::string outer;
+    int outerLow = -1;
+    int outerHigh = -1;
+};
+
+/**
+ * @brief One part of a chip: the chip used and its connections.
+ */
+struct HdlPart {
+    std::string chip;
+    std::vector<HdlConnection> connections;
+    unsigned line = 0;
+};
+
+/**
+ * @brief A parsed `CHIP` definition.
+ */
+struct HdlChip {
+    std::string name;
+    std::string file;
+    std::vector<HdlPin> inputs;
+    std::vector<HdlPin> outputs;
+    std::vector<HdlPart> parts;
+    bool builtin = false;   // Declared with `BUILTIN` instead of `PARTS:`
+};
+
+/**
+ * @brief Parses the text of an .hdl file.
+ *
+ * @param text The file contents.
+ * @param file The file name used in error messages.
+ * @return HdlChip The chip definition.
+ * @throws std::runtime_error With a "file:line: message" description of the first syntax error.
+ */
+HdlChip parseHdl(const std::string& text, const std::string& file);
+
+/**
+ * @brief Finds chip definitions by name in a set of directories.
+ *
+ * Chip `Name` is loaded from the first `Name.hdl` found while searching the directories
+ * (recursively) in the order they were added. Files are parsed once and cached.
+ */
+class HdlLibrary {
+public:
+    /**
+     * @brief Adds a directory to search; its subdirectories are searched too.
+     *
+     * @param directory The directory.
+     */
+    void addDirectory(const std::string& directory);
+
+    /**
+     * @brief Parses a chip file directly and registers it under its chip name.
+     *
+     * @param filename The .hdl file.
+     * @return const HdlChip& The chip definition.
+     * @throws std::runtime_error If the file cannot be read or parsed.
+     */
+    const HdlChip& loadFile(const std::string& filename);
+
+    /**
+     * @brief Looks up a chip by name.
+     *
+     * @param name The chip name, e.g. "Mux16".
+     * @return const HdlChip& The chip definition.
+     * @throws std::runtime_error If no .hdl file defines the chip or it does not parse.
+     */
+    const HdlChip& chip(const std::string& name);
+
+private:
+    std::vector<std::string> directories;
+    std::map<std::string, std::string> files;   // Chip name -> .hdl file, filled lazily
+    std::map<std::string, std::unique_ptr<HdlChip>> chips;
+    bool indexed = false;
+};
+
+/**
+ * @brief Operations of the flattened, simplified gate array.
+ */
+enum class GateOp : uint8_t {
+    Nand,   // out = !(a & b)
+    And,    // out = a & b
+    Or,     // out = a | b
+    Xor,    // out = a ^ b
+    Not,    // out = !a
+    Mux     // out = c ? b : a
+};
+
+/**
+ * @brief One gate of a netlist. Operands and result are signal slots.
+ */
+struct Gate {
+    GateOp op;
+    uint32_t out;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+};
+
+/**
+ * @brief A chip flattened to a topologically sorted array of gates.
+ *
+ * Signals are numbered slots: slot 0 is constant false, slot 1 constant true, then come
+ * the input bits (pin by pin, bit 0 first), then one slot per `DFF`, then the gate outputs.
+ * The pins are those of the chip, followed by the pins of its `Keyboard` and `ROM32K` parts.
+ * Evaluating the gates in order computes every signal from the inputs and the DFF states;
+ * each `Latch` then copies its next-state signal into its DFF slot on the clock edge.
+ */
+class Netlist {
+public:
+    /** @brief A DFF: the slot holding its state and the slot of its input. */
+    struct Latch {
+        uint32_t state;
+        uint32_t next;
+    };
+
+    /**
+     * @brief Flattens and compiles a chip.
+     *
+     * @param library Where the chip and all its parts are looked up.
+     * @param chipName The chip to compile.
+     * @throws std::runtime_error For unknown chips or pins, width mismatches, signals with
+     *         no or several drivers, combinational loops and unsupported built-in chips.
+     */
+    Netlist(HdlLibrary& library, const std::string& chipName);
+
+    const std::string& name() const { return chipName; }
+    const std::vector<HdlPin>& inputs() const { return inputPins; }
+    const std::vector<HdlPin>& outputs() const { return outputPins; }
+
+    /** @brief The slot of bit `bit` of input pin `pin`. */
+    uint32_t inputSlot(size_t pin, unsigned bit) const { return inputBase[pin] + bit; }
+
+    /** @brief The slot that carries bit `bit` of output pin `pin`. */
+    uint32_t outputSlot(size_t pin, unsigned bit) const { return outputSlots[outputBase[pin] + bit]; }
+
+    const std::vector<Gate>& gates() const { return gateArray; }
+    const std::vector<Latch>& latches() const { return latchArray; }
+    size_t slotCount() const { return slots; }
+
+    /** @brief Number of Nand gates before simplification. */
+    size_t nandCount() const { return flattenedNands; }
+
+private:
+    std::string chipName;
+    std::vector<HdlPin> inputPins;
+    std::vector<HdlPin> outputPins;
+    std::vector<uint32_t> inputBase;
+    std::vector<uint32_t> outputBase;
+    std::vector<uint32_t> outputSlots;
+    std::vector<Gate> gateArray;
+    std::vector<Latch> latchArray;
+    size_t slots = 0;
+    size_t flattenedNands = 0;
+};
+
+/**
+ * @brief Runs 512 independent simulations of a netlist at once.
+ *
+ * @code
+ * GateSimulator sim(netlist);
+ * sim.signal(netlist.inputSlot(0, 0)) = Lanes::fill(true);
+ * sim.evaluate();
+ * Lanes out = sim.signal(netlist.outputSlot(0, 0));
+ * @endcode
+ */
+class GateSimulator {
+public:
+    /**
+     * @brief Creates a simulator with all inputs and DFFs at 0.
+     *
+     * @param netlist The compiled chip; it must outlive the simulator.
+     */
+    explicit GateSimulator(const Netlist& netlist);
+
+    /** @brief The value of a signal slot in all 512 lanes. */
+    Lanes& signal(uint32_t slot) { return values[slot]; }
+    const Lanes& signal(uint32_t slot) const { return values[slot]; }
+
+    /**
+     * @brief Computes every gate output from the inputs and the current DFF states.
+     */
+    void evaluate();
+
+    /**
+     * @brief Clock edge: every DFF takes the value of its input as computed by `evaluate()`.
+     */
+    void clock();
+
+    /**
+     * @brief Sets every DFF back to 0.
+     */
+    void resetState();
+
+    /** @brief The instruction set used by `evaluate()` ("avx2" or "generic"). */
+    static const char* implementation();
+
+private:
+    const Netlist& netlist;
+    std::vector<Lanes> values;
+    std::vector<Lanes> pending;   // Next DFF states during `clock()`
+};
+
+#endif // HDL_H
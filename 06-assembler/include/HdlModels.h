@@ -0,0 +1,55 @@
+/**
+ * @file HdlModels.h
+ * @brief Header file for the reference models of the project chips.
+ *
+ * This file declares behavioural models of the chips specified in projects 1 to 3
+ * (`Not` .. `DMux8Way`, `HalfAdder` .. `ALU`, `Bit` .. `RAM16K`) and project 5 (`CPU`,
+ * `Memory`, `Computer`). The HDL simulator checks a compiled `Netlist` against these models.
+ *
+ * Key Components:
+ * - ChipModel: The pins of a chip and its behaviour, written with bitwise operations
+ *   on `Lanes`, so a model computes 512 test vectors at a time just like the netlist.
+ * - findChipModel: Looks a model up by chip name.
+ *
+ * Models are matched to netlists by pin name, so the order in which an .hdl file
+ * declares its pins does not matter.
+ */
+#ifndef HDLMODELS_H
+#define HDLMODELS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "Hdl.h"
+
+/**
+ * @brief Reference behaviour of one chip.
+ *
+ * All pins are passed as one `Lanes` per bit, pin by pin in the order of `inputs` and
+ * `outputs`, bit 0 first. Sequential chips keep `stateBits` bits of state; their outputs
+ * depend on the state (and, for RAMs, on the address), and `clock` computes the state
+ * after the next clock edge.
+ *
+ * Where the specification leaves something open, `constrain` moves the random inputs
+ * into the specified range, and `care` clears the output bits that may take any value.
+ */
+struct ChipModel {
+    std::string name;
+    std::vector<HdlPin> inputs;
+    std::vector<HdlPin> outputs;
+    size_t stateBits = 0;
+    void (*compute)(const Lanes* in, const Lanes* state, Lanes* out) = nullptr;
+    void (*clock)(const Lanes* in, Lanes* state) = nullptr;   // nullptr for combinational chips
+    void (*constrain)(Lanes* in) = nullptr;                    // nullptr if every input is valid
+    void (*care)(const Lanes* in, const Lanes* state, Lanes* mask) = nullptr;   // nullptr if every output is specified
+};
+
+/**
+ * @brief Looks up the reference model of a chip.
+ *
+ * @param name The chip name, e.g. "ALU".
+ * @return const ChipModel* The model, or nullptr if there is none.
+ */
+const ChipModel* findChipModel(const std::string& name);
+
+#endif // HDLMODELS_H
@@ -0,0 +1,139 @@
+/**
+ * @file IncrementalAssembler.h
+ * @brief Header file for the incremental assembler behind `Assembler --watch`.
+ *
+ * This file declares `IncrementalAssembler`, which keeps the result of both passes in
+ * memory (the instruction list, the label definitions, the symbol of every symbolic
+ * A-instruction and the encoded words) and brings it up to date with a new version of
+ * the source by redoing only the work the edit affects.
+ *
+ * Key Components:
+ * - Edit detection: The old and new sources are compared from both ends; the lines in
+ *   between are the only ones tokenized again.
+ * - Splicing: The instructions and labels of those lines replace the old ones; the ones
+ *   after them only have their offsets, lines and ROM addresses shifted.
+ * - Symbols: Label addresses and variable addresses (in order of first use) are
+ *   recomputed from the spliced lists, and only the A-instructions whose symbol moved
+ *   are encoded again.
+ * - Change list: The words that differ from the previous version, so a `.hack` file can
+ *   be patched in place with `patchHackFile`.
+ *
+ * The machine code is always identical to what `Assembler::assemble` produces for the
+ * same source.
+ */
+#ifndef INCREMENTALASSEMBLER_H
+#define INCREMENTALASSEMBLER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Parser.h"
+#include "SymbolTables.h"
+
+/**
+ * @brief How much work one `IncrementalAssembler::update` did.
+ */
+struct UpdateStats {
+    size_t linesScanned = 0;          // Source lines tokenized again
+    size_t instructionsEncoded = 0;   // Instructions encoded from text, or again because their symbol moved
+    size_t symbolsMoved = 0;          // Labels and variables whose address changed
+};
+
+/**
+ * @brief An assembler that updates its output for an edited source instead of starting over.
+ *
+ * Typical use:
+ * @code
+ * IncrementalAssembler assembler;
+ * assembler.update(loadSource("Prog.asm"));       // Full assembly the first time
+ * ...
+ * size_t previous = assembler.machineCode().size();
+ * if(assembler.update(loadSource("Prog.asm"))){   // Only the edited lines
+ *     patchHackFile("Prog.hack", assembler.machineCode(), OutputFormat::Text,
+ *                   assembler.changedWords(), assembler.rewriteFrom(), previous);
+ * }
+ * @endcode
+ */
+class IncrementalAssembler {
+public:
+    /**
+     * @param name The name used in diagnostics.
+     */
+    explicit IncrementalAssembler(std::string name = "<input>");
+
+    /**
+     * @brief Brings the machine code up to date with a new version of the source.
+     *
+     * @param text The complete new source.
+     * @return bool true if the program assembles without errors. On errors the
+     *         diagnostics are filled in and the machine code is not meaningful, but the
+     *         state stays consistent, so the next update can again be incremental.
+     */
+    bool update(std::string text);
+
+    /** @brief The encoded program, one word per instruction in ROM order. */
+    const std::vector<uint16_t>& machineCode() const { return words; }
+
+    /**
+     * @brief The words below `rewriteFrom()` that changed in the last update, in ascending order.
+     */
+    const std::vector<uint32_t>& changedWords() const { return changed; }
+
+    /**
+     * @brief The first word that moved in the last update: every word from here on must be
+     *        rewritten. Equals the program size if the number of instructions did not change.
+     */
+    size_t rewriteFrom() const { return tailStart; }
+
+    /** @brief The work done by the last update. */
+    const UpdateStats& stats() const { return updateStats; }
+
+    /** @brief Error messages of the last update, formatted as "file:line: message". */
+    const std::vector<std::string>& diagnostics() const { return messages; }
+
+    /** @brief Whether the last update found errors. */
+    bool hasErrors() const { return failures > 0 || duplicates > 0; }
+
+private:
+    // A label statement; `instruction` is the index of the instruction it names
+    struct LabelDefinition {
+        uint32_t symbol;
+        uint32_t offset;
+        uint32_t line;
+        uint32_t instruction;
+    };
+
+    static constexpr uint32_t NO_SYMBOL = UINT32_MAX;
+
+    uint32_t intern(std::string_view name);
+    uint32_t lineAt(size_t offset) const;
+    bool encode(size_t index);
+    void collectDiagnostics();
+
+    std::string sourceName;
+    std::string source;
+
+    // One entry per instruction, in ROM order
+    std::vector<Instruction> program;
+    std::vector<uint32_t> symbolOf;     // The user symbol of a symbolic A-instruction, else NO_SYMBOL
+    std::vector<uint8_t> failed;        // The instruction could not be encoded
+    std::vector<uint16_t> words;
+
+    std::vector<LabelDefinition> labels;  // In source order
+
+    // One entry per user symbol ever seen; ids never change
+    SymbolTable ids;                    // Name -> id
+    std::vector<int> addresses;         // Current address, -1 if the symbol is unused
+    std::vector<uint32_t> uses;         // Number of A-instructions that name the symbol
+    std::vector<uint32_t> definitions;  // Number of label statements that define it
+
+    size_t failures = 0;
+    size_t duplicates = 0;
+    std::vector<uint32_t> changed;
+    size_t tailStart = 0;
+    UpdateStats updateStats;
+    std::vector<std::string> messages;
+};
+
+#endif // INCREMENTALASSEMBLER_H
@@ -0,0 +1,85 @@
+/**
+ * @file Linker.h
+ * @brief Header file for the linker of separately assembled modules.
+ *
+ * This file declares the `Linker` class, which merges relocatable modules produced by
+ * `Assembler::compile` (or read from .hobj files) into one ROM image. Only the modules
+ * whose source changed need to be assembled again; linking only copies and patches words.
+ *
+ * Key Components:
+ * - Layout: Modules are placed in ROM one after another, in the order they were added.
+ * - Labels: Every label is global. It is defined once, at its module's base plus its
+ *   relative address; a second definition anywhere is an error.
+ * - Variables: Externals that no module defines as a label are variables. They get RAM
+ *   addresses from 16 upwards in order of first use, module by module, exactly like
+ *   `nextAvailableRamAddress` in the assembler.
+ *
+ * Linking the modules of a program therefore gives the same machine code as assembling
+ * their concatenated sources in one go.
+ */
+#ifndef LINKER_H
+#define LINKER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "HackFile.h"
+#include "SymbolTables.h"
+
+/**
+ * @brief Links relocatable modules into one program.
+ *
+ * Typical use:
+ * @code
+ * Linker linker;
+ * linker.addObject("Main.hobj", readObjectFile("Main.hobj"));
+ * linker.addObject("Math.hobj", readObjectFile("Math.hobj"));
+ * if(linker.link()){
+ *     writeHackFile("Prog.hack", linker.machineCode(), OutputFormat::Text);
+ * }
+ * @endcode
+ */
+class Linker {
+public:
+    /**
+     * @brief Appends a module to the program.
+     *
+     * @param name The name used in diagnostics, usually the module's file name.
+     * @param object The module.
+     */
+    void addObject(std::string name, ObjectFile object);
+
+    /**
+     * @brief Lays out the modules, resolves every symbol and patches the words.
+     *
+     * @return bool true if the program linked without errors.
+     */
+    bool link();
+
+    /** @brief The linked program, one word per instruction in ROM order. */
+    const std::vector<uint16_t>& machineCode() const { return words; }
+
+    /** @brief The program's symbol table: the labels of all modules and the variables. */
+    const SymbolTable& symbols() const { return symbolTable; }
+
+    /** @brief Error messages of the last `link()`, formatted as "module: message". */
+    const std::vector<std::string>& diagnostics() const { return messages; }
+
+    /** @brief Whether any error has been reported. */
+    bool hasErrors() const { return !messages.empty(); }
+
+private:
+    struct Module {
+        std::string name;
+        ObjectFile object;
+        uint32_t base = 0;  // ROM address of the module's first word
+    };
+
+    std::vector<Module> modules;
+    SymbolTable symbolTable;
+    int nextAvailableRamAddress = 16;
+    std::vector<uint16_t> words;
+    std::vector<std::string> messages;
+};
+
+#endif // LINKER_H
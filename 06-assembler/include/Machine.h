@@ -0,0 +1,283 @@
+/**
+ * @file Machine.h
+ * @brief Header file for the native Hack computer emulator.
+ *
+ * This file declares a software model of the Hack computer described by
+ * `05-computer-architecture/src/CPU.hdl` and `Memory.hdl`, so assembled programs
+ * can be run at native speed instead of in the Java CPU emulator.
+ *
+ * Key Components:
+ * - Machine: ROM, the A, D and PC registers and the 32K data memory, with the screen
+ *   mapped at `SCREEN` (16384..24575) and the keyboard at `KBD` (24576).
+ * - loadProgram / loadFile: Fill the ROM from machine words, a .hack file in either
+ *   format, or an .asm file that is assembled in memory.
+ * - run / step: Execute instructions with one of two engines that produce identical
+ *   results (see `Engine`).
+ * - ExecutionProfile: Per-instruction and per-RAM-word counters filled while profiling.
+ * - MachineState / KeyEvent: A snapshot of the registers and RAM, and a timestamped key
+ *   press, for the checkpoints and keyboard replay of Replay.h.
+ *
+ * Memory follows `Memory.hdl`: writes to the keyboard or to addresses above it are
+ * ignored, and reads above the keyboard return 0.
+ */
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class SymbolTable;
+
+/**
+ * @brief The two ways a `Machine` can execute its ROM.
+ *
+ * - Interpreter: Fetches every word and decodes the `111a cccc ccdd djjj` fields of each
+ *   C-instruction on the fly.
+ * - Threaded: Decodes the ROM once, when it is loaded, into compact micro-ops with a
+ *   specialized handler per computation, and dispatches them as threaded code. Common
+ *   two-instruction idioms such as `@X` followed by `D=M` run as a single micro-op.
+ */
+enum class Engine {
+    Interpreter,
+    Threaded
+};
+
+/**
+ * @brief Counts collected while a profile is attached to a `Machine`.
+ *
+ * `executions` has one counter per ROM address. `reads` and `writes` have one counter
+ * per RAM address and count the accesses to `M` made by C-instructions; writes to the
+ * keyboard are counted even though they are ignored.
+ */
+struct ExecutionProfile {
+    std::vector<uint64_t> executions = std::vector<uint64_t>(32768);
+    std::vector<uint64_t> reads = std::vector<uint64_t>(32768);
+    std::vector<uint64_t> writes = std::vector<uint64_t>(32768);
+};
+
+/**
+ * @brief Everything a running program can observe or change, saved by `Machine::saveState`.
+ *
+ * The ROM is not included: a state is only meaningful for the program it was saved from.
+ */
+struct MachineState {
+    uint16_t pc = 0;
+    uint16_t a = 0;
+    uint16_t d = 0;
+    bool halted = false;
+    uint64_t cycles = 0;
+    std::array<uint16_t, 32768> ram{};
+};
+
+/**
+ * @brief A change of the keyboard register: from `cycle` executed instructions on, `KBD` holds `key`.
+ */
+struct KeyEvent {
+    uint64_t cycle;
+    uint16_t key;
+};
+
+/**
+ * @brief One Hack computer: instruction memory, CPU registers and data memory.
+ *
+ * A machine runs until a cycle budget is spent, it reaches the usual end-of-program
+ * loop (`(END) @END 0;JMP`, or any two-instruction loop that can never change state)
+ * or PC leaves the loaded program; the last two are reported as halted.
+ *
+ * @code
+ * Machine machine;
+ * machine.loadFile("Rect.asm");
+ * machine.poke(0, 10);
+ * machine.run(1000000);
+ * @endcode
+ */
+class Machine {
+public:
+    static constexpr size_t ROM_SIZE = 32768;
+    static constexpr size_t RAM_SIZE = 32768;   // The whole 15-bit address space
+    static constexpr uint16_t SCREEN = 16384;
+    static constexpr uint16_t KBD = 24576;
+    static constexpr size_t SCREEN_WORDS = 8192;
+
+    /**
+     * @brief Creates a machine with an empty ROM (all `@0`) and cleared registers and RAM.
+     */
+    Machine();
+
+    /**
+     * @brief Replaces the ROM with the given program and clears the machine.
+     *
+     * @param words The machine words in ROM order; the rest of the ROM is zero.
+     * @throws std::runtime_error If the program does not fit in the 32K ROM.
+     */
+    void loadProgram(const std::vector<uint16_t>& words);
+
+    /**
+     * @brief Loads a program from disk and clears the machine.
+     *
+     * Files ending in `.asm` are assembled in memory; anything else is read as a
+     * .hack file in text or binary format.
+     *
+     * @param filename The program to load.
+     * @param symbols If given and the file is assembled, receives the program's labels and variables.
+     * @throws std::runtime_error If the file cannot be read or does not assemble.
+     */
+    void loadFile(const std::string& filename, SymbolTable* symbols = nullptr);
+
+    /**
+     * @brief Sets PC to 0, like the CPU's reset input; registers and RAM are kept.
+     */
+    void reset();
+
+    /**
+     * @brief Zeroes A, D, PC, the cycle counter and all of RAM, including the keyboard.
+     */
+    void clear();
+
+    /**
+     * @brief Executes instructions until the budget is spent or the program halts.
+     *
+     * @param maxCycles The most instructions to execute.
+     * @return uint64_t The number of instructions executed by this call.
+     */
+    uint64_t run(uint64_t maxCycles);
+
+    /**
+     * @brief Executes a single instruction (nothing if the machine has halted).
+     *
+     * @return bool false if the machine has halted.
+     */
+    bool step();
+
+    /**
+     * @brief Attaches a profile that `run()` adds its counts to, or detaches it (nullptr).
+     *
+     * While a profile is attached, `run()` uses a counting version of the interpreter,
+     * whatever the selected engine.
+     */
+    void setProfile(ExecutionProfile* attached) { profile = attached; }
+
+    /** @brief Selects the execution engine used by `run()`; the default is `Engine::Threaded`. */
+    void setEngine(Engine selected) { engine = selected; }
+    Engine currentEngine() const { return engine; }
+
+    /** @brief Whether the program has reached a loop it can never leave or left the loaded program. */
+    bool halted() const { return stopped; }
+
+    /** @brief Total instructions executed since the last `clear()`. */
+    uint64_t cycles() const { return cycleCount; }
+
+    uint16_t pc() const { return programCounter; }
+    uint16_t a() const { return registerA; }
+    uint16_t d() const { return registerD; }
+    void setPC(uint16_t value);
+    void setA(uint16_t value) { registerA = value; }
+    void setD(uint16_t value) { registerD = value; }
+
+    /**
+     * @brief Reads a data memory word as the CPU would see it.
+     *
+     * @param address A 15-bit address; higher bits are ignored.
+     * @return uint16_t The word, or 0 above the keyboard.
+     */
+    uint16_t peek(uint16_t address) const { return ram[address & 0x7FFF]; }
+
+    /**
+     * @brief Writes a data memory word directly, e.g. to set up test inputs.
+     *
+     * Unlike a program's writes, this can also set the keyboard register.
+     *
+     * @param address A 15-bit address; writes above the keyboard are ignored.
+     * @param value The word to store.
+     */
+    void poke(uint16_t address, uint16_t value);
+
+    /** @brief Sets the key code the program reads from `KBD` (0 for no key). */
+    void setKeyboard(uint16_t key);
+
+    /**
+     * @brief Starts appending every change of the keyboard register to `log`, or stops (nullptr).
+     *
+     * Changes made with `setKeyboard` or `poke` are stamped with the current cycle count,
+     * so replaying the log reproduces the run exactly (see `runWithKeys`).
+     */
+    void setKeyLog(std::vector<KeyEvent>* log) { keyLog = log; }
+
+    /** @brief Copies the registers, cycle count, halted flag and RAM into `state`. */
+    void saveState(MachineState& state) const;
+
+    /** @brief Returns to a state saved from a machine running the same program. */
+    void restoreState(const MachineState& state);
+
+    /** @brief The 8K words of the screen memory map, 32 words per row of 512 pixels. */
+    const uint16_t* screen() const { return ram.data() + SCREEN; }
+
+    /** @brief The loaded ROM image. */
+    const std::array<uint16_t, ROM_SIZE>& program() const { return rom; }
+
+    /** @brief Number of words in the loaded program. */
+    size_t programSize() const { return programLength; }
+
+private:
+    // One pre-decoded ROM word (or fused pair of words) for the threaded engine
+    struct MicroOp {
+        uint8_t handler = 0;   // What to execute; see ThreadedEngine.cpp
+        uint8_t tail = 0;      // C-instructions: dest bits, plus 8 if the instruction can jump
+        uint8_t jump = 0;      // The `j` bits
+        uint8_t control = 0;   // The `a c1..c6` bits, for computations without a specialized handler
+        uint16_t operand = 0;  // The value loaded into A by an A-instruction
+    };
+
+    template <bool Profiled>
+    uint64_t runInterpreter(uint64_t maxCycles);
+    uint64_t runThreaded(uint64_t maxCycles);
+    void predecode();
+
+    std::array<uint16_t, ROM_SIZE> rom{};
+    std::vector<MicroOp> microOps;       // ROM_SIZE + 1 entries; the last one wraps PC to 0
+    std::array<uint16_t, RAM_SIZE> ram{};
+    size_t programLength = 0;
+    uint16_t programCounter = 0;
+    uint16_t registerA = 0;
+    uint16_t registerD = 0;
+    uint64_t cycleCount = 0;
+    bool stopped = false;
+    Engine engine = Engine::Threaded;
+    ExecutionProfile* profile = nullptr;
+    std::vector<KeyEvent>* keyLog = nullptr;
+};
+
+/**
+ * @brief Computes the Hack ALU function selected by the six `c` bits of an instruction.
+ *
+ * @param x The x input (the D register).
+ * @param y The y input (A or M).
+ * @param control The bits `zx nx zy ny f no`, with `no` as bit 0.
+ * @return uint16_t The ALU output.
+ */
+inline uint16_t hackAlu(uint16_t x, uint16_t y, unsigned control){
+    uint16_t zx = (control & 0x20) ? 0 : 0xFFFF;
+    uint16_t nx = (control & 0x10) ? 0xFFFF : 0;
+    uint16_t zy = (control & 0x08) ? 0 : 0xFFFF;
+    uint16_t ny = (control & 0x04) ? 0xFFFF : 0;
+    uint16_t f = (control & 0x02) ? 0xFFFF : 0;
+    uint16_t no = (control & 0x01) ? 0xFFFF : 0;
+    x = (x & zx) ^ nx;
+    y = (y & zy) ^ ny;
+    uint16_t out = (static_cast<uint16_t>(x + y) & f) | (x & y & ~f);
+    return out ^ no;
+}
+
+/**
+ * @brief Tests a 3-bit jump condition `j1 j2 j3` (less, equal, greater) against an ALU output.
+ */
+inline bool hackJump(uint16_t out, unsigned jump){
+    int16_t value = static_cast<int16_t>(out);
+    unsigned sign = value < 0 ? 4u : (value == 0 ? 2u : 1u);
+    return (jump & sign) != 0;
+}
+
+#endif // MACHINE_H
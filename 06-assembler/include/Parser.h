@@ -1,38 +1,249 @@
 /**
  * @file Parser.h
  * @brief Header file for the Assembler parser.
- * 
- * This file declares the main parsing function used in the Assembler.
+ *
+ * This file declares the `Assembler` class and the main parsing function.
  * The parser is responsible for reading the assembly language file (.asm),
  * processing its contents, and generating the corresponding machine code.
- * 
+ *
  * Key Components:
- * - parse function: The main entry point for the parsing process.
- * 
+ * - Assembler: Owns all state of one assembly (source, symbol table, RAM allocator,
+ *   machine code and diagnostics), so any number of assemblies can run concurrently.
+ * - Instruction: A compact record locating one instruction inside the source buffer.
+ * - parse function: Assembles one file and writes its .hack output.
+ * - compile: Assembles one module of a larger program into a relocatable `ObjectFile`
+ *   for the `Linker`, so only changed modules need to be assembled again.
+ * - AssemblyStats: Optional counters and phase timings of one assembly, for `--stats`.
+ *
  * The parser implements a two-pass algorithm:
  * 1. First pass: Identify and process labels, building the symbol table.
  * 2. Second pass: Translate instructions to binary, handling variables and symbols.
+ *
+ * The source file is read from disk only once. The first pass records every
+ * instruction as an offset into the in-memory buffer, and the second pass walks
+ * that instruction vector instead of re-reading and re-trimming the file.
  */
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <vector>
+#include "HackFile.h"
+#include "SymbolTables.h"
+
+class ThreadPool;
+
+/**
+ * @brief Location of a single instruction inside the loaded source buffer.
+ *
+ * Comments, whitespace and labels are already stripped, so `offset` points at
+ * the first character of the instruction and `length` covers it exactly.
+ * `line` is the 1-based source line, kept for error messages.
+ */
+struct Instruction {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t line;
+};
+
+/**
+ * @brief Counters and phase timings of one assembly, collected by `Assembler::setStats`.
+ *
+ * Counts are taken while the source is scanned; sizes and the RAM allocator's state are
+ * read once the passes are done. Times are in seconds and stay 0 for phases not run.
+ */
+struct AssemblyStats {
+    size_t bytes = 0;
+    size_t lines = 0;               // Source lines, including blank and comment lines
+    size_t labels = 0;
+    size_t aInstructions = 0;
+    size_t cInstructions = 0;
+    size_t symbolReferences = 0;    // A-instructions naming a symbol rather than a constant
+    size_t variables = 0;
+    int highestVariable = -1;       // RAM address of the last variable allocated; -1 if none
+    size_t words = 0;               // Machine code words (ROM used)
+    size_t removed = 0;             // Instructions removed by `optimize()`
+    double loadSeconds = 0;
+    double firstPassSeconds = 0;
+    double optimizeSeconds = 0;
+    double secondPassSeconds = 0;
+    double writeSeconds = 0;        // Left to the caller, which writes the output
+};
+
+/**
+ * @brief Reads the whole assembly file into memory with a single bulk read.
+ *
+ * @param filename The name of the input assembly file (.asm).
+ * @return std::string The complete file contents.
+ * @throws std::runtime_error If the file cannot be opened or read.
+ */
+std::string loadSource(const std::string& filename);
+
+/**
+ * @brief A self-contained assembler for one Hack program.
+ *
+ * Each instance owns its symbol table, its RAM allocator for variables and its
+ * diagnostics; the only shared data are the read-only opcode tables. Separate
+ * instances can therefore be used from separate threads without locking.
+ *
+ * Typical use:
+ * @code
+ * Assembler assembler;
+ * assembler.loadFile("Prog.asm");
+ * if(assembler.assemble()){
+ *     writeHackFile("Prog.hack", assembler.machineCode(), OutputFormat::Text);
+ * }
+ * @endcode
+ */
+class Assembler {
+public:
+    /**
+     * @brief Reads the source of the program from a file.
+     *
+     * @param filename The name of the input assembly file (.asm).
+     * @throws std::runtime_error If the file cannot be opened or read.
+     */
+    void loadFile(const std::string& filename);
+
+    /**
+     * @brief Uses an in-memory string as the source of the program.
+     *
+     * @param text The complete assembly source.
+     * @param name The name used in diagnostics.
+     */
+    void setSource(std::string text, std::string name = "<input>");
+
+    /**
+     * @brief First pass: tokenizes the source and records label addresses.
+     *
+     * Every line is stripped of its comment and surrounding whitespace exactly once.
+     * Labels are added to the symbol table with their ROM address, and every real
+     * instruction is appended to the instruction vector for the second pass.
+     */
+    void firstPass();
+
+    /**
+     * @brief Optional peephole pass between the two passes.
+     *
+     * Removes redundant A-register reloads, loads that are overwritten unused, jumps to
+     * the next instruction, `D=M` right after `M=D` and unreachable code after an
+     * unconditional jump, then moves the labels to their new addresses. Variables are
+     * allocated beforehand, so they keep the addresses the unoptimized program gives them.
+     *
+     * @return size_t The number of instructions removed.
+     */
+    size_t optimize();
+
+    /**
+     * @brief Second pass: encodes every instruction, allocating variables on first use.
+     */
+    void secondPass();
+
+    /**
+     * @brief Second pass spread over a thread pool; the result is identical to `secondPass()`.
+     *
+     * A serial scan first allocates RAM to the variables in order of first use, which
+     * is the only order-dependent part of the pass. The instructions are then encoded
+     * in independent ranges directly into the preallocated machine code. Programs
+     * shorter than `PARALLEL_MIN_INSTRUCTIONS` are encoded serially.
+     *
+     * @param pool The pool that encodes the ranges.
+     */
+    void secondPass(ThreadPool& pool);
+
+    /**
+     * @brief Runs both passes.
+     *
+     * @param pool If given, the second pass is spread over this pool.
+     * @param optimized Run `optimize()` between the passes.
+     * @return bool true if the program assembled without errors.
+     */
+    bool assemble(ThreadPool* pool = nullptr, bool optimized = false);
+
+    /**
+     * @brief Assembles the source as one module of a larger program.
+     *
+     * Runs the first pass, then encodes every instruction into `object()` instead of
+     * `machineCode()`. Labels are kept relative to the start of the module and no
+     * variables are allocated: a symbol the module does not define as a label may be a
+     * label of another module, so it is left to the linker as an external.
+     *
+     * @return bool true if the module assembled without errors.
+     */
+    bool compile();
+
+    /**
+     * @brief Collects counters and phase timings into `stats`, or stops with `nullptr`.
+     *
+     * Off by default. The first pass then runs a copy of its loop without any counting,
+     * and no clock is read, so assemblies without a report pay nothing for it.
+     *
+     * @param stats Receives the figures of the next `loadFile` and `assemble` calls.
+     */
+    void setStats(AssemblyStats* stats){ statistics = stats; }
+
+    /** @brief Smallest program for which `secondPass(ThreadPool&)` splits the work. */
+    static constexpr size_t PARALLEL_MIN_INSTRUCTIONS = 1 << 16;
+
+    /** @brief The encoded program, one word per instruction in ROM order. */
+    const std::vector<uint16_t>& machineCode() const { return words; }
+
+    /** @brief The relocatable module produced by `compile()`. */
+    const ObjectFile& object() const { return objectCode; }
+
+    /** @brief The instructions recorded by the first pass. */
+    const std::vector<Instruction>& instructions() const { return program; }
+
+    /** @brief The number of instructions the last `optimize()` removed. */
+    size_t removedInstructions() const { return removed; }
+
+    /** @brief The program's symbol table (predefined symbols, labels and variables). */
+    const SymbolTable& symbols() const { return symbolTable; }
+
+    /** @brief Error messages collected so far, formatted as "file:line: message". */
+    const std::vector<std::string>& diagnostics() const { return messages; }
+
+    /** @brief Whether any error has been reported. */
+    bool hasErrors() const { return !messages.empty(); }
+
+private:
+    void error(uint32_t line, const std::string& message);
+    std::string diagnostic(uint32_t line, const std::string& message) const;
+    void allocateVariables();
+    uint16_t encodeInstruction(std::string_view line, bool allocate);
+    template<bool Counting> void scanSource();
+
+    std::string sourceName = "<input>";
+    std::string source;
+    std::vector<Instruction> program;
+    SymbolTable symbolTable;
+    int nextAvailableRamAddress = 16;
+    size_t removed = 0;
+    std::vector<uint16_t> words;
+    ObjectFile objectCode;
+    std::vector<std::string> messages;
+    AssemblyStats* statistics = nullptr;
+};
 
 /**
- * @brief Parses the given assembly file line by line.
- * 
+ * @brief Parses the given assembly file.
+ *
  * This function is the core of the assembler, responsible for:
  * 1. Reading the input .asm file.
  * 2. Processing labels and building the symbol table.
  * 3. Translating A-instructions and C-instructions to binary.
  * 4. Handling variable symbols and assigning memory addresses.
- * 5. Writing the resulting machine code to a .hack file.
- * 
- * The function utilizes helper functions from `SymbolTables` and `BinCodes`
- * for symbol handling and instruction translation.
- * 
+ * 5. Writing the resulting machine code to a .hack file, as text or packed binary.
+ *
+ * Every call uses a fresh `Assembler`, so symbols from one file never leak into the next.
+ *
  * @param filename The name of the input assembly file (.asm).
+ * @param format The format of the .hack file to write.
+ * @param optimized Run the peephole pass (`Assembler::optimize`) between the passes.
+ * @throws std::runtime_error If the file cannot be read or the program has errors.
  */
-void parse(std::string filename);
+void parse(std::string filename, OutputFormat format = OutputFormat::Text, bool optimized = false);
 
 #endif // PARSER_H
@@ -0,0 +1,76 @@
+/**
+ * @file Profiler.h
+ * @brief Header file for the reports of the emulator's profiling mode.
+ *
+ * This file declares the functions that turn an `ExecutionProfile` into reports. Cycles
+ * are attributed to the labels of the program, taken from the assembler's symbol table,
+ * so the reports speak in terms of the source (`LOOP`, `Ball.move`, ...) rather than ROM
+ * addresses.
+ *
+ * Key Components:
+ * - labelRanges: Splits the ROM into the address ranges that start at each label.
+ * - writeProfileReport: Sorted text: instructions per label, the hottest instructions,
+ *   and RAM reads and writes per region (registers, variables, stack, heap, `SCREEN`,
+ *   `KBD`) and per word.
+ * - writeCollapsedStacks: One `frame;frame;... count` line per executed address, the
+ *   input format of flame graph tools such as `flamegraph.pl`.
+ */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Machine.h"
+#include "SymbolTables.h"
+
+/**
+ * @brief The ROM addresses [begin, end) that follow a label, up to the next label.
+ */
+struct LabelRange {
+    std::string name;   // Labels at the same address are joined with '/'
+    uint16_t begin;
+    uint16_t end;
+};
+
+/**
+ * @brief Attributes every address of a program to the closest label before it.
+ *
+ * @param symbols The program's symbol table; an empty table gives a single range.
+ * @param programSize Number of words in the program.
+ * @return std::vector<LabelRange> The ranges in address order. Code before the first
+ *         label is named "<start>".
+ */
+std::vector<LabelRange> labelRanges(const SymbolTable& symbols, size_t programSize);
+
+/**
+ * @brief Writes the text report of a profile.
+ *
+ * @param out The stream to write to.
+ * @param program The name of the profiled program, used in the title.
+ * @param profile The collected counts.
+ * @param labels The label ranges from `labelRanges`.
+ * @param symbols The program's symbol table, used to name RAM words.
+ * @param top How many of the hottest instructions and RAM words to list.
+ */
+void writeProfileReport(std::ostream& out, const std::string& program, const ExecutionProfile& profile,
+                        const std::vector<LabelRange>& labels, const SymbolTable& symbols, size_t top = 20);
+
+/**
+ * @brief Writes a profile as collapsed stacks for flame graphs.
+ *
+ * Every executed address becomes one line `program;label;ROM[address] count`. Labels
+ * of the VM translator's form `Function$label` get their function as an extra frame,
+ * so the graph groups them by function.
+ *
+ * @param out The stream to write to.
+ * @param program The name of the profiled program, used as the root frame.
+ * @param profile The collected counts.
+ * @param labels The label ranges from `labelRanges`.
+ */
+void writeCollapsedStacks(std::ostream& out, const std::string& program, const ExecutionProfile& profile,
+                          const std::vector<LabelRange>& labels);
+
+#endif // PROFILER_H
@@ -0,0 +1,100 @@
+/**
+ * @file Replay.h
+ * @brief Header file for emulator checkpoints and deterministic keyboard replay.
+ *
+ * This file declares what is needed to reproduce a long interactive run, such as a bug
+ * deep into `Pong.asm`, without running it again from reset: checkpoint files holding a
+ * `MachineState`, and key logs holding the keyboard input with cycle timestamps.
+ *
+ * Key Components:
+ * - writeCheckpoint / readCheckpoint: Save and restore a machine's state on disk.
+ * - programFingerprint: Identifies the program a checkpoint belongs to.
+ * - writeKeyLog / readKeyLog: Store the `KeyEvent`s recorded by `Machine::setKeyLog`.
+ * - runWithKeys: Runs a machine while applying key events at their exact cycles.
+ *
+ * Cycle counts are part of the state, so a key log recorded from reset also replays
+ * from any checkpoint of the same run: events before the checkpoint are already in its
+ * RAM and are skipped.
+ *
+ * Checkpoint format (.hsnp, all integers little-endian):
+ * - Bytes 0..3: Magic "HSNP".
+ * - Bytes 4..5: Format version, currently 1.
+ * - Bytes 6..7: Flags; bit 0 is set if the machine had halted.
+ * - Bytes 8..11: Fingerprint of the program.
+ * - Bytes 12..19: Cycle count.
+ * - Bytes 20..25: PC, A and D (2 bytes each).
+ * - Bytes 26..27: Reserved, written as 0.
+ * - Then RAM[0] to RAM[KBD], 2 bytes per word (nothing can be stored above the keyboard).
+ *
+ * Key log format (text): one `cycle key` pair of decimal numbers per line, in cycle
+ * order. Blank lines and `//` comments are ignored.
+ */
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Machine.h"
+
+/**
+ * @brief Computes a 32-bit FNV-1a hash of the loaded program's words.
+ *
+ * @param machine The machine whose program is hashed.
+ * @return uint32_t The fingerprint stored in checkpoints.
+ */
+uint32_t programFingerprint(const Machine& machine);
+
+/**
+ * @brief Saves the machine's state in a checkpoint file.
+ *
+ * @param filename The file to write.
+ * @param machine The machine to save.
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void writeCheckpoint(const std::string& filename, const Machine& machine);
+
+/**
+ * @brief Restores a machine from a checkpoint file.
+ *
+ * @param filename The file to read.
+ * @param machine A machine with the checkpoint's program loaded.
+ * @throws std::runtime_error If the file cannot be read, is not a checkpoint, or was
+ *         saved from a different program.
+ */
+void readCheckpoint(const std::string& filename, Machine& machine);
+
+/**
+ * @brief Writes key events as a key log.
+ *
+ * @param filename The file to write.
+ * @param events The events in cycle order.
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void writeKeyLog(const std::string& filename, const std::vector<KeyEvent>& events);
+
+/**
+ * @brief Reads a key log.
+ *
+ * @param filename The file to read.
+ * @return std::vector<KeyEvent> The events in cycle order.
+ * @throws std::runtime_error If the file cannot be read, has a malformed line, or its
+ *         cycles decrease.
+ */
+std::vector<KeyEvent> readKeyLog(const std::string& filename);
+
+/**
+ * @brief Runs a machine like `Machine::run`, setting the keyboard as the events say.
+ *
+ * An event takes effect when the machine has executed exactly `event.cycle`
+ * instructions, so the same events always produce the same run. Events before the
+ * machine's current cycle count are skipped.
+ *
+ * @param machine The machine to run.
+ * @param events The key events in cycle order.
+ * @param maxCycles The most instructions to execute.
+ * @return uint64_t The number of instructions executed by this call.
+ */
+uint64_t runWithKeys(Machine& machine, const std::vector<KeyEvent>& events, uint64_t maxCycles);
+
+#endif // REPLAY_H
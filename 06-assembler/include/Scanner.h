@@ -0,0 +1,90 @@
+/**
+ * @file Scanner.h
+ * @brief Header file for the line scanner of the Assembler.
+ * 
+ * This file declares the lexer that splits an in-memory assembly source into
+ * statements: one per line, with the comment and surrounding whitespace removed.
+ * 
+ * Key Components:
+ * - Statement: A zero-copy view of one statement and the line it came from.
+ * - LineScanner: Walks the source 64 bytes at a time. Each block is classified with
+ *   SIMD compares (AVX2 or SSE2, with a scalar fallback) into bitmasks of newlines,
+ *   "//" comment starts and non-blank characters, and statements are cut out of those
+ *   masks with bit operations instead of per-character branches.
+ * 
+ * Blanks are ' ', '\t' and '\r', so tab-indented sources and CRLF line endings
+ * produce the same statements as space-indented LF sources.
+ */
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief One non-empty statement of the source.
+ * 
+ * `text` points into the scanned buffer and stays valid as long as that buffer does.
+ */
+struct Statement {
+    std::string_view text;
+    uint32_t offset;  // Byte offset of `text` in the source
+    uint32_t line;    // 1-based source line
+};
+
+/**
+ * @brief Single-pass scanner that yields the statements of a source buffer in order.
+ * 
+ * @code
+ * LineScanner scanner(source);
+ * Statement statement;
+ * while(scanner.next(statement)){
+ *     // statement.text is e.g. "D=M" or "(LOOP)"
+ * }
+ * @endcode
+ */
+class LineScanner {
+public:
+    /**
+     * @brief Prepares to scan the given buffer; nothing is copied.
+     * 
+     * @param source The complete assembly source.
+     */
+    explicit LineScanner(std::string_view source);
+
+    /**
+     * @brief Finds the next statement, skipping blank and comment-only lines.
+     * 
+     * @param statement Receives the statement.
+     * @return bool false once the end of the source has been reached.
+     */
+    bool next(Statement& statement);
+
+    /**
+     * @brief Names the block classifier selected for this machine.
+     * 
+     * @return const char* "avx2", "sse2" or "scalar".
+     */
+    static const char* implementation();
+
+private:
+    void loadBlock();
+    bool endLine(Statement& statement);
+
+    std::string_view source;
+    size_t blockBase = 0;         // Source offset of the current 64-byte block
+    size_t nextBlock = 0;         // Source offset of the block after it
+    unsigned position = 64;       // Next bit of the current block to examine; 64 = load a block
+    uint64_t newlines = 0;        // Bit i set: byte i of the block is '\n'
+    uint64_t commentMarks = 0;    // Bit i set: byte i is the second '/' of a "//"
+    uint64_t nonBlanks = 0;       // Bit i set: byte i is not ' ', '\t', '\r' or '\n'
+    bool previousSlash = false;   // Last byte of the previous block was '/'
+    bool inComment = false;       // Skipping the rest of the line after "//"
+    bool finished = false;
+    size_t tokenStart = SIZE_MAX; // Start of the current line's statement, if any yet
+    size_t tokenEnd = 0;          // One past its last non-blank character so far
+    uint32_t line = 1;
+};
+
+#endif // SCANNER_H
@@ -0,0 +1,140 @@
+/**
+ * @file StreamAssembler.h
+ * @brief Header file for the single-pass streaming assembler behind `Assembler --stream`.
+ *
+ * This file declares `StreamAssembler`, which reads a program from a stream once, in
+ * fixed-size chunks, and writes every word as soon as it is encoded. Nothing of the
+ * source is kept, so programs of any size can be piped in from a code generator.
+ *
+ * Key Components:
+ * - Fixups: An A-instruction naming a symbol that is not yet a label is written as a
+ *   placeholder and recorded with its symbol. When the label appears, its fixups are
+ *   patched and dropped; whatever is left at the end of the input is a variable.
+ * - Variables: Allocated from RAM[16] at the end of the input, in order of first use,
+ *   exactly like `nextAvailableRamAddress` in the two-pass assembler. (Until the input
+ *   ends, any unknown symbol may still turn out to be a label.)
+ * - Output: A seekable output (a file) is written straight through and patched in place,
+ *   so memory is bounded by the symbols and the unresolved references, not by the size of
+ *   the program. A pipe cannot be patched, so words are held back from the oldest
+ *   unresolved one on and released as soon as everything before them is resolved.
+ *
+ * The output is identical to `Assembler::assemble` on the same source.
+ */
+#ifndef STREAMASSEMBLER_H
+#define STREAMASSEMBLER_H
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "HackFile.h"
+#include "SymbolTables.h"
+
+/**
+ * @brief Assembles a program read from a stream in one pass, writing to another stream.
+ *
+ * Typical use:
+ * @code
+ * StreamAssembler assembler(std::cout, OutputFormat::Text);
+ * if(!assembler.assemble(std::cin)){
+ *     for(const std::string& message : assembler.diagnostics()) std::cerr << message << '\n';
+ * }
+ * @endcode
+ */
+class StreamAssembler {
+public:
+    /**
+     * @param out Where the machine code is written. It is patched in place if it is seekable.
+     * @param format The output format. The binary header holds the word count, so binary
+     *        output needs a seekable stream.
+     * @param name The name used in diagnostics.
+     * @throws std::invalid_argument For binary output to a stream that cannot seek.
+     */
+    StreamAssembler(std::ostream& out, OutputFormat format, std::string name = "<stdin>");
+
+    /**
+     * @brief Reads and assembles the whole input.
+     *
+     * @param in The assembly source.
+     * @return bool true if the program assembled without errors. Unlike the batch
+     *         assembler, the output has already been written when an error is found,
+     *         so it must be discarded.
+     * @throws std::runtime_error If the input cannot be read or the output cannot be written.
+     */
+    bool assemble(std::istream& in);
+
+    /** @brief Number of words written. */
+    uint64_t size() const { return wordCount; }
+
+    /** @brief Most references that were waiting for their symbol at any one time. */
+    size_t maxPendingReferences() const { return peakPending; }
+
+    /** @brief Most words held back in memory at any one time. */
+    size_t maxBufferedWords() const { return peakBuffered; }
+
+    /** @brief Error messages, formatted as "name:line: message", in line order. */
+    std::vector<std::string> diagnostics() const;
+
+    /** @brief Whether any error has been reported. */
+    bool hasErrors() const { return !messages.empty(); }
+
+    /** @brief Source bytes read per chunk. */
+    static constexpr size_t CHUNK_SIZE = 1 << 20;
+
+    /** @brief Words held in memory before a seekable output is written to. */
+    static constexpr size_t FLUSH_WORDS = 1 << 16;
+
+private:
+    // An A-instruction waiting for its symbol's address
+    struct Fixup {
+        uint64_t word;
+        uint64_t line;
+    };
+
+    struct Symbol {
+        int address = -1;               // Set when the label is defined or the variable allocated
+        bool label = false;
+        bool listed = false;            // Already in `unresolved`
+        std::vector<Fixup> fixups;
+    };
+
+    void scan(std::string_view text, uint64_t firstLine);
+    void statement(std::string_view text, uint64_t line);
+    uint32_t symbolId(std::string_view name);
+    void resolve(Symbol& symbol);
+    void emit(uint16_t word, bool ready);
+    void patch(uint64_t index, uint16_t word);
+    void flush(bool all);
+    void write(const uint16_t* words, size_t count, uint64_t first);
+    void writeAt(uint64_t position, const char* bytes, size_t length);
+    void error(uint64_t line, const std::string& message);
+
+    std::ostream& out;
+    OutputFormat format;
+    std::string sourceName;
+    bool seekable = false;
+    std::streamoff origin = 0;         // Stream position of the first byte of output
+    uint64_t end = 0;                  // Bytes written so far, relative to `origin`
+    bool atEnd = true;                 // The stream is positioned at `end`, not at a patched word
+
+    SymbolTable ids;                   // Name -> index into `symbols`
+    std::vector<Symbol> symbols;
+    std::vector<uint32_t> unresolved;  // Symbols used before any label defined them, in order of first use
+    size_t pending = 0;
+    size_t peakPending = 0;
+
+    uint64_t wordCount = 0;
+    uint64_t bufferStart = 0;          // Index of the first word not written yet
+    size_t head = 0;                   // Position of word `bufferStart` in `buffer`
+    std::vector<uint16_t> buffer;      // Words not written yet, from `head` on
+    std::vector<uint8_t> ready;        // Per buffered word: it has its final value
+    size_t firstWaiting = 0;           // Position in `buffer`; the words before it are all ready
+    size_t peakBuffered = 0;
+
+    std::vector<std::pair<uint64_t, std::string>> messages;  // (line, "name:line: message")
+};
+
+#endif // STREAMASSEMBLER_H
@@ -1,51 +1,179 @@
 /**
  * @file SymbolTables.h
  * @brief Header file for symbol table management in the Assembler.
- * 
+ *
  * This file declares functions and data structures for managing symbols
  * in the Hack assembly language. It includes support for predefined symbols,
  * user-defined labels, and variables.
- * 
+ *
  * Key Components:
- * - Symbol table: An unordered map storing symbol names and their addresses.
- * - Computation, destination, and jump maps: For C-instruction translation.
+ * - SymbolTable: A per-assembly flat hash table storing symbol names and their addresses.
+ * - Computation, destination, and jump tables: Compile-time opcode tables for
+ *   C-instruction translation, with perfect-hash lookups over `string_view`.
  * - Functions for adding and retrieving symbol addresses.
- * 
+ *
  * The symbol table is a crucial part of the assembler, allowing efficient
  * lookup and management of symbols throughout the assembly process.
+ *
+ * Symbol tables hold per-program state and are owned by each `Assembler`. The opcode
+ * tables never change and are shared, read-only, by every assembly in the process.
  */
 #ifndef SYMBOLTABLES_H
 #define SYMBOLTABLES_H
 
+#include <array>
+#include <cstdint>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 /**
- * @brief Adds a new symbol to the symbol table.
- * 
- * This function is used to add labels and variables to the symbol table.
- * If the symbol already exists, it will not be added again.
- * 
- * @param symbol The name of the symbol to add.
- * @param address The memory address associated with the symbol.
+ * @brief One entry of an opcode table: an assembly mnemonic and its bit pattern.
+ *
+ * For the computation table `bits` holds the 7 bits `a c1..c6`; for the
+ * destination and jump tables it holds the 3 `d` or `j` bits.
  */
-void addSymbol(const std::string& symbol, int address);
+struct Mnemonic {
+    std::string_view name;
+    uint16_t bits;
+};
 
 /**
- * @brief Retrieves the address of a symbol from the symbol table.
- * 
- * This function looks up a symbol in the table and returns its associated address.
- * If the symbol is not found, it returns -1.
- * 
- * @param symbol The name of the symbol to look up.
- * @return int The address of the symbol, or -1 if not found.
+ * @brief What a user-defined symbol names: a ROM address (label) or a RAM address (variable).
  */
-int getSymbolAddress(const std::string& symbol);
+enum class SymbolKind : uint8_t {
+    Label,
+    Variable
+};
 
-// External declarations for symbol maps
-extern std::unordered_map<std::string, int> symbolTable;
-extern std::unordered_map<std::string, std::string> computationMap;
-extern std::unordered_map<std::string, std::string> destinationMap;
-extern std::unordered_map<std::string, std::string> jumpMap;
+/**
+ * @brief One label or variable, as listed by `SymbolTable::entries`.
+ *
+ * The name points into the table and stays valid until the table is modified.
+ */
+struct SymbolEntry {
+    std::string_view name;
+    int address;
+    SymbolKind kind;
+};
+
+/**
+ * @brief Symbol table of a single program: predefined symbols, labels and variables.
+ *
+ * The predefined symbols (`SP`..`THAT`, `R0`..`R15`, `SCREEN`, `KBD`) are baked in at
+ * compile time; labels and variables live in a flat open-addressing hash table whose
+ * names are interned in a single character arena. All lookups take a `string_view`,
+ * so no temporary strings are built. Tables are independent of each other, so separate
+ * assemblies can run concurrently as long as each uses its own table.
+ */
+class SymbolTable {
+public:
+    /**
+     * @brief Creates a table that holds only the predefined symbols.
+     */
+    SymbolTable();
+
+    /**
+     * @brief Adds a new symbol to the symbol table.
+     *
+     * This function is used to add labels and variables to the symbol table.
+     * If the symbol already exists, it will not be added again.
+     *
+     * @param symbol The name of the symbol to add.
+     * @param address The memory address associated with the symbol (non-negative).
+     * @param kind Whether the symbol is a label or a variable.
+     * @return bool true if the symbol was added, false if it already existed.
+     */
+    bool addSymbol(std::string_view symbol, int address, SymbolKind kind = SymbolKind::Variable);
+
+    /**
+     * @brief Looks a symbol up and adds it if it is missing, hashing the name only once.
+     *
+     * @param symbol The name of the symbol.
+     * @param address The address to give the symbol if it is new (non-negative).
+     * @param kind Whether a new symbol is a label or a variable.
+     * @return std::pair<int, bool> The symbol's address, and true if it was newly added.
+     */
+    std::pair<int, bool> insert(std::string_view symbol, int address, SymbolKind kind = SymbolKind::Variable);
+
+    /**
+     * @brief Retrieves the address of a symbol from the symbol table.
+     *
+     * This function looks up a symbol in the table and returns its associated address.
+     * If the symbol is not found, it returns -1.
+     *
+     * @param symbol The name of the symbol to look up.
+     * @return int The address of the symbol, or -1 if not found.
+     */
+    int getSymbolAddress(std::string_view symbol) const;
+
+    /** @brief Number of labels and variables (predefined symbols are not counted). */
+    size_t size() const { return count; }
+
+    /**
+     * @brief Lists the labels or the variables of the program.
+     *
+     * @param kind Which symbols to list.
+     * @return std::vector<SymbolEntry> The symbols, sorted by address and then by name.
+     */
+    std::vector<SymbolEntry> entries(SymbolKind kind) const;
+
+private:
+    // One slot of the open-addressing table; `address` is -1 for an empty slot
+    struct Slot {
+        uint32_t hash = 0;
+        uint32_t nameOffset = 0;
+        uint32_t nameLength = 0;
+        int32_t address = -1;
+        SymbolKind kind = SymbolKind::Variable;
+    };
+
+    static constexpr size_t INITIAL_CAPACITY = 64;
+
+    size_t findSlot(std::string_view symbol, uint32_t hash) const;
+    void grow();
+
+    std::vector<Slot> slots;
+    std::string arena;  // The characters of every symbol name, back to back
+    size_t count = 0;
+};
+
+/**
+ * @brief Looks up the 7 `a c1..c6` bits of a computation mnemonic (e.g. "D+M").
+ *
+ * @param mnemonic The comp part of a C-instruction.
+ * @return int The bit pattern, or -1 if the mnemonic is unknown.
+ */
+int lookupComputation(std::string_view mnemonic);
+
+/**
+ * @brief Looks up the 3 `d` bits of a destination mnemonic (e.g. "AM", or "" for none).
+ *
+ * @param mnemonic The dest part of a C-instruction.
+ * @return int The bit pattern, or -1 if the mnemonic is unknown.
+ */
+int lookupDestination(std::string_view mnemonic);
+
+/**
+ * @brief Looks up the address of a predefined symbol (e.g. "R13" or "SCREEN").
+ *
+ * @param symbol The symbol name.
+ * @return int The fixed address, or -1 if the name is not predefined.
+ */
+int lookupPredefinedSymbol(std::string_view symbol);
+
+/**
+ * @brief Looks up the 3 `j` bits of a jump mnemonic (e.g. "JGT", or "" for none).
+ *
+ * @param mnemonic The jump part of a C-instruction.
+ * @return int The bit pattern, or -1 if the mnemonic is unknown.
+ */
+int lookupJump(std::string_view mnemonic);
+
+// Read-only opcode tables, canonical spelling first for every bit pattern
+extern const std::array<Mnemonic, 34> computationMap;
+extern const std::array<Mnemonic, 8> destinationMap;
+extern const std::array<Mnemonic, 8> jumpMap;
 
 #endif // SYMBOLTABLES_H
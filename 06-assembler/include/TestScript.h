@@ -0,0 +1,106 @@
+/**
+ * @file TestScript.h
+ * @brief Header file for the headless runner of CPU emulator test scripts.
+ *
+ * This file declares a parser and an executor for the `.tst` scripts of the course
+ * (`Mult.tst`, `FillAutomatic.tst`, ...), so they can run on `Machine` instead of the
+ * interactive Java CPU emulator.
+ *
+ * Key Components:
+ * - parseTestScript: Reads a script into a tree of commands: `load`, `output-file`,
+ *   `compare-to`, `output-list`, `set`, `output`, `ticktock`, `repeat N { ... }`,
+ *   `while COND { ... }` and `echo`.
+ * - runTestScript: Executes a script, formats the `output-list` columns (`%D2.6.2`,
+ *   `%X1.4.1`, `%B1.16.1`, `%S1.4.1`) exactly like the Java tools and compares every
+ *   output line with the `.cmp` file as it is produced.
+ *
+ * Scripts that contain a `repeat` without a count are meant to be watched in the
+ * emulator (e.g. `Fill.tst`); they are reported as skipped rather than run.
+ */
+#ifndef TESTSCRIPT_H
+#define TESTSCRIPT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Machine.h"
+
+/**
+ * @brief A value a script can read or set: `RAM[n]`, `A`, `D`, `PC` or `time`.
+ */
+struct ScriptVariable {
+    enum Kind { Ram, A, D, PC, Time } kind = Ram;
+    uint16_t address = 0;   // For Ram
+    std::string name;       // As written in the script, used as the column header
+};
+
+/**
+ * @brief One column of an `output-list`, e.g. `RAM[0]%D2.6.2`.
+ */
+struct OutputColumn {
+    ScriptVariable variable;
+    char format = 'B';      // B(inary), D(ecimal), X (hex) or S(tring)
+    unsigned padLeft = 1;
+    unsigned length = 16;
+    unsigned padRight = 1;
+};
+
+/**
+ * @brief One script command; `repeat` and `while` hold their body.
+ */
+struct ScriptCommand {
+    enum Kind { Load, OutputFile, CompareTo, OutputList, Set, Output, TickTock, Repeat, While, Echo } kind;
+    unsigned line = 0;
+    std::string argument;               // File name or echo text
+    ScriptVariable variable;            // Set, While
+    int value = 0;                      // Set, While: the operand
+    std::string comparison;             // While: =, <>, <, >, <= or >=
+    uint64_t count = 0;                 // Repeat
+    std::vector<OutputColumn> columns;  // OutputList
+    std::vector<ScriptCommand> body;    // Repeat, While
+};
+
+/**
+ * @brief A parsed test script.
+ */
+struct TestScript {
+    std::string file;
+    std::vector<ScriptCommand> commands;
+    bool interactive = false;   // Contains a `repeat` without a count
+};
+
+/**
+ * @brief Parses the text of a .tst file.
+ *
+ * @param text The file contents.
+ * @param file The file name used in error messages.
+ * @return TestScript The commands of the script.
+ * @throws std::runtime_error With a "file:line: message" description of the first error.
+ */
+TestScript parseTestScript(const std::string& text, const std::string& file);
+
+/**
+ * @brief The outcome of running one script.
+ */
+struct TestResult {
+    enum class Status { Passed, Failed, Skipped, Error } status = Status::Passed;
+    std::string message;        // Why the script failed, was skipped or could not run
+    std::string output;         // The output lines produced, as they would be written to the .out file
+    std::string outputFile;     // The file named by `output-file`, if any
+    size_t lines = 0;           // Number of output lines, including the header
+    uint64_t cycles = 0;        // Instructions executed
+};
+
+/**
+ * @brief Loads, parses and runs a script on a fresh machine.
+ *
+ * Files named by `load` and `compare-to` are looked up next to the script. The script
+ * fails at the first output line that differs from the .cmp file.
+ *
+ * @param filename The .tst file.
+ * @param engine The execution engine of the machine.
+ * @return TestResult The outcome; errors are reported in it, not thrown.
+ */
+TestResult runTestScript(const std::string& filename, Engine engine = Engine::Threaded);
+
+#endif // TESTSCRIPT_H
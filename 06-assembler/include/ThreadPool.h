@@ -0,0 +1,96 @@
+/**
+ * @file ThreadPool.h
+ * @brief Header file for the work-stealing thread pool used by the Assembler.
+ * 
+ * This file declares a small, fixed-size thread pool. Each worker thread owns a
+ * task queue; when its own queue runs dry it steals work from the other queues,
+ * so a few slow tasks (e.g. one huge .asm file) do not leave the other cores idle.
+ * 
+ * Key Components:
+ * - submit: Queues a task. Tasks submitted from a worker go to that worker's own queue.
+ * - wait: Blocks until every submitted task has finished.
+ * - parallelFor: Splits an index range into chunks and runs them on the pool.
+ */
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A fixed-size pool of worker threads with per-worker queues and work stealing.
+ * 
+ * A worker takes tasks from the back of its own queue (most recently queued first,
+ * which keeps its caches warm) and steals from the front of the other queues.
+ * Tasks must not throw; wrap any work that can fail and record the failure instead.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Starts the worker threads.
+     * 
+     * @param threadCount Number of workers; 0 selects one per hardware thread.
+     */
+    explicit ThreadPool(unsigned threadCount = 0);
+
+    /**
+     * @brief Finishes all queued tasks, then stops and joins the workers.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Queues a task for execution on one of the workers.
+     * 
+     * @param task The work to run.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Blocks until every task submitted so far has finished.
+     */
+    void wait();
+
+    /**
+     * @brief Runs `body(begin, end)` over consecutive chunks of [0, count) and waits for all of them.
+     * 
+     * @param count Size of the index range.
+     * @param chunkSize Maximum number of indices per task (at least 1).
+     * @param body Called once per chunk with a half-open index range.
+     */
+    void parallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& body);
+
+    /** @brief Number of worker threads. */
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool takeTask(size_t self, std::function<void()>& task);
+    void run(size_t self);
+    void runReserved(size_t self);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex stateMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    size_t queued = 0;      // Tasks sitting in some queue
+    size_t unfinished = 0;  // Tasks submitted but not yet completed
+    bool stopping = false;
+    std::atomic<size_t> nextQueue{0};
+};
+
+#endif // THREADPOOL_H
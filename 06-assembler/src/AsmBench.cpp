@@ -0,0 +1,561 @@
+/**
+ * @file AsmBench.cpp
+ * @brief Main entry point for the assembler benchmark and its program generator.
+ *
+ * This file measures how fast the `Assembler` handles large inputs, phase by phase,
+ * so regressions can be tracked and speedups verified on real workloads.
+ *
+ * Key Components:
+ * - Generator: Writes a synthetic program shaped like the output of the VM translator
+ *   of projects 7 and 8: functions, push/pop sequences on the stack, comparisons with
+ *   their own labels, loops, calls and many static variables. Headers such as
+ *   `// push constant 7`, documentation blocks and inline comments make up a large part
+ *   of the text; indentation, trailing blanks and line endings are mixed at random.
+ * - Harness: Times reading the file, the first pass (scanning and labels), the second
+ *   pass (encoding, serial and optionally on a pool), writing the .hack output, and the
+ *   whole `parse()` call, over repeated runs after a warm-up run.
+ * - Report: JSON with the median, minimum, mean and maximum time of every phase and its
+ *   throughput in lines/s and MB/s of source; a readable table goes to standard error.
+ * - Exit status: 0 on success, 1 if an input cannot be read or fails to assemble, 2 for
+ *   usage errors.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../include/CommandLine.h"
+#include "../include/HackFile.h"
+#include "../include/Parser.h"
+#include "../include/SymbolTables.h"
+#include "../include/ThreadPool.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+/**
+ * @brief Settings collected from the command line.
+ */
+struct Options {
+    vector<string> inputs;        // Programs to benchmark; empty: a generated one
+    string generate;              // Write a generated program to this file and exit
+    string output;                // JSON report file; empty: standard output
+    uint64_t lines = 1000000;     // Size of the generated program
+    uint64_t variables = 2000;    // Distinct variables in the generated program
+    uint64_t seed = 1;
+    uint64_t repeat = 5;          // Timed runs per input
+    bool parallel = false;        // Also time the second pass on a pool
+    unsigned threads = 0;
+};
+
+/**
+ * @brief Prints the command-line help.
+ */
+static void printUsage(){
+    cout<<"Usage: AsmBench [options] [input.asm...]\n"
+        <<"       AsmBench --generate FILE [--lines N] [--variables N] [--seed N]\n"
+        <<"\n"
+        <<"Times the phases of the assembler on each input and writes a JSON report. Without\n"
+        <<"inputs, a synthetic program of --lines lines is generated and benchmarked.\n"
+        <<"\n"
+        <<"Options:\n"
+        <<"  -r, --repeat N        Timed runs per input, after one warm-up run (default 5)\n"
+        <<"  -j, --jobs N          Also time the parallel second pass with N threads (0: all cores)\n"
+        <<"  -o, --output FILE     Write the JSON report to FILE instead of standard output\n"
+        <<"  --generate FILE       Write a synthetic program to FILE and exit\n"
+        <<"  --lines N             Lines of the synthetic program (default 1000000)\n"
+        <<"  --variables N         Distinct variables in it (default 2000, at most 16000)\n"
+        <<"  --seed N              Seed of the synthetic program (default 1)\n"
+        <<"  -h, --help            Show this help\n";
+}
+
+/**
+ * @brief Reads the options and the inputs from the command line.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Command-line arguments.
+ * @param options Receives the parsed settings.
+ * @return bool false if the program should exit (after `--help`).
+ * @throws std::invalid_argument For unknown options or bad values.
+ */
+static bool parseArguments(int argc, char* argv[], Options& options){
+    for(int i = 1; i < argc; i++){
+        string argument = argv[i];
+        auto value = [&]() -> string {
+            if(i + 1 >= argc){
+                throw invalid_argument("Missing value for " + argument);
+            }
+            return argv[++i];
+        };
+
+        if(argument == "-h" || argument == "--help"){
+            printUsage();
+            return false;
+        }else if(argument == "-r" || argument == "--repeat"){
+            options.repeat = max<uint64_t>(1, parseNumber(value(), 1000000));
+        }else if(argument == "-j" || argument == "--jobs"){
+            options.parallel = true;
+            options.threads = static_cast<unsigned>(parseNumber(value(), 1024));
+        }else if(argument == "-o" || argument == "--output"){
+            options.output = value();
+        }else if(argument == "--generate"){
+            options.generate = value();
+        }else if(argument == "--lines"){
+            options.lines = max<uint64_t>(1, parseNumber(value(), 1000000000));
+        }else if(argument == "--variables"){
+            options.variables = max<uint64_t>(1, parseNumber(value(), 16000));
+        }else if(argument == "--seed"){
+            options.seed = parseNumber(value(), UINT64_MAX);
+        }else if(argument.size() > 1 && argument[0] == '-'){
+            throw invalid_argument("Unknown option: " + argument);
+        }else{
+            options.inputs.push_back(argument);
+        }
+    }
+    if(!options.generate.empty() && !options.inputs.empty()){
+        throw invalid_argument("--generate takes no inputs");
+    }
+    return true;
+}
+
+/**
+ * @brief Writes a synthetic program in the style of the VM translator's output.
+ *
+ * Builds the text one VM command at a time until it has at least the requested number of
+ * lines; the last command is always complete. Every command expands to the instructions
+ * the translator would emit, usually under a `// command` header; comparisons, calls and
+ * loops define labels as they go.
+ *
+ * Real programs fit in the 32K ROM, but the benchmark inputs may be far larger. The
+ * generator therefore tracks the ROM address of every instruction and only references
+ * labels whose address fits in an A-instruction; past the limit, jumps and calls go to
+ * the functions defined below it. The output always assembles without errors.
+ */
+class ProgramGenerator {
+public:
+    ProgramGenerator(uint64_t seed, uint64_t variables) : random(seed) {
+        static const char* const CLASSES[] = {
+            "Main", "Ball", "Bat", "PongGame", "Screen", "Math", "Memory", "Output",
+            "Keyboard", "String", "Array", "Sys", "Square", "SquareGame", "List", "Fraction"
+        };
+        for(const char* name : CLASSES){
+            classes.push_back(name);
+        }
+        for(uint64_t i = 0; i < variables; i++){
+            statics.push_back(classes[i % classes.size()] + "." + to_string(i / classes.size()));
+        }
+    }
+
+    string generate(uint64_t lines){
+        text.reserve(lines * 14);
+        while(lineCount < lines){
+            if(function.empty() || pick(100) < 2){
+                beginFunction();
+            }
+            command();
+        }
+        return move(text);
+    }
+
+private:
+    uint64_t pick(uint64_t range){ return nextRandom(random) % range; }
+
+    // One source line: random indentation, the text, sometimes an inline comment or
+    // trailing blanks, and LF or (less often) CRLF
+    void line(const string& content, const char* remark = nullptr){
+        static const char* const INDENTS[] = {"", "    ", "\t", "  ", " \t", "        "};
+        text += content.empty() || content[0] == '(' ? "" : INDENTS[pick(6)];
+        text += content;
+        if(remark && pick(100) < 30){
+            text += pick(2) ? "  // " : "\t// ";
+            text += remark;
+        }else if(pick(100) < 5){
+            text += pick(2) ? " " : "\t ";
+        }
+        text += pick(100) < 15 ? "\r\n" : "\n";
+        lineCount++;
+    }
+
+    void instruction(const string& content, const char* remark = nullptr){
+        line(content, remark);
+        address++;
+    }
+
+    void header(const string& command){
+        if(pick(100) < 70){
+            line("// " + command);
+        }
+    }
+
+    void label(const string& name){
+        line("(" + name + ")");
+        if(address < ROM_LIMIT){
+            reachable.push_back(name);
+        }
+    }
+
+    // A label to jump to that is `distance` instructions ahead, or a reachable one if
+    // that address is past the ROM
+    string target(const string& name, uint64_t distance){
+        if(address + distance < ROM_LIMIT || reachable.empty()){
+            return name;
+        }
+        return reachable[pick(reachable.size())];
+    }
+
+    void beginFunction(){
+        const string& owner = classes[pick(classes.size())];
+        function = owner + ".f" + to_string(functionCount++);
+        text += "\n";
+        lineCount++;
+        if(pick(100) < 40){
+            line("// " + function + ": generated for the assembler benchmark.");
+            for(uint64_t i = pick(6); i > 0; i--){
+                line("// It keeps the stack balanced and returns the value on top of it (" + to_string(i) + ").");
+            }
+        }
+        uint64_t locals = pick(5);
+        header("function " + function + " " + to_string(locals));
+        label(function);
+        for(uint64_t i = 0; i < locals; i++){
+            instruction("@SP");
+            instruction("A=M");
+            instruction("M=0", "local = 0");
+            instruction("@SP");
+            instruction("M=M+1");
+        }
+    }
+
+    void push(){
+        instruction("@SP");
+        instruction("A=M");
+        instruction("M=D");
+        instruction("@SP");
+        instruction("M=M+1", "SP++");
+    }
+
+    void pop(){
+        instruction("@SP");
+        instruction("AM=M-1", "SP--");
+        instruction("D=M");
+    }
+
+    void command(){
+        static const char* const SEGMENTS[] = {"LCL", "ARG", "THIS", "THAT"};
+        static const char* const SEGMENT_NAMES[] = {"local", "argument", "this", "that"};
+        uint64_t kind = pick(100);
+        if(kind < 25){
+            uint64_t value = pick(1000);
+            header("push constant " + to_string(value));
+            instruction("@" + to_string(value));
+            instruction("D=A");
+            push();
+        }else if(kind < 40){
+            const string& name = statics[pick(statics.size())];
+            bool load = pick(2);
+            header(string(load ? "push" : "pop") + " static " + name.substr(name.find('.') + 1));
+            if(load){
+                instruction("@" + name);
+                instruction("D=M");
+                push();
+            }else{
+                pop();
+                instruction("@" + name);
+                instruction("M=D", "store static");
+            }
+        }else if(kind < 55){
+            uint64_t segment = pick(4), index = pick(8);
+            header(string("push ") + SEGMENT_NAMES[segment] + " " + to_string(index));
+            instruction(string("@") + SEGMENTS[segment]);
+            instruction("D=M");
+            instruction("@" + to_string(index));
+            instruction("A=D+A", "address of the element");
+            instruction("D=M");
+            push();
+        }else if(kind < 70){
+            static const char* const OPERATIONS[][2] = {
+                {"add", "M=D+M"}, {"sub", "M=M-D"}, {"and", "M=D&M"}, {"or", "M=D|M"}
+            };
+            uint64_t operation = pick(4);
+            header(OPERATIONS[operation][0]);
+            pop();
+            instruction("A=A-1");
+            instruction(OPERATIONS[operation][1]);
+        }else if(kind < 82){
+            static const char* const COMPARISONS[][2] = {{"eq", "JEQ"}, {"gt", "JGT"}, {"lt", "JLT"}};
+            uint64_t comparison = pick(3);
+            string id = to_string(labelCount++);
+            string yes = function + "$" + COMPARISONS[comparison][0] + "_true." + id;
+            string done = function + "$" + COMPARISONS[comparison][0] + "_end." + id;
+            header(COMPARISONS[comparison][0]);
+            pop();
+            instruction("A=A-1");
+            instruction("D=M-D");
+            instruction("@" + target(yes, 7));
+            instruction(string("D;") + COMPARISONS[comparison][1]);
+            instruction("@SP");
+            instruction("A=M-1");
+            instruction("M=0", "false");
+            instruction("@" + target(done, 3));
+            instruction("0;JMP");
+            label(yes);
+            instruction("@SP");
+            instruction("A=M-1");
+            instruction("M=-1", "true");
+            label(done);
+        }else if(kind < 92){
+            string loop = function + "$LOOP." + to_string(labelCount++);
+            header("label " + loop.substr(loop.find('$') + 1));
+            label(loop);
+            header("if-goto " + loop.substr(loop.find('$') + 1));
+            pop();
+            instruction("@" + target(loop, 0));
+            instruction("D;JNE", "loop again");
+        }else{
+            const string& callee = reachable.empty() ? function : reachable[pick(reachable.size())];
+            string back = function + "$ret." + to_string(labelCount++);
+            header("call " + callee);
+            instruction("@" + target(back, 4));
+            instruction("D=A", "return address");
+            push();
+            instruction("@" + callee);
+            instruction("0;JMP");
+            label(back);
+        }
+    }
+
+    static constexpr uint64_t ROM_LIMIT = 32768;
+
+    uint64_t random;
+    vector<string> classes, statics;
+    vector<string> reachable;      // Labels whose address fits in an A-instruction
+    string function;
+    string text;
+    uint64_t lineCount = 0, address = 0, functionCount = 0, labelCount = 0;
+};
+
+/**
+ * @brief The times of one phase over all timed runs.
+ */
+struct Phase {
+    string name;
+    vector<double> seconds;
+};
+
+/**
+ * @brief Deletes the benchmark's scratch directory when it goes out of scope.
+ */
+struct ScratchDirectory {
+    fs::path path;
+
+    ScratchDirectory(){
+        auto stamp = chrono::steady_clock::now().time_since_epoch().count();
+        path = fs::temp_directory_path() / ("asmbench-" + to_string(stamp));
+        fs::create_directories(path);
+    }
+
+    ~ScratchDirectory(){
+        error_code ignored;
+        fs::remove_all(path, ignored);
+    }
+};
+
+/*
+ * Function: benchmarkInput
+ * ------------------------
+ * Runs every phase of the assembler on one input, once untimed and then `repeat` times.
+ *
+ * Parameters:
+ *  - name: How the input is reported.
+ *  - path: The program to assemble.
+ *  - options: The repeat count and pool settings.
+ *  - pool: The pool for the parallel second pass, or null.
+ *  - scratch: Where the .hack outputs and the copy used by `parse()` go, so nothing is
+ *    written next to the input.
+ *
+ * Returns:
+ *  - The JSON object describing the input and its phases.
+ *
+ * Logic:
+ *  - read: `loadSource`, the single bulk read.
+ *  - first_pass: `setSource` and `firstPass`; the source is copied before the clock starts.
+ *  - second_pass: `secondPass` on the assembler left by the first pass.
+ *  - second_pass_parallel: `secondPass(pool)` after an untimed first pass (with -j).
+ *  - output: `writeHackFile` in the text format.
+ *  - parse: The whole `parse()` call, as the Assembler runs it for one file.
+ */
+static string benchmarkInput(const string& name, const string& path, const Options& options, ThreadPool* pool,
+                             const fs::path& scratch){
+    fs::path copy = scratch / "input.asm";
+    fs::copy_file(path, copy, fs::copy_options::overwrite_existing);
+    string hackFile = (scratch / "output.hack").string();
+
+    vector<Phase> phases = {{"read", {}}, {"first_pass", {}}, {"second_pass", {}}};
+    if(pool){
+        phases.push_back({"second_pass_parallel", {}});
+    }
+    phases.push_back({"output", {}});
+    phases.push_back({"parse", {}});
+
+    size_t lines = 0, bytes = 0, instructions = 0, labels = 0, variables = 0;
+    for(uint64_t run = 0; run <= options.repeat; run++){
+        vector<double> times;
+        auto timed = [&](auto&& body){
+            auto start = chrono::steady_clock::now();
+            body();
+            times.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        };
+
+        string source;
+        timed([&]{ source = loadSource(path); });
+
+        Assembler assembler;
+        string text = source;
+        timed([&]{
+            assembler.setSource(move(text), path);
+            assembler.firstPass();
+        });
+        timed([&]{ assembler.secondPass(); });
+        if(assembler.hasErrors()){
+            throw runtime_error(assembler.diagnostics().front());
+        }
+
+        if(pool){
+            Assembler parallel;
+            parallel.setSource(string(source), path);
+            parallel.firstPass();
+            timed([&]{ parallel.secondPass(*pool); });
+            if(parallel.machineCode() != assembler.machineCode()){
+                throw runtime_error("The parallel second pass encoded " + path + " differently");
+            }
+        }
+
+        timed([&]{ writeHackFile(hackFile, assembler.machineCode(), OutputFormat::Text); });
+        timed([&]{ parse(copy.string()); });
+
+        if(run == 0){
+            // The warm-up run only fills the caches and describes the input
+            lines = static_cast<size_t>(count(source.begin(), source.end(), '\n'))
+                    + (!source.empty() && source.back() != '\n');
+            bytes = source.size();
+            instructions = assembler.instructions().size();
+            labels = assembler.symbols().entries(SymbolKind::Label).size();
+            variables = assembler.symbols().entries(SymbolKind::Variable).size();
+            continue;
+        }
+        for(size_t i = 0; i < phases.size(); i++){
+            phases[i].seconds.push_back(times[i]);
+        }
+    }
+
+    string json = "    {\n      \"name\": " + jsonString(name) + ",\n      \"path\": " + jsonString(path)
+                + ",\n      \"lines\": " + to_string(lines) + ",\n      \"bytes\": " + to_string(bytes)
+                + ",\n      \"instructions\": " + to_string(instructions) + ",\n      \"labels\": " + to_string(labels)
+                + ",\n      \"variables\": " + to_string(variables) + ",\n      \"phases\": {\n";
+    cerr<<name<<": "<<lines<<" lines, "<<fixed<<setprecision(1)<<bytes / 1e6<<" MB, "<<instructions
+        <<" instructions, "<<labels<<" labels, "<<variables<<" variables\n";
+    for(size_t i = 0; i < phases.size(); i++){
+        vector<double> sorted = phases[i].seconds;
+        sort(sorted.begin(), sorted.end());
+        double median = sorted.size() % 2 ? sorted[sorted.size() / 2]
+                                          : (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]) / 2;
+        double mean = 0;
+        for(double seconds : sorted){
+            mean += seconds / sorted.size();
+        }
+        double linesPerSecond = median > 0 ? lines / median : 0;
+        double megabytesPerSecond = median > 0 ? bytes / median / 1e6 : 0;
+        json += "        " + jsonString(phases[i].name) + ": {\"median_s\": " + jsonNumber(median)
+              + ", \"min_s\": " + jsonNumber(sorted.front()) + ", \"mean_s\": " + jsonNumber(mean)
+              + ", \"max_s\": " + jsonNumber(sorted.back()) + ", \"lines_per_s\": " + jsonNumber(linesPerSecond)
+              + ", \"mb_per_s\": " + jsonNumber(megabytesPerSecond) + "}" + (i + 1 < phases.size() ? ",\n" : "\n");
+        cerr<<"  "<<left<<setw(22)<<phases[i].name<<right<<setw(10)<<setprecision(2)<<median * 1e3<<" ms"
+            <<setw(12)<<setprecision(1)<<linesPerSecond / 1e6<<" M lines/s"<<setw(10)<<megabytesPerSecond<<" MB/s\n";
+    }
+    return json + "      }\n    }";
+}
+
+/**
+ * @brief Main function for the AsmBench program
+ *
+ * Process Flow:
+ * 1. Parse the command-line options.
+ * 2. With `--generate`, write the synthetic program and stop.
+ * 3. Without inputs, generate the synthetic program into a scratch directory.
+ * 4. Benchmark every input (`benchmarkInput`) and write the JSON report.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Command-line arguments.
+ * @return int 0 on success, 1 if an input cannot be read or assembled, 2 on usage errors.
+ */
+int main(int argc, char* argv[]){
+    Options options;
+    try{
+        if(!parseArguments(argc, argv, options)){
+            return 0;
+        }
+    }catch(const invalid_argument& e){
+        cerr<<e.what()<<endl;
+        printUsage();
+        return 2;
+    }
+
+    try{
+        if(!options.generate.empty()){
+            string program = ProgramGenerator(options.seed, options.variables).generate(options.lines);
+            ofstream file(options.generate, ios::binary | ios::trunc);
+            file.write(program.data(), static_cast<streamsize>(program.size()));
+            if(!file){
+                throw runtime_error("Cannot write " + options.generate);
+            }
+            cout<<"Wrote "<<count(program.begin(), program.end(), '\n')<<" lines ("<<program.size()<<" bytes) to "<<options.generate<<".\n";
+            return 0;
+        }
+
+        ScratchDirectory scratch;
+        vector<pair<string, string>> inputs;   // Name and path
+        for(const string& input : options.inputs){
+            inputs.emplace_back(fs::path(input).filename().string(), input);
+        }
+        if(inputs.empty()){
+            string path = (scratch.path / "synthetic.asm").string();
+            string program = ProgramGenerator(options.seed, options.variables).generate(options.lines);
+            ofstream file(path, ios::binary | ios::trunc);
+            file.write(program.data(), static_cast<streamsize>(program.size()));
+            file.close();
+            inputs.emplace_back("synthetic-" + to_string(options.lines) + "-seed" + to_string(options.seed), path);
+        }
+
+        unique_ptr<ThreadPool> pool;
+        if(options.parallel){
+            pool = make_unique<ThreadPool>(options.threads);
+        }
+        string report = "{\n  \"benchmark\": \"assembler\",\n  \"repeat\": " + to_string(options.repeat)
+                      + ",\n  \"threads\": " + to_string(pool ? pool->size() : 1) + ",\n  \"inputs\": [\n";
+        for(size_t i = 0; i < inputs.size(); i++){
+            report += benchmarkInput(inputs[i].first, inputs[i].second, options, pool.get(), scratch.path);
+            report += i + 1 < inputs.size() ? ",\n" : "\n";
+        }
+        report += "  ]\n}\n";
+
+        if(options.output.empty()){
+            cout<<report<<flush;
+        }else{
+            ofstream file(options.output, ios::trunc);
+            file<<report;
+            if(!file){
+                throw runtime_error("Cannot write " + options.output);
+            }
+        }
+    }catch(const exception& e){
+        cerr<<"Error: "<<e.what()<<endl;
+        return 1;
+    }
+    return 0;
+}
@@ -3,43 +3,843 @@
  * @brief Main entry point for the Assembler program.
  * 
  * This file contains the main function that serves as the entry point for the Assembler.
- * It prompts the user for an input file, initiates the parsing process, and handles any
- * potential errors during execution.
+ * Input files are taken from the command line and assembled in parallel; with no inputs
+ * it falls back to prompting the user for a single file.
  * 
  * Key Components:
- * - User input handling for the assembly file name.
- * - Invocation of the parsing function to process the assembly code.
- * - Basic error handling for file operations.
+ * - Command-line parsing: options plus any number of files, directories or wildcard patterns.
+ * - Input expansion: directories are searched recursively for `.asm` files, and patterns
+ *   such as `*.asm` in the last path component are matched against the files of that directory.
+ * - Batch assembly: one task per file on a work-stealing `ThreadPool`, each with its own
+ *   `Assembler`, so files are assembled concurrently on all cores.
+ * - `--parallel-encode`: large programs additionally split their encoding pass into ranges
+ *   on the same pool, which helps when a batch holds a few very large files.
+ * - Separate assembly: `-c` writes a relocatable `.hobj` module per input instead of a
+ *   `.hack` file, and `--link FILE` links the inputs into one program. When linking, an
+ *   `.asm` input whose `.hobj` is newer than the source is not assembled again.
+ * - `--watch`: reassembles one file whenever it is saved, with an `IncrementalAssembler`
+ *   that redoes only the edited lines and patches the `.hack` file in place.
+ *   `--fuzz-watch N` checks it: N random edits, each compared with a full assembly.
+ * - `-O`: runs the peephole pass of `Assembler::optimize` on every program and reports the
+ *   number of instructions it removed.
+ * - `--stream`: assembles standard input to standard output in one pass with a
+ *   `StreamAssembler`, in memory bounded by the symbols rather than the program size.
+ * - `--stats FILE`: writes a JSON report of the batch: per file the phase timings, line,
+ *   label and variable counts, ROM use against the 32K limit and the highest variable
+ *   address against `SCREEN`, so slow jobs and programs near their limits can be found.
+ * - Exit status: 0 if every file assembled, 1 if any file failed, 2 for usage errors.
  */
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <set>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "../include/CommandLine.h"
+#include "../include/IncrementalAssembler.h"
+#include "../include/Linker.h"
 #include "../include/Parser.h"
+#include "../include/StreamAssembler.h"
+#include "../include/ThreadPool.h"
 
 using namespace std;
+namespace fs = std::filesystem;
+
+/**
+ * @brief Settings collected from the command line.
+ */
+struct Options {
+    OutputFormat format = OutputFormat::Text;
+    string outputDirectory;  // Empty: write each .hack next to its source
+    unsigned jobs = 0;       // 0: one worker per hardware thread
+    bool parallelEncode = false;
+    bool optimize = false;     // Run the peephole pass between the two passes
+    bool compileOnly = false;  // Write .hobj modules instead of .hack files
+    string linkOutput;         // Non-empty: link all inputs into this .hack file
+    bool watch = false;        // Reassemble the input whenever it changes
+    bool stream = false;       // Assemble standard input to standard output
+    uint64_t fuzzWatch = 0;    // Number of random edits to check the watch mode with; 0: assemble
+    uint64_t seed = 1;         // Seed of the random edits
+    string statsFile;          // Non-empty: write a JSON stats report here ("-": standard error)
+    vector<string> inputs;
+};
+
+/** @brief Words of ROM, and the first RAM address past the space for variables. */
+static const size_t ROM_WORDS = 32768;
+static const int SCREEN = 16384;
+
+/**
+ * @brief The result of assembling one input file.
+ */
+struct Job {
+    string input;
+    string output;
+    vector<string> errors;
+    ObjectFile object;      // When linking: the module of this input
+    bool upToDate = false;  // When linking: the module was read from an existing .hobj
+    size_t removed = 0;     // Instructions removed by -O
+    AssemblyStats stats;    // With --stats: counters and phase timings
+};
+
+/**
+ * @brief Prints the command-line help.
+ */
+static void printUsage(){
+    cout<<"Usage: Assembler [options] [inputs...]\n"
+        <<"\n"
+        <<"Inputs may be .asm files, directories (searched recursively for .asm files)\n"
+        <<"or wildcard patterns such as \"progs/*.asm\". With no inputs, the assembler\n"
+        <<"prompts for a single file name.\n"
+        <<"\n"
+        <<"Options:\n"
+        <<"  --binary              Write packed binary .hack files\n"
+        <<"  -o, --output-dir DIR  Write .hack files into DIR instead of next to each source\n"
+        <<"  -j, --jobs N          Number of worker threads (default: all cores)\n"
+        <<"  --parallel-encode     Also split the encoding pass of large programs across threads\n"
+        <<"  -O, --optimize        Remove redundant and unreachable instructions before encoding\n"
+        <<"  -c, --compile         Write a relocatable .hobj module per input instead of a .hack file\n"
+        <<"  --link FILE           Link the inputs (.asm or .hobj), in order, into one .hack file\n"
+        <<"  --watch               Reassemble one .asm file incrementally whenever it is saved\n"
+        <<"  --stream              Assemble standard input to standard output in one pass\n"
+        <<"  --fuzz-watch N        Check --watch: apply N random edits, comparing each update with a full assembly\n"
+        <<"  --seed N              Seed of the random edits (default 1)\n"
+        <<"  --stats FILE          Write a JSON report of timings, counts and limits (\"-\": standard error)\n"
+        <<"  -h, --help            Show this help\n";
+}
+
+/**
+ * @brief Matches a file name against a pattern where '*' matches any run of characters
+ * and '?' matches exactly one.
+ * 
+ * @param pattern The wildcard pattern.
+ * @param name The file name to test.
+ * @return bool true if the whole name matches.
+ */
+static bool wildcardMatch(const string& pattern, const string& name){
+    size_t p = 0, n = 0;
+    size_t starPattern = string::npos, starName = 0;
+    while(n < name.size()){
+        if(p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])){
+            p++;
+            n++;
+        }else if(p < pattern.size() && pattern[p] == '*'){
+            starPattern = p++;  // Remember the star and first try matching it to nothing
+            starName = n;
+        }else if(starPattern != string::npos){
+            p = starPattern + 1;  // Let the last star swallow one more character
+            n = ++starName;
+        }else{
+            return false;
+        }
+    }
+    while(p < pattern.size() && pattern[p] == '*') p++;
+    return p == pattern.size();
+}
+
+/**
+ * @brief Expands the command-line inputs into a sorted list of .asm files.
+ * 
+ * - Directories contribute every `.asm` file below them.
+ * - Arguments containing '*' or '?' in their last component are matched against the
+ *   entries of their directory (wildcards in directory names are not supported).
+ * - Anything else is taken as a file name as-is, so a missing file is reported as a
+ *   failed job rather than silently skipped.
+ * 
+ * @param inputs The raw input arguments.
+ * @return vector<string> The files to assemble.
+ */
+static vector<string> expandInputs(const vector<string>& inputs){
+    vector<string> files;
+    for(const string& input : inputs){
+        fs::path path(input);
+        string name = path.filename().string();
+        if(name.find_first_of("*?") != string::npos){
+            fs::path directory = path.has_parent_path() ? path.parent_path() : fs::path(".");
+            vector<string> matches;
+            error_code error;
+            for(const auto& entry : fs::directory_iterator(directory, error)){
+                if(entry.is_regular_file() && wildcardMatch(name, entry.path().filename().string())){
+                    matches.push_back(entry.path().string());
+                }
+            }
+            if(matches.empty()){
+                throw runtime_error("No files match: " + input);
+            }
+            sort(matches.begin(), matches.end());
+            files.insert(files.end(), matches.begin(), matches.end());
+        }else if(fs::is_directory(path)){
+            vector<string> matches;
+            for(const auto& entry : fs::recursive_directory_iterator(path)){
+                if(entry.is_regular_file() && entry.path().extension() == ".asm"){
+                    matches.push_back(entry.path().string());
+                }
+            }
+            sort(matches.begin(), matches.end());
+            files.insert(files.end(), matches.begin(), matches.end());
+        }else{
+            files.push_back(input);
+        }
+    }
+    return files;
+}
+
+/**
+ * @brief Reads the options and inputs from the command line.
+ * 
+ * @param argc Number of command-line arguments.
+ * @param argv Command-line arguments.
+ * @param options Receives the parsed settings.
+ * @return bool false if the program should exit (after `--help`).
+ * @throws std::invalid_argument For unknown options or missing option values.
+ */
+static bool parseArguments(int argc, char* argv[], Options& options){
+    for(int i = 1; i < argc; i++){
+        string argument = argv[i];
+        auto value = [&]() -> string {
+            if(i + 1 >= argc){
+                throw invalid_argument("Missing value for " + argument);
+            }
+            return argv[++i];
+        };
+
+        if(argument == "-h" || argument == "--help"){
+            printUsage();
+            return false;
+        }else if(argument == "--binary"){
+            options.format = OutputFormat::Binary;
+        }else if(argument == "--parallel-encode"){
+            options.parallelEncode = true;
+        }else if(argument == "-O" || argument == "--optimize"){
+            options.optimize = true;
+        }else if(argument == "-c" || argument == "--compile"){
+            options.compileOnly = true;
+        }else if(argument == "--link"){
+            options.linkOutput = value();
+        }else if(argument == "--watch"){
+            options.watch = true;
+        }else if(argument == "--stream"){
+            options.stream = true;
+        }else if(argument == "--fuzz-watch"){
+            options.fuzzWatch = max<uint64_t>(1, parseNumber(value(), UINT64_MAX));
+        }else if(argument == "--seed"){
+            options.seed = parseNumber(value(), UINT64_MAX);
+        }else if(argument == "--stats"){
+            options.statsFile = value();
+        }else if(argument == "-o" || argument == "--output-dir"){
+            options.outputDirectory = value();
+        }else if(argument == "-j" || argument == "--jobs"){
+            options.jobs = static_cast<unsigned>(parseNumber(value(), 1024));
+        }else if(argument.size() > 1 && argument[0] == '-'){
+            throw invalid_argument("Unknown option: " + argument);
+        }else{
+            options.inputs.push_back(argument);
+        }
+    }
+    if(options.fuzzWatch > 0 && (options.compileOnly || !options.linkOutput.empty() || options.watch ||
+                                 options.stream || options.optimize || !options.statsFile.empty() ||
+                                 !options.inputs.empty())){
+        throw invalid_argument("--fuzz-watch generates its own sources and takes no inputs or other modes");
+    }
+    if(options.compileOnly && !options.linkOutput.empty()){
+        throw invalid_argument("--compile and --link cannot be combined");
+    }
+    if(!options.linkOutput.empty() && options.inputs.empty()){
+        throw invalid_argument("No inputs to link");
+    }
+    if(options.watch && (options.compileOnly || !options.linkOutput.empty() || options.inputs.size() != 1)){
+        throw invalid_argument("--watch takes exactly one .asm file and no --compile or --link");
+    }
+    if(options.stream && (options.compileOnly || !options.linkOutput.empty() || options.watch ||
+                          !options.outputDirectory.empty() || !options.inputs.empty())){
+        throw invalid_argument("--stream reads standard input and takes no inputs, --output-dir, --compile, --link or --watch");
+    }
+    if(options.optimize && (options.compileOnly || !options.linkOutput.empty() || options.watch || options.stream)){
+        throw invalid_argument("--optimize works on whole programs and cannot be combined with --compile, --link, --watch or --stream");
+    }
+    if(!options.statsFile.empty() && (options.compileOnly || !options.linkOutput.empty() || options.watch ||
+                                      options.stream || options.inputs.empty())){
+        throw invalid_argument("--stats needs inputs and cannot be combined with --compile, --link, --watch or --stream");
+    }
+    return true;
+}
+
+/**
+ * @brief Assembles one file and writes its .hack output, recording any errors in the job.
+ * 
+ * @param job The input/output file names; receives the errors.
+ * @param options The output format and whether to write a relocatable module instead.
+ * @param pool If given, the encoding pass of large programs is split across this pool.
+ */
+static void assembleJob(Job& job, const Options& options, ThreadPool* pool){
+    try{
+        Assembler assembler;
+        if(!options.statsFile.empty()){
+            assembler.setStats(&job.stats);
+        }
+        assembler.loadFile(job.input);
+        if(options.compileOnly){
+            if(assembler.compile()){
+                writeObjectFile(job.output, assembler.object());
+            }else{
+                job.errors = assembler.diagnostics();
+            }
+        }else if(assembler.assemble(pool, options.optimize)){
+            if(!options.statsFile.empty()){
+                auto start = chrono::steady_clock::now();
+                writeHackFile(job.output, assembler.machineCode(), options.format);
+                job.stats.writeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            }else{
+                writeHackFile(job.output, assembler.machineCode(), options.format);
+            }
+            job.removed = assembler.removedInstructions();
+        }else{
+            job.errors = assembler.diagnostics();
+        }
+    }catch(const exception& e){
+        job.errors.push_back(e.what());
+    }
+}
+
+/**
+ * @brief Gets the module of one input for linking, recording any errors in the job.
+ * 
+ * - A `.hobj` input is read as it is.
+ * - An `.asm` input reuses its `.hobj` (`job.output`) if that is at least as new as the
+ *   source. Otherwise, or if the object cannot be read, the source is assembled and the
+ *   object is written for the next link.
+ * 
+ * @param job The input and its object file; receives the module and the errors.
+ */
+static void moduleJob(Job& job){
+    try{
+        if(fs::path(job.input).extension() == ".hobj"){
+            job.object = readObjectFile(job.input);
+            job.upToDate = true;
+            return;
+        }
+        error_code error;
+        auto objectTime = fs::last_write_time(job.output, error);
+        if(!error && objectTime >= fs::last_write_time(job.input)){
+            try{
+                job.object = readObjectFile(job.output);
+                job.upToDate = true;
+                return;
+            }catch(const exception&){
+                // A stale or damaged object is simply rebuilt
+            }
+        }
+
+        Assembler assembler;
+        assembler.loadFile(job.input);
+        if(assembler.compile()){
+            job.object = assembler.object();
+            writeObjectFile(job.output, job.object);
+        }else{
+            job.errors = assembler.diagnostics();
+        }
+    }catch(const exception& e){
+        job.errors.push_back(e.what());
+    }
+}
+
+/**
+ * @brief Prints the errors of every failed job.
+ * 
+ * @param jobs The finished jobs.
+ * @return size_t The number of failed jobs.
+ */
+static size_t reportErrors(const vector<Job>& jobs){
+    size_t failed = 0;
+    for(const Job& job : jobs){
+        if(!job.errors.empty()){
+            failed++;
+            for(const string& message : job.errors){
+                cerr<<message<<'\n';
+            }
+        }
+    }
+    return failed;
+}
+
+/**
+ * @brief Names the output of every input, rejecting two inputs with the same output.
+ * 
+ * @param files The inputs.
+ * @param options The output directory.
+ * @param extension The extension of the outputs (".hack" or ".hobj").
+ * @return vector<Job> One job per input.
+ */
+static vector<Job> planJobs(const vector<string>& files, const Options& options, const string& extension){
+    vector<Job> jobs(files.size());
+    set<string> outputs;
+    for(size_t i = 0; i < files.size(); i++){
+        fs::path output = fs::path(files[i]).replace_extension(extension);
+        if(!options.outputDirectory.empty()){
+            output = fs::path(options.outputDirectory) / output.filename();
+        }
+        jobs[i].input = files[i];
+        jobs[i].output = output.string();
+        if(!outputs.insert(jobs[i].output).second){
+            throw invalid_argument("Two inputs would both be written to " + jobs[i].output);
+        }
+    }
+    if(!options.outputDirectory.empty()){
+        fs::create_directories(options.outputDirectory);
+    }
+    return jobs;
+}
+
+/**
+ * @brief Renders the `--stats` report of a finished batch.
+ * 
+ * - Per file: whether it assembled, its size and counts, the phase timings in seconds,
+ *   the ROM it uses against the 32K limit, and the highest variable address against
+ *   `SCREEN`. Variables at or above `SCREEN` still assemble but overwrite the screen.
+ * - Totals add up the counts and timings of all files; `wall_s` is the whole batch.
+ * - The counts of instructions are taken before `-O`; `words` is what was encoded.
+ * 
+ * @param jobs The finished jobs.
+ * @param threads The number of worker threads.
+ * @param wallSeconds How long the whole batch took.
+ * @return string The JSON report.
+ */
+static string statsReport(const vector<Job>& jobs, size_t threads, double wallSeconds){
+    AssemblyStats total;
+    size_t failed = 0;
+    string files;
+    for(size_t i = 0; i < jobs.size(); i++){
+        const Job& job = jobs[i];
+        const AssemblyStats& stats = job.stats;
+        failed += job.errors.empty() ? 0 : 1;
+        total.bytes += stats.bytes;
+        total.lines += stats.lines;
+        total.labels += stats.labels;
+        total.aInstructions += stats.aInstructions;
+        total.cInstructions += stats.cInstructions;
+        total.variables += stats.variables;
+        total.words += stats.words;
+        total.removed += stats.removed;
+        total.loadSeconds += stats.loadSeconds;
+        total.firstPassSeconds += stats.firstPassSeconds;
+        total.optimizeSeconds += stats.optimizeSeconds;
+        total.secondPassSeconds += stats.secondPassSeconds;
+        total.writeSeconds += stats.writeSeconds;
+
+        int nextVariable = stats.highestVariable < 0 ? 16 : stats.highestVariable + 1;
+        files += "    {\"input\": " + jsonString(job.input) + ", \"output\": " + jsonString(job.output)
+               + ", \"ok\": " + (job.errors.empty() ? "true" : "false")
+               + ", \"errors\": " + to_string(job.errors.size()) + ",\n"
+               + "     \"lines\": " + to_string(stats.lines) + ", \"bytes\": " + to_string(stats.bytes)
+               + ", \"labels\": " + to_string(stats.labels) + ", \"variables\": " + to_string(stats.variables)
+               + ", \"a_instructions\": " + to_string(stats.aInstructions)
+               + ", \"c_instructions\": " + to_string(stats.cInstructions)
+               + ", \"symbol_references\": " + to_string(stats.symbolReferences)
+               + ", \"removed\": " + to_string(stats.removed) + ",\n"
+               + "     \"rom\": {\"words\": " + to_string(stats.words) + ", \"limit\": " + to_string(ROM_WORDS)
+               + ", \"used_percent\": " + jsonNumber(100.0 * stats.words / ROM_WORDS)
+               + ", \"fits\": " + (stats.words <= ROM_WORDS ? "true" : "false") + "},\n"
+               + "     \"ram\": {\"highest_variable\": "
+               + (stats.highestVariable < 0 ? string("null") : to_string(stats.highestVariable))
+               + ", \"screen\": " + to_string(SCREEN)
+               + ", \"free_below_screen\": " + to_string(max(0, SCREEN - nextVariable))
+               + ", \"overlaps_screen\": " + (nextVariable > SCREEN ? "true" : "false") + "},\n"
+               + "     \"phases_s\": {\"load\": " + jsonNumber(stats.loadSeconds)
+               + ", \"first_pass\": " + jsonNumber(stats.firstPassSeconds)
+               + ", \"optimize\": " + jsonNumber(stats.optimizeSeconds)
+               + ", \"second_pass\": " + jsonNumber(stats.secondPassSeconds)
+               + ", \"write\": " + jsonNumber(stats.writeSeconds) + "}}"
+               + (i + 1 < jobs.size() ? ",\n" : "\n");
+    }
+
+    return "{\n  \"files\": " + to_string(jobs.size()) + ", \"failed\": " + to_string(failed)
+         + ", \"threads\": " + to_string(threads) + ", \"wall_s\": " + jsonNumber(wallSeconds) + ",\n"
+         + "  \"limits\": {\"rom_words\": " + to_string(ROM_WORDS) + ", \"screen\": " + to_string(SCREEN) + "},\n"
+         + "  \"totals\": {\"lines\": " + to_string(total.lines) + ", \"bytes\": " + to_string(total.bytes)
+         + ", \"labels\": " + to_string(total.labels) + ", \"variables\": " + to_string(total.variables)
+         + ", \"a_instructions\": " + to_string(total.aInstructions)
+         + ", \"c_instructions\": " + to_string(total.cInstructions)
+         + ", \"words\": " + to_string(total.words) + ", \"removed\": " + to_string(total.removed) + ",\n"
+         + "             \"phases_s\": {\"load\": " + jsonNumber(total.loadSeconds)
+         + ", \"first_pass\": " + jsonNumber(total.firstPassSeconds)
+         + ", \"optimize\": " + jsonNumber(total.optimizeSeconds)
+         + ", \"second_pass\": " + jsonNumber(total.secondPassSeconds)
+         + ", \"write\": " + jsonNumber(total.writeSeconds) + "}},\n"
+         + "  \"inputs\": [\n" + files + "  ]\n}\n";
+}
+
+/**
+ * @brief Assembles every input on a thread pool and reports the results in input order.
+ * 
+ * @param options The parsed command line.
+ * @return int 0 if every file assembled, 1 otherwise.
+ */
+static int assembleBatch(const Options& options){
+    vector<string> files = expandInputs(options.inputs);
+    vector<Job> jobs = planJobs(files, options, options.compileOnly ? ".hobj" : ".hack");
+
+    auto start = chrono::steady_clock::now();
+    size_t threads = 0;
+    {
+        ThreadPool pool(options.jobs);
+        ThreadPool* encodePool = options.parallelEncode ? &pool : nullptr;
+        for(Job& job : jobs){
+            pool.submit([&job, &options, encodePool]{ assembleJob(job, options, encodePool); });
+        }
+        pool.wait();
+        threads = pool.size();
+    }
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t failed = reportErrors(jobs);
+    cout<<"Assembled "<<(jobs.size() - failed)<<" of "<<jobs.size()<<" file(s)";
+    if(failed > 0){
+        cout<<", "<<failed<<" failed";
+    }
+    if(options.optimize){
+        size_t removed = 0;
+        for(const Job& job : jobs){
+            removed += job.removed;
+        }
+        cout<<", "<<removed<<" instruction(s) removed by -O";
+    }
+    cout<<"."<<endl;
+
+    if(!options.statsFile.empty()){
+        string report = statsReport(jobs, threads, wallSeconds);
+        if(options.statsFile == "-"){
+            cerr<<report<<flush;
+        }else{
+            ofstream file(options.statsFile, ios::trunc);
+            file<<report;
+            if(!file){
+                cerr<<"Error writing stats file: "<<options.statsFile<<endl;
+                return 1;
+            }
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Links every input into one program, assembling only the modules that changed.
+ * 
+ * The modules are prepared in parallel and linked in input order. The program is not
+ * written if any module failed or the link reported errors.
+ * 
+ * @param options The parsed command line.
+ * @return int 0 if the program was linked, 1 otherwise.
+ */
+static int linkBatch(const Options& options){
+    vector<string> files = expandInputs(options.inputs);
+    vector<Job> jobs = planJobs(files, options, ".hobj");
+
+    {
+        ThreadPool pool(options.jobs);
+        for(Job& job : jobs){
+            pool.submit([&job]{ moduleJob(job); });
+        }
+        pool.wait();
+    }
+    if(reportErrors(jobs) > 0){
+        cout<<"Link failed."<<endl;
+        return 1;
+    }
+
+    size_t assembled = 0;
+    Linker linker;
+    for(Job& job : jobs){
+        assembled += job.upToDate ? 0 : 1;
+        linker.addObject(job.input, move(job.object));
+    }
+    if(!linker.link()){
+        for(const string& message : linker.diagnostics()){
+            cerr<<message<<'\n';
+        }
+        cout<<"Link failed."<<endl;
+        return 1;
+    }
+    writeHackFile(options.linkOutput, linker.machineCode(), options.format);
+    cout<<"Linked "<<jobs.size()<<" module(s) ("<<assembled<<" assembled) into "<<options.linkOutput
+        <<" ("<<linker.machineCode().size()<<" words)."<<endl;
+    return 0;
+}
+
+/**
+ * @brief Reassembles one file every time it changes, until the program is interrupted.
+ * 
+ * The file's modification time and size are polled every `WATCH_INTERVAL`, and a new
+ * version is only read once both have stayed the same for one interval, so a file that
+ * an editor is still writing is not assembled half-written. The first version is
+ * assembled in full; later versions go through `IncrementalAssembler::update`, and the
+ * `.hack` file is patched in place. While the source has errors the output is left
+ * alone, and the first good version after them rewrites it completely.
+ * 
+ * @param options The parsed command line.
+ * @return int 1 if the file cannot be watched; otherwise it does not return.
+ */
+static int watchFile(const Options& options){
+    const auto WATCH_INTERVAL = chrono::milliseconds(50);
+    vector<Job> jobs = planJobs(options.inputs, options, ".hack");
+    const string& input = jobs[0].input;
+    const string& output = jobs[0].output;
+
+    IncrementalAssembler assembler(input);
+    bool outputCurrent = false;  // The .hack file holds the previous version's machine code
+    pair<fs::file_time_type, uintmax_t> polled, assembled;  // Modification time and size
+    bool first = true;
+    cout<<"Watching "<<input<<" (press Ctrl+C to stop)."<<endl;
+    while(true){
+        error_code timeError, sizeError;
+        pair<fs::file_time_type, uintmax_t> current(fs::last_write_time(input, timeError), fs::file_size(input, sizeError));
+        if((timeError || sizeError) && first){
+            cerr<<"Error opening file: "<<input<<endl;
+            return 1;
+        }
+        bool settled = !timeError && !sizeError && current == polled;
+        polled = current;
+        if(first || (settled && current != assembled)){
+            first = false;
+            assembled = current;
+            try{
+                auto start = chrono::steady_clock::now();
+                size_t previousCount = assembler.machineCode().size();
+                if(assembler.update(loadSource(input))){
+                    size_t written = assembler.machineCode().size();
+                    if(outputCurrent){
+                        written = patchHackFile(output, assembler.machineCode(), options.format,
+                                                assembler.changedWords(), assembler.rewriteFrom(), previousCount);
+                    }else{
+                        writeHackFile(output, assembler.machineCode(), options.format);
+                    }
+                    outputCurrent = true;
+                    double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                    const UpdateStats& stats = assembler.stats();
+                    cout<<"Assembled "<<input<<": "<<stats.linesScanned<<" line(s) scanned, "
+                        <<stats.instructionsEncoded<<" instruction(s) encoded, "<<written<<" word(s) written in "
+                        <<milliseconds<<" ms."<<endl;
+                }else{
+                    outputCurrent = false;
+                    for(const string& message : assembler.diagnostics()){
+                        cerr<<message<<'\n';
+                    }
+                    cerr<<flush;
+                }
+            }catch(const exception& e){
+                outputCurrent = false;
+                cerr<<e.what()<<endl;
+            }
+        }
+        this_thread::sleep_for(WATCH_INTERVAL);
+    }
+}
+
+/**
+ * @brief Edits a source at random: statements inserted or deleted a line at a time, and
+ *        single characters inserted or deleted at the start of a line or anywhere.
+ */
+static void randomEdit(string& source, uint64_t& random){
+    static const char* const statements[] = {
+        "@1", "@17", "@x", "@y", "@SCREEN", "@R13", "D=A", "AM=M-1", "M=D+1", "D;JGT", "0;JMP", "// note", ""
+    };
+    static const char characters[] = "ADM1@=;()/ \n";
+    size_t offset = static_cast<size_t>(nextRandom(random) % (source.size() + 1));
+    bool lineStart = nextRandom(random) % 2 == 0;
+    if(lineStart){
+        while(offset > 0 && source[offset - 1] != '\n') offset--;
+    }
+    switch(nextRandom(random) % 6){
+        case 0:
+        case 1: {
+            string lines;
+            for(uint64_t count = 1 + nextRandom(random) % 3; count > 0; count--){
+                uint64_t pick = nextRandom(random) % 16;
+                if(pick < 3){
+                    lines += (pick == 0 ? "@L" : "(L") + to_string(nextRandom(random) % 64) + (pick == 0 ? "" : ")");
+                }else{
+                    lines += statements[pick - 3];
+                }
+                lines += nextRandom(random) % 8 == 0 ? "\r\n" : "\n";
+            }
+            if(!lineStart){
+                lines.insert(0, "\n");
+            }
+            source.insert(offset, lines);
+            break;
+        }
+        case 2: {
+            size_t end = source.find('\n', offset);
+            source.erase(offset, end == string::npos ? string::npos : end + 1 - offset);
+            break;
+        }
+        case 3:
+        case 4:
+            source.insert(offset, 1, characters[nextRandom(random) % (sizeof(characters) - 1)]);
+            break;
+        default:
+            source.erase(offset, static_cast<size_t>(nextRandom(random) % 3));
+            break;
+    }
+}
+
+/*
+ * Function: fuzzWatch
+ * -------------------
+ * Checks the incremental assembler behind `--watch` against full assemblies.
+ *
+ * Parameters:
+ *  - options: The number of edits and the seed.
+ *
+ * Returns:
+ *  - 0 if every update matched, 1 otherwise.
+ *
+ * Logic:
+ *  - Each block starts from a random program of a few dozen lines and applies
+ *    `EDITS_PER_BLOCK` random edits to it, updating one `IncrementalAssembler`.
+ *  - After every edit, `Assembler::assemble` runs on the same source. Both must agree on
+ *    whether it assembles and on every word. After two good versions in a row, patching
+ *    the old words with `changedWords` and `rewriteFrom` must give the new ones, as
+ *    `patchHackFile` does.
+ *  - The first mismatch is reported with its block and edit, so it reproduces with the
+ *    same seed.
+ */
+static int fuzzWatch(const Options& options){
+    const uint64_t EDITS_PER_BLOCK = 256;
+    uint64_t blocks = (options.fuzzWatch + EDITS_PER_BLOCK - 1) / EDITS_PER_BLOCK;
+    auto start = chrono::steady_clock::now();
+    for(uint64_t block = 0; block < blocks; block++){
+        uint64_t random = blockSeed(options.seed, block);
+        string source, good;
+        IncrementalAssembler incremental("random");
+        vector<uint16_t> previous;
+        bool previousOk = false;
+        for(uint64_t edit = 0; edit < EDITS_PER_BLOCK; edit++){
+            if(!previousOk && nextRandom(random) % 2 == 0){
+                source = good;  // Undo back to the last version that assembled
+            }else{
+                randomEdit(source, random);
+            }
+            bool ok = incremental.update(source);
+            Assembler full;
+            full.setSource(source, "random");
+            bool expected = full.assemble();
+            const vector<uint16_t>& words = incremental.machineCode();
+
+            string error;
+            if(ok != expected){
+                error = expected ? "the update fails but the source assembles" : "the update accepts a source that does not assemble";
+            }else if(ok && words != full.machineCode()){
+                error = "the update gives " + to_string(words.size()) + " word(s) that differ from the " +
+                        to_string(full.machineCode().size()) + " of a full assembly";
+            }else if(ok && previousOk){
+                vector<uint16_t> patched = previous;
+                patched.resize(words.size());
+                for(uint32_t index : incremental.changedWords()) patched[index] = words[index];
+                copy(words.begin() + min(incremental.rewriteFrom(), words.size()), words.end(),
+                     patched.begin() + min(incremental.rewriteFrom(), words.size()));
+                if(patched != words){
+                    error = "patching the previous words with the changed ones does not give the new program";
+                }
+            }
+            if(!error.empty()){
+                cout<<"Watch updates: FAILED: block "<<block<<", edit "<<edit<<": "<<error<<" (--seed "
+                    <<options.seed<<"). Source:\n"<<source<<endl;
+                return 1;
+            }
+            previous = words;
+            previousOk = ok;
+            if(ok){
+                good = source;
+            }
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout<<"Watch updates: OK, "<<blocks * EDITS_PER_BLOCK<<" random edits in "<<seconds<<" s."<<endl;
+    return 0;
+}
+
+/**
+ * @brief Assembles standard input to standard output with a `StreamAssembler`.
+ * 
+ * The machine code goes to standard output as it is produced; the summary and any
+ * errors go to standard error. When standard output is a file, words that were already
+ * written are patched in place; when it is a pipe, words are held back until every label
+ * before them is known (see `StreamAssembler`). On errors the output is incomplete and
+ * the exit status is 1.
+ * 
+ * @param options The parsed command line.
+ * @return int 0 on success, 1 on errors.
+ */
+static int streamAssembly(const Options& options){
+    ios::sync_with_stdio(false);  // Buffered standard streams; nothing was printed yet
+    StreamAssembler assembler(cout, options.format);
+    bool ok = assembler.assemble(cin);
+    for(const string& message : assembler.diagnostics()){
+        cerr<<message<<'\n';
+    }
+    cerr<<(ok ? "Assembled" : "Failed to assemble")<<" <stdin>: "<<assembler.size()<<" word(s), at most "
+        <<assembler.maxPendingReferences()<<" unresolved reference(s), at most "
+        <<assembler.maxBufferedWords()<<" word(s) buffered."<<endl;
+    return ok ? 0 : 1;
+}
 
 /**
  * @brief Main function for the Assembler program
  * 
- * This is the entry point of the assembler program. It prompts the user
- * to provide an assembly language source file name, then initiates the
- * parsing and translation process for converting assembly code to machine code.
+ * This is the entry point of the assembler program.
  * 
  * Process Flow:
- * 1. Prompt user for a `.asm` file input.
- * 2. Call the `parse` function to start parsing and processing the file.
- * 3. Handle any exceptions that might occur during file processing.
+ * 1. Parse the command-line options and inputs.
+ * 2. With inputs: expand them and assemble all files in parallel (`assembleBatch`), or
+ *    link them into one program with `--link` (`linkBatch`), or watch one file (`watchFile`).
+ *    With `--stream`, assemble standard input instead (`streamAssembly`); with
+ *    `--fuzz-watch`, check the watch mode against full assemblies (`fuzzWatch`).
+ * 3. Without inputs: prompt the user for a `.asm` file and call `parse` on it.
+ * 4. Handle any exceptions that might occur during file processing.
  * 
- * @return int Returns 0 on successful execution, non-zero on error.
+ * @param argc Number of command-line arguments.
+ * @param argv Command-line arguments.
+ * @return int 0 on success, 1 if any assembly failed, 2 on usage errors.
  */
-int main(){
+int main(int argc, char* argv[]){
+    Options options;
+    try{
+        if(!parseArguments(argc, argv, options)){
+            return 0;
+        }
+        if(options.fuzzWatch > 0){
+            return fuzzWatch(options);
+        }
+        if(options.watch){
+            return watchFile(options);
+        }
+        if(options.stream){
+            return streamAssembly(options);
+        }
+        if(!options.linkOutput.empty()){
+            return linkBatch(options);
+        }
+        if(!options.inputs.empty()){
+            return assembleBatch(options);
+        }
+    }catch(const invalid_argument& e){
+        cerr<<e.what()<<endl;
+        printUsage();
+        return 2;
+    }catch(const exception& e){
+        cerr<<"Error during assembly: "<<e.what()<<endl;
+        return 1;
+    }
+
     string filename;
     cout<<"Enter the filename with extension ('filename.asm'): ";
     cin>>filename;
 
     try{
         // Initiate the parsing and processing of the provided assembly file
-        parse(filename);
+        parse(filename, options.format, options.optimize);
         cout<<"Assembly completed successfully."<<endl;
     }catch (const std::exception& e) {
         cerr<<"Error during assembly: "<<e.what()<<endl;
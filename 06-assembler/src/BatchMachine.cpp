@@ -0,0 +1,538 @@
+/**
+ * @file BatchMachine.cpp
+ * @brief Implementation of the batched, structure-of-arrays Hack emulator.
+ *
+ * Every block of 16 machines is run independently (and in parallel when a pool is
+ * given). Its scheduler repeatedly picks the machines at the lowest PC and runs them:
+ * - Lockstep: Several machines execute the same instruction with 256-bit vector
+ *   operations. While they also agree on A (the common case: it was just loaded by an
+ *   `@` instruction), `M` is one row of the structure-of-arrays hot RAM. Otherwise each
+ *   machine's word is gathered or scattered on its own.
+ * - Scalar: A machine that is alone at its PC runs the plain interpreter loop.
+ * Both stop as soon as they reach the PC of a waiting machine, so machines that take
+ * different paths through a conditional meet again afterwards and continue together.
+ *
+ * Executing the lowest PC first is what makes them meet: the machines behind catch up
+ * with the ones ahead instead of being overtaken. The semantics are exactly those of
+ * `Machine::runInterpreter`, including the halting rules.
+ */
+#include <algorithm>
+#include <stdexcept>
+#include "../include/BatchMachine.h"
+#include "../include/Machine.h"
+#include "../include/ThreadPool.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BATCH_X86 1
+#endif
+
+using namespace std;
+
+namespace {
+
+typedef uint16_t Vector __attribute__((vector_size(32), may_alias));   // One word of every lane
+typedef uint64_t Wide __attribute__((vector_size(32), may_alias));     // The same bits, for fast tests
+
+struct alignas(32) Row {
+    Vector words;
+};
+
+static_assert(sizeof(Vector) / sizeof(uint16_t) == BatchMachine::LANES, "one vector per block");
+
+const size_t LANES = BatchMachine::LANES;
+const size_t PAGE_WORDS = 256;
+const size_t PAGES = 32768 / PAGE_WORDS;
+const uint16_t KBD = Machine::KBD;
+
+} // namespace
+
+/**
+ * @brief The registers and hot RAM of `LANES` machines, structure-of-arrays.
+ */
+struct alignas(32) BatchMachine::Block {
+    Vector pc{}, a{}, d{};
+    uint64_t cycles[LANES] = {};
+    uint16_t halted = 0;               // One bit per lane
+    uint16_t present = 0;              // Lanes that hold a machine (the last block may be partial)
+    vector<Row> hot;                   // hot[address] holds that word of every lane
+};
+
+namespace {
+
+/**
+ * @brief What one block's run needs, passed to the two compiled variants of `runBlock`.
+ */
+struct BlockJob {
+    const uint16_t* rom;
+    size_t end;                        // Program length
+    uint16_t* pc;                      // The block's registers, viewed as words
+    uint16_t* a;
+    uint16_t* d;
+    uint64_t* cycles;
+    uint16_t* halted;
+    uint16_t present;
+    Row* hot;
+    size_t hotWords;
+    unique_ptr<uint16_t[]>* pages;     // The page table of the block's first lane
+    uint64_t limit[LANES];             // Cycle count at which each lane stops
+    BatchStats stats;
+};
+
+// Helpers take vectors by reference: passing them by value to a function that is not
+// built for AVX would change its ABI, even though they are always inlined
+__attribute__((always_inline)) inline bool anySet(const Vector& value){
+    Wide wide = (Wide)value;
+    return (wide[0] | wide[1] | wide[2] | wide[3]) != 0;
+}
+
+__attribute__((always_inline)) inline void laneMask(uint16_t lanes, Vector& mask){
+    const Vector BITS = {0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080,
+                         0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000, 0x8000};
+    mask = (Vector)((BITS & lanes) != 0);
+}
+
+// Stores the lanes of `value` selected by `mask` into `target`
+__attribute__((always_inline)) inline void blend(const Vector& mask, const Vector& value, Vector& target){
+    target ^= (target ^ value) & mask;
+}
+
+/*
+ * Function: readWord / writeWord
+ * ------------------------------
+ * Access one lane's data memory word. Hot addresses are a column of the hot rows;
+ * the others live in the lane's pages, where a missing page reads as zero. Addresses
+ * above the keyboard are never written, so they read as zero too.
+ */
+__attribute__((always_inline)) inline uint16_t readWord(const BlockJob& job, size_t lane, uint16_t address){
+    if(address < job.hotWords){
+        return job.hot[address].words[lane];
+    }
+    const uint16_t* page = job.pages[lane * PAGES + address / PAGE_WORDS].get();
+    return page ? page[address % PAGE_WORDS] : 0;
+}
+
+__attribute__((always_inline)) inline void writeWord(BlockJob& job, size_t lane, uint16_t address, uint16_t value){
+    if(address < job.hotWords){
+        job.hot[address].words[lane] = value;
+        return;
+    }
+    unique_ptr<uint16_t[]>& page = job.pages[lane * PAGES + address / PAGE_WORDS];
+    if(!page){
+        page.reset(new uint16_t[PAGE_WORDS]());
+    }
+    page[address % PAGE_WORDS] = value;
+}
+
+/*
+ * Function: runScalar
+ * -------------------
+ * Runs a lane that is alone at its PC with the interpreter loop of `Machine`.
+ *
+ * Parameters:
+ *  - lane: The lane to run.
+ *  - waiting: The lowest PC of the other active lanes; reaching it ends the run.
+ *  - budget: The most instructions to execute.
+ */
+__attribute__((always_inline)) inline void runScalar(BlockJob& job, size_t lane, uint16_t waiting, uint64_t budget){
+    const uint16_t* code = job.rom;
+    uint16_t pc = job.pc[lane];
+    uint16_t a = job.a[lane];
+    uint16_t d = job.d[lane];
+    uint64_t executed = 0;
+    while(executed < budget && pc < waiting){
+        if(pc >= job.end){
+            *job.halted |= 1u << lane;
+            break;
+        }
+        uint16_t instruction = code[pc];
+        executed++;
+        if(!(instruction & 0x8000)){
+            a = instruction;
+            pc = (pc + 1) & 0x7FFF;
+            continue;
+        }
+        uint16_t address = a & 0x7FFF;
+        uint16_t y = (instruction & 0x1000) ? readWord(job, lane, address) : a;
+        uint16_t out = hackAlu(d, y, (instruction >> 6) & 0x3F);
+        if((instruction & 0x0008) && address < KBD){
+            writeWord(job, lane, address, out);
+        }
+        uint16_t next = (pc + 1) & 0x7FFF;
+        if(hackJump(out, instruction & 0x7)){
+            if(address + 1 == pc && code[address] == address && !(instruction & 0x0038)
+               && !((instruction & 0x1000) && address == KBD)){
+                pc = address;
+                *job.halted |= 1u << lane;
+                break;
+            }
+            next = address;
+        }
+        if(instruction & 0x0020){
+            a = out;
+        }
+        if(instruction & 0x0010){
+            d = out;
+        }
+        pc = next;
+    }
+    job.pc[lane] = pc;
+    job.a[lane] = a;
+    job.d[lane] = d;
+    job.cycles[lane] += executed;
+    job.stats.scalarSteps += executed;
+}
+
+/*
+ * Function: runLockstep
+ * ---------------------
+ * Runs the lanes of `group`, which are all at PC `p`, one instruction at a time for
+ * all of them at once.
+ *
+ * Parameters:
+ *  - group: The lanes to run (at least two).
+ *  - p: Their common PC.
+ *  - waiting: The lowest PC of the other active lanes; reaching it ends the run.
+ *  - budget: The most instructions to execute.
+ *
+ * Logic:
+ *  - A, D and the ALU output are vectors over all lanes; lanes outside the group
+ *    compute garbage that is never stored. Only the group's lanes are written back.
+ *  - After an A-instruction every lane has the same A, kept as the scalar `shared`
+ *    until a C-instruction loads A with differing values. While A is shared, M is the
+ *    hot row `hot[A]` (or a gather from the pages above the hot words).
+ *  - A conditional jump is taken by all lanes, by none, or by some. Only the last
+ *    ends the run; the lanes' own next PCs are stored and the scheduler takes over.
+ */
+__attribute__((always_inline)) inline void runLockstep(BlockJob& job, uint16_t group, uint16_t p, uint16_t waiting,
+                                                       uint64_t budget){
+    const uint16_t* code = job.rom;
+    Vector mask;
+    laneMask(group, mask);
+    Vector a = *(Vector*)job.a;
+    Vector d = *(Vector*)job.d;
+    Vector pcs = *(Vector*)job.pc;
+    bool uniform = !anySet((a ^ a[__builtin_ctz(group)]) & mask);
+    uint16_t shared = a[__builtin_ctz(group)];
+    bool diverged = false;
+
+    uint64_t steps = 0;
+    while(steps < budget && p < waiting){
+        if(p >= job.end){
+            *job.halted |= group;
+            break;
+        }
+        uint16_t instruction = code[p];
+        steps++;
+        if(!(instruction & 0x8000)){
+            uniform = true;
+            shared = instruction;
+            p = (p + 1) & 0x7FFF;
+            continue;
+        }
+
+        if(uniform){
+            a = Vector{} + shared;
+        }
+        uint16_t address = shared & 0x7FFF;
+        Vector y = a;
+        if(instruction & 0x1000){
+            if(uniform && address < job.hotWords){
+                y = job.hot[address].words;
+            }else{
+                for(size_t lane = 0; lane < LANES; lane++){
+                    if(group & (1u << lane)){
+                        y[lane] = readWord(job, lane, a[lane] & 0x7FFF);
+                    }
+                }
+            }
+        }
+
+        // The ALU of Machine.h, on vectors; the control bits are the same for all lanes
+        unsigned control = (instruction >> 6) & 0x3F;
+        Vector x = d;
+        if(control & 0x20) x = Vector{};
+        if(control & 0x10) x = ~x;
+        if(control & 0x08) y = Vector{};
+        if(control & 0x04) y = ~y;
+        Vector out = (control & 0x02) ? x + y : (x & y);
+        if(control & 0x01) out = ~out;
+
+        if(instruction & 0x0008){
+            if(uniform && address < job.hotWords){
+                blend(mask, out, job.hot[address].words);
+            }else{
+                for(size_t lane = 0; lane < LANES; lane++){
+                    uint16_t target = a[lane] & 0x7FFF;
+                    if((group & (1u << lane)) && target < KBD){
+                        writeWord(job, lane, target, out[lane]);
+                    }
+                }
+            }
+        }
+
+        uint16_t next = (p + 1) & 0x7FFF;
+        unsigned jump = instruction & 0x7;
+        if(jump != 0){
+            Vector taken = ~Vector{};
+            if(jump != 7){
+                Vector negative = (Vector)((out >> 15) != 0);
+                Vector zero = (Vector)(out == 0);
+                taken = Vector{};
+                if(jump & 4) taken |= negative;
+                if(jump & 2) taken |= zero;
+                if(jump & 1) taken |= ~(negative | zero);
+            }
+            taken &= mask;
+            if(!anySet(taken)){
+                // Not taken anywhere: fall through together
+            }else if(uniform && !anySet(mask & ~taken)){
+                if(address + 1 == p && code[address] == address && !(instruction & 0x0038)
+                   && !((instruction & 0x1000) && address == KBD)){
+                    p = address;
+                    *job.halted |= group;
+                    break;
+                }
+                next = address;
+            }else{
+                // The lanes go separate ways: give each its own next PC
+                for(size_t lane = 0; lane < LANES; lane++){
+                    if(!(group & (1u << lane))){
+                        continue;
+                    }
+                    uint16_t target = a[lane] & 0x7FFF;
+                    pcs[lane] = next;
+                    if(taken[lane]){
+                        pcs[lane] = target;
+                        if(target + 1 == p && code[target] == target && !(instruction & 0x0038)
+                           && !((instruction & 0x1000) && target == KBD)){
+                            *job.halted |= 1u << lane;
+                        }
+                    }
+                }
+                diverged = true;
+            }
+        }
+        if(instruction & 0x0020){
+            a = out;
+            shared = out[__builtin_ctz(group)];
+            uniform = !anySet((a ^ shared) & mask);
+        }
+        if(instruction & 0x0010){
+            d = out;
+        }
+        if(diverged){
+            break;
+        }
+        p = next;
+    }
+
+    if(uniform){
+        a = Vector{} + shared;
+    }
+    if(!diverged){
+        pcs = Vector{} + p;
+    }
+    blend(mask, a, *(Vector*)job.a);
+    blend(mask, d, *(Vector*)job.d);
+    blend(mask, pcs, *(Vector*)job.pc);
+    unsigned lanes = __builtin_popcount(group);
+    for(size_t lane = 0; lane < LANES; lane++){
+        if(group & (1u << lane)){
+            job.cycles[lane] += steps;
+        }
+    }
+    job.stats.vectorSteps += steps;
+    job.stats.vectorLanes += steps * lanes;
+}
+
+/*
+ * Function: runBlock
+ * ------------------
+ * Runs the lanes of one block until each has halted or spent the budget.
+ *
+ * Logic:
+ *  - Each round picks the lowest PC among the active lanes and runs the lanes at that
+ *    PC, in lockstep or, for a single lane, with the scalar loop.
+ *  - The run ends when it reaches the PC of another active lane, so that lane can join
+ *    (or, when the run jumped past it, catch up) in the next round.
+ */
+__attribute__((always_inline)) inline void runBlockBody(BlockJob& job){
+    for(;;){
+        uint16_t active = 0;
+        uint16_t lowest = 0xFFFF;
+        for(size_t lane = 0; lane < LANES; lane++){
+            uint16_t bit = 1u << lane;
+            if(!(job.present & bit) || (*job.halted & bit) || job.cycles[lane] >= job.limit[lane]){
+                continue;
+            }
+            active |= bit;
+            lowest = min(lowest, job.pc[lane]);
+        }
+        if(active == 0){
+            break;
+        }
+        uint16_t group = 0;
+        uint16_t waiting = 0xFFFF;
+        uint64_t budget = UINT64_MAX;
+        for(size_t lane = 0; lane < LANES; lane++){
+            if(!(active & (1u << lane))){
+                continue;
+            }
+            if(job.pc[lane] == lowest){
+                group |= 1u << lane;
+                budget = min(budget, job.limit[lane] - job.cycles[lane]);
+            }else{
+                waiting = min(waiting, job.pc[lane]);
+            }
+        }
+        if(__builtin_popcount(group) == 1){
+            runScalar(job, __builtin_ctz(group), waiting, budget);
+        }else{
+            runLockstep(job, group, lowest, waiting, budget);
+        }
+    }
+}
+
+void runBlockGeneric(BlockJob& job){
+    runBlockBody(job);
+}
+
+#ifdef BATCH_X86
+__attribute__((target("avx2")))
+void runBlockAvx2(BlockJob& job){
+    runBlockBody(job);
+}
+#endif
+
+using BlockRunner = void (*)(BlockJob&);
+
+struct RunnerChoice {
+    BlockRunner run;
+    const char* name;
+};
+
+const RunnerChoice& bestRunner(){
+    static const RunnerChoice choice = []{
+#ifdef BATCH_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")){
+            return RunnerChoice{runBlockAvx2, "avx2"};
+        }
+#endif
+        return RunnerChoice{runBlockGeneric, "generic"};
+    }();
+    return choice;
+}
+
+} // namespace
+
+BatchMachine::BatchMachine(const vector<uint16_t>& program, size_t count, size_t hotWords)
+    : rom(program), programLength(program.size()), machineCount(count), hotWords(min<size_t>(hotWords, KBD)),
+      blocks((count + LANES - 1) / LANES), pages(count * PAGES) {
+    if(program.size() > Machine::ROM_SIZE){
+        throw runtime_error("Program has " + to_string(program.size()) + " instructions but the ROM holds "
+                            + to_string(Machine::ROM_SIZE));
+    }
+    // Jumps may target any address, so the ROM is padded to its full size with @0
+    rom.resize(Machine::ROM_SIZE, 0);
+    for(size_t b = 0; b < blocks.size(); b++){
+        size_t lanes = min(LANES, count - b * LANES);
+        blocks[b].present = static_cast<uint16_t>((1u << lanes) - 1);
+        blocks[b].hot.assign(this->hotWords, Row{});
+    }
+}
+
+BatchMachine::~BatchMachine() = default;
+
+/**
+ * @brief Runs every machine until it halts or has executed `maxCycles` more instructions.
+ *
+ * Blocks share nothing but the ROM, so they are handed to the pool a few at a time.
+ *
+ * @param maxCycles The budget of each machine.
+ * @param pool If given, the blocks are spread over this pool.
+ */
+void BatchMachine::run(uint64_t maxCycles, ThreadPool* pool){
+    BlockRunner runner = bestRunner().run;
+    vector<BatchStats> stats(blocks.size());
+    auto runBlocks = [&](size_t begin, size_t end){
+        for(size_t b = begin; b < end; b++){
+            Block& block = blocks[b];
+            BlockJob job{rom.data(), programLength, reinterpret_cast<uint16_t*>(&block.pc),
+                         reinterpret_cast<uint16_t*>(&block.a), reinterpret_cast<uint16_t*>(&block.d),
+                         block.cycles, &block.halted, block.present, block.hot.data(), hotWords,
+                         pages.data() + b * LANES * PAGES, {}, BatchStats{}};
+            for(size_t lane = 0; lane < LANES; lane++){
+                job.limit[lane] = block.cycles[lane] + min(maxCycles, UINT64_MAX - block.cycles[lane]);
+            }
+            runner(job);
+            stats[b] = job.stats;
+        }
+    };
+    if(pool){
+        pool->parallelFor(blocks.size(), 4, runBlocks);
+    }else{
+        runBlocks(0, blocks.size());
+    }
+
+    runStats = BatchStats{};
+    for(const BatchStats& block : stats){
+        runStats.vectorSteps += block.vectorSteps;
+        runStats.vectorLanes += block.vectorLanes;
+        runStats.scalarSteps += block.scalarSteps;
+    }
+    runStats.instructions = runStats.vectorLanes + runStats.scalarSteps;
+}
+
+uint16_t* BatchMachine::hotWord(size_t machine, uint16_t address) const {
+    return reinterpret_cast<uint16_t*>(const_cast<Row*>(&blocks[machine / LANES].hot[address])) + machine % LANES;
+}
+
+uint16_t BatchMachine::peek(size_t machine, uint16_t address) const {
+    address &= 0x7FFF;
+    if(address < hotWords){
+        return *hotWord(machine, address);
+    }
+    const uint16_t* page = pages[machine * PAGES + address / PAGE_WORDS].get();
+    return page ? page[address % PAGE_WORDS] : 0;
+}
+
+void BatchMachine::poke(size_t machine, uint16_t address, uint16_t value){
+    address &= 0x7FFF;
+    if(address > KBD){
+        return;
+    }
+    if(address < hotWords){
+        *hotWord(machine, address) = value;
+        return;
+    }
+    unique_ptr<uint16_t[]>& page = pages[machine * PAGES + address / PAGE_WORDS];
+    if(!page){
+        page.reset(new uint16_t[PAGE_WORDS]());
+    }
+    page[address % PAGE_WORDS] = value;
+}
+
+uint16_t BatchMachine::pc(size_t machine) const {
+    return blocks[machine / LANES].pc[machine % LANES];
+}
+
+uint16_t BatchMachine::a(size_t machine) const {
+    return blocks[machine / LANES].a[machine % LANES];
+}
+
+uint16_t BatchMachine::d(size_t machine) const {
+    return blocks[machine / LANES].d[machine % LANES];
+}
+
+bool BatchMachine::halted(size_t machine) const {
+    return (blocks[machine / LANES].halted >> (machine % LANES)) & 1;
+}
+
+uint64_t BatchMachine::cycles(size_t machine) const {
+    return blocks[machine / LANES].cycles[machine % LANES];
+}
+
+const char* BatchMachine::implementation(){
+    return bestRunner().name;
+}
@@ -10,14 +10,17 @@
  * - C-instructions (e.g., `D=M+1`) specify computation, storage, and optional jump conditions.
  * 
  * Uses:
- * - `stoi`: Converts a string to an integer.
- * - `bitset<15>`: A template that converts an integer to a binary string. Here, `15` denotes 
- *   that the integer is stored in a 15-bit binary representation.
+ * - `uint16_t`: Every instruction is encoded as one 16-bit integer. The fields are combined
+ *   with shifts and bitwise ORs instead of concatenating strings.
+ * - `string_view`: A non-owning view of characters, so the instruction fields can be
+ *   examined in place without copying them into new strings.
+ * - `from_chars`: Converts decimal text to an integer without allocating or throwing.
  */
-#include <iostream>
-#include <fstream>
+#include <cctype>
 #include <string>
-#include <bitset>
+#include <string_view>
+#include <charconv>
+#include <stdexcept>
 #include "../include/BinCodes.h"
 #include "../include/SymbolTables.h"
 
@@ -25,17 +28,68 @@
 using namespace std;
 
 /**
- * @brief Translates an A-instruction into binary code.
+ * @brief Encodes an A-instruction that loads the given address or constant.
  * 
- * Converts an A-instruction (e.g., `@5`) into a 16-bit binary string. A-instructions
- * start with a leading '0' bit, followed by a 15-bit binary representation of the address.
+ * A-instructions start with a leading '0' bit, followed by a 15-bit value, so any value
+ * in 0..32767 is already its own encoding.
+ * 
+ * @param address The value to load.
+ * @return uint16_t The encoded A-instruction.
+ */
+uint16_t encodeAInstruction(int address){
+    if(address < 0 || address > 0x7FFF){
+        throw runtime_error("A-instruction value out of range: " + to_string(address));
+    }
+    return static_cast<uint16_t>(address);
+}
+
+/**
+ * @brief Translates a numeric A-instruction into binary code.
+ * 
+ * Converts an A-instruction (e.g., `@5`) into a 16-bit word. The digits after '@'
+ * must make up the whole token.
  * 
  * @param token The A-instruction in the format "@value".
- * @return string A 16-bit binary string representing the A-instruction.
+ * @return uint16_t The encoded A-instruction.
  */
-string translateAInstruction(const string& token){
-    int address = stoi(token.substr(1));  // `stoi` converts the address part of token (after '@') to an integer
-    return "0" + bitset<15>(address).to_string();  // Convert to 15-bit binary and prepend '0' for A-instruction
+uint16_t translateAInstruction(string_view token){
+    string_view digits = token.substr(1);  // The value part of the token (after '@')
+    int address = 0;
+    auto [end, error] = from_chars(digits.data(), digits.data() + digits.size(), address);
+    if(digits.empty() || error != errc() || end != digits.data() + digits.size()){
+        throw runtime_error("Invalid A-instruction: " + string(token));
+    }
+    return encodeAInstruction(address);
+}
+
+/**
+ * @brief Tests whether an instruction is an A-instruction naming a label or variable.
+ * 
+ * @param token The instruction text.
+ * @return bool true if the text after '@' is neither a number nor a predefined symbol.
+ */
+bool isUserSymbol(string_view token){
+    return token[0] == '@' && token.size() > 1 && !isdigit(static_cast<unsigned char>(token[1])) &&
+           lookupPredefinedSymbol(token.substr(1)) < 0;
+}
+
+/**
+ * @brief Encodes an instruction that does not depend on the program's own symbols.
+ * 
+ * @param token A C-instruction, or an A-instruction with a constant or predefined symbol.
+ * @return uint16_t The encoded instruction.
+ */
+uint16_t encodeFixedInstruction(string_view token){
+    if(token[0] != '@'){
+        return translateCInstruction(token);
+    }
+    if(token.size() == 1){
+        throw runtime_error("Missing A-instruction value");
+    }
+    if(isdigit(static_cast<unsigned char>(token[1]))){
+        return translateAInstruction(token);
+    }
+    return encodeAInstruction(lookupPredefinedSymbol(token.substr(1)));
 }
 
 /**
@@ -43,33 +97,66 @@ string translateAInstruction(const string& token){
  * 
  * C-instructions define computation and destination, with an optional jump condition. 
  * The binary format is "111a c1c2c3c4 c5c6d1d2 d3j1j2j3":
- * - `a` and `c (computation)`: Bits representing the computation type and operands.
- * - `d (destination)`: Specifies the destination register(s).
- * - `j (jump)`: Specifies a jump condition.
+ * - `a` and `c (computation)`: Bits 12..6, looked up in the computation table.
+ * - `d (destination)`: Bits 5..3, specifies the destination register(s).
+ * - `j (jump)`: Bits 2..0, specifies a jump condition.
  * 
  * @param token The C-instruction in the format "dest=comp;jump".
- * @return string The 16-bit binary representation of the C-instruction.
+ * @return uint16_t The 16-bit encoding of the C-instruction.
  */
-string translateCInstruction(const string& token){
-    // Initial binary string for a C-instruction begins with "111"
-    string binary = "111";
-
+uint16_t translateCInstruction(string_view token){
     // Parse dest, comp, and jump from instruction
     size_t equalSignPos = token.find('=');
-    size_t semicolonPos = token.find(";");
-    string dest, comp, jump;
+    size_t semicolonPos = token.find(';');
+    string_view dest, comp, jump;
 
-    if(equalSignPos != string::npos){
+    if(equalSignPos != string_view::npos){
         dest = token.substr(0, equalSignPos); // Destination before '='
     }
 
-    if(semicolonPos != string::npos){
+    if(semicolonPos != string_view::npos){
         jump = token.substr(semicolonPos + 1); // Jump after ';'
     }
-    
+
     comp = token.substr(equalSignPos + 1, semicolonPos - equalSignPos - 1); // Computation in between
 
-    binary += computationMap[comp] + destinationMap[dest] + jumpMap[jump];
+    int compBits = lookupComputation(comp);
+    int destBits = lookupDestination(dest);
+    int jumpBits = lookupJump(jump);
+    if(compBits < 0){
+        throw runtime_error("Unknown computation '" + string(comp) + "' in: " + string(token));
+    }
+    if(destBits < 0){
+        throw runtime_error("Unknown destination '" + string(dest) + "' in: " + string(token));
+    }
+    if(jumpBits < 0){
+        throw runtime_error("Unknown jump '" + string(jump) + "' in: " + string(token));
+    }
+
+    // "111" prefix, then the a+comp, dest and jump fields
+    return static_cast<uint16_t>(0xE000 | (compBits << 6) | (destBits << 3) | jumpBits);
+}
+
+/**
+ * @brief Writes the 16 '0'/'1' characters of a machine word, most significant bit first.
+ * 
+ * @param word The encoded instruction.
+ * @param out Destination for exactly 16 characters.
+ */
+void formatBinary(uint16_t word, char* out){
+    for(int bit = 0; bit < 16; bit++){
+        out[bit] = static_cast<char>('0' + ((word >> (15 - bit)) & 1));
+    }
+}
 
-    return binary;
+/**
+ * @brief Returns the 16-character binary text of a machine word.
+ * 
+ * @param word The encoded instruction.
+ * @return string The binary text.
+ */
+string toBinaryString(uint16_t word){
+    string text(16, '0');
+    formatBinary(word, &text[0]);
+    return text;
 }
@@ -0,0 +1,121 @@
+/**
+ * @file Decoder.cpp
+ * @brief Implementation of the decode table.
+ *
+ * The table is the inverse of the encoder, built from the same opcode tables:
+ * - Words 0..32767 are A-instructions; their text is "@" and the decimal value.
+ * - For C-instructions, the canonical computation, destination and jump mnemonics are
+ *   first placed in small tables indexed by their bit patterns, then combined for every
+ *   `111a cccc ccdd djjj` word. Aliases (e.g. "M+D") are skipped, so each word has
+ *   one fixed spelling.
+ * - The remaining words (`100x`, `101x` and `110x` prefixes, and unknown computations)
+ *   stay empty.
+ */
+#include <array>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../include/Decoder.h"
+#include "../include/BinCodes.h"
+#include "../include/SymbolTables.h"
+
+using namespace std;
+
+namespace {
+
+void setText(DecodedWord& entry, string_view text){
+    memcpy(entry.text, text.data(), text.size());
+    entry.length = static_cast<uint8_t>(text.size());
+}
+
+array<DecodedWord, 65536> buildDecodeTable(){
+    array<DecodedWord, 65536> table{};
+    for(uint32_t word = 0; word < 0x8000; word++){
+        setText(table[word], "@" + to_string(word));
+    }
+
+    // The first entry of each bit pattern is its canonical spelling
+    array<string_view, 128> computations{};
+    array<bool, 128> known{};
+    for(const Mnemonic& entry : computationMap){
+        if(!known[entry.bits]){
+            known[entry.bits] = true;
+            computations[entry.bits] = entry.name;
+        }
+    }
+    array<string_view, 8> destinations, jumps;
+    for(const Mnemonic& entry : destinationMap) destinations[entry.bits] = entry.name;
+    for(const Mnemonic& entry : jumpMap) jumps[entry.bits] = entry.name;
+
+    string text;
+    for(uint32_t comp = 0; comp < 128; comp++){
+        if(!known[comp]){
+            continue;
+        }
+        for(uint32_t dest = 0; dest < 8; dest++){
+            for(uint32_t jump = 0; jump < 8; jump++){
+                text.clear();
+                if(dest != 0){
+                    text.append(destinations[dest]).push_back('=');
+                }
+                text.append(computations[comp]);
+                if(jump != 0){
+                    text.append(1, ';').append(jumps[jump]);
+                }
+                setText(table[0xE000 | (comp << 6) | (dest << 3) | jump], text);
+            }
+        }
+    }
+    return table;
+}
+
+} // namespace
+
+/**
+ * @brief Returns the decode table, building it on the first call.
+ *
+ * @return const array<DecodedWord, 65536>& The table.
+ */
+const array<DecodedWord, 65536>& decodeTable(){
+    static const array<DecodedWord, 65536> table = buildDecodeTable();
+    return table;
+}
+
+/**
+ * @brief Renders a program as assembly source, one instruction per line.
+ *
+ * The output is sized up front and filled by copying table entries, so the cost per
+ * word is one load and one short copy.
+ *
+ * @param words The machine words in ROM order.
+ * @param addresses Append each word's ROM address as a comment.
+ * @param invalid If not null, receives the number of words without an instruction.
+ * @return string The assembly source.
+ */
+string disassemble(const vector<uint16_t>& words, bool addresses, size_t* invalid){
+    const array<DecodedWord, 65536>& table = decodeTable();
+    const size_t COLUMN = 16;  // Where the address comments start
+    string text;
+    text.reserve(words.size() * (addresses ? COLUMN + 12 : 12));
+    size_t unknown = 0;
+    for(size_t i = 0; i < words.size(); i++){
+        const DecodedWord& entry = table[words[i]];
+        size_t start = text.size();
+        if(entry.length != 0){
+            text.append(entry.text, entry.length);
+        }else{
+            unknown++;
+            text.append("// no instruction: ").append(toBinaryString(words[i]));
+        }
+        if(addresses){
+            text.append(text.size() - start < COLUMN ? COLUMN - (text.size() - start) : 1, ' ');
+            text.append("// ").append(to_string(i));
+        }
+        text.push_back('\n');
+    }
+    if(invalid != nullptr){
+        *invalid = unknown;
+    }
+    return text;
+}
@@ -0,0 +1,452 @@
+/**
+ * @file Disassembler.cpp
+ * @brief Main entry point for the Hack disassembler and its differential fuzzer.
+ *
+ * This file contains the command-line front end of the decode table in Decoder.h. It
+ * turns a `.hack` file (text or binary, e.g. a ROM dump) back into assembly source,
+ * or, with `--fuzz`, checks the decoder and the encoder against each other.
+ *
+ * Key Components:
+ * - Disassembly: One table load per word; the source goes to standard output or `-o FILE`.
+ * - Table check: Every one of the 65,536 words that decodes must encode back to itself,
+ *   and every (computation, destination, jump) combination the encoder accepts,
+ *   aliases included, must decode.
+ * - Random programs: Blocks of random instructions (C-instructions in every spelling,
+ *   constants, predefined symbols, labels and variables) are assembled, disassembled
+ *   and assembled again, and the two programs are compared word by word. Each
+ *   C-instruction is also round-tripped through `translateCInstruction` on its own.
+ * - The blocks are spread over a `ThreadPool` and seeded by their number, so a failure
+ *   can be reproduced with the same `--seed` regardless of the thread count.
+ * - Exit status: 0 on success, 1 if a word has no instruction or the fuzzer finds a
+ *   mismatch, 2 for usage errors.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../include/BinCodes.h"
+#include "../include/CommandLine.h"
+#include "../include/Decoder.h"
+#include "../include/HackFile.h"
+#include "../include/Parser.h"
+#include "../include/SymbolTables.h"
+#include "../include/ThreadPool.h"
+
+using namespace std;
+
+/**
+ * @brief Settings collected from the command line.
+ */
+struct Options {
+    string input;             // The .hack file to disassemble
+    string output;            // Empty: standard output
+    bool addresses = false;   // Append each word's ROM address as a comment
+    uint64_t fuzz = 0;        // Number of random instructions to check; 0: disassemble instead
+    uint64_t seed = 1;
+    unsigned threads = 0;
+};
+
+/**
+ * @brief Prints the command-line help.
+ */
+static void printUsage(){
+    cout<<"Usage: Disassembler [options] input.hack\n"
+        <<"       Disassembler --fuzz N [--seed N] [-j N]\n"
+        <<"\n"
+        <<"Disassembles a text or binary .hack file into Hack assembly. Words that no\n"
+        <<"instruction encodes to are written as comments and make the exit status 1.\n"
+        <<"\n"
+        <<"Options:\n"
+        <<"  -o, --output FILE     Write the assembly to FILE instead of standard output\n"
+        <<"  -a, --addresses       Append each instruction's ROM address as a comment\n"
+        <<"  --fuzz N              Check the decode table, then round-trip N random instructions\n"
+        <<"                        through the assembler and the disassembler\n"
+        <<"  --seed N              Seed of the random programs (default 1)\n"
+        <<"  -j, --jobs N          Number of worker threads (default: all cores)\n"
+        <<"  -h, --help            Show this help\n";
+}
+
+/**
+ * @brief Reads the options and the input from the command line.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Command-line arguments.
+ * @param options Receives the parsed settings.
+ * @return bool false if the program should exit (after `--help`).
+ * @throws std::invalid_argument For unknown options, bad values or a wrong number of inputs.
+ */
+static bool parseArguments(int argc, char* argv[], Options& options){
+    vector<string> inputs;
+    for(int i = 1; i < argc; i++){
+        string argument = argv[i];
+        auto value = [&]() -> string {
+            if(i + 1 >= argc){
+                throw invalid_argument("Missing value for " + argument);
+            }
+            return argv[++i];
+        };
+
+        if(argument == "-h" || argument == "--help"){
+            printUsage();
+            return false;
+        }else if(argument == "-o" || argument == "--output"){
+            options.output = value();
+        }else if(argument == "-a" || argument == "--addresses"){
+            options.addresses = true;
+        }else if(argument == "--fuzz"){
+            options.fuzz = max<uint64_t>(1, parseNumber(value(), UINT64_MAX));
+        }else if(argument == "--seed"){
+            options.seed = parseNumber(value(), UINT64_MAX);
+        }else if(argument == "-j" || argument == "--jobs"){
+            options.threads = static_cast<unsigned>(parseNumber(value(), 1024));
+        }else if(argument.size() > 1 && argument[0] == '-'){
+            throw invalid_argument("Unknown option: " + argument);
+        }else{
+            inputs.push_back(argument);
+        }
+    }
+    if(options.fuzz > 0){
+        if(!inputs.empty() || !options.output.empty()){
+            throw invalid_argument("--fuzz takes no input or output file");
+        }
+        return true;
+    }
+    if(inputs.size() != 1){
+        throw invalid_argument("Expected exactly one .hack file");
+    }
+    options.input = inputs[0];
+    return true;
+}
+
+/**
+ * @brief Encodes the text of a decode table entry, which never names a user symbol.
+ */
+static uint16_t encodeDecoded(string_view text){
+    return text[0] == '@' ? translateAInstruction(text) : translateCInstruction(text);
+}
+
+/**
+ * @brief Returns "dest=comp;jump" with the empty fields left out.
+ */
+static string cInstruction(string_view dest, string_view comp, string_view jump){
+    string text;
+    if(!dest.empty()){
+        text.append(dest).push_back('=');
+    }
+    text.append(comp);
+    if(!jump.empty()){
+        text.append(1, ';').append(jump);
+    }
+    return text;
+}
+
+/*
+ * Function: checkDecodeTable
+ * --------------------------
+ * Checks that the decode table and the encoder are inverses of each other.
+ *
+ * Parameters:
+ *  - decodable: Receives the number of words that have text.
+ *
+ * Returns:
+ *  - An empty string if they are; otherwise a description of the first mismatch.
+ *
+ * Logic:
+ *  - Every word with text must encode back to itself, so decoding loses nothing.
+ *  - Every combination of computation (aliases included), destination and jump must
+ *    encode to a word with text, so no instruction is missing from the table.
+ *    A-instructions are covered by the first check, since all 32,768 have text.
+ */
+static string checkDecodeTable(size_t& decodable){
+    const array<DecodedWord, 65536>& table = decodeTable();
+    decodable = 0;
+    for(uint32_t word = 0; word < table.size(); word++){
+        string_view text = table[word].view();
+        if(text.empty()){
+            if(word < 0x8000){
+                return "A-instruction " + to_string(word) + " has no text";
+            }
+            continue;
+        }
+        decodable++;
+        try{
+            uint16_t encoded = encodeDecoded(text);
+            if(encoded != word){
+                return "word " + toBinaryString(static_cast<uint16_t>(word)) + " decodes to '" + string(text) +
+                       "', which encodes to " + toBinaryString(encoded);
+            }
+        }catch(const exception& e){
+            return "word " + toBinaryString(static_cast<uint16_t>(word)) + " decodes to '" + string(text) +
+                   "', which does not assemble: " + e.what();
+        }
+    }
+    for(const Mnemonic& comp : computationMap){
+        for(const Mnemonic& dest : destinationMap){
+            for(const Mnemonic& jump : jumpMap){
+                string text = cInstruction(dest.name, comp.name, jump.name);
+                uint16_t word = translateCInstruction(text);
+                if(table[word].length == 0){
+                    return "'" + text + "' encodes to " + toBinaryString(word) + ", which does not decode";
+                }
+            }
+        }
+    }
+    return "";
+}
+
+/*
+ * Function: randomProgram
+ * -----------------------
+ * Writes one block of random assembly source.
+ *
+ * Parameters:
+ *  - random: The block's generator.
+ *  - count: Number of instructions.
+ *  - cInstructions: Receives the text of every C-instruction, for the direct check.
+ *
+ * Logic:
+ *  - 40% C-instructions, with any spelling of the computation (aliases included) and
+ *    random destinations and jumps; 20% decimal constants; 10% predefined symbols;
+ *    15% labels and 15% variables, from small pools so that names repeat.
+ *  - Every label in the pool is defined once, at a random instruction, so forward and
+ *    backward references both occur.
+ *  - Some statements get surrounding blanks or a trailing comment.
+ */
+static string randomProgram(uint64_t& random, size_t count, vector<string>& cInstructions){
+    static const char* const PREDEFINED[] = {
+        "SP", "LCL", "ARG", "THIS", "THAT", "R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7",
+        "R8", "R9", "R10", "R11", "R12", "R13", "R14", "R15", "SCREEN", "KBD"
+    };
+    const size_t LABELS = 64, VARIABLES = 256;
+    vector<size_t> labelAt(LABELS);
+    for(size_t& at : labelAt) at = nextRandom(random) % count;
+
+    string source;
+    source.reserve(count * 16);
+    cInstructions.clear();
+    for(size_t i = 0; i < count; i++){
+        for(size_t label = 0; label < LABELS; label++){
+            if(labelAt[label] == i){
+                source.append("(LABEL.").append(to_string(label)).append(")\n");
+            }
+        }
+        uint64_t bits = nextRandom(random);
+        unsigned kind = static_cast<unsigned>(bits % 100);
+        bits /= 100;
+        string statement;
+        if(kind < 40){
+            const Mnemonic& comp = computationMap[bits % computationMap.size()];
+            const Mnemonic& dest = destinationMap[(bits >> 8) % 8];
+            const Mnemonic& jump = jumpMap[(bits >> 11) % 8];
+            statement = cInstruction(dest.name, comp.name, jump.name);
+            cInstructions.push_back(statement);
+        }else if(kind < 60){
+            statement = "@" + to_string(bits % 0x8000);
+        }else if(kind < 70){
+            statement = string("@") + PREDEFINED[bits % size(PREDEFINED)];
+        }else if(kind < 85){
+            statement = "@LABEL." + to_string(bits % LABELS);
+        }else{
+            statement = "@var_" + to_string(bits % VARIABLES);
+        }
+        switch((bits >> 20) % 8){
+            case 0: source.append("    ").append(statement).append("\n"); break;
+            case 1: source.append(statement).append(" // comment\n"); break;
+            case 2: source.append("\t").append(statement).append("\r\n"); break;
+            default: source.append(statement).append("\n"); break;
+        }
+    }
+    return source;
+}
+
+/*
+ * Function: fuzzBlock
+ * -------------------
+ * Runs the round trips for one block of random instructions.
+ *
+ * Parameters:
+ *  - random: The block's generator.
+ *  - size: Number of instructions.
+ *  - decodedWords, decodeSeconds: Incremented by the words disassembled and the time it took.
+ *
+ * Returns:
+ *  - An empty string if every check passed; otherwise a description of the first failure.
+ *
+ * Logic:
+ *  1. Each C-instruction is encoded with `translateCInstruction`, decoded, and encoded
+ *     again; both words must be equal.
+ *  2. The whole program is assembled, disassembled and assembled again. Symbols become
+ *     numbers on the way, so the two programs must be identical word for word.
+ */
+static string fuzzBlock(uint64_t& random, size_t size, uint64_t& decodedWords, double& decodeSeconds){
+    vector<string> cInstructions;
+    string source = randomProgram(random, size, cInstructions);
+
+    for(const string& text : cInstructions){
+        uint16_t word = translateCInstruction(text);
+        string_view decoded = disassembleWord(word);
+        if(decoded.empty()){
+            return "'" + text + "' encodes to " + toBinaryString(word) + ", which does not decode";
+        }
+        uint16_t again = translateCInstruction(decoded);
+        if(again != word){
+            return "'" + text + "' encodes to " + toBinaryString(word) + " but its disassembly '" +
+                   string(decoded) + "' encodes to " + toBinaryString(again);
+        }
+    }
+
+    Assembler original;
+    original.setSource(source, "random");
+    if(!original.assemble()){
+        return "random program does not assemble: " + original.diagnostics()[0];
+    }
+    const vector<uint16_t>& words = original.machineCode();
+    auto start = chrono::steady_clock::now();
+    size_t invalid = 0;
+    string disassembly = disassemble(words, false, &invalid);
+    decodeSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    decodedWords += words.size();
+    if(invalid != 0){
+        return to_string(invalid) + " assembled word(s) have no instruction";
+    }
+
+    Assembler roundTrip;
+    roundTrip.setSource(disassembly, "disassembly");
+    if(!roundTrip.assemble()){
+        return "disassembly does not assemble: " + roundTrip.diagnostics()[0];
+    }
+    const vector<uint16_t>& again = roundTrip.machineCode();
+    if(again.size() != words.size()){
+        return "disassembly has " + to_string(again.size()) + " instructions instead of " + to_string(words.size());
+    }
+    for(size_t i = 0; i < words.size(); i++){
+        if(again[i] != words[i]){
+            return "ROM[" + to_string(i) + "] is " + toBinaryString(words[i]) + ", disassembled as '" +
+                   string(disassembleWord(words[i])) + "', which assembles to " + toBinaryString(again[i]);
+        }
+    }
+    return "";
+}
+
+/**
+ * @brief Checks the decode table, then round-trips random programs on all threads.
+ *
+ * @param options The number of instructions, the seed and the thread count.
+ * @return int 0 if every check passed, 1 otherwise.
+ */
+static int fuzz(const Options& options){
+    const size_t BLOCK_SIZE = 4096;  // Instructions per random program
+
+    auto start = chrono::steady_clock::now();
+    size_t decodable = 0;
+    string tableError = checkDecodeTable(decodable);
+    if(!tableError.empty()){
+        cout<<"Decode table: FAILED: "<<tableError<<endl;
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout<<"Decode table: OK, "<<decodable<<" of 65536 words decode ("<<(computationMap.size() * 64)
+        <<" C-instruction spellings checked) in "<<seconds<<" s."<<endl;
+
+    uint64_t blocks = (options.fuzz + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    ThreadPool pool(options.threads);
+    Failure failure;
+    mutex totals;
+    uint64_t decodedWords = 0;
+    double decodeSeconds = 0;
+    start = chrono::steady_clock::now();
+    size_t chunk = static_cast<size_t>(max<uint64_t>(1, min<uint64_t>(64, blocks / (pool.size() * 8 + 1))));
+    pool.parallelFor(static_cast<size_t>(blocks), chunk, [&](size_t begin, size_t end){
+        uint64_t words = 0;
+        double time = 0;
+        for(size_t block = begin; block < end && !failure.found; block++){
+            uint64_t random = blockSeed(options.seed, block);
+            string error;
+            try{
+                error = fuzzBlock(random, BLOCK_SIZE, words, time);
+            }catch(const exception& e){
+                error = e.what();
+            }
+            if(!error.empty()){
+                failure.record(block, "block " + to_string(block) + ": " + error);
+                break;
+            }
+        }
+        lock_guard<mutex> guard(totals);
+        decodedWords += words;
+        decodeSeconds += time;
+    });
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if(failure.found){
+        cout<<"Round trips: FAILED: "<<failure.message<<" (--seed "<<options.seed<<")"<<endl;
+        return 1;
+    }
+    cout<<"Round trips: OK, "<<blocks * BLOCK_SIZE<<" random instructions in "<<seconds<<" s";
+    if(seconds > 0){
+        cout<<" ("<<(blocks * BLOCK_SIZE / seconds / 1e6)<<" M/s)";
+    }
+    if(decodeSeconds > 0){
+        cout<<"; disassembly alone: "<<(decodedWords / decodeSeconds / 1e6)<<" M words/s";
+    }
+    cout<<"."<<endl;
+    return 0;
+}
+
+/**
+ * @brief Disassembles one .hack file.
+ *
+ * @param options The input, the output and whether to add addresses.
+ * @return int 0 if every word disassembled, 1 otherwise.
+ */
+static int disassembleFile(const Options& options){
+    vector<uint16_t> words = readHackFile(options.input);
+    size_t invalid = 0;
+    string text = disassemble(words, options.addresses, &invalid);
+    if(options.output.empty()){
+        cout<<text<<flush;
+    }else{
+        writeFile(options.output, text);
+    }
+    if(invalid != 0){
+        cerr<<options.input<<": "<<invalid<<" of "<<words.size()<<" word(s) have no instruction."<<endl;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Main function for the Disassembler program
+ *
+ * Process Flow:
+ * 1. Parse the command-line options.
+ * 2. With `--fuzz`, check the decode table and round-trip random programs (`fuzz`).
+ * 3. Otherwise, disassemble the input file (`disassembleFile`).
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Command-line arguments.
+ * @return int 0 on success, 1 on invalid words, mismatches or I/O errors, 2 on usage errors.
+ */
+int main(int argc, char* argv[]){
+    Options options;
+    try{
+        if(!parseArguments(argc, argv, options)){
+            return 0;
+        }
+    }catch(const invalid_argument& e){
+        cerr<<e.what()<<endl;
+        printUsage();
+        return 2;
+    }
+
+    try{
+        return options.fuzz > 0 ? fuzz(options) : disassembleFile(options);
+    }catch(const exception& e){
+        cerr<<"Error: "<<e.what()<<endl;
+        return 1;
+    }
+}
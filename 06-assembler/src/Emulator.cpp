@@ -0,0 +1,541 @@
+/**
+ * @file Emulator.cpp
+ * @brief Main entry point for the Hack CPU emulator.
+ *
+ * This file contains the command-line front end of `Machine`: it loads a program
+ * (a .hack file, or an .asm file assembled in memory), sets up RAM, runs the program
+ * and prints the final state.
+ *
+ * Key Components:
+ * - Command-line parsing: the program, a cycle budget, initial RAM words, a held key,
+ *   the RAM ranges to print afterwards and the execution engine.
+ * - Profiling: `--profile` and `--collapsed` write the reports of Profiler.h, with the
+ *   labels of an .asm program taken from its symbol table.
+ * - Sweeps: `--sweep` runs one machine per point of an input grid with `BatchMachine`
+ *   and prints the requested RAM words of each.
+ * - Checkpoints and key logs (Replay.h): `--restore` starts from a saved state, `--save`
+ *   and `--save-every` write states, `--replay` presses keys at recorded cycles and
+ *   `--record` writes every key change of the run.
+ * - Frames: `--frame` and `--frame-every` save the screen as PBM or PNG images through
+ *   a `Framebuffer`; periodic frames are encoded and written on a background thread.
+ * - Addresses may be numbers or predefined symbols such as `R0`, `SP` or `SCREEN`.
+ * - Exit status: 0 if the program ran, 1 if it could not be loaded, 2 for usage errors.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../include/BatchMachine.h"
+#include "../include/CommandLine.h"
+#include "../include/Framebuffer.h"
+#include "../include/Machine.h"
+#include "../include/Profiler.h"
+#include "../include/Replay.h"
+#include "../include/SymbolTables.h"
+#include "../include/ThreadPool.h"
+
+using namespace std;
+
+/**
+ * @brief One axis of an input grid: a RAM word and the values it takes.
+ */
+struct Sweep {
+    string name;                                 // As given, e.g. "R0"
+    uint16_t address;
+    int32_t from, to;                            // Inclusive, as signed words
+};
+
+/**
+ * @brief Settings collected from the command line.
+ */
+struct Options {
+    string program;
+    uint64_t cycles = UINT64_MAX;               // Default: run until the program halts
+    vector<pair<uint16_t, uint16_t>> writes;     // RAM words to set before running
+    vector<pair<uint16_t, uint16_t>> dumps;      // Address and word count to print afterwards
+    int32_t key = -1;                            // Key held from the start; -1 leaves KBD alone
+    Engine engine = Engine::Threaded;
+    string profileReport;                        // Text report file, "-" for standard output
+    string collapsedStacks;                      // Flame graph input file, "-" for standard output
+    vector<Sweep> sweeps;                        // Run one machine per combination of values
+    unsigned jobs = 0;                           // Sweep threads; 0 selects one per hardware thread
+    string restore;                              // Checkpoint to start from
+    string save;                                 // Checkpoint to write when the run ends
+    uint64_t saveEvery = 0;                      // Also write SAVE.<cycle> every this many cycles
+    string replay;                               // Key log to replay
+    string record;                               // Key log to write
+    string frame;                                // Screen image to write when the run ends
+    uint64_t frameEvery = 0;                     // Also write a frame every this many cycles
+};
+
+/**
+ * @brief Prints the command-line help.
+ */
+static void printUsage(){
+    cout<<"Usage: Emulator [options] program\n"
+        <<"\n"
+        <<"The program may be a .hack file (text or binary) or an .asm file, which is\n"
+        <<"assembled in memory. It runs until it reaches its end loop, e.g.\n"
+        <<"\"(END) @END 0;JMP\", or until the cycle budget is spent.\n"
+        <<"\n"
+        <<"Options:\n"
+        <<"  -n, --cycles N        Execute at most N instructions\n"
+        <<"  --set ADDR=VALUE      Store VALUE in RAM[ADDR] before running\n"
+        <<"  --key CODE            Hold down the key with this code (read from KBD)\n"
+        <<"  --dump ADDR[:COUNT]   Print COUNT words (default 1) starting at ADDR afterwards\n"
+        <<"  --engine NAME         \"threaded\" (pre-decoded, the default) or \"interpreter\"\n"
+        <<"  --profile FILE        Count executions per instruction and label and RAM accesses,\n"
+        <<"                        and write a report to FILE (- for standard output)\n"
+        <<"  --collapsed FILE      Write the profile as collapsed stacks for flame graphs\n"
+        <<"  --restore FILE        Start from the checkpoint in FILE instead of from reset\n"
+        <<"  --save FILE           Write a checkpoint to FILE when the run ends\n"
+        <<"  --save-every N        Also write FILE.<cycle> every N cycles (with --save)\n"
+        <<"  --replay FILE         Set the keyboard at the cycles given in the key log FILE\n"
+        <<"  --record FILE         Write every keyboard change of the run to the key log FILE\n"
+        <<"  --frame FILE          Write the screen to FILE when the run ends (.png, else PBM)\n"
+        <<"  --frame-every N       Also write the screen every N cycles if it changed, to FILE\n"
+        <<"                        with .<cycle> before the extension (with --frame)\n"
+        <<"  --sweep ADDR=FROM..TO Run one machine per value of RAM[ADDR]; repeat to sweep a grid,\n"
+        <<"                        then --dump prints the words of every machine\n"
+        <<"  -j, --jobs N          Threads for --sweep (default: one per hardware thread)\n"
+        <<"  -h, --help            Show this help\n"
+        <<"\n"
+        <<"ADDR may be a number or a predefined symbol such as R0, SP or SCREEN.\n";
+}
+
+/**
+ * @brief Parses a RAM address given as a number or a predefined symbol.
+ */
+static uint16_t parseAddress(const string& text){
+    int predefined = lookupPredefinedSymbol(text);
+    if(predefined >= 0){
+        return static_cast<uint16_t>(predefined);
+    }
+    return static_cast<uint16_t>(parseNumber(text, Machine::KBD));
+}
+
+/**
+ * @brief Parses a 16-bit word given as an unsigned or negative decimal number.
+ */
+static uint16_t parseWord(const string& text){
+    if(!text.empty() && text[0] == '-'){
+        return static_cast<uint16_t>(-static_cast<int>(parseNumber(text.substr(1), 32768)));
+    }
+    return static_cast<uint16_t>(parseNumber(text, 65535));
+}
+
+/**
+ * @brief Reads the options and the program from the command line.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Command-line arguments.
+ * @param options Receives the parsed settings.
+ * @return bool false if the program should exit (after `--help`).
+ * @throws std::invalid_argument For unknown options, bad values or a missing program.
+ */
+static bool parseArguments(int argc, char* argv[], Options& options){
+    for(int i = 1; i < argc; i++){
+        string argument = argv[i];
+        auto value = [&]() -> string {
+            if(i + 1 >= argc){
+                throw invalid_argument("Missing value for " + argument);
+            }
+            return argv[++i];
+        };
+
+        if(argument == "-h" || argument == "--help"){
+            printUsage();
+            return false;
+        }else if(argument == "-n" || argument == "--cycles"){
+            options.cycles = parseNumber(value(), UINT64_MAX);
+        }else if(argument == "--set"){
+            string assignment = value();
+            size_t equals = assignment.find('=');
+            if(equals == string::npos){
+                throw invalid_argument("Expected ADDR=VALUE: " + assignment);
+            }
+            options.writes.emplace_back(parseAddress(assignment.substr(0, equals)),
+                                        parseWord(assignment.substr(equals + 1)));
+        }else if(argument == "--engine"){
+            string name = value();
+            if(name == "threaded"){
+                options.engine = Engine::Threaded;
+            }else if(name == "interpreter"){
+                options.engine = Engine::Interpreter;
+            }else{
+                throw invalid_argument("Unknown engine: " + name);
+            }
+        }else if(argument == "--profile"){
+            options.profileReport = value();
+        }else if(argument == "--collapsed"){
+            options.collapsedStacks = value();
+        }else if(argument == "--sweep"){
+            string axis = value();
+            size_t equals = axis.find('=');
+            size_t dots = axis.find("..", equals == string::npos ? 0 : equals);
+            if(equals == string::npos || dots == string::npos){
+                throw invalid_argument("Expected ADDR=FROM..TO: " + axis);
+            }
+            Sweep sweep{axis.substr(0, equals), parseAddress(axis.substr(0, equals)),
+                        static_cast<int16_t>(parseWord(axis.substr(equals + 1, dots - equals - 1))),
+                        static_cast<int16_t>(parseWord(axis.substr(dots + 2)))};
+            if(sweep.from > sweep.to){
+                throw invalid_argument("Empty sweep: " + axis);
+            }
+            options.sweeps.push_back(sweep);
+        }else if(argument == "-j" || argument == "--jobs"){
+            options.jobs = static_cast<unsigned>(parseNumber(value(), 1024));
+        }else if(argument == "--key"){
+            options.key = static_cast<int32_t>(parseNumber(value(), 65535));
+        }else if(argument == "--restore"){
+            options.restore = value();
+        }else if(argument == "--save"){
+            options.save = value();
+        }else if(argument == "--save-every"){
+            options.saveEvery = parseNumber(value(), UINT64_MAX);
+            if(options.saveEvery == 0){
+                throw invalid_argument("--save-every needs at least 1 cycle");
+            }
+        }else if(argument == "--frame"){
+            options.frame = value();
+        }else if(argument == "--frame-every"){
+            options.frameEvery = parseNumber(value(), UINT64_MAX);
+            if(options.frameEvery == 0){
+                throw invalid_argument("--frame-every needs at least 1 cycle");
+            }
+        }else if(argument == "--replay"){
+            options.replay = value();
+        }else if(argument == "--record"){
+            options.record = value();
+        }else if(argument == "--dump"){
+            string range = value();
+            size_t colon = range.find(':');
+            uint16_t address = parseAddress(range.substr(0, colon));
+            uint64_t count = colon == string::npos ? 1 : parseNumber(range.substr(colon + 1), Machine::RAM_SIZE);
+            options.dumps.emplace_back(address, static_cast<uint16_t>(count));
+        }else if(argument.size() > 1 && argument[0] == '-'){
+            throw invalid_argument("Unknown option: " + argument);
+        }else if(options.program.empty()){
+            options.program = argument;
+        }else{
+            throw invalid_argument("Only one program can be run: " + argument);
+        }
+    }
+    if(options.program.empty()){
+        throw invalid_argument("No program given");
+    }
+    if(!options.sweeps.empty() && (!options.profileReport.empty() || !options.collapsedStacks.empty())){
+        throw invalid_argument("--sweep cannot be combined with --profile or --collapsed");
+    }
+    if(!options.sweeps.empty() && (!options.restore.empty() || !options.save.empty() || !options.replay.empty()
+                                   || !options.record.empty() || !options.frame.empty())){
+        throw invalid_argument("--sweep cannot be combined with checkpoints, key logs or frames");
+    }
+    if(options.saveEvery != 0 && options.save.empty()){
+        throw invalid_argument("--save-every needs --save");
+    }
+    if(options.frameEvery != 0 && options.frame.empty()){
+        throw invalid_argument("--frame-every needs --frame");
+    }
+    return true;
+}
+
+/**
+ * @brief Runs the program once per point of the sweep grid and prints the results.
+ *
+ * The grid is run in batches of `BATCH` machines, so memory stays bounded however large
+ * it is. Point i assigns the axes like nested loops, the last axis varying fastest.
+ * After the summary, each machine's line lists its inputs and the `--dump` words.
+ *
+ * @param options The parsed settings.
+ * @param program The machine words to run.
+ * @return int 0 on success, 2 if the grid is too large.
+ */
+static int sweep(const Options& options, const vector<uint16_t>& program){
+    const size_t BATCH = 16384;
+    uint64_t points = 1;
+    for(const Sweep& axis : options.sweeps){
+        points *= static_cast<uint64_t>(axis.to - axis.from + 1);
+        if(points > (uint64_t(1) << 32)){
+            cerr<<"The sweep grid has more than 2^32 points"<<endl;
+            return 2;
+        }
+    }
+
+    // The value of every axis at grid point `point`
+    vector<uint16_t> inputs(options.sweeps.size());
+    auto locate = [&](uint64_t point){
+        for(size_t k = options.sweeps.size(); k-- > 0;){
+            const Sweep& axis = options.sweeps[k];
+            uint64_t span = static_cast<uint64_t>(axis.to - axis.from + 1);
+            inputs[k] = static_cast<uint16_t>(axis.from + static_cast<int32_t>(point % span));
+            point /= span;
+        }
+    };
+
+    ThreadPool pool(options.jobs);
+    uint64_t instructions = 0, lockstep = 0, halted = 0;
+    double seconds = 0;
+    string lines;
+    for(uint64_t first = 0; first < points; first += BATCH){
+        size_t count = static_cast<size_t>(min<uint64_t>(BATCH, points - first));
+        BatchMachine batch(program, count);
+        for(size_t i = 0; i < count; i++){
+            for(const auto& [address, word] : options.writes){
+                batch.poke(i, address, word);
+            }
+            if(options.key >= 0){
+                batch.poke(i, Machine::KBD, static_cast<uint16_t>(options.key));
+            }
+            locate(first + i);
+            for(size_t k = 0; k < options.sweeps.size(); k++){
+                batch.poke(i, options.sweeps[k].address, inputs[k]);
+            }
+        }
+
+        auto start = chrono::steady_clock::now();
+        batch.run(options.cycles, &pool);
+        seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        instructions += batch.stats().instructions;
+        lockstep += batch.stats().vectorLanes;
+
+        for(size_t i = 0; i < count; i++){
+            halted += batch.halted(i);
+            if(options.dumps.empty()){
+                continue;
+            }
+            locate(first + i);
+            for(size_t k = 0; k < options.sweeps.size(); k++){
+                lines += (k ? " " : "") + options.sweeps[k].name + "=" + to_string(static_cast<int16_t>(inputs[k]));
+            }
+            lines += ":";
+            for(const auto& [address, count] : options.dumps){
+                for(uint32_t offset = 0; offset < count && address + offset < Machine::RAM_SIZE; offset++){
+                    lines += " RAM[" + to_string(address + offset) + "]="
+                             + to_string(static_cast<int16_t>(batch.peek(i, address + offset)));
+                }
+            }
+            lines += '\n';
+        }
+    }
+
+    cout<<"Ran "<<points<<" machines: "<<instructions<<" instructions in "<<seconds<<" s";
+    if(seconds > 0){
+        cout<<" ("<<(instructions / seconds / 1e6)<<" MIPS)";
+    }
+    cout<<".\n"
+        <<halted<<" halted, "<<(points - halted)<<" stopped by the cycle budget; "
+        <<(instructions ? 100.0 * lockstep / instructions : 0.0)<<"% of the instructions ran in lockstep ("
+        <<BatchMachine::implementation()<<").\n"
+        <<lines<<flush;
+    return 0;
+}
+
+/**
+ * @brief Main function for the Emulator program
+ *
+ * Process Flow:
+ * 1. Parse the command-line options.
+ * 2. Load the program, restore a checkpoint if given, and apply the initial RAM words
+ *    and the keyboard.
+ * 3. Run it, replaying key events and writing periodic checkpoints and frames if asked,
+ *    and report the instruction count, speed and final CPU state.
+ * 4. Print the requested RAM ranges as signed decimal words.
+ * 5. Write the final checkpoint, the recorded key log and the final frame.
+ * 6. When profiling, write the text report and/or the collapsed stacks.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Command-line arguments.
+ * @return int 0 on success, 1 if the program, a checkpoint, a key log or a frame could not
+ *         be read or written, 2 on usage errors.
+ */
+int main(int argc, char* argv[]){
+    Options options;
+    try{
+        if(!parseArguments(argc, argv, options)){
+            return 0;
+        }
+    }catch(const invalid_argument& e){
+        cerr<<e.what()<<endl;
+        printUsage();
+        return 2;
+    }
+
+    Machine machine;
+    machine.setEngine(options.engine);
+    SymbolTable symbols;
+    try{
+        machine.loadFile(options.program, &symbols);
+    }catch(const exception& e){
+        cerr<<"Error loading program: "<<e.what()<<endl;
+        return 1;
+    }
+    if(!options.sweeps.empty()){
+        return sweep(options, vector<uint16_t>(machine.program().begin(),
+                                               machine.program().begin() + machine.programSize()));
+    }
+    bool profiling = !options.profileReport.empty() || !options.collapsedStacks.empty();
+    ExecutionProfile profile;
+    if(profiling){
+        machine.setProfile(&profile);
+    }
+    vector<KeyEvent> replay, recorded;
+    try{
+        if(!options.restore.empty()){
+            readCheckpoint(options.restore, machine);
+        }
+        if(!options.replay.empty()){
+            replay = readKeyLog(options.replay);
+        }
+    }catch(const exception& e){
+        cerr<<"Error: "<<e.what()<<endl;
+        return 1;
+    }
+    if(!options.record.empty()){
+        machine.setKeyLog(&recorded);
+    }
+    for(const auto& [address, word] : options.writes){
+        machine.poke(address, word);
+    }
+    if(options.key >= 0){
+        machine.setKeyboard(static_cast<uint16_t>(options.key));
+    }
+
+    // Periodic frames are only converted where the screen changed, then copied and
+    // encoded on a background thread while the machine keeps running
+    Framebuffer display;
+    unique_ptr<ThreadPool> frameWriter;
+    mutex frameMutex;
+    string frameError;
+    uint64_t framesWritten = 0, framesUnchanged = 0;
+    auto writeFrame = [&](uint64_t cycle){
+        if(display.update(machine.screen()).empty() && framesWritten + framesUnchanged > 0){
+            framesUnchanged++;
+            return;
+        }
+        framesWritten++;
+        filesystem::path path(options.frame);
+        string name = (path.parent_path() / path.stem()).string() + "." + to_string(cycle) + path.extension().string();
+        if(!frameWriter){
+            frameWriter = make_unique<ThreadPool>(1);
+        }
+        frameWriter->submit([&, image = display, name]{
+            try{
+                image.writeImage(name);
+            }catch(const exception& e){
+                lock_guard<mutex> lock(frameMutex);
+                if(frameError.empty()){
+                    frameError = e.what();
+                }
+            }
+        });
+    };
+
+    // With --save-every or --frame-every, the run is cut into slices that end on multiples of N cycles
+    auto start = chrono::steady_clock::now();
+    uint64_t executed = 0;
+    try{
+        while(executed < options.cycles && !machine.halted()){
+            uint64_t slice = options.cycles - executed;
+            if(options.saveEvery != 0){
+                slice = min(slice, options.saveEvery - machine.cycles() % options.saveEvery);
+            }
+            if(options.frameEvery != 0){
+                slice = min(slice, options.frameEvery - machine.cycles() % options.frameEvery);
+            }
+            uint64_t ran = replay.empty() ? machine.run(slice) : runWithKeys(machine, replay, slice);
+            executed += ran;
+            if(ran < slice){
+                break;
+            }
+            if(options.saveEvery != 0 && machine.cycles() % options.saveEvery == 0){
+                writeCheckpoint(options.save + "." + to_string(machine.cycles()), machine);
+            }
+            if(options.frameEvery != 0 && machine.cycles() % options.frameEvery == 0){
+                writeFrame(machine.cycles());
+            }
+        }
+    }catch(const exception& e){
+        cerr<<"Error: "<<e.what()<<endl;
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if(frameWriter){
+        frameWriter->wait();
+    }
+
+    cout<<"Executed "<<executed<<" instructions in "<<seconds<<" s";
+    if(seconds > 0){
+        cout<<" ("<<(executed / seconds / 1e6)<<" MIPS)";
+    }
+    cout<<".\n"
+        <<(machine.halted() ? "Halted" : "Stopped")<<" at PC="<<machine.pc()
+        <<", A="<<static_cast<int16_t>(machine.a())<<", D="<<static_cast<int16_t>(machine.d())<<".\n";
+    if(options.frameEvery != 0){
+        cout<<"Wrote "<<framesWritten<<" frame(s); "<<framesUnchanged<<" unchanged frame(s) skipped.\n";
+    }
+    for(const auto& [address, count] : options.dumps){
+        for(uint32_t offset = 0; offset < count && address + offset < Machine::RAM_SIZE; offset++){
+            cout<<"RAM["<<(address + offset)<<"] = "<<static_cast<int16_t>(machine.peek(address + offset))<<'\n';
+        }
+    }
+    cout<<flush;
+
+    try{
+        if(!options.save.empty()){
+            writeCheckpoint(options.save, machine);
+        }
+        if(!options.record.empty()){
+            writeKeyLog(options.record, recorded);
+        }
+        if(!frameError.empty()){
+            throw runtime_error(frameError);
+        }
+        if(!options.frame.empty()){
+            display.update(machine.screen());
+            display.writeImage(options.frame);
+        }
+    }catch(const exception& e){
+        cerr<<"Error: "<<e.what()<<endl;
+        return 1;
+    }
+
+    if(profiling){
+        vector<LabelRange> labels = labelRanges(symbols, machine.programSize());
+        string name = filesystem::path(options.program).filename().string();
+        auto write = [&](const string& target, auto report) -> bool {
+            if(target.empty()){
+                return true;
+            }
+            if(target == "-"){
+                report(cout);
+                return true;
+            }
+            ofstream file(target);
+            report(file);
+            if(!file){
+                cerr<<"Cannot write "<<target<<endl;
+                return false;
+            }
+            return true;
+        };
+        bool written = write(options.profileReport, [&](ostream& out){
+            writeProfileReport(out, name, profile, labels, symbols);
+        });
+        written = write(options.collapsedStacks, [&](ostream& out){
+            writeCollapsedStacks(out, filesystem::path(name).stem().string(), profile, labels);
+        }) && written;
+        if(!written){
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+/**
+ * @file Framebuffer.cpp
+ * @brief Implementation of the headless display and its image encoders.
+ *
+ * Key Concepts:
+ * - Bit order: In a screen word, bit 0 is the leftmost of its 16 pixels. PBM and PNG
+ *   store the leftmost pixel of a byte in its high bit, so each word becomes two bytes
+ *   through a 256-entry bit-reversal table.
+ * - Change detection: `update` compares the screen with its shadow copy four words at a
+ *   time and converts only the words that differ.
+ * - PNG: The image is written as 1-bit grayscale with one zlib "stored" block, so no
+ *   compression library is needed. At 1 bit per pixel the file is only about 16 KiB.
+ */
+#include <array>
+#include <cstring>
+#include <string>
+#include "../include/Framebuffer.h"
+#include "../include/HackFile.h"
+
+using namespace std;
+
+namespace {
+
+array<uint8_t, 256> buildReverseTable(){
+    array<uint8_t, 256> table{};
+    for(unsigned value = 0; value < 256; value++){
+        unsigned reversed = 0;
+        for(int bit = 0; bit < 8; bit++){
+            reversed |= ((value >> bit) & 1) << (7 - bit);
+        }
+        table[value] = static_cast<uint8_t>(reversed);
+    }
+    return table;
+}
+
+const array<uint8_t, 256> REVERSED = buildReverseTable();
+
+array<uint32_t, 256> buildCrcTable(){
+    array<uint32_t, 256> table{};
+    for(uint32_t n = 0; n < 256; n++){
+        uint32_t c = n;
+        for(int k = 0; k < 8; k++){
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table[n] = c;
+    }
+    return table;
+}
+
+uint32_t crc32(const string& data, size_t begin, size_t end){
+    static const array<uint32_t, 256> table = buildCrcTable();
+    uint32_t crc = 0xFFFFFFFFu;
+    for(size_t i = begin; i < end; i++){
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void appendBigEndian(string& buffer, uint32_t value){
+    for(int shift = 24; shift >= 0; shift -= 8){
+        buffer.push_back(static_cast<char>((value >> shift) & 0xFF));
+    }
+}
+
+// Appends a PNG chunk: length, type, data and the CRC of type and data
+void appendChunk(string& png, const char* type, const string& data){
+    appendBigEndian(png, static_cast<uint32_t>(data.size()));
+    size_t start = png.size();
+    png.append(type, 4).append(data);
+    appendBigEndian(png, crc32(png, start, png.size()));
+}
+
+} // namespace
+
+Framebuffer::Framebuffer() = default;
+
+/**
+ * @brief Converts the screen words that changed since the previous update.
+ *
+ * @param screen The 8K words of the screen.
+ * @return DirtyRegion The rows and columns that changed.
+ */
+DirtyRegion Framebuffer::update(const uint16_t* screen){
+    DirtyRegion region;
+    region.firstRow = HEIGHT;
+    region.firstColumn = ROW_WORDS;
+    for(size_t i = 0; i < shadow.size(); i += 4){
+        uint64_t before, after;
+        memcpy(&before, &shadow[i], sizeof(before));
+        memcpy(&after, &screen[i], sizeof(after));
+        if(before == after){
+            continue;
+        }
+        for(size_t k = i; k < i + 4; k++){
+            uint16_t word = screen[k];
+            if(word == shadow[k]){
+                continue;
+            }
+            shadow[k] = word;
+            size_t row = k / ROW_WORDS, column = k % ROW_WORDS;
+            pixels[row * ROW_BYTES + 2 * column] = REVERSED[word & 0xFF];
+            pixels[row * ROW_BYTES + 2 * column + 1] = REVERSED[word >> 8];
+            region.firstRow = min(region.firstRow, row);
+            region.lastRow = row;
+            region.firstColumn = min(region.firstColumn, column);
+            region.lastColumn = max(region.lastColumn, column);
+            region.words++;
+        }
+    }
+    if(region.empty()){
+        return DirtyRegion{};
+    }
+    return region;
+}
+
+/**
+ * @brief Renders the image as a binary PBM (P4) file, which stores exactly our bitmap.
+ *
+ * @return string The bytes of the file.
+ */
+string Framebuffer::encodePbm() const {
+    string pbm = "P4\n" + to_string(WIDTH) + " " + to_string(HEIGHT) + "\n";
+    pbm.append(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+    return pbm;
+}
+
+/**
+ * @brief Renders the image as a 1-bit grayscale PNG file.
+ *
+ * In grayscale 0 is black, so the bitmap is inverted. Every row starts with filter
+ * type 0 (none). The rows form one stored deflate block inside the zlib stream.
+ *
+ * @return string The bytes of the file.
+ */
+string Framebuffer::encodePng() const {
+    string raw;
+    raw.reserve(HEIGHT * (ROW_BYTES + 1));
+    for(size_t row = 0; row < HEIGHT; row++){
+        raw.push_back(0);
+        for(size_t i = 0; i < ROW_BYTES; i++){
+            raw.push_back(static_cast<char>(~pixels[row * ROW_BYTES + i]));
+        }
+    }
+
+    string zlib = {0x78, 0x01};
+    // One stored block holds up to 65535 bytes; the image needs 16,640
+    zlib.push_back(1);   // BFINAL, BTYPE = 00
+    uint16_t length = static_cast<uint16_t>(raw.size());
+    zlib.push_back(static_cast<char>(length & 0xFF));
+    zlib.push_back(static_cast<char>(length >> 8));
+    zlib.push_back(static_cast<char>(~length & 0xFF));
+    zlib.push_back(static_cast<char>((~length >> 8) & 0xFF));
+    zlib.append(raw);
+    uint32_t a = 1, b = 0;
+    for(char c : raw){
+        a = (a + static_cast<uint8_t>(c)) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendBigEndian(zlib, (b << 16) | a);
+
+    string header;
+    appendBigEndian(header, WIDTH);
+    appendBigEndian(header, HEIGHT);
+    header += string{1, 0, 0, 0, 0};   // Bit depth 1, grayscale, deflate, no filter set, no interlace
+
+    string png = "\x89PNG\r\n\x1a\n";
+    appendChunk(png, "IHDR", header);
+    appendChunk(png, "IDAT", zlib);
+    appendChunk(png, "IEND", "");
+    return png;
+}
+
+/**
+ * @brief Writes the image, as PNG if the name ends in `.png` and as PBM otherwise.
+ *
+ * @param filename The file to write.
+ */
+void Framebuffer::writeImage(const string& filename) const {
+    bool png = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".png") == 0;
+    writeFile(filename, png ? encodePng() : encodePbm());
+}
@@ -0,0 +1,462 @@
+/**
+ * @file HackFile.cpp
+ * @brief Reading and writing of assembled Hack programs.
+ * 
+ * The encoding pass produces a vector of 16-bit words. This module is the only place
+ * where those words are turned into bytes on disk, either as the text `.hack` format or
+ * as the packed binary format described in HackFile.h.
+ * 
+ * Key Concepts:
+ * - The whole file is rendered into one `std::string` first, so writing it costs a single
+ *   `write` call instead of one stream insertion (and flush) per instruction.
+ * - Text rendering writes the '0'/'1' characters straight into the preallocated buffer
+ *   with `formatBinary`, so no temporary string is created per word.
+ * - Binary words are stored little-endian regardless of the host byte order.
+ * - Relocatable objects (.hobj) use the same little-endian encoding. Reading one checks
+ *   every count and index against the size of the file before anything is allocated.
+ */
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "../include/HackFile.h"
+#include "../include/BinCodes.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+const char BINARY_MAGIC[4] = {'H', 'A', 'C', 'K'};
+const uint16_t BINARY_VERSION = 1;
+const size_t BINARY_HEADER_SIZE = 12;
+
+const char OBJECT_MAGIC[4] = {'H', 'O', 'B', 'J'};
+const uint16_t OBJECT_VERSION = 1;
+const size_t OBJECT_HEADER_SIZE = 28;
+
+void appendLittleEndian(string& buffer, uint32_t value, int bytes){
+    for(int i = 0; i < bytes; i++){
+        buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+/*
+    Reads the fields of an object file in order, checking each read against the end of the
+    image; a truncated or corrupt file is reported instead of read past its end.
+*/
+class ObjectReader {
+public:
+    ObjectReader(const string& image, const string& filename) : image(image), filename(filename){}
+
+    uint32_t number(int bytes){
+        need(bytes);
+        uint32_t value = getLittleEndian(image, offset, bytes);
+        offset += bytes;
+        return value;
+    }
+
+    string name(){
+        size_t length = number(2);
+        need(length);
+        string text = image.substr(offset, length);
+        offset += length;
+        return text;
+    }
+
+    // Rejects a count of records that could not possibly fit in the rest of the file
+    size_t count(uint32_t records, size_t minimumSize){
+        if(records > (image.size() - offset) / minimumSize){
+            fail();
+        }
+        return records;
+    }
+
+    bool atEnd() const { return offset == image.size(); }
+
+    [[noreturn]] void fail() const {
+        throw runtime_error("Malformed object file: " + filename);
+    }
+
+private:
+    void need(size_t bytes) const {
+        if(image.size() - offset < bytes){
+            fail();
+        }
+    }
+
+    const string& image;
+    const string& filename;
+    size_t offset = OBJECT_HEADER_SIZE;
+};
+
+}  // namespace
+
+/**
+ * @brief Reads a whole file, byte for byte.
+ * 
+ * @param filename The name of the file.
+ * @return string The contents of the file.
+ */
+string readFile(const string& filename){
+    ifstream file(filename, ios::binary);
+    if(!file.is_open()){
+        throw runtime_error("Error opening file: " + filename);
+    }
+    return string((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+}
+
+/**
+ * @brief Replaces a file with the given bytes in a single write.
+ * 
+ * @param filename The name of the file.
+ * @param image The bytes to write.
+ */
+void writeFile(const string& filename, const string& image){
+    ofstream output(filename, ios::binary | ios::trunc);
+    if(!output.is_open()){
+        throw runtime_error("Error opening output file: " + filename);
+    }
+    output.write(image.data(), static_cast<streamsize>(image.size()));
+    if(!output){
+        throw runtime_error("Error writing output file: " + filename);
+    }
+}
+
+/**
+ * @brief Stores the low `bytes` bytes of a value little-endian at a position of a buffer.
+ * 
+ * @param buffer The buffer; it must already hold `offset + bytes` bytes.
+ * @param offset The position of the first byte.
+ * @param value The value to store.
+ * @param bytes The width of the field, 1 to 8.
+ */
+void putLittleEndian(string& buffer, size_t offset, uint64_t value, int bytes){
+    for(int i = 0; i < bytes; i++){
+        buffer[offset + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+/**
+ * @brief Reads a little-endian field of `bytes` bytes from a buffer.
+ * 
+ * @param buffer The buffer; it must hold `offset + bytes` bytes.
+ * @param offset The position of the first byte.
+ * @param bytes The width of the field, 1 to 8.
+ * @return uint64_t The value of the field.
+ */
+uint64_t getLittleEndian(const string& buffer, size_t offset, int bytes){
+    uint64_t value = 0;
+    for(int i = 0; i < bytes; i++){
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(buffer[offset + i])) << (8 * i);
+    }
+    return value;
+}
+
+/**
+ * @brief Builds the complete file image for a program in one buffer.
+ * 
+ * - Text: every word takes 16 characters plus a '\n' separator, so the buffer size is
+ *   known up front and each line is formatted directly into place.
+ * - Binary: the 12-byte header followed by 2 bytes per word.
+ * 
+ * @param words The machine words in ROM order.
+ * @param format The output format to render.
+ * @return string The bytes of the file.
+ */
+string renderHack(const vector<uint16_t>& words, OutputFormat format){
+    string buffer;
+    if(format == OutputFormat::Binary){
+        buffer.assign(BINARY_HEADER_SIZE + 2 * words.size(), '\0');
+        buffer.replace(0, 4, BINARY_MAGIC, 4);
+        putLittleEndian(buffer, 4, BINARY_VERSION, 2);
+        putLittleEndian(buffer, 8, static_cast<uint32_t>(words.size()), 4);
+        for(size_t i = 0; i < words.size(); i++){
+            putLittleEndian(buffer, BINARY_HEADER_SIZE + 2 * i, words[i], 2);
+        }
+        return buffer;
+    }
+
+    if(words.empty()){
+        return buffer;
+    }
+    buffer.assign(17 * words.size() - 1, '\n');  // No newline after the last instruction
+    for(size_t i = 0; i < words.size(); i++){
+        formatBinary(words[i], &buffer[17 * i]);
+    }
+    return buffer;
+}
+
+/**
+ * @brief Renders a program and writes it to disk with a single write.
+ * 
+ * @param filename The name of the output file.
+ * @param words The machine words in ROM order.
+ * @param format The output format to write.
+ */
+void writeHackFile(const string& filename, const vector<uint16_t>& words, OutputFormat format){
+    writeFile(filename, renderHack(words, format));
+}
+
+/**
+ * @brief Updates a file written by `writeHackFile` to hold a new version of the program.
+ * 
+ * - Text: word i starts at byte 17 * i. The tail is written from the '\n' before its first
+ *   word, which is missing if that word is appended after the old last line.
+ * - Binary: word i starts at byte 12 + 2 * i, and the header's word count is updated.
+ * - Adjacent changed words are written together, so a run of changes costs one write.
+ * 
+ * @param filename The name of the .hack file.
+ * @param words The new machine words in ROM order.
+ * @param format The format the file was written in.
+ * @param changed Indices below `rewriteFrom` whose words changed, in ascending order.
+ * @param rewriteFrom The first index from which every word is written again.
+ * @param previousCount The number of words the file holds now.
+ * @return size_t The number of words written.
+ */
+size_t patchHackFile(const string& filename, const vector<uint16_t>& words, OutputFormat format,
+                     const vector<uint32_t>& changed, size_t rewriteFrom, size_t previousCount){
+    bool binary = format == OutputFormat::Binary;
+    auto fileSize = [binary](size_t count) -> uintmax_t {
+        return binary ? BINARY_HEADER_SIZE + 2 * count : (count == 0 ? 0 : 17 * count - 1);
+    };
+    auto position = [binary](size_t index) -> streamoff {
+        return static_cast<streamoff>(binary ? BINARY_HEADER_SIZE + 2 * index : 17 * index);
+    };
+
+    error_code error;
+    if(fs::file_size(filename, error) != fileSize(previousCount) || error){
+        writeHackFile(filename, words, format);
+        return words.size();
+    }
+    fstream file(filename, ios::in | ios::out | ios::binary);
+    if(!file.is_open()){
+        throw runtime_error("Error opening output file: " + filename);
+    }
+
+    // Renders words [begin, end) as they appear in the file, joined by '\n' in text format
+    auto render = [&](size_t begin, size_t end){
+        string bytes;
+        if(binary){
+            bytes.assign(2 * (end - begin), '\0');
+            for(size_t i = begin; i < end; i++){
+                putLittleEndian(bytes, 2 * (i - begin), words[i], 2);
+            }
+        }else if(end > begin){
+            bytes.assign(17 * (end - begin) - 1, '\n');
+            for(size_t i = begin; i < end; i++){
+                formatBinary(words[i], &bytes[17 * (i - begin)]);
+            }
+        }
+        return bytes;
+    };
+    auto put = [&](streamoff offset, const string& bytes){
+        file.seekp(offset);
+        file.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+    };
+
+    size_t written = 0;
+    for(size_t i = 0; i < changed.size(); ){
+        size_t end = i + 1;
+        while(end < changed.size() && changed[end] == changed[end - 1] + 1){
+            end++;
+        }
+        put(position(changed[i]), render(changed[i], changed[end - 1] + 1));
+        written += end - i;
+        i = end;
+    }
+    if(rewriteFrom < words.size()){
+        string tail = render(rewriteFrom, words.size());
+        if(!binary && rewriteFrom > 0){
+            put(position(rewriteFrom) - 1, "\n" + tail);
+        }else{
+            put(position(rewriteFrom), tail);
+        }
+        written += words.size() - rewriteFrom;
+    }
+    if(binary && words.size() != previousCount){
+        string count(4, '\0');
+        putLittleEndian(count, 0, static_cast<uint32_t>(words.size()), 4);
+        put(8, count);
+    }
+    file.close();
+    if(!file){
+        throw runtime_error("Error writing output file: " + filename);
+    }
+    if(fileSize(words.size()) != fileSize(previousCount)){
+        fs::resize_file(filename, fileSize(words.size()));
+    }
+    return written;
+}
+
+/**
+ * @brief Loads a .hack file in either format.
+ * 
+ * @param filename The name of the .hack file.
+ * @return vector<uint16_t> The machine words in ROM order.
+ */
+vector<uint16_t> readHackFile(const string& filename){
+    string image = readFile(filename);
+
+    vector<uint16_t> words;
+    if(image.size() >= BINARY_HEADER_SIZE && image.compare(0, 4, BINARY_MAGIC, 4) == 0){
+        uint32_t version = getLittleEndian(image, 4, 2);
+        uint32_t count = getLittleEndian(image, 8, 4);
+        if(version != BINARY_VERSION || image.size() != BINARY_HEADER_SIZE + 2 * static_cast<size_t>(count)){
+            throw runtime_error("Malformed binary .hack file: " + filename);
+        }
+        words.resize(count);
+        for(size_t i = 0; i < count; i++){
+            words[i] = static_cast<uint16_t>(getLittleEndian(image, BINARY_HEADER_SIZE + 2 * i, 2));
+        }
+        return words;
+    }
+
+    // Text format: one 16-digit binary number per line; blank lines and CRs are ignored
+    size_t lineStart = 0;
+    size_t lineNumber = 0;
+    while(lineStart < image.size()){
+        lineNumber++;
+        size_t lineEnd = image.find('\n', lineStart);
+        if(lineEnd == string::npos){
+            lineEnd = image.size();
+        }
+        size_t last = lineEnd;
+        while(last > lineStart && (image[last - 1] == '\r' || image[last - 1] == ' ')) last--;
+
+        if(last > lineStart){
+            if(last - lineStart != 16){
+                throw runtime_error(filename + ":" + to_string(lineNumber) + ": expected 16 binary digits");
+            }
+            uint16_t word = 0;
+            for(size_t i = lineStart; i < last; i++){
+                if(image[i] != '0' && image[i] != '1'){
+                    throw runtime_error(filename + ":" + to_string(lineNumber) + ": expected 16 binary digits");
+                }
+                word = static_cast<uint16_t>((word << 1) | (image[i] - '0'));
+            }
+            words.push_back(word);
+        }
+        lineStart = lineEnd + 1;
+    }
+    return words;
+}
+
+/**
+ * @brief Builds the complete .hobj image of a module in one buffer.
+ * 
+ * The header is written with its final counts first; the sections follow in the order
+ * given in HackFile.h.
+ * 
+ * @param object The module to render.
+ * @return string The bytes of the file.
+ */
+string renderObject(const ObjectFile& object){
+    string buffer(OBJECT_HEADER_SIZE, '\0');
+    buffer.replace(0, 4, OBJECT_MAGIC, 4);
+    putLittleEndian(buffer, 4, OBJECT_VERSION, 2);
+    putLittleEndian(buffer, 8, static_cast<uint32_t>(object.words.size()), 4);
+    putLittleEndian(buffer, 12, static_cast<uint32_t>(object.labels.size()), 4);
+    putLittleEndian(buffer, 16, static_cast<uint32_t>(object.externals.size()), 4);
+    putLittleEndian(buffer, 20, static_cast<uint32_t>(object.relocations.size()), 4);
+    putLittleEndian(buffer, 24, static_cast<uint32_t>(object.references.size()), 4);
+
+    buffer.reserve(OBJECT_HEADER_SIZE + 2 * object.words.size() + 4 * object.relocations.size() +
+                   8 * object.references.size());
+    for(uint16_t word : object.words){
+        appendLittleEndian(buffer, word, 2);
+    }
+    for(const ObjectLabel& label : object.labels){
+        appendLittleEndian(buffer, label.address, 4);
+        appendLittleEndian(buffer, static_cast<uint32_t>(label.name.size()), 2);
+        buffer += label.name;
+    }
+    for(const string& name : object.externals){
+        appendLittleEndian(buffer, static_cast<uint32_t>(name.size()), 2);
+        buffer += name;
+    }
+    for(uint32_t word : object.relocations){
+        appendLittleEndian(buffer, word, 4);
+    }
+    for(const ObjectReference& reference : object.references){
+        appendLittleEndian(buffer, reference.word, 4);
+        appendLittleEndian(buffer, reference.external, 4);
+    }
+    return buffer;
+}
+
+/**
+ * @brief Renders a module and writes it to disk with a single write.
+ * 
+ * @param filename The name of the output file (.hobj).
+ * @param object The module to write.
+ */
+void writeObjectFile(const string& filename, const ObjectFile& object){
+    writeFile(filename, renderObject(object));
+}
+
+/**
+ * @brief Loads a .hobj file.
+ * 
+ * - Counts are checked against the remaining bytes before any vector is sized, so a
+ *   corrupt count cannot trigger a huge allocation.
+ * - Label addresses may equal the number of words (a label after the last instruction);
+ *   relocated and referencing words must exist, and references must name an external.
+ * 
+ * @param filename The name of the .hobj file.
+ * @return ObjectFile The module.
+ */
+ObjectFile readObjectFile(const string& filename){
+    string image = readFile(filename);
+    if(image.size() < OBJECT_HEADER_SIZE || image.compare(0, 4, OBJECT_MAGIC, 4) != 0 ||
+       getLittleEndian(image, 4, 2) != OBJECT_VERSION){
+        throw runtime_error("Not an object file: " + filename);
+    }
+
+    ObjectReader reader(image, filename);
+    ObjectFile object;
+    object.words.resize(reader.count(getLittleEndian(image, 8, 4), 2));
+    uint32_t labels = getLittleEndian(image, 12, 4);
+    uint32_t externals = getLittleEndian(image, 16, 4);
+    uint32_t relocations = getLittleEndian(image, 20, 4);
+    uint32_t references = getLittleEndian(image, 24, 4);
+
+    for(uint16_t& word : object.words){
+        word = static_cast<uint16_t>(reader.number(2));
+    }
+    object.labels.resize(reader.count(labels, 6));
+    for(ObjectLabel& label : object.labels){
+        label.address = reader.number(4);
+        label.name = reader.name();
+        if(label.address > object.words.size() || label.name.empty()){
+            reader.fail();
+        }
+    }
+    object.externals.resize(reader.count(externals, 2));
+    for(string& name : object.externals){
+        name = reader.name();
+        if(name.empty()){
+            reader.fail();
+        }
+    }
+    object.relocations.resize(reader.count(relocations, 4));
+    for(uint32_t& word : object.relocations){
+        word = reader.number(4);
+        if(word >= object.words.size()){
+            reader.fail();
+        }
+    }
+    object.references.resize(reader.count(references, 8));
+    for(ObjectReference& reference : object.references){
+        reference.word = reader.number(4);
+        reference.external = reader.number(4);
+        if(reference.word >= object.words.size() || reference.external >= object.externals.size()){
+            reader.fail();
+        }
+    }
+    if(!reader.atEnd()){
+        reader.fail();
+    }
+    return object;
+}
@@ -0,0 +1,1069 @@
+/**
+ * @file Hdl.cpp
+ * @brief Implementation of the HDL parser, the netlist compiler and the gate simulator.
+ *
+ * Compiling a chip happens in three steps:
+ * 1. Flattening: every part is instantiated recursively until only `Nand` gates and
+ *    `DFF`s remain. Each bit of every pin and internal wire becomes a net; wires start
+ *    as placeholders and are bound to their driver when the part that drives them is
+ *    instantiated, so parts may appear in any order, as in the hardware simulator.
+ * 2. Ordering: a depth-first walk from the chip outputs (and from the inputs of every
+ *    DFF reached) visits each gate after its operands, which both sorts the gates and
+ *    detects combinational loops. Gates that no output depends on are never visited,
+ *    and DFFs fed by the same signal are merged into one.
+ * 3. Simplification: while the sorted gates are emitted, constants are folded, equal
+ *    gates are shared, and the Nand shapes that the project chips build And, Or, Xor
+ *    and Mux from are replaced by single gates. Gates left unused are then dropped.
+ *
+ * Key Concepts:
+ * - Bit-parallel evaluation: a signal is a `Lanes` of 512 bits, one per test vector,
+ *   so each gate costs two 256-bit operations (four SSE ones) for 512 simulations.
+ * - Runtime dispatch: `evaluate` has an AVX2 build selected with `__builtin_cpu_supports`,
+ *   like the line scanner; elsewhere the SSE2 baseline is used.
+ */
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_map>
+#include "../include/Hdl.h"
+#include "../include/Parser.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HDL_X86 1
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+/*
+    HDL tokenizer: names, numbers and the punctuation of the language, with line
+    and block comments skipped.
+*/
+struct Token {
+    enum Kind { Name, Number, Symbol, End } kind;
+    string text;
+    unsigned line;
+};
+
+vector<Token> tokenize(const string& text, const string& file){
+    vector<Token> tokens;
+    unsigned line = 1;
+    size_t i = 0;
+    while(i < text.size()){
+        char c = text[i];
+        if(c == '\n'){
+            line++;
+            i++;
+        }else if(isspace(static_cast<unsigned char>(c))){
+            i++;
+        }else if(text.compare(i, 2, "//") == 0){
+            while(i < text.size() && text[i] != '\n') i++;
+        }else if(text.compare(i, 2, "/*") == 0){
+            size_t end = text.find("*/", i + 2);
+            if(end == string::npos){
+                throw runtime_error(file + ":" + to_string(line) + ": Unterminated comment");
+            }
+            line += static_cast<unsigned>(count(text.begin() + i, text.begin() + end, '\n'));
+            i = end + 2;
+        }else if(isalpha(static_cast<unsigned char>(c)) || c == '_'){
+            size_t start = i;
+            while(i < text.size() && (isalnum(static_cast<unsigned char>(text[i])) || text[i] == '_')) i++;
+            tokens.push_back({Token::Name, text.substr(start, i - start), line});
+        }else if(isdigit(static_cast<unsigned char>(c))){
+            size_t start = i;
+            while(i < text.size() && isdigit(static_cast<unsigned char>(text[i]))) i++;
+            tokens.push_back({Token::Number, text.substr(start, i - start), line});
+        }else if(text.compare(i, 2, "..") == 0){
+            tokens.push_back({Token::Symbol, "..", line});
+            i += 2;
+        }else if(string("{}()[],;=:").find(c) != string::npos){
+            tokens.push_back({Token::Symbol, string(1, c), line});
+            i++;
+        }else{
+            throw runtime_error(file + ":" + to_string(line) + ": Unexpected character '" + string(1, c) + "'");
+        }
+    }
+    tokens.push_back({Token::End, "", line});
+    return tokens;
+}
+
+/*
+    Recursive-descent parser over the token list.
+*/
+class HdlParser {
+public:
+    HdlParser(const string& text, const string& file) : tokens(tokenize(text, file)), file(file) {}
+
+    HdlChip parse(){
+        HdlChip chip;
+        chip.file = file;
+        expect("CHIP");
+        chip.name = name();
+        expect("{");
+        while(!accept("}")){
+            if(accept("IN")){
+                pins(chip.inputs);
+            }else if(accept("OUT")){
+                pins(chip.outputs);
+            }else if(accept("PARTS")){
+                expect(":");
+                while(peek().text != "}" && peek().kind != Token::End){
+                    chip.parts.push_back(part());
+                }
+            }else if(accept("BUILTIN")){
+                name();
+                expect(";");
+                chip.builtin = true;
+            }else if(accept("CLOCKED")){
+                do{ name(); }while(accept(","));
+                expect(";");
+            }else{
+                fail("Expected IN, OUT, PARTS: or BUILTIN but found '" + peek().text + "'");
+            }
+        }
+        if(peek().kind != Token::End){
+            fail("Unexpected '" + peek().text + "' after the end of the chip");
+        }
+        return chip;
+    }
+
+private:
+    const Token& peek() const { return tokens[position]; }
+
+    [[noreturn]] void fail(const string& message) const {
+        throw runtime_error(file + ":" + to_string(peek().line) + ": " + message);
+    }
+
+    bool accept(const string& text){
+        if(peek().kind != Token::End && peek().text == text){
+            position++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(const string& text){
+        if(!accept(text)){
+            fail("Expected '" + text + "' but found '" + peek().text + "'");
+        }
+    }
+
+    string name(){
+        if(peek().kind != Token::Name){
+            fail("Expected a name but found '" + peek().text + "'");
+        }
+        return tokens[position++].text;
+    }
+
+    int number(){
+        if(peek().kind != Token::Number || peek().text.size() > 5){
+            fail("Expected a bit index but found '" + peek().text + "'");
+        }
+        return stoi(tokens[position++].text);
+    }
+
+    void pins(vector<HdlPin>& list){
+        do{
+            HdlPin pin;
+            pin.name = name();
+            if(accept("[")){
+                int width = number();
+                if(width < 1 || width > 64){
+                    fail("Pin width must be 1 to 64");
+                }
+                pin.width = static_cast<unsigned>(width);
+                expect("]");
+            }
+            list.push_back(pin);
+        }while(accept(","));
+        expect(";");
+    }
+
+    void range(int& low, int& high){
+        if(accept("[")){
+            low = high = number();
+            if(accept("..")){
+                high = number();
+            }
+            expect("]");
+            if(high < low){
+                fail("Bit range is reversed");
+            }
+        }
+    }
+
+    HdlPart part(){
+        HdlPart result;
+        result.line = peek().line;
+        result.chip = name();
+        expect("(");
+        do{
+            HdlConnection connection;
+            connection.inner = name();
+            range(connection.innerLow, connection.innerHigh);
+            expect("=");
+            connection.outer = name();
+            range(connection.outerLow, connection.outerHigh);
+            result.connections.push_back(connection);
+        }while(accept(","));
+        expect(")");
+        expect(";");
+        return result;
+    }
+
+    vector<Token> tokens;
+    string file;
+    size_t position = 0;
+};
+
+/*
+    Flattened netlist before simplification. Every net is one bit: a constant, a chip
+    input, a Nand or DFF output, or a wire that forwards another net once it is driven.
+*/
+constexpr uint32_t NONE = UINT32_MAX;
+constexpr uint32_t NET_FALSE = 0;
+constexpr uint32_t NET_TRUE = 1;
+
+enum class NetKind : uint8_t { Constant, Input, Nand, Dff, Wire };
+
+struct Net {
+    NetKind kind;
+    uint32_t a = NONE;   // Nand/DFF: first input; Wire: driver
+    uint32_t b = NONE;   // Nand: second input; Wire: index into the wire labels
+};
+
+// Where a wire came from, for "has no driver" messages
+struct WireLabel {
+    const HdlChip* chip;
+    const string* name;
+    unsigned bit;
+};
+
+// A named signal inside one chip instance: a pin or an internal wire
+struct Signal {
+    enum Role { Input, Output, Internal } role;
+    vector<uint32_t> bits;
+};
+
+/*
+ * Function: findPin
+ * -----------------
+ * Locates a pin of a chip.
+ *
+ * Returns:
+ *  - The offset of the pin's bit 0 among all input (or output) bits, and its width,
+ *    with `found` set to false if the chip has no such pin in that list.
+ */
+struct PinLocation {
+    bool found = false;
+    unsigned offset = 0;
+    unsigned width = 0;
+};
+
+PinLocation findPin(const vector<HdlPin>& pins, const string& name){
+    PinLocation location;
+    for(const HdlPin& pin : pins){
+        if(pin.name == name){
+            location.found = true;
+            location.width = pin.width;
+            return location;
+        }
+        location.offset += pin.width;
+    }
+    return location;
+}
+
+unsigned totalWidth(const vector<HdlPin>& pins){
+    unsigned width = 0;
+    for(const HdlPin& pin : pins){
+        width += pin.width;
+    }
+    return width;
+}
+
+class Flattener {
+public:
+    explicit Flattener(HdlLibrary& library) : library(library) {
+        nets.push_back({NetKind::Constant});
+        nets.push_back({NetKind::Constant});
+    }
+
+    uint32_t addInput(){
+        nets.push_back({NetKind::Input});
+        return static_cast<uint32_t>(nets.size() - 1);
+    }
+
+    /*
+     * Function: instantiate
+     * ---------------------
+     * Builds the nets of one chip instance.
+     *
+     * Parameters:
+     *  - chip: The chip to instantiate.
+     *  - inputs: One net per input bit, pin by pin.
+     *  - depth: Nesting depth, to stop chips that contain themselves.
+     *
+     * Returns:
+     *  - One net per output bit, pin by pin.
+     *
+     * Logic:
+ *  - Nand and DFF create their nets directly.
+     *  - Keyboard and ROM32K are connected to the outside, see `external`.
+     *  - For other chips, every part's inputs are gathered from the chip's pins, constants
+     *    and internal wires (unconnected inputs are false), the part is instantiated, and
+     *    its outputs are bound to the wires and output pins they are connected to.
+     */
+    vector<uint32_t> instantiate(const HdlChip& chip, const vector<uint32_t>& inputs, unsigned depth){
+        if(chip.name == "Nand"){
+            nets.push_back({NetKind::Nand, inputs[0], inputs[1]});
+            nandCount++;
+            return {static_cast<uint32_t>(nets.size() - 1)};
+        }
+        if(chip.name == "DFF"){
+            nets.push_back({NetKind::Dff, inputs[0]});
+            return {static_cast<uint32_t>(nets.size() - 1)};
+        }
+        if(chip.name == "Keyboard" || chip.name == "ROM32K"){
+            return external(chip, inputs);
+        }
+        if(chip.builtin){
+            throw runtime_error(chip.file + ": Built-in chip " + chip.name + " cannot be simulated at gate level");
+        }
+        if(depth > 64){
+            throw runtime_error(chip.file + ": Chip " + chip.name + " is nested too deeply (does it contain itself?)");
+        }
+
+        map<string, Signal> signals;
+        size_t offset = 0;
+        for(const HdlPin& pin : chip.inputs){
+            Signal& signal = signals[pin.name];
+            signal.role = Signal::Input;
+            signal.bits.assign(inputs.begin() + offset, inputs.begin() + offset + pin.width);
+            offset += pin.width;
+        }
+        for(const HdlPin& pin : chip.outputs){
+            Signal& signal = signals[pin.name];
+            signal.role = Signal::Output;
+            for(unsigned bit = 0; bit < pin.width; bit++){
+                signal.bits.push_back(addWire(chip, pin.name, bit));
+            }
+        }
+
+        for(const HdlPart& part : chip.parts){
+            auto fail = [&](const string& message){
+                throw runtime_error(chip.file + ":" + to_string(part.line) + ": " + message);
+            };
+            const HdlChip& sub = library.chip(part.chip);
+
+            // Inputs of the part
+            vector<uint32_t> subInputs(totalWidth(sub.inputs), NET_FALSE);
+            for(const HdlConnection& connection : part.connections){
+                PinLocation pin = findPin(sub.inputs, connection.inner);
+                if(!pin.found){
+                    if(!findPin(sub.outputs, connection.inner).found){
+                        fail("Chip " + sub.name + " has no pin named " + connection.inner);
+                    }
+                    continue;
+                }
+                unsigned low = 0, width = pin.width;
+                innerRange(connection, pin, low, width, fail);
+                if(connection.outer == "true" || connection.outer == "false"){
+                    uint32_t constant = connection.outer == "true" ? NET_TRUE : NET_FALSE;
+                    fill(subInputs.begin() + pin.offset + low, subInputs.begin() + pin.offset + low + width, constant);
+                    continue;
+                }
+                Signal& signal = lookup(signals, chip, connection, width, fail);
+                if(signal.role == Signal::Output){
+                    fail("Output pin " + connection.outer + " cannot be used as the input of a part");
+                }
+                vector<uint32_t> bits = outerBits(signal, connection, fail);
+                if(bits.size() != width){
+                    fail("Width mismatch connecting " + connection.inner + " (" + to_string(width) + " bits) to "
+                         + connection.outer + " (" + to_string(bits.size()) + " bits)");
+                }
+                copy(bits.begin(), bits.end(), subInputs.begin() + pin.offset + low);
+            }
+
+            vector<uint32_t> subOutputs = instantiate(sub, subInputs, depth + 1);
+
+            // Outputs of the part
+            for(const HdlConnection& connection : part.connections){
+                PinLocation pin = findPin(sub.outputs, connection.inner);
+                if(!pin.found){
+                    continue;
+                }
+                unsigned low = 0, width = pin.width;
+                innerRange(connection, pin, low, width, fail);
+                if(connection.outer == "true" || connection.outer == "false"){
+                    fail("Output " + connection.inner + " cannot drive a constant");
+                }
+                Signal& signal = lookup(signals, chip, connection, width, fail);
+                if(signal.role == Signal::Input){
+                    fail("Input pin " + connection.outer + " cannot be driven by a part");
+                }
+                vector<uint32_t> bits = outerBits(signal, connection, fail);
+                if(bits.size() != width){
+                    fail("Width mismatch connecting " + connection.inner + " (" + to_string(width) + " bits) to "
+                         + connection.outer + " (" + to_string(bits.size()) + " bits)");
+                }
+                for(unsigned i = 0; i < width; i++){
+                    Net& wire = nets[bits[i]];
+                    if(wire.a != NONE){
+                        fail("Signal " + connection.outer + " has more than one driver");
+                    }
+                    wire.a = subOutputs[pin.offset + low + i];
+                }
+            }
+        }
+
+        vector<uint32_t> outputs;
+        for(const HdlPin& pin : chip.outputs){
+            const vector<uint32_t>& bits = signals[pin.name].bits;
+            outputs.insert(outputs.end(), bits.begin(), bits.end());
+        }
+        return outputs;
+    }
+
+    /*
+     * Function: resolve
+     * -----------------
+     * Follows wires to the net that actually drives them.
+     *
+     * Returns:
+     *  - A constant, input, Nand or DFF net.
+     *
+     * Throws:
+     *  - runtime_error if the wire was never driven.
+     */
+    uint32_t resolve(uint32_t net) const {
+        while(nets[net].kind == NetKind::Wire){
+            if(nets[net].a == NONE){
+                const WireLabel& label = labels[nets[net].b];
+                string name = *label.name;
+                const vector<HdlPin>& outputs = label.chip->outputs;
+                auto pin = find_if(outputs.begin(), outputs.end(), [&](const HdlPin& p){ return p.name == name; });
+                if(pin == outputs.end() || pin->width > 1){
+                    name += "[" + to_string(label.bit) + "]";
+                }
+                throw runtime_error(label.chip->file + ": Signal " + name + " of chip " + label.chip->name
+                                    + " is used but has no driver");
+            }
+            net = nets[net].a;
+        }
+        return net;
+    }
+
+    /*
+     * Function: external
+     * ------------------
+     * Connects a part whose contents come from outside the computer: the key pressed
+     * (`Keyboard`) or the program (`ROM32K`).
+     *
+     * Logic:
+     *  - The part's outputs become extra inputs of the netlist, `keyboard` and `rom`.
+     *    All Keyboard parts read the same keyboard.
+     *  - The address of the ROM becomes the extra output `romAddress`, so the program
+     *    counter can be checked. A chip can only read one program.
+     */
+    vector<uint32_t> external(const HdlChip& chip, const vector<uint32_t>& inputs){
+        bool rom = chip.name == "ROM32K";
+        if(rom && !romAddress.empty()){
+            throw runtime_error("Chip ROM32K can only be used once");
+        }
+        vector<uint32_t>& outputs = rom ? romData : keyboard;
+        if(outputs.empty()){
+            for(unsigned bit = 0; bit < chip.outputs[0].width; bit++){
+                outputs.push_back(addInput());
+            }
+            externalInputs.push_back({rom ? "rom" : "keyboard", chip.outputs[0].width});
+            externalNets.insert(externalNets.end(), outputs.begin(), outputs.end());
+        }
+        if(rom){
+            romAddress = inputs;
+        }
+        return outputs;
+    }
+
+    vector<Net> nets;
+    size_t nandCount = 0;
+    vector<HdlPin> externalInputs;   // Pins of `external` parts, in order of first use
+    vector<uint32_t> externalNets;   // Their nets, pin by pin
+    vector<uint32_t> romAddress;
+
+private:
+    vector<uint32_t> keyboard;
+    vector<uint32_t> romData;
+
+    uint32_t addWire(const HdlChip& chip, const string& name, unsigned bit){
+        labels.push_back({&chip, &name, bit});
+        nets.push_back({NetKind::Wire, NONE, static_cast<uint32_t>(labels.size() - 1)});
+        return static_cast<uint32_t>(nets.size() - 1);
+    }
+
+    template <typename Fail>
+    void innerRange(const HdlConnection& connection, const PinLocation& pin, unsigned& low, unsigned& width, Fail fail){
+        if(connection.innerLow >= 0){
+            if(static_cast<unsigned>(connection.innerHigh) >= pin.width){
+                fail("Bit range of " + connection.inner + " is out of bounds");
+            }
+            low = static_cast<unsigned>(connection.innerLow);
+            width = static_cast<unsigned>(connection.innerHigh - connection.innerLow + 1);
+        }
+    }
+
+    // Finds the signal named by the outer side of a connection, creating internal wires on first use
+    template <typename Fail>
+    Signal& lookup(map<string, Signal>& signals, const HdlChip& chip, const HdlConnection& connection,
+                   unsigned width, Fail fail){
+        auto found = signals.find(connection.outer);
+        if(found != signals.end()){
+            if(found->second.role == Signal::Internal && connection.outerLow >= 0){
+                fail("Internal signal " + connection.outer + " cannot be subscripted");
+            }
+            return found->second;
+        }
+        if(connection.outerLow >= 0){
+            fail("Internal signal " + connection.outer + " cannot be subscripted");
+        }
+        Signal& signal = signals[connection.outer];
+        signal.role = Signal::Internal;
+        for(unsigned bit = 0; bit < width; bit++){
+            signal.bits.push_back(addWire(chip, connection.outer, bit));
+        }
+        return signal;
+    }
+
+    template <typename Fail>
+    vector<uint32_t> outerBits(const Signal& signal, const HdlConnection& connection, Fail fail){
+        if(connection.outerLow < 0){
+            return signal.bits;
+        }
+        if(static_cast<size_t>(connection.outerHigh) >= signal.bits.size()){
+            fail("Bit range of " + connection.outer + " is out of bounds");
+        }
+        return vector<uint32_t>(signal.bits.begin() + connection.outerLow, signal.bits.begin() + connection.outerHigh + 1);
+    }
+
+    HdlLibrary& library;
+    vector<WireLabel> labels;
+};
+
+/*
+    Simplifying builder. Nodes are created in topological order; every `make` function
+    first tries to fold its operands into an existing node and otherwise shares an equal
+    gate that already exists.
+*/
+class GateBuilder {
+public:
+    enum Kind : uint8_t { Constant, Input, Dff, Logic };
+
+    struct Node {
+        Kind kind;
+        GateOp op;
+        uint32_t a, b, c;
+    };
+
+    GateBuilder(){
+        nodes.push_back({Constant, GateOp::Nand, 0, 0, 0});
+        nodes.push_back({Constant, GateOp::Nand, 0, 0, 0});
+    }
+
+    uint32_t source(Kind kind){
+        nodes.push_back({kind, GateOp::Nand, NONE, NONE, NONE});
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+
+    bool is(uint32_t node, GateOp op) const { return nodes[node].kind == Logic && nodes[node].op == op; }
+
+    // Whether `x` is known to be the complement of `y`
+    bool complement(uint32_t x, uint32_t y) const {
+        return (is(x, GateOp::Not) && nodes[x].a == y) || (is(y, GateOp::Not) && nodes[y].a == x)
+            || (x == NET_FALSE && y == NET_TRUE) || (x == NET_TRUE && y == NET_FALSE);
+    }
+
+    uint32_t makeNot(uint32_t x){
+        if(x <= NET_TRUE) return x ^ 1;
+        if(is(x, GateOp::Not)) return nodes[x].a;
+        if(is(x, GateOp::Nand)) return makeAnd(nodes[x].a, nodes[x].b);
+        if(is(x, GateOp::And)) return makeNand(nodes[x].a, nodes[x].b);
+        return emit(GateOp::Not, x, 0, 0);
+    }
+
+    uint32_t makeAnd(uint32_t x, uint32_t y){
+        if(x == NET_FALSE || y == NET_FALSE || complement(x, y)) return NET_FALSE;
+        if(x == NET_TRUE || x == y) return y;
+        if(y == NET_TRUE) return x;
+        return emit(GateOp::And, min(x, y), max(x, y), 0);
+    }
+
+    uint32_t makeOr(uint32_t x, uint32_t y){
+        if(x == NET_TRUE || y == NET_TRUE || complement(x, y)) return NET_TRUE;
+        if(x == NET_FALSE || x == y) return y;
+        if(y == NET_FALSE) return x;
+        return emit(GateOp::Or, min(x, y), max(x, y), 0);
+    }
+
+    uint32_t makeXor(uint32_t x, uint32_t y){
+        if(x == y) return NET_FALSE;
+        if(complement(x, y)) return NET_TRUE;
+        if(x == NET_FALSE) return y;
+        if(y == NET_FALSE) return x;
+        if(x == NET_TRUE) return makeNot(y);
+        if(y == NET_TRUE) return makeNot(x);
+        return emit(GateOp::Xor, min(x, y), max(x, y), 0);
+    }
+
+    // select ? y : x
+    uint32_t makeMux(uint32_t select, uint32_t x, uint32_t y){
+        if(x == y || select == NET_FALSE) return x;
+        if(select == NET_TRUE) return y;
+        if(x == NET_FALSE && y == NET_TRUE) return select;
+        if(x == NET_TRUE && y == NET_FALSE) return makeNot(select);
+        if(x == NET_FALSE) return makeAnd(select, y);
+        if(y == NET_TRUE) return makeOr(select, x);
+        if(complement(x, y)) return makeXor(x, select);
+        return emit(GateOp::Mux, x, y, select);
+    }
+
+    /*
+     * Nand is the only gate the flattened netlist contains, so this is where the shapes
+     * of the project's Not, And, Or, Xor and Mux chips are recognized:
+     * - Nand(x, x) is Not(x), and Not(Nand(x, y)) becomes And(x, y) in makeNot.
+     * - Nand(Not x, Not y) is Or(x, y).
+     * - Nand(Nand(x, Not s), Nand(y, s)) is Mux(s, x, y); a Mux between a signal and its
+     *   complement is an Xor.
+     */
+    uint32_t makeNand(uint32_t x, uint32_t y){
+        if(x == NET_FALSE || y == NET_FALSE || complement(x, y)) return NET_TRUE;
+        if(x == NET_TRUE || x == y) return makeNot(y);
+        if(y == NET_TRUE) return makeNot(x);
+        if(is(x, GateOp::Not) && is(y, GateOp::Not)) return makeOr(nodes[x].a, nodes[y].a);
+        if(is(x, GateOp::Nand) && is(y, GateOp::Nand)){
+            uint32_t mux = matchMux(x, y);
+            if(mux == NONE) mux = matchMux(y, x);
+            if(mux != NONE) return mux;
+        }
+        return emit(GateOp::Nand, min(x, y), max(x, y), 0);
+    }
+
+    vector<Node> nodes;
+
+private:
+    // Matches Nand(p, q) and Nand(r, t) where one operand of the first is the complement
+    // of one operand of the second: the complemented side selects the other operand.
+    uint32_t matchMux(uint32_t first, uint32_t second){
+        const uint32_t f[2] = {nodes[first].a, nodes[first].b};
+        const uint32_t s[2] = {nodes[second].a, nodes[second].b};
+        for(int i = 0; i < 2; i++){
+            for(int j = 0; j < 2; j++){
+                if(is(f[i], GateOp::Not) && nodes[f[i]].a == s[j]){
+                    // first = Nand(x, !sel), second = Nand(y, sel)
+                    return makeMux(s[j], f[1 - i], s[1 - j]);
+                }
+            }
+        }
+        return NONE;
+    }
+
+    struct Key {
+        uint8_t op;
+        uint32_t a, b, c;
+        bool operator==(const Key& other) const {
+            return op == other.op && a == other.a && b == other.b && c == other.c;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            uint64_t h = (uint64_t(key.a) << 32 | key.b) * 0x9E3779B97F4A7C15ULL;
+            h ^= (uint64_t(key.c) << 8 | key.op) * 0xC2B2AE3D27D4EB4FULL;
+            return static_cast<size_t>(h ^ (h >> 29));
+        }
+    };
+
+    uint32_t emit(GateOp op, uint32_t a, uint32_t b, uint32_t c){
+        Key key{static_cast<uint8_t>(op), a, b, c};
+        auto found = existing.find(key);
+        if(found != existing.end()){
+            return found->second;
+        }
+        nodes.push_back({Logic, op, a, b, c});
+        uint32_t node = static_cast<uint32_t>(nodes.size() - 1);
+        existing.emplace(key, node);
+        return node;
+    }
+
+    unordered_map<Key, uint32_t, KeyHash> existing;
+};
+
+// The screen memory map: 8K words, the first 4K at address[12] = 0
+const char* const SCREEN_HDL =
+    "CHIP Screen {\n"
+    "    IN in[16], load, address[13];\n"
+    "    OUT out[16];\n"
+    "    PARTS:\n"
+    "    DMux(in=load, sel=address[12], a=loadLow, b=loadHigh);\n"
+    "    RAM4K(in=in, load=loadLow, address=address[0..11], out=low);\n"
+    "    RAM4K(in=in, load=loadHigh, address=address[0..11], out=high);\n"
+    "    Mux16(a=low, b=high, sel=address[12], out=out);\n"
+    "}\n";
+
+} // namespace
+
+HdlChip parseHdl(const string& text, const string& file){
+    return HdlParser(text, file).parse();
+}
+
+void HdlLibrary::addDirectory(const string& directory){
+    directories.push_back(directory);
+    indexed = false;
+}
+
+const HdlChip& HdlLibrary::loadFile(const string& filename){
+    auto chip = make_unique<HdlChip>(parseHdl(loadSource(filename), filename));
+    string name = chip->name;
+    files[name] = filename;
+    chips[name] = move(chip);
+    return *chips[name];
+}
+
+/*
+ * Function: chip
+ * --------------
+ * Looks a chip up, loading its .hdl file on first use.
+ *
+ * Logic:
+ *  - Nand and DFF are the primitives and need no file.
+ *  - ARegister and DRegister behave exactly like Register and are simulated as one.
+ *  - Keyboard and ROM32K only declare their pins; the netlist connects them to the
+ *    outside. Screen is the 8K-word RAM of `SCREEN_HDL`, built from two RAM4K.
+ *    These are found before any .hdl file, so the BUILTIN stubs of the hardware
+ *    simulator's `builtInChips` directory are never used.
+ *  - The search directories are indexed once, recursively; when two directories define
+ *    the same chip, the one added first wins.
+ */
+const HdlChip& HdlLibrary::chip(const string& requested){
+    string name = (requested == "ARegister" || requested == "DRegister") ? "Register" : requested;
+    auto cached = chips.find(name);
+    if(cached != chips.end()){
+        return *cached->second;
+    }
+
+    if(name == "Nand" || name == "DFF"){
+        auto primitive = make_unique<HdlChip>();
+        primitive->name = name;
+        primitive->file = "<primitive>";
+        if(name == "Nand"){
+            primitive->inputs = {{"a", 1}, {"b", 1}};
+        }else{
+            primitive->inputs = {{"in", 1}};
+        }
+        primitive->outputs = {{"out", 1}};
+        chips[name] = move(primitive);
+        return *chips[name];
+    }
+    if(name == "Keyboard" || name == "ROM32K"){
+        auto external = make_unique<HdlChip>();
+        external->name = name;
+        external->file = "<built-in>";
+        if(name == "ROM32K"){
+            external->inputs = {{"address", 15}};
+        }
+        external->outputs = {{"out", 16}};
+        chips[name] = move(external);
+        return *chips[name];
+    }
+    if(name == "Screen"){
+        chips[name] = make_unique<HdlChip>(parseHdl(SCREEN_HDL, "<built-in Screen>"));
+        return *chips[name];
+    }
+
+    if(!indexed){
+        for(const string& directory : directories){
+            error_code error;
+            for(fs::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error)){
+                if(it->is_regular_file() && it->path().extension() == ".hdl"){
+                    files.emplace(it->path().stem().string(), it->path().string());
+                }
+            }
+        }
+        indexed = true;
+    }
+    auto file = files.find(name);
+    if(file == files.end()){
+        throw runtime_error("No .hdl file defines chip " + name);
+    }
+    auto chip = make_unique<HdlChip>(parseHdl(loadSource(file->second), file->second));
+    if(chip->name != name){
+        throw runtime_error(file->second + ": Expected chip " + name + " but the file defines " + chip->name);
+    }
+    chips[name] = move(chip);
+    return *chips[name];
+}
+
+/*
+ * Function: Netlist
+ * -----------------
+ * Compiles a chip: flatten, order, simplify, then drop and renumber.
+ *
+ * Logic:
+ *  - The ordering walk is an explicit-stack depth-first search (chips like RAM16K have
+ *    millions of nets, too deep for recursion). A net seen again while still on the
+ *    stack closes a combinational loop.
+ *  - DFF outputs are sources, so loops through a DFF are fine; the input of every DFF
+ *    reached is queued as a further root of the walk.
+ *  - The builder's nodes come out in topological order. Only nodes reachable from the
+ *    outputs (through DFFs) are kept, numbered as documented in Hdl.h.
+ */
+Netlist::Netlist(HdlLibrary& library, const string& name) : chipName(name) {
+    const HdlChip& top = library.chip(name);
+    inputPins = top.inputs;
+    outputPins = top.outputs;
+
+    Flattener flattener(library);
+    vector<uint32_t> inputNets;
+    for(unsigned i = 0; i < totalWidth(top.inputs); i++){
+        inputNets.push_back(flattener.addInput());
+    }
+    vector<uint32_t> outputNets = flattener.instantiate(top, inputNets, 0);
+    inputPins.insert(inputPins.end(), flattener.externalInputs.begin(), flattener.externalInputs.end());
+    inputNets.insert(inputNets.end(), flattener.externalNets.begin(), flattener.externalNets.end());
+    if(!flattener.romAddress.empty()){
+        outputPins.push_back({"romAddress", static_cast<unsigned>(flattener.romAddress.size())});
+        outputNets.insert(outputNets.end(), flattener.romAddress.begin(), flattener.romAddress.end());
+    }
+    flattenedNands = flattener.nandCount;
+    const vector<Net>& nets = flattener.nets;
+
+    GateBuilder builder;
+    vector<uint32_t> nodeOf(nets.size(), NONE);
+    vector<uint8_t> visiting(nets.size(), 0);
+    nodeOf[NET_FALSE] = NET_FALSE;
+    nodeOf[NET_TRUE] = NET_TRUE;
+    for(uint32_t net : inputNets){
+        nodeOf[net] = builder.source(GateBuilder::Input);
+    }
+
+    vector<pair<uint32_t, uint32_t>> dffs;   // (builder node, net of the DFF input)
+    unordered_map<uint32_t, uint32_t> dffByInput;
+    auto order = [&](uint32_t root){
+        vector<uint32_t> stack{flattener.resolve(root)};
+        while(!stack.empty()){
+            uint32_t net = stack.back();
+            if(nodeOf[net] != NONE){
+                stack.pop_back();
+                continue;
+            }
+            const Net& n = nets[net];
+            if(n.kind == NetKind::Dff){
+                // DFFs fed by the same signal always hold the same state (Bit.hdl often has two)
+                auto shared = dffByInput.emplace(flattener.resolve(n.a), 0);
+                if(shared.second){
+                    shared.first->second = builder.source(GateBuilder::Dff);
+                    dffs.emplace_back(shared.first->second, n.a);
+                }
+                nodeOf[net] = shared.first->second;
+                stack.pop_back();
+                continue;
+            }
+            uint32_t a = flattener.resolve(n.a);
+            uint32_t b = flattener.resolve(n.b);
+            if(!visiting[net]){
+                visiting[net] = 1;
+                if(nodeOf[a] == NONE) stack.push_back(a);
+                if(nodeOf[b] == NONE) stack.push_back(b);
+                continue;
+            }
+            if(nodeOf[a] == NONE || nodeOf[b] == NONE){
+                throw runtime_error("Chip " + name + " contains a combinational loop");
+            }
+            nodeOf[net] = builder.makeNand(nodeOf[a], nodeOf[b]);
+            stack.pop_back();
+        }
+    };
+
+    vector<uint32_t> outputNodes;
+    for(uint32_t net : outputNets){
+        order(net);
+        outputNodes.push_back(nodeOf[flattener.resolve(net)]);
+    }
+    vector<uint32_t> dffNext;
+    for(size_t i = 0; i < dffs.size(); i++){
+        order(dffs[i].second);
+        dffNext.push_back(nodeOf[flattener.resolve(dffs[i].second)]);
+    }
+
+    // Keep only what the outputs depend on
+    const vector<GateBuilder::Node>& nodes = builder.nodes;
+    vector<uint32_t> dffIndex(nodes.size(), NONE);
+    for(size_t i = 0; i < dffs.size(); i++){
+        dffIndex[dffs[i].first] = static_cast<uint32_t>(i);
+    }
+    vector<uint8_t> live(nodes.size(), 0);
+    vector<uint32_t> work(outputNodes.begin(), outputNodes.end());
+    while(!work.empty()){
+        uint32_t node = work.back();
+        work.pop_back();
+        if(live[node]){
+            continue;
+        }
+        live[node] = 1;
+        const GateBuilder::Node& n = nodes[node];
+        if(n.kind == GateBuilder::Logic){
+            work.push_back(n.a);
+            if(n.op != GateOp::Not) work.push_back(n.b);
+            if(n.op == GateOp::Mux) work.push_back(n.c);
+        }else if(n.kind == GateBuilder::Dff){
+            work.push_back(dffNext[dffIndex[node]]);
+        }
+    }
+
+    vector<uint32_t> slotOf(nodes.size(), NONE);
+    uint32_t next = 0;
+    slotOf[NET_FALSE] = next++;
+    slotOf[NET_TRUE] = next++;
+    inputBase.clear();
+    for(const HdlPin& pin : inputPins){
+        inputBase.push_back(next);
+        next += pin.width;
+    }
+    for(size_t i = 0; i < inputNets.size(); i++){
+        slotOf[nodeOf[inputNets[i]]] = 2 + static_cast<uint32_t>(i);
+    }
+    for(size_t i = 0; i < dffs.size(); i++){
+        if(live[dffs[i].first]){
+            slotOf[dffs[i].first] = next++;
+        }
+    }
+    for(size_t node = 0; node < nodes.size(); node++){
+        if(nodes[node].kind == GateBuilder::Logic && live[node]){
+            slotOf[node] = next++;
+            const GateBuilder::Node& n = nodes[node];
+            gateArray.push_back({n.op, slotOf[node], slotOf[n.a],
+                                 n.op == GateOp::Not ? 0 : slotOf[n.b],
+                                 n.op == GateOp::Mux ? slotOf[n.c] : 0});
+        }
+    }
+    for(size_t i = 0; i < dffs.size(); i++){
+        if(live[dffs[i].first]){
+            latchArray.push_back({slotOf[dffs[i].first], slotOf[dffNext[i]]});
+        }
+    }
+    uint32_t base = 0;
+    for(const HdlPin& pin : outputPins){
+        outputBase.push_back(base);
+        base += pin.width;
+    }
+    for(uint32_t node : outputNodes){
+        outputSlots.push_back(slotOf[node]);
+    }
+    slots = next;
+}
+
+namespace {
+
+/*
+    Gate evaluation. The body is written once and compiled twice: with the default
+    target, and with AVX2 enabled. A Lanes value is handled as two Lanes::Vector values,
+    which become two ymm operations under AVX2 and pairs of SSE operations otherwise
+    (plain 8-word loops are not vectorized at -O2).
+*/
+using Vector = Lanes::Vector;
+
+__attribute__((always_inline)) inline void evaluateGates(const Gate* gates, size_t count, Lanes* values){
+    for(size_t g = 0; g < count; g++){
+        const Gate& gate = gates[g];
+        Vector* out = values[gate.out].vectors();
+        const Vector* a = values[gate.a].vectors();
+        const Vector* b = values[gate.b].vectors();
+        switch(gate.op){
+        case GateOp::Nand:
+            for(size_t i = 0; i < Lanes::VECTORS; i++) out[i] = ~(a[i] & b[i]);
+            break;
+        case GateOp::And:
+            for(size_t i = 0; i < Lanes::VECTORS; i++) out[i] = a[i] & b[i];
+            break;
+        case GateOp::Or:
+            for(size_t i = 0; i < Lanes::VECTORS; i++) out[i] = a[i] | b[i];
+            break;
+        case GateOp::Xor:
+            for(size_t i = 0; i < Lanes::VECTORS; i++) out[i] = a[i] ^ b[i];
+            break;
+        case GateOp::Not:
+            for(size_t i = 0; i < Lanes::VECTORS; i++) out[i] = ~a[i];
+            break;
+        case GateOp::Mux: {
+            const Vector* select = values[gate.c].vectors();
+            for(size_t i = 0; i < Lanes::VECTORS; i++) out[i] = (a[i] & ~select[i]) | (b[i] & select[i]);
+            break;
+        }
+        }
+    }
+}
+
+void evaluateGeneric(const Gate* gates, size_t count, Lanes* values){
+    evaluateGates(gates, count, values);
+}
+
+#ifdef HDL_X86
+__attribute__((target("avx2")))
+void evaluateAvx2(const Gate* gates, size_t count, Lanes* values){
+    evaluateGates(gates, count, values);
+}
+#endif
+
+using Evaluator = void (*)(const Gate*, size_t, Lanes*);
+
+struct EvaluatorChoice {
+    Evaluator evaluate;
+    const char* name;
+};
+
+const EvaluatorChoice& bestEvaluator(){
+    static const EvaluatorChoice choice = []{
+#ifdef HDL_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")){
+            return EvaluatorChoice{evaluateAvx2, "avx2"};
+        }
+#endif
+        return EvaluatorChoice{evaluateGeneric, "generic"};
+    }();
+    return choice;
+}
+
+} // namespace
+
+GateSimulator::GateSimulator(const Netlist& netlist) : netlist(netlist), values(netlist.slotCount(), Lanes::fill(false)) {
+    values[NET_TRUE] = Lanes::fill(true);
+}
+
+void GateSimulator::evaluate(){
+    const vector<Gate>& gates = netlist.gates();
+    bestEvaluator().evaluate(gates.data(), gates.size(), values.data());
+}
+
+void GateSimulator::clock(){
+    // Every next-state signal is read before any state changes, as on a real clock edge
+    const vector<Netlist::Latch>& latches = netlist.latches();
+    pending.resize(latches.size());
+    for(size_t i = 0; i < latches.size(); i++){
+        pending[i] = values[latches[i].next];
+    }
+    for(size_t i = 0; i < latches.size(); i++){
+        values[latches[i].state] = pending[i];
+    }
+}
+
+void GateSimulator::resetState(){
+    for(const Netlist::Latch& latch : netlist.latches()){
+        values[latch.state] = Lanes::fill(false);
+    }
+}
+
+const char* GateSimulator::implementation(){
+    return bestEvaluator().name;
+}
@@ -0,0 +1,416 @@
+/**
+ * @file HdlModels.cpp
+ * @brief Implementation of the reference models of the project chips.
+ *
+ * Every model is a direct transcription of the chip's specification in the book, in
+ * bit-sliced form: a 16-bit value is an array of 16 `Lanes`, and arithmetic is done
+ * with a ripple-carry adder over those arrays. The models deliberately share no code
+ * with the gate-level netlists they are used to check.
+ */
+#include <vector>
+#include "../include/HdlModels.h"
+
+using namespace std;
+
+namespace {
+
+const size_t WORD = 16;
+
+Lanes mux(const Lanes& select, const Lanes& a, const Lanes& b){
+    return (a & ~select) | (b & select);
+}
+
+// sum = a + b + carry over `width` bits
+void add(const Lanes* a, const Lanes* b, Lanes* sum, size_t width, const Lanes& carryIn){
+    Lanes carry = carryIn;
+    for(size_t i = 0; i < width; i++){
+        Lanes half = a[i] ^ b[i];
+        sum[i] = half ^ carry;
+        carry = (a[i] & b[i]) | (carry & half);
+    }
+}
+
+/*
+    Combinational chips of project 1.
+*/
+void computeNot(const Lanes* in, const Lanes*, Lanes* out){ out[0] = ~in[0]; }
+void computeAnd(const Lanes* in, const Lanes*, Lanes* out){ out[0] = in[0] & in[1]; }
+void computeOr(const Lanes* in, const Lanes*, Lanes* out){ out[0] = in[0] | in[1]; }
+void computeXor(const Lanes* in, const Lanes*, Lanes* out){ out[0] = in[0] ^ in[1]; }
+void computeMux(const Lanes* in, const Lanes*, Lanes* out){ out[0] = mux(in[2], in[0], in[1]); }
+
+void computeDMux(const Lanes* in, const Lanes*, Lanes* out){
+    out[0] = in[0] & ~in[1];
+    out[1] = in[0] & in[1];
+}
+
+void computeNot16(const Lanes* in, const Lanes*, Lanes* out){
+    for(size_t i = 0; i < WORD; i++) out[i] = ~in[i];
+}
+
+void computeAnd16(const Lanes* in, const Lanes*, Lanes* out){
+    for(size_t i = 0; i < WORD; i++) out[i] = in[i] & in[WORD + i];
+}
+
+void computeOr16(const Lanes* in, const Lanes*, Lanes* out){
+    for(size_t i = 0; i < WORD; i++) out[i] = in[i] | in[WORD + i];
+}
+
+void computeMux16(const Lanes* in, const Lanes*, Lanes* out){
+    for(size_t i = 0; i < WORD; i++) out[i] = mux(in[2 * WORD], in[i], in[WORD + i]);
+}
+
+void computeOr8Way(const Lanes* in, const Lanes*, Lanes* out){
+    Lanes any = in[0];
+    for(size_t i = 1; i < 8; i++) any = any | in[i];
+    out[0] = any;
+}
+
+// out = input word number `sel` of `ways` 16-bit words
+template <size_t Ways, size_t SelectBits>
+void computeMuxWay16(const Lanes* in, const Lanes*, Lanes* out){
+    const Lanes* select = in + Ways * WORD;
+    for(size_t i = 0; i < WORD; i++){
+        Lanes level[Ways];
+        for(size_t w = 0; w < Ways; w++) level[w] = in[w * WORD + i];
+        for(size_t s = 0, count = Ways; s < SelectBits; s++, count /= 2){
+            for(size_t w = 0; w < count / 2; w++) level[w] = mux(select[s], level[2 * w], level[2 * w + 1]);
+        }
+        out[i] = level[0];
+    }
+}
+
+// Output number `sel` gets `in`, all other outputs are 0
+template <size_t Ways, size_t SelectBits>
+void computeDMuxWay(const Lanes* in, const Lanes*, Lanes* out){
+    for(size_t w = 0; w < Ways; w++){
+        Lanes match = in[0];
+        for(size_t s = 0; s < SelectBits; s++) match = match & (((w >> s) & 1) ? in[1 + s] : ~in[1 + s]);
+        out[w] = match;
+    }
+}
+
+/*
+    Arithmetic chips of project 2.
+*/
+void computeHalfAdder(const Lanes* in, const Lanes*, Lanes* out){
+    out[0] = in[0] ^ in[1];
+    out[1] = in[0] & in[1];
+}
+
+void computeFullAdder(const Lanes* in, const Lanes*, Lanes* out){
+    add(in, in + 1, out, 1, in[2]);
+    out[1] = (in[0] & in[1]) | (in[2] & (in[0] ^ in[1]));
+}
+
+void computeAdd16(const Lanes* in, const Lanes*, Lanes* out){
+    add(in, in + WORD, out, WORD, Lanes::fill(false));
+}
+
+void computeInc16(const Lanes* in, const Lanes*, Lanes* out){
+    Lanes zero[WORD];
+    for(Lanes& bit : zero) bit = Lanes::fill(false);
+    add(in, zero, out, WORD, Lanes::fill(true));
+}
+
+/*
+ * Function: computeAlu
+ * --------------------
+ * The Hack ALU: x[16], y[16], zx, nx, zy, ny, f, no -> out[16], zr, ng.
+ */
+void computeAlu(const Lanes* in, const Lanes*, Lanes* out){
+    const Lanes* control = in + 2 * WORD;
+    const Lanes &zx = control[0], &nx = control[1], &zy = control[2], &ny = control[3], &f = control[4], &no = control[5];
+    Lanes x[WORD], y[WORD], sum[WORD];
+    for(size_t i = 0; i < WORD; i++){
+        x[i] = (in[i] & ~zx) ^ nx;
+        y[i] = (in[WORD + i] & ~zy) ^ ny;
+    }
+    add(x, y, sum, WORD, Lanes::fill(false));
+    Lanes any = Lanes::fill(false);
+    for(size_t i = 0; i < WORD; i++){
+        out[i] = mux(f, x[i] & y[i], sum[i]) ^ no;
+        any = any | out[i];
+    }
+    out[WORD] = ~any;
+    out[WORD + 1] = out[WORD - 1];
+}
+
+/*
+    Sequential chips of project 3. The output is the stored state (for the RAMs, the
+    register selected by the address), and the clock edge loads the new state.
+*/
+void computeStored(const Lanes*, const Lanes* state, Lanes* out, size_t width){
+    for(size_t i = 0; i < width; i++) out[i] = state[i];
+}
+
+void computeBit(const Lanes* in, const Lanes* state, Lanes* out){ computeStored(in, state, out, 1); }
+void computeRegister(const Lanes* in, const Lanes* state, Lanes* out){ computeStored(in, state, out, WORD); }
+
+void clockBit(const Lanes* in, Lanes* state){
+    state[0] = mux(in[1], state[0], in[0]);
+}
+
+void clockRegister(const Lanes* in, Lanes* state){
+    for(size_t i = 0; i < WORD; i++) state[i] = mux(in[WORD], state[i], in[i]);
+}
+
+// PC: in[16], inc, load, reset
+void clockPc(const Lanes* in, Lanes* state){
+    const Lanes &inc = in[WORD], &load = in[WORD + 1], &reset = in[WORD + 2];
+    Lanes zero[WORD], incremented[WORD];
+    for(Lanes& bit : zero) bit = Lanes::fill(false);
+    add(state, zero, incremented, WORD, Lanes::fill(true));
+    for(size_t i = 0; i < WORD; i++){
+        Lanes next = mux(inc, state[i], incremented[i]);
+        next = mux(load, next, in[i]);
+        state[i] = next & ~reset;
+    }
+}
+
+// One mask per register: which lanes address it
+vector<Lanes> decodeAddress(const Lanes* address, size_t bits){
+    vector<Lanes> match(size_t(1) << bits);
+    match[0] = Lanes::fill(true);
+    for(size_t j = 0; j < bits; j++){
+        size_t half = size_t(1) << j;
+        for(size_t r = 0; r < half; r++){
+            match[r + half] = match[r] & address[j];
+            match[r] = match[r] & ~address[j];
+        }
+    }
+    return match;
+}
+
+// RAM with 2^AddressBits registers: in[16], load, address[AddressBits]
+template <size_t AddressBits>
+void computeRam(const Lanes* in, const Lanes* state, Lanes* out){
+    vector<Lanes> match = decodeAddress(in + WORD + 1, AddressBits);
+    for(size_t i = 0; i < WORD; i++) out[i] = Lanes::fill(false);
+    for(size_t r = 0; r < match.size(); r++){
+        for(size_t i = 0; i < WORD; i++) out[i] = out[i] | (match[r] & state[r * WORD + i]);
+    }
+}
+
+template <size_t AddressBits>
+void clockRam(const Lanes* in, Lanes* state){
+    vector<Lanes> match = decodeAddress(in + WORD + 1, AddressBits);
+    for(size_t r = 0; r < match.size(); r++){
+        Lanes write = match[r] & in[WORD];
+        for(size_t i = 0; i < WORD; i++) state[r * WORD + i] = mux(write, state[r * WORD + i], in[i]);
+    }
+}
+
+template <size_t AddressBits>
+ChipModel ramModel(const string& name){
+    return {name, {{"in", 16}, {"load", 1}, {"address", AddressBits}}, {{"out", 16}},
+            WORD << AddressBits, computeRam<AddressBits>, clockRam<AddressBits>};
+}
+
+/*
+    The computer of project 5. The CPU executes instructions like `Machine::runInterpreter`
+    (with `hackAlu` and `hackJump`), on the state A[16], D[16], PC[16].
+*/
+const size_t KEYBOARD = 0x6000;
+const size_t MEMORY_BITS = WORD * KEYBOARD;   // RAM16K, then the Screen
+
+/*
+ * Function: executeCpu
+ * --------------------
+ * Decodes one instruction and computes its ALU output.
+ *
+ * Parameters:
+ *  - inM, instruction: The CPU inputs, 16 bits each.
+ *  - state: A, D and PC.
+ *  - alu: Receives out[16], zr and ng of the ALU.
+ *  - writeM, jump: Receive the write enable of M and the jump condition.
+ *
+ * Logic:
+ *  - x is D and y is A or M (bit 12, `a`); bits 11-6 are zx, nx, zy, ny, f, no.
+ *  - Bits 2-0 jump on out < 0, = 0 and > 0. A-instructions write nothing and never jump.
+ */
+void executeCpu(const Lanes* inM, const Lanes* instruction, const Lanes* state, Lanes* alu, Lanes& writeM, Lanes& jump){
+    const Lanes& compute = instruction[15];
+    Lanes operands[2 * WORD + 6];
+    for(size_t i = 0; i < WORD; i++){
+        operands[i] = state[WORD + i];
+        operands[WORD + i] = mux(instruction[12], state[i], inM[i]);
+    }
+    for(size_t k = 0; k < 6; k++) operands[2 * WORD + k] = instruction[11 - k];
+    computeAlu(operands, nullptr, alu);
+    const Lanes &zr = alu[WORD], &ng = alu[WORD + 1];
+    writeM = compute & instruction[3];
+    jump = compute & ((instruction[2] & ng) | (instruction[1] & zr) | (instruction[0] & ~zr & ~ng));
+}
+
+// Loads A, D and PC at the clock edge; PC jumps to the old A
+void clockCpuState(const Lanes* instruction, const Lanes& reset, const Lanes* alu, const Lanes& jump, Lanes* state){
+    Lanes* a = state;
+    Lanes* d = state + WORD;
+    Lanes* pc = state + 2 * WORD;
+    const Lanes& compute = instruction[15];
+    Lanes zero[WORD], incremented[WORD];
+    for(Lanes& bit : zero) bit = Lanes::fill(false);
+    add(pc, zero, incremented, WORD, Lanes::fill(true));
+    for(size_t i = 0; i < WORD; i++){
+        pc[i] = mux(jump, incremented[i], a[i]) & ~reset;
+        a[i] = mux(compute, instruction[i], mux(instruction[5], a[i], alu[i]));
+        d[i] = mux(compute & instruction[4], d[i], alu[i]);
+    }
+}
+
+// CPU: inM[16], instruction[16], reset -> outM[16], writeM, addressM[15], pc[15]
+void computeCpu(const Lanes* in, const Lanes* state, Lanes* out){
+    Lanes alu[WORD + 2], jump;
+    executeCpu(in, in + WORD, state, alu, out[WORD], jump);
+    for(size_t i = 0; i < WORD; i++) out[i] = alu[i];
+    for(size_t i = 0; i < 15; i++){
+        out[WORD + 1 + i] = state[i];
+        out[WORD + 16 + i] = state[2 * WORD + i];
+    }
+}
+
+void clockCpu(const Lanes* in, Lanes* state){
+    Lanes alu[WORD + 2], writeM, jump;
+    executeCpu(in, in + WORD, state, alu, writeM, jump);
+    clockCpuState(in + WORD, in[2 * WORD], alu, jump, state);
+}
+
+// outM is only specified while writeM is set
+void careCpu(const Lanes* in, const Lanes*, Lanes* mask){
+    Lanes writeM = in[WORD + 15] & in[WORD + 3];
+    for(size_t i = 0; i < WORD; i++) mask[i] = writeM;
+    for(size_t i = WORD; i < WORD + 31; i++) mask[i] = Lanes::fill(true);
+}
+
+// The words of the RAM and the screen, then the keyboard; `match` is decodeAddress() of 15 bits
+void readMemory(const vector<Lanes>& match, const Lanes* keyboard, const Lanes* memory, Lanes* out){
+    for(size_t i = 0; i < WORD; i++) out[i] = match[KEYBOARD] & keyboard[i];
+    for(size_t r = 0; r < KEYBOARD; r++){
+        for(size_t i = 0; i < WORD; i++) out[i] = out[i] | (match[r] & memory[r * WORD + i]);
+    }
+}
+
+// The keyboard cannot be written
+void writeMemory(const vector<Lanes>& match, const Lanes* in, const Lanes& load, Lanes* memory){
+    for(size_t r = 0; r < KEYBOARD; r++){
+        Lanes write = match[r] & load;
+        for(size_t i = 0; i < WORD; i++) memory[r * WORD + i] = mux(write, memory[r * WORD + i], in[i]);
+    }
+}
+
+// Memory: in[16], load, address[15], keyboard[16] -> out[16]
+void computeMemory(const Lanes* in, const Lanes* state, Lanes* out){
+    readMemory(decodeAddress(in + WORD + 1, 15), in + 2 * WORD, state, out);
+}
+
+void clockMemory(const Lanes* in, Lanes* state){
+    writeMemory(decodeAddress(in + WORD + 1, 15), in, in[WORD], state);
+}
+
+// Addresses above the keyboard are invalid; they become the keyboard's address
+void constrainAddress(Lanes* address){
+    Lanes invalid = address[13] & address[14];
+    for(size_t i = 0; i < 13; i++) address[i] = address[i] & ~invalid;
+}
+
+void constrainMemory(Lanes* in){
+    constrainAddress(in + WORD + 1);
+}
+
+/*
+ * Function: clockComputer
+ * -----------------------
+ * Computer: reset, keyboard[16], rom[16] -> romAddress[15]. The state is the CPU, then
+ * the memory.
+ *
+ * Logic:
+ *  - M is read from address A and written there before the CPU registers load.
+ */
+void clockComputer(const Lanes* in, Lanes* state){
+    const Lanes* instruction = in + 1 + WORD;
+    vector<Lanes> match = decodeAddress(state, 15);
+    Lanes inM[WORD], alu[WORD + 2], writeM, jump;
+    readMemory(match, in + 1, state + 3 * WORD, inM);
+    executeCpu(inM, instruction, state, alu, writeM, jump);
+    writeMemory(match, alu, writeM, state + 3 * WORD);
+    clockCpuState(instruction, in[0], alu, jump, state);
+}
+
+void computeComputer(const Lanes*, const Lanes* state, Lanes* out){
+    for(size_t i = 0; i < 15; i++) out[i] = state[2 * WORD + i];
+}
+
+/*
+ * What an address above the keyboard reads, or what writing it does, is not specified,
+ * so the program only ever loads valid addresses into A: A-instructions are limited
+ * like the Memory inputs, and C-instructions do not load A (the CPU check covers that).
+ */
+void constrainComputer(Lanes* in){
+    Lanes* instruction = in + 1 + WORD;
+    Lanes invalid = ~instruction[15] & instruction[13] & instruction[14];
+    for(size_t i = 0; i < 13; i++) instruction[i] = instruction[i] & ~invalid;
+    instruction[5] = instruction[5] & ~instruction[15];
+}
+
+vector<ChipModel> buildModels(){
+    vector<HdlPin> sixteenWays;
+    for(const char* name : {"a", "b", "c", "d", "e", "f", "g", "h"}) sixteenWays.push_back({name, 16});
+
+    return {
+        {"Not", {{"in", 1}}, {{"out", 1}}, 0, computeNot, nullptr},
+        {"And", {{"a", 1}, {"b", 1}}, {{"out", 1}}, 0, computeAnd, nullptr},
+        {"Or", {{"a", 1}, {"b", 1}}, {{"out", 1}}, 0, computeOr, nullptr},
+        {"Xor", {{"a", 1}, {"b", 1}}, {{"out", 1}}, 0, computeXor, nullptr},
+        {"Mux", {{"a", 1}, {"b", 1}, {"sel", 1}}, {{"out", 1}}, 0, computeMux, nullptr},
+        {"DMux", {{"in", 1}, {"sel", 1}}, {{"a", 1}, {"b", 1}}, 0, computeDMux, nullptr},
+        {"Not16", {{"in", 16}}, {{"out", 16}}, 0, computeNot16, nullptr},
+        {"And16", {{"a", 16}, {"b", 16}}, {{"out", 16}}, 0, computeAnd16, nullptr},
+        {"Or16", {{"a", 16}, {"b", 16}}, {{"out", 16}}, 0, computeOr16, nullptr},
+        {"Mux16", {{"a", 16}, {"b", 16}, {"sel", 1}}, {{"out", 16}}, 0, computeMux16, nullptr},
+        {"Or8Way", {{"in", 8}}, {{"out", 1}}, 0, computeOr8Way, nullptr},
+        {"Mux4Way16", {sixteenWays[0], sixteenWays[1], sixteenWays[2], sixteenWays[3], {"sel", 2}},
+         {{"out", 16}}, 0, computeMuxWay16<4, 2>, nullptr},
+        {"Mux8Way16", {sixteenWays[0], sixteenWays[1], sixteenWays[2], sixteenWays[3],
+                       sixteenWays[4], sixteenWays[5], sixteenWays[6], sixteenWays[7], {"sel", 3}},
+         {{"out", 16}}, 0, computeMuxWay16<8, 3>, nullptr},
+        {"DMux4Way", {{"in", 1}, {"sel", 2}}, {{"a", 1}, {"b", 1}, {"c", 1}, {"d", 1}}, 0,
+         computeDMuxWay<4, 2>, nullptr},
+        {"DMux8Way", {{"in", 1}, {"sel", 3}},
+         {{"a", 1}, {"b", 1}, {"c", 1}, {"d", 1}, {"e", 1}, {"f", 1}, {"g", 1}, {"h", 1}}, 0,
+         computeDMuxWay<8, 3>, nullptr},
+        {"HalfAdder", {{"a", 1}, {"b", 1}}, {{"sum", 1}, {"carry", 1}}, 0, computeHalfAdder, nullptr},
+        {"FullAdder", {{"a", 1}, {"b", 1}, {"c", 1}}, {{"sum", 1}, {"carry", 1}}, 0, computeFullAdder, nullptr},
+        {"Add16", {{"a", 16}, {"b", 16}}, {{"out", 16}}, 0, computeAdd16, nullptr},
+        {"Inc16", {{"in", 16}}, {{"out", 16}}, 0, computeInc16, nullptr},
+        {"ALU", {{"x", 16}, {"y", 16}, {"zx", 1}, {"nx", 1}, {"zy", 1}, {"ny", 1}, {"f", 1}, {"no", 1}},
+         {{"out", 16}, {"zr", 1}, {"ng", 1}}, 0, computeAlu, nullptr},
+        {"Bit", {{"in", 1}, {"load", 1}}, {{"out", 1}}, 1, computeBit, clockBit},
+        {"Register", {{"in", 16}, {"load", 1}}, {{"out", 16}}, WORD, computeRegister, clockRegister},
+        {"PC", {{"in", 16}, {"inc", 1}, {"load", 1}, {"reset", 1}}, {{"out", 16}}, WORD, computeRegister, clockPc},
+        ramModel<3>("RAM8"),
+        ramModel<6>("RAM64"),
+        ramModel<9>("RAM512"),
+        ramModel<12>("RAM4K"),
+        ramModel<14>("RAM16K"),
+        {"CPU", {{"inM", 16}, {"instruction", 16}, {"reset", 1}},
+         {{"outM", 16}, {"writeM", 1}, {"addressM", 15}, {"pc", 15}}, 3 * WORD,
+         computeCpu, clockCpu, nullptr, careCpu},
+        {"Memory", {{"in", 16}, {"load", 1}, {"address", 15}, {"keyboard", 16}}, {{"out", 16}}, MEMORY_BITS,
+         computeMemory, clockMemory, constrainMemory, nullptr},
+        {"Computer", {{"reset", 1}, {"keyboard", 16}, {"rom", 16}}, {{"romAddress", 15}}, 3 * WORD + MEMORY_BITS,
+         computeComputer, clockComputer, constrainComputer, nullptr}
+    };
+}
+
+} // namespace
+
+const ChipModel* findChipModel(const string& name){
+    static const vector<ChipModel> models = buildModels();
+    for(const ChipModel& model : models){
+        if(model.name == name){
+            return &model;
+        }
+    }
+    return nullptr;
+}
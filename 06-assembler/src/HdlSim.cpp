@@ -0,0 +1,493 @@
+/**
+ * @file HdlSim.cpp
+ * @brief Main entry point for the bit-parallel HDL simulator.
+ *
+ * This file contains the command-line front end of `Netlist` and `GateSimulator`: it
+ * compiles the given chips and checks each one against its reference model from
+ * HdlModels.h, 512 test vectors per pass over the gate array.
+ *
+ * Key Components:
+ * - Chip selection: .hdl files, directories of .hdl files or chip names looked up in
+ *   the library directories (`-L`).
+ * - Combinational chips are checked exhaustively when they have few enough input bits
+ *   (or when `--exhaustive` is given), otherwise on random vectors.
+ * - Sequential chips run many random input sequences from the all-zero state, comparing
+ *   the outputs before every clock edge.
+ * - `Keyboard` and `ROM32K` parts are driven with random words like the chip's own inputs.
+ * - The vector blocks are spread over a `ThreadPool`.
+ * - Exit status: 0 if every chip passed, 1 if a chip failed or did not compile, 2 for
+ *   usage errors.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../include/CommandLine.h"
+#include "../include/Hdl.h"
+#include "../include/HdlModels.h"
+#include "../include/ThreadPool.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+/**
+ * @brief Settings collected from the command line.
+ */
+struct Options {
+    vector<string> chips;                // .hdl files, directories or chip names
+    vector<string> libraries;            // Extra directories searched for parts
+    bool exhaustive = false;
+    unsigned maxExhaustiveBits = 24;     // Combinational chips with more inputs get random vectors
+    uint64_t vectors = uint64_t(1) << 20;
+    uint64_t cycles = 1000;
+    uint64_t seed = 1;
+    unsigned threads = 0;
+};
+
+/**
+ * @brief Prints the command-line help.
+ */
+static void printUsage(){
+    cout<<"Usage: HdlSim [options] chip...\n"
+        <<"\n"
+        <<"Each chip may be an .hdl file, a directory (every .hdl file in it is checked)\n"
+        <<"or a chip name. Parts are looked up in the directory of the chip's file and in\n"
+        <<"the library directories. Every chip is compiled to a gate array and checked\n"
+        <<"against the reference model of the chip with the same name.\n"
+        <<"\n"
+        <<"Options:\n"
+        <<"  -L, --library DIR         Also search DIR (and its subdirectories) for parts\n"
+        <<"  --exhaustive              Check every input combination of combinational chips\n"
+        <<"  --max-exhaustive-bits N   Check chips with at most N input bits exhaustively (default 24)\n"
+        <<"  --vectors N               Number of random test vectors otherwise (default 1048576)\n"
+        <<"  --cycles N                Clock cycles per random sequence of sequential chips (default 1000)\n"
+        <<"  --seed N                  Seed of the random vectors (default 1)\n"
+        <<"  -j, --jobs N              Number of worker threads (default: all cores)\n"
+        <<"  -h, --help                Show this help\n";
+}
+
+/**
+ * @brief Reads the options and the chips from the command line.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Command-line arguments.
+ * @param options Receives the parsed settings.
+ * @return bool false if the program should exit (after `--help`).
+ * @throws std::invalid_argument For unknown options, bad values or no chips.
+ */
+static bool parseArguments(int argc, char* argv[], Options& options){
+    for(int i = 1; i < argc; i++){
+        string argument = argv[i];
+        auto value = [&]() -> string {
+            if(i + 1 >= argc){
+                throw invalid_argument("Missing value for " + argument);
+            }
+            return argv[++i];
+        };
+
+        if(argument == "-h" || argument == "--help"){
+            printUsage();
+            return false;
+        }else if(argument == "-L" || argument == "--library"){
+            options.libraries.push_back(value());
+        }else if(argument == "--exhaustive"){
+            options.exhaustive = true;
+        }else if(argument == "--max-exhaustive-bits"){
+            options.maxExhaustiveBits = static_cast<unsigned>(parseNumber(value(), 48));
+        }else if(argument == "--vectors"){
+            options.vectors = max<uint64_t>(1, parseNumber(value(), UINT64_MAX));
+        }else if(argument == "--cycles"){
+            options.cycles = max<uint64_t>(1, parseNumber(value(), UINT64_MAX));
+        }else if(argument == "--seed"){
+            options.seed = parseNumber(value(), UINT64_MAX);
+        }else if(argument == "-j" || argument == "--jobs"){
+            options.threads = static_cast<unsigned>(parseNumber(value(), 1024));
+        }else if(argument.size() > 1 && argument[0] == '-'){
+            throw invalid_argument("Unknown option: " + argument);
+        }else{
+            options.chips.push_back(argument);
+        }
+    }
+    if(options.chips.empty()){
+        throw invalid_argument("No chips given");
+    }
+    return true;
+}
+
+/**
+ * @brief A chip compiled and paired with its reference model.
+ *
+ * The slot lists follow the model's pin order, one entry per bit, so the model's
+ * `Lanes` arrays and the netlist signals can be copied into each other directly.
+ */
+struct Harness {
+    const Netlist& netlist;
+    const ChipModel& model;
+    vector<uint32_t> inputSlots;
+    vector<uint32_t> outputSlots;
+};
+
+/**
+ * @brief Collects the netlist slots of the model's pins.
+ *
+ * @throws std::runtime_error If the chip does not declare the model's pins.
+ */
+static Harness connect(const Netlist& netlist, const ChipModel& model){
+    Harness harness{netlist, model, {}, {}};
+    auto find = [&](const vector<HdlPin>& pins, const HdlPin& wanted) -> size_t {
+        for(size_t p = 0; p < pins.size(); p++){
+            if(pins[p].name == wanted.name){
+                if(pins[p].width != wanted.width){
+                    throw runtime_error("Pin " + wanted.name + " should be " + to_string(wanted.width) + " bits wide");
+                }
+                return p;
+            }
+        }
+        throw runtime_error("Missing pin " + wanted.name);
+    };
+    if(netlist.inputs().size() != model.inputs.size() || netlist.outputs().size() != model.outputs.size()){
+        throw runtime_error("The pins differ from the specification of " + model.name);
+    }
+    for(const HdlPin& pin : model.inputs){
+        size_t p = find(netlist.inputs(), pin);
+        for(unsigned bit = 0; bit < pin.width; bit++) harness.inputSlots.push_back(netlist.inputSlot(p, bit));
+    }
+    for(const HdlPin& pin : model.outputs){
+        size_t p = find(netlist.outputs(), pin);
+        for(unsigned bit = 0; bit < pin.width; bit++) harness.outputSlots.push_back(netlist.outputSlot(p, bit));
+    }
+    return harness;
+}
+
+static void randomLanes(Lanes& lanes, uint64_t& state){
+    for(uint64_t& word : lanes.word) word = nextRandom(state);
+}
+
+/**
+ * @brief Moves the inputs into the range the model specifies, then sets them in the simulator.
+ */
+static void applyInputs(const Harness& harness, GateSimulator& sim, vector<Lanes>& in){
+    if(harness.model.constrain != nullptr){
+        harness.model.constrain(in.data());
+    }
+    for(size_t k = 0; k < in.size(); k++){
+        sim.signal(harness.inputSlots[k]) = in[k];
+    }
+}
+
+/**
+ * @brief Describes one lane of a failed comparison: the inputs, then the expected
+ *        and the actual outputs, as unsigned pin values.
+ */
+static string describeLane(const Harness& harness, const vector<Lanes>& in,
+                           const vector<Lanes>& expected, const vector<Lanes>& actual, size_t lane){
+    ostringstream text;
+    auto pins = [&](const vector<HdlPin>& list, const vector<Lanes>& values){
+        size_t bit = 0;
+        for(const HdlPin& pin : list){
+            uint64_t value = 0;
+            for(unsigned b = 0; b < pin.width; b++, bit++){
+                value |= uint64_t(values[bit].get(lane)) << b;
+            }
+            text<<' '<<pin.name<<'='<<value;
+        }
+    };
+    text<<"inputs";
+    pins(harness.model.inputs, in);
+    text<<"; expected";
+    pins(harness.model.outputs, expected);
+    text<<"; got";
+    pins(harness.model.outputs, actual);
+    return text.str();
+}
+
+/**
+ * @brief Finds the first lane in which the outputs differ, or Lanes::COUNT if none.
+ *        Output bits cleared in `care` are not compared.
+ */
+static size_t firstMismatch(const vector<Lanes>& expected, const vector<Lanes>& actual, const vector<Lanes>& care){
+    Lanes differ = Lanes::fill(false);
+    for(size_t bit = 0; bit < expected.size(); bit++){
+        differ = differ | ((expected[bit] ^ actual[bit]) & care[bit]);
+    }
+    for(size_t w = 0; w < Lanes::WORDS; w++){
+        if(differ.word[w]){
+            return w * 64 + static_cast<size_t>(__builtin_ctzll(differ.word[w]));
+        }
+    }
+    return Lanes::COUNT;
+}
+
+/*
+ * Function: checkCombinational
+ * ----------------------------
+ * Compares a combinational chip with its model on blocks of 512 vectors.
+ *
+ * Parameters:
+ *  - harness: The chip and its model.
+ *  - blocks: Number of blocks of Lanes::COUNT vectors.
+ *  - exhaustive: true to enumerate the inputs, false for random vectors.
+ *  - options, pool, failure: Settings, workers and the failure report.
+ *
+ * Logic:
+ *  - Exhaustive vector number v = block * 512 + lane gets input bit k = bit k of v. In a
+ *    Lanes value, bits 0-5 are the same pattern in every word (0xAAAA..., 0xCCCC..., ...),
+ *    bits 6-8 select the word and higher bits are constant within a block.
+ *  - Each chunk of blocks runs on its own simulator; workers stop once any failure is
+ *    known.
+ */
+static void checkCombinational(const Harness& harness, uint64_t blocks, bool exhaustive,
+                               const Options& options, ThreadPool& pool, Failure& failure){
+    static const uint64_t patterns[6] = {
+        0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+        0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL
+    };
+    size_t chunk = static_cast<size_t>(max<uint64_t>(1, min<uint64_t>(4096, blocks / (pool.size() * 8 + 1))));
+    pool.parallelFor(static_cast<size_t>(blocks), chunk, [&](size_t begin, size_t end){
+        GateSimulator sim(harness.netlist);
+        size_t inputCount = harness.inputSlots.size();
+        vector<Lanes> in(inputCount), expected(harness.outputSlots.size()), actual(harness.outputSlots.size());
+        vector<Lanes> care(harness.outputSlots.size(), Lanes::fill(true));
+        for(size_t block = begin; block < end && !failure.found; block++){
+            uint64_t random = blockSeed(options.seed, block);
+            for(size_t k = 0; k < inputCount; k++){
+                if(!exhaustive){
+                    randomLanes(in[k], random);
+                }else if(k < 6){
+                    for(uint64_t& word : in[k].word) word = patterns[k];
+                }else if(k < 9){
+                    for(size_t w = 0; w < Lanes::WORDS; w++) in[k].word[w] = ((w >> (k - 6)) & 1) ? ~uint64_t(0) : 0;
+                }else{
+                    in[k] = Lanes::fill((block >> (k - 9)) & 1);
+                }
+            }
+            applyInputs(harness, sim, in);
+            sim.evaluate();
+            harness.model.compute(in.data(), nullptr, expected.data());
+            if(harness.model.care != nullptr){
+                harness.model.care(in.data(), nullptr, care.data());
+            }
+            for(size_t o = 0; o < actual.size(); o++) actual[o] = sim.signal(harness.outputSlots[o]);
+
+            size_t lane = firstMismatch(expected, actual, care);
+            if(lane != Lanes::COUNT){
+                failure.record(block, describeLane(harness, in, expected, actual, lane));
+                return;
+            }
+        }
+    });
+}
+
+/*
+ * Function: checkSequential
+ * -------------------------
+ * Runs `sequences` random input sequences of `cycles` clock cycles each through the
+ * chip and its model, 512 sequences per block, all starting with every DFF at 0.
+ *
+ * Logic:
+ *  - Every cycle the outputs are compared after the inputs are set, then both the
+ *    netlist and the model are clocked.
+ *  - Load/write enables are random bits like every other input, so about half of the
+ *    cycles write.
+ *  - Inputs outside the specification are moved into it by the model (Memory addresses
+ *    above the keyboard), and outputs it leaves open are not compared (CPU's outM while
+ *    writeM is 0).
+ */
+static void checkSequential(const Harness& harness, uint64_t blocks, const Options& options,
+                            ThreadPool& pool, Failure& failure){
+    pool.parallelFor(static_cast<size_t>(blocks), 1, [&](size_t begin, size_t end){
+        GateSimulator sim(harness.netlist);
+        vector<Lanes> in(harness.inputSlots.size()), state(harness.model.stateBits, Lanes::fill(false));
+        vector<Lanes> expected(harness.outputSlots.size()), actual(harness.outputSlots.size());
+        vector<Lanes> care(harness.outputSlots.size(), Lanes::fill(true));
+        for(size_t block = begin; block < end && !failure.found; block++){
+            sim.resetState();
+            fill(state.begin(), state.end(), Lanes::fill(false));
+            uint64_t random = blockSeed(options.seed, block);
+            for(uint64_t cycle = 0; cycle < options.cycles; cycle++){
+                for(Lanes& bit : in){
+                    randomLanes(bit, random);
+                }
+                applyInputs(harness, sim, in);
+                sim.evaluate();
+                harness.model.compute(in.data(), state.data(), expected.data());
+                if(harness.model.care != nullptr){
+                    harness.model.care(in.data(), state.data(), care.data());
+                }
+                for(size_t o = 0; o < actual.size(); o++) actual[o] = sim.signal(harness.outputSlots[o]);
+
+                size_t lane = firstMismatch(expected, actual, care);
+                if(lane != Lanes::COUNT){
+                    failure.record(block, "cycle " + to_string(cycle) + ": " +
+                                          describeLane(harness, in, expected, actual, lane));
+                    return;
+                }
+                sim.clock();
+                harness.model.clock(in.data(), state.data());
+            }
+        }
+    });
+}
+
+/**
+ * @brief Expands the chip arguments into chip names and registers their directories.
+ *
+ * Files and directories come first in the library, in command-line order, so a chip's
+ * own project directory supplies its parts before any `-L` directory.
+ */
+static vector<string> collectChips(const Options& options, HdlLibrary& library){
+    vector<string> names;
+    vector<string> seen;
+    auto addDirectory = [&](const string& directory){
+        if(find(seen.begin(), seen.end(), directory) == seen.end()){
+            seen.push_back(directory);
+            library.addDirectory(directory);
+        }
+    };
+    for(const string& argument : options.chips){
+        fs::path path(argument);
+        if(fs::is_directory(path)){
+            addDirectory(path.string());
+            vector<string> found;
+            for(const auto& entry : fs::directory_iterator(path)){
+                if(entry.is_regular_file() && entry.path().extension() == ".hdl"){
+                    found.push_back(library.loadFile(entry.path().string()).name);
+                }
+            }
+            sort(found.begin(), found.end());
+            names.insert(names.end(), found.begin(), found.end());
+        }else if(path.extension() == ".hdl"){
+            addDirectory(path.has_parent_path() ? path.parent_path().string() : ".");
+            names.push_back(library.loadFile(argument).name);
+        }else{
+            names.push_back(argument);
+        }
+    }
+    for(const string& directory : options.libraries){
+        addDirectory(directory);
+    }
+    if(seen.empty()){
+        addDirectory(".");
+    }
+    return names;
+}
+
+/**
+ * @brief Compiles and checks one chip and prints the result.
+ *
+ * @return bool true if the chip compiled and matched its model (or has no model).
+ */
+static bool checkChip(const string& name, HdlLibrary& library, const Options& options, ThreadPool& pool){
+    auto compileStart = chrono::steady_clock::now();
+    unique_ptr<Netlist> netlist;
+    try{
+        netlist = make_unique<Netlist>(library, name);
+    }catch(const exception& e){
+        cout<<name<<": Error: "<<e.what()<<endl;
+        return false;
+    }
+    double compileSeconds = chrono::duration<double>(chrono::steady_clock::now() - compileStart).count();
+    cout<<name<<": "<<netlist->nandCount()<<" Nand gates -> "<<netlist->gates().size()<<" gates, "
+        <<netlist->latches().size()<<" DFFs (compiled in "<<compileSeconds<<" s)"<<endl;
+
+    const ChipModel* model = findChipModel(name);
+    if(model == nullptr){
+        cout<<name<<": No reference model; compiled only."<<endl;
+        return true;
+    }
+    unique_ptr<Harness> harness;
+    try{
+        harness = make_unique<Harness>(connect(*netlist, *model));
+    }catch(const exception& e){
+        cout<<name<<": Error: "<<e.what()<<endl;
+        return false;
+    }
+
+    size_t inputBits = harness->inputSlots.size();
+    bool sequential = model->clock != nullptr;
+    bool exhaustive = !sequential && (options.exhaustive || inputBits <= options.maxExhaustiveBits);
+    if(exhaustive && inputBits > 48){
+        cout<<name<<": Error: "<<inputBits<<" input bits are too many to check exhaustively"<<endl;
+        return false;
+    }
+    uint64_t blocks;
+    uint64_t vectors;
+    if(exhaustive){
+        vectors = uint64_t(1) << inputBits;
+        blocks = (vectors + Lanes::COUNT - 1) / Lanes::COUNT;
+    }else if(sequential){
+        blocks = max<uint64_t>(1, options.vectors / (Lanes::COUNT * options.cycles));
+        vectors = blocks * Lanes::COUNT * options.cycles;
+    }else{
+        blocks = (options.vectors + Lanes::COUNT - 1) / Lanes::COUNT;
+        vectors = blocks * Lanes::COUNT;
+    }
+
+    Failure failure;
+    auto start = chrono::steady_clock::now();
+    if(sequential){
+        checkSequential(*harness, blocks, options, pool, failure);
+    }else{
+        checkCombinational(*harness, blocks, exhaustive, options, pool, failure);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if(failure.found){
+        cout<<name<<": FAILED: "<<failure.message<<endl;
+        return false;
+    }
+    cout<<name<<": OK, "<<vectors<<(exhaustive ? " vectors (exhaustive)" : sequential ? " random cycles" : " random vectors")
+        <<" in "<<seconds<<" s";
+    if(seconds > 0){
+        cout<<" ("<<(vectors / seconds / 1e6)<<" M/s, "<<GateSimulator::implementation()<<")";
+    }
+    cout<<"."<<endl;
+    return true;
+}
+
+/**
+ * @brief Main function for the HdlSim program
+ *
+ * Process Flow:
+ * 1. Parse the command-line options.
+ * 2. Resolve the chip arguments and set up the part library.
+ * 3. Compile each chip and check it against its reference model.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Command-line arguments.
+ * @return int 0 if every chip passed, 1 if any failed, 2 on usage errors.
+ */
+int main(int argc, char* argv[]){
+    Options options;
+    try{
+        if(!parseArguments(argc, argv, options)){
+            return 0;
+        }
+    }catch(const invalid_argument& e){
+        cerr<<e.what()<<endl;
+        printUsage();
+        return 2;
+    }
+
+    HdlLibrary library;
+    vector<string> names;
+    try{
+        names = collectChips(options, library);
+    }catch(const exception& e){
+        cerr<<"Error: "<<e.what()<<endl;
+        return 1;
+    }
+
+    ThreadPool pool(options.threads);
+    bool passed = true;
+    for(const string& name : names){
+        passed = checkChip(name, library, options, pool) && passed;
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,336 @@
+/**
+ * @file IncrementalAssembler.cpp
+ * @brief Implementation of the incremental assembler.
+ *
+ * An update costs a comparison of the old and new source (done with `memcmp` a block at a
+ * time), the tokenizing and encoding of the edited lines, one move of the per-instruction
+ * arrays behind the edit, and a scan of the symbol ids to allocate the variables. The
+ * A-instructions are only scanned again for encoding when a label or variable moved, and
+ * then only those naming a moved symbol are encoded.
+ *
+ * Diagnostics are rare and must match the assembler word for word, so when an update
+ * finds an error the messages are produced by a full `Assembler` run over the source.
+ */
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "../include/IncrementalAssembler.h"
+#include "../include/BinCodes.h"
+#include "../include/Scanner.h"
+
+using namespace std;
+
+namespace {
+
+const size_t COMPARE_BLOCK = 4096;
+
+size_t commonPrefix(string_view a, string_view b){
+    size_t limit = min(a.size(), b.size());
+    size_t length = 0;
+    while(length + COMPARE_BLOCK <= limit && memcmp(a.data() + length, b.data() + length, COMPARE_BLOCK) == 0){
+        length += COMPARE_BLOCK;
+    }
+    while(length < limit && a[length] == b[length]){
+        length++;
+    }
+    return length;
+}
+
+// Common suffix of at most `limit` bytes, so it never overlaps the common prefix
+size_t commonSuffix(string_view a, string_view b, size_t limit){
+    size_t length = 0;
+    while(length + COMPARE_BLOCK <= limit &&
+          memcmp(a.data() + a.size() - length - COMPARE_BLOCK, b.data() + b.size() - length - COMPARE_BLOCK, COMPARE_BLOCK) == 0){
+        length += COMPARE_BLOCK;
+    }
+    while(length < limit && a[a.size() - 1 - length] == b[b.size() - 1 - length]){
+        length++;
+    }
+    return length;
+}
+
+// Replaces v[begin, end) by `items` with at most one move of the elements behind the range.
+// Growing leaves 1/8 spare capacity, so inserting lines later does not reallocate.
+template <typename T>
+void splice(vector<T>& v, size_t begin, size_t end, const vector<T>& items){
+    size_t removed = end - begin;
+    if(items.size() > removed){
+        size_t size = v.size() + items.size() - removed;
+        if(size > v.capacity()){
+            v.reserve(size + size / 8);
+        }
+        v.insert(v.begin() + end, items.size() - removed, T());
+    }else if(items.size() < removed){
+        v.erase(v.begin() + begin + items.size(), v.begin() + end);
+    }
+    copy(items.begin(), items.end(), v.begin() + begin);
+}
+
+template <typename T>
+size_t firstAtOrAfter(const vector<T>& items, size_t offset){
+    return partition_point(items.begin(), items.end(), [offset](const T& item){ return item.offset < offset; }) - items.begin();
+}
+
+} // namespace
+
+IncrementalAssembler::IncrementalAssembler(string name) : sourceName(move(name)){
+}
+
+/*
+    IncrementalAssembler::intern(string_view name)
+    Returns the id of a user symbol, giving a new name the next id.
+*/
+uint32_t IncrementalAssembler::intern(string_view name){
+    auto [id, added] = ids.insert(name, static_cast<int>(addresses.size()));
+    if(added){
+        addresses.push_back(-1);
+        uses.push_back(0);
+        definitions.push_back(0);
+    }
+    return static_cast<uint32_t>(id);
+}
+
+/*
+    IncrementalAssembler::lineAt(size_t offset)
+    The 1-based line of a source offset. Newlines are only counted from the closest statement
+    before the offset, whose line is known, instead of from the start of the file.
+*/
+uint32_t IncrementalAssembler::lineAt(size_t offset) const{
+    size_t start = 0;
+    uint32_t line = 1;
+    size_t instruction = firstAtOrAfter(program, offset);
+    if(instruction > 0){
+        start = program[instruction - 1].offset;
+        line = program[instruction - 1].line;
+    }
+    size_t label = firstAtOrAfter(labels, offset);
+    if(label > 0 && labels[label - 1].offset >= start){
+        start = labels[label - 1].offset;
+        line = labels[label - 1].line;
+    }
+    return line + static_cast<uint32_t>(count(source.begin() + start, source.begin() + offset, '\n'));
+}
+
+/*
+    IncrementalAssembler::encode(size_t index)
+    Encodes one instruction with the current symbol addresses and updates its error flag.
+
+    Returns:
+    - `bool`: Whether the word changed.
+*/
+bool IncrementalAssembler::encode(size_t index){
+    uint16_t word = 0;
+    bool ok = true;
+    try{
+        uint32_t symbol = symbolOf[index];
+        if(symbol != NO_SYMBOL){
+            word = encodeAInstruction(addresses[symbol]);
+        }else{
+            word = encodeFixedInstruction(string_view(source.data() + program[index].offset, program[index].length));
+        }
+    }catch(const exception&){
+        ok = false;
+    }
+    failures -= failed[index];
+    failed[index] = ok ? 0 : 1;
+    failures += failed[index];
+    updateStats.instructionsEncoded++;
+    bool different = words[index] != word;
+    words[index] = word;
+    return different;
+}
+
+/*
+    IncrementalAssembler::collectDiagnostics()
+    Fills in the messages of an update that found errors by assembling the source in full.
+*/
+void IncrementalAssembler::collectDiagnostics(){
+    messages.clear();
+    if(!hasErrors()){
+        return;
+    }
+    Assembler assembler;
+    assembler.setSource(source, sourceName);
+    assembler.assemble();
+    messages = assembler.diagnostics();
+}
+
+/*
+    IncrementalAssembler::update(string text)
+    Brings the state up to date with a new version of the source.
+
+    Logic:
+    1. The common prefix and suffix of the old and new source bound the edit. The range is
+       widened to whole lines, in both versions: [begin, oldEnd) in the old source became
+       [begin, newEnd).
+    2. The statements of the old lines are removed from the use and definition counts;
+       the new lines are tokenized with `LineScanner` and their instructions classified.
+    3. The per-instruction arrays and the label list are spliced, and everything behind
+       the edit is shifted by the change in bytes, lines and instructions.
+    4. Label addresses come from the label list (the first definition wins, like the
+       first pass); variables are allocated from 16 in order of first use by scanning the
+       symbol ids, stopping as soon as every variable has its address.
+    5. The new instructions are encoded, plus every instruction outside the edit whose
+       symbol moved.
+*/
+bool IncrementalAssembler::update(string text){
+    updateStats = UpdateStats();
+    changed.clear();
+
+    size_t oldSize = source.size();
+    size_t newSize = text.size();
+    size_t prefix = commonPrefix(source, text);
+    if(prefix == oldSize && prefix == newSize){
+        tailStart = words.size();
+        return !hasErrors();
+    }
+    size_t suffix = commonSuffix(source, text, min(oldSize, newSize) - prefix);
+
+    size_t begin = prefix;
+    while(begin > 0 && source[begin - 1] != '\n'){
+        begin--;
+    }
+    // Both ends must start a line, also when the edit only inserted or only deleted text
+    size_t oldEnd = oldSize - suffix;
+    size_t newEnd = newSize - suffix;
+    while(oldEnd < oldSize && ((oldEnd > 0 && source[oldEnd - 1] != '\n') || (newEnd > 0 && text[newEnd - 1] != '\n'))){
+        oldEnd++;
+        newEnd++;
+    }
+
+    size_t first = firstAtOrAfter(program, begin);
+    size_t last = firstAtOrAfter(program, oldEnd);
+    size_t firstLabel = firstAtOrAfter(labels, begin);
+    size_t lastLabel = firstAtOrAfter(labels, oldEnd);
+    uint32_t firstLine = lineAt(begin);
+    uint32_t oldLines = static_cast<uint32_t>(count(source.begin() + begin, source.begin() + oldEnd, '\n'));
+    uint32_t newLines = static_cast<uint32_t>(count(text.begin() + begin, text.begin() + newEnd, '\n'));
+
+    for(size_t i = first; i < last; i++){
+        if(symbolOf[i] != NO_SYMBOL){
+            uses[symbolOf[i]]--;
+        }
+        failures -= failed[i];
+    }
+    for(size_t i = firstLabel; i < lastLabel; i++){
+        if(labels[i].symbol != NO_SYMBOL){
+            definitions[labels[i].symbol]--;
+        }
+    }
+
+    vector<Instruction> newProgram;
+    vector<uint32_t> newSymbols;
+    vector<LabelDefinition> newLabels;
+    LineScanner scanner(string_view(text).substr(begin, newEnd - begin));
+    Statement statement;
+    while(scanner.next(statement)){
+        string_view token = statement.text;
+        uint32_t offset = static_cast<uint32_t>(begin + statement.offset);
+        uint32_t line = firstLine + statement.line - 1;
+        if(token.front() == '(' && token.back() == ')'){
+            string_view label = token.substr(1, token.size() - 2);
+            // An empty or predefined name is never a valid definition; NO_SYMBOL counts as an error
+            uint32_t symbol = label.empty() || lookupPredefinedSymbol(label) >= 0 ? NO_SYMBOL : intern(label);
+            if(symbol != NO_SYMBOL){
+                definitions[symbol]++;
+            }
+            newLabels.push_back({symbol, offset, line, static_cast<uint32_t>(first + newProgram.size())});
+        }else{
+            uint32_t symbol = NO_SYMBOL;
+            if(isUserSymbol(token)){
+                symbol = intern(token.substr(1));
+                uses[symbol]++;
+            }
+            newProgram.push_back({offset, static_cast<uint32_t>(token.size()), line});
+            newSymbols.push_back(symbol);
+        }
+    }
+    updateStats.linesScanned = newLines + (newEnd > begin && text[newEnd - 1] != '\n' ? 1 : 0);
+    source = move(text);
+
+    vector<uint16_t> oldWords(words.begin() + first, words.begin() + last);
+    size_t inserted = newProgram.size();
+    splice(program, first, last, newProgram);
+    splice(symbolOf, first, last, newSymbols);
+    splice(failed, first, last, vector<uint8_t>(inserted, 0));
+    splice(words, first, last, vector<uint16_t>(inserted, 0));
+    splice(labels, firstLabel, lastLabel, newLabels);
+
+    uint32_t byteDelta = static_cast<uint32_t>(newEnd - oldEnd);                   // Modulo 2^32
+    uint32_t lineDelta = newLines - oldLines;
+    uint32_t instructionDelta = static_cast<uint32_t>(inserted - (last - first));
+    if(byteDelta != 0 || lineDelta != 0){
+        for(size_t i = first + inserted; i < program.size(); i++){
+            program[i].offset += byteDelta;
+            program[i].line += lineDelta;
+        }
+    }
+    for(size_t i = firstLabel + newLabels.size(); i < labels.size(); i++){
+        labels[i].offset += byteDelta;
+        labels[i].line += lineDelta;
+        labels[i].instruction += instructionDelta;
+    }
+
+    // Recompute every symbol's address and see which ones moved
+    vector<int> next(addresses.size(), -1);
+    duplicates = 0;
+    for(const LabelDefinition& label : labels){
+        if(label.symbol == NO_SYMBOL || next[label.symbol] >= 0){
+            duplicates++;
+        }else{
+            next[label.symbol] = static_cast<int>(label.instruction);
+        }
+    }
+    size_t variables = 0;
+    for(size_t symbol = 0; symbol < next.size(); symbol++){
+        variables += (definitions[symbol] == 0 && uses[symbol] > 0) ? 1 : 0;
+    }
+    int nextAvailableRamAddress = 16;
+    for(size_t i = 0; i < symbolOf.size() && variables > 0; i++){
+        uint32_t symbol = symbolOf[i];
+        if(symbol != NO_SYMBOL && next[symbol] < 0){
+            next[symbol] = nextAvailableRamAddress++;
+            variables--;
+        }
+    }
+    vector<uint8_t> moved(next.size(), 0);
+    size_t pending = 0;  // Uses of moved symbols outside the edit that still need encoding
+    for(size_t symbol = 0; symbol < next.size(); symbol++){
+        if(next[symbol] != addresses[symbol] && uses[symbol] > 0){
+            moved[symbol] = 1;
+            pending += uses[symbol];
+            updateStats.symbolsMoved++;
+        }
+    }
+    addresses.swap(next);
+
+    // Encode the new instructions and those whose symbol moved, noting the changed words
+    tailStart = inserted == last - first ? words.size() : first;
+    for(size_t i = first; i < first + inserted; i++){
+        if(symbolOf[i] != NO_SYMBOL && moved[symbolOf[i]]){
+            pending--;
+        }
+    }
+    auto reencodeMoved = [&](size_t from, size_t to){
+        for(size_t i = from; i < to && pending > 0; i++){
+            uint32_t symbol = symbolOf[i];
+            if(symbol != NO_SYMBOL && moved[symbol]){
+                pending--;
+                if(encode(i) && i < tailStart){
+                    changed.push_back(static_cast<uint32_t>(i));
+                }
+            }
+        }
+    };
+    reencodeMoved(0, first);
+    for(size_t i = first; i < first + inserted; i++){
+        encode(i);
+        if(i < tailStart && words[i] != oldWords[i - first]){
+            changed.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    reencodeMoved(first + inserted, words.size());
+
+    collectDiagnostics();
+    return !hasErrors();
+}
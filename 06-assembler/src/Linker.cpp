@@ -0,0 +1,90 @@
+/**
+ * @file Linker.cpp
+ * @brief Implementation of the linker.
+ *
+ * Linking is three linear passes over data the assembler already prepared:
+ * 1. Layout and labels: give every module its ROM base and define its labels there.
+ * 2. Externals: resolve each module's externals, in first-use order, to a label or a
+ *    newly allocated variable. Each name is looked up once per module, not once per use.
+ * 3. Patching: copy the words of every module into place and fix up its relocations and
+ *    references.
+ *
+ * No source text is touched, so linking a large program takes a few milliseconds.
+ */
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../include/Linker.h"
+#include "../include/BinCodes.h"
+
+using namespace std;
+
+/**
+ * @brief Appends a module to the program.
+ *
+ * @param name The name used in diagnostics.
+ * @param object The module.
+ */
+void Linker::addObject(string name, ObjectFile object){
+    modules.push_back({move(name), move(object), 0});
+}
+
+/**
+ * @brief Lays out the modules, resolves every symbol and patches the words.
+ *
+ * - The symbol table is rebuilt from scratch, so `link()` may be called again after
+ *   adding more modules.
+ * - A patched address that does not fit in an A-instruction (a label past ROM[32767]
+ *   or too many variables) is reported with the module and its word index, as the
+ *   assembler reports it for a single file.
+ *
+ * @return bool true if the program linked without errors.
+ */
+bool Linker::link(){
+    symbolTable = SymbolTable();
+    nextAvailableRamAddress = 16;
+    words.clear();
+    messages.clear();
+
+    size_t size = 0;
+    for(Module& module : modules){
+        module.base = static_cast<uint32_t>(size);
+        size += module.object.words.size();
+        for(const ObjectLabel& label : module.object.labels){
+            if(!symbolTable.addSymbol(label.name, static_cast<int>(module.base + label.address), SymbolKind::Label)){
+                messages.push_back(module.name + ": Duplicate label '" + label.name + "'");
+            }
+        }
+    }
+
+    words.reserve(size);
+    vector<int> resolved;
+    for(const Module& module : modules){
+        const ObjectFile& object = module.object;
+        resolved.clear();
+        for(const string& name : object.externals){
+            auto [address, added] = symbolTable.insert(name, nextAvailableRamAddress);
+            if(added){
+                nextAvailableRamAddress++;
+            }
+            resolved.push_back(address);
+        }
+
+        words.insert(words.end(), object.words.begin(), object.words.end());
+        uint16_t* code = words.data() + module.base;
+        auto patch = [&](uint32_t word, int address){
+            try{
+                code[word] = encodeAInstruction(address);
+            }catch(const exception& e){
+                messages.push_back(module.name + ": word " + to_string(word) + ": " + e.what());
+            }
+        };
+        for(uint32_t word : object.relocations){
+            patch(word, static_cast<int>(module.base + code[word]));
+        }
+        for(const ObjectReference& reference : object.references){
+            patch(reference.word, resolved[reference.external]);
+        }
+    }
+    return !hasErrors();
+}
@@ -0,0 +1,210 @@
+/**
+ * @file Machine.cpp
+ * @brief Implementation of the native Hack computer emulator.
+ *
+ * This file holds the machine state handling and the interpreter engine. The
+ * interpreter keeps PC, A and D in locals and reads ROM and RAM through raw pointers,
+ * so the compiler can hold the whole CPU state in registers. Every C-instruction is
+ * decoded on the fly: the ALU is evaluated with branch-free masks built from its six
+ * control bits, and the jump test compares the sign of the output against the three
+ * jump bits. The threaded engine lives in ThreadedEngine.cpp.
+ */
+#include <algorithm>
+#include <stdexcept>
+#include "../include/Machine.h"
+#include "../include/Parser.h"
+
+using namespace std;
+
+Machine::Machine(){
+    predecode();
+}
+
+void Machine::loadProgram(const vector<uint16_t>& words){
+    if(words.size() > ROM_SIZE){
+        throw runtime_error("Program has " + to_string(words.size()) + " instructions but the ROM holds "
+                            + to_string(ROM_SIZE));
+    }
+    rom.fill(0);
+    copy(words.begin(), words.end(), rom.begin());
+    programLength = words.size();
+    predecode();
+    clear();
+}
+
+void Machine::loadFile(const string& filename, SymbolTable* symbols){
+    string extension = filename.size() >= 4 ? filename.substr(filename.size() - 4) : "";
+    if(extension == ".asm"){
+        Assembler assembler;
+        assembler.loadFile(filename);
+        if(!assembler.assemble()){
+            string report;
+            for(const string& message : assembler.diagnostics()){
+                report += (report.empty() ? "" : "\n") + message;
+            }
+            throw runtime_error(report);
+        }
+        loadProgram(assembler.machineCode());
+        if(symbols){
+            *symbols = assembler.symbols();
+        }
+    }else{
+        loadProgram(readHackFile(filename));
+    }
+}
+
+void Machine::reset(){
+    programCounter = 0;
+    stopped = false;
+}
+
+void Machine::clear(){
+    ram.fill(0);
+    programCounter = 0;
+    registerA = 0;
+    registerD = 0;
+    cycleCount = 0;
+    stopped = false;
+}
+
+void Machine::setPC(uint16_t value){
+    programCounter = value & 0x7FFF;
+    stopped = false;
+}
+
+void Machine::poke(uint16_t address, uint16_t value){
+    address &= 0x7FFF;
+    if(address == KBD){
+        setKeyboard(value);
+    }else if(address < KBD){
+        ram[address] = value;
+    }
+}
+
+void Machine::setKeyboard(uint16_t key){
+    if(keyLog && key != ram[KBD]){
+        keyLog->push_back({cycleCount, key});
+    }
+    ram[KBD] = key;
+}
+
+void Machine::saveState(MachineState& state) const {
+    state.pc = programCounter;
+    state.a = registerA;
+    state.d = registerD;
+    state.halted = stopped;
+    state.cycles = cycleCount;
+    state.ram = ram;
+}
+
+void Machine::restoreState(const MachineState& state){
+    programCounter = state.pc & 0x7FFF;
+    registerA = state.a;
+    registerD = state.d;
+    stopped = state.halted;
+    cycleCount = state.cycles;
+    ram = state.ram;
+    // Nothing can be stored above the keyboard
+    fill(ram.begin() + KBD + 1, ram.end(), 0);
+}
+
+uint64_t Machine::run(uint64_t maxCycles){
+    if(profile){
+        return runInterpreter<true>(maxCycles);
+    }
+    return engine == Engine::Threaded ? runThreaded(maxCycles) : runInterpreter<false>(maxCycles);
+}
+
+/*
+ * Function: runInterpreter
+ * ------------------------
+ * Executes instructions with the classic fetch/decode/execute loop.
+ *
+ * Parameters:
+ *  - maxCycles: The most instructions to execute.
+ *
+ * Returns:
+ *  - The number of instructions executed.
+ *
+ * Logic:
+ *  - An A-instruction only loads A.
+ *  - A C-instruction reads M from the old A, computes the ALU output, writes M to the
+ *    old A (unless that is the keyboard or above), jumps to the old A if the condition
+ *    holds, and finally loads A and/or D, matching the clocking of CPU.hdl.
+ *  - A taken jump to the `@target` right before it, from an instruction that writes
+ *    no register, can never change the machine state again, so the machine halts there.
+ *  - The machine also halts when PC leaves the loaded program, instead of running on
+ *    through the empty ROM and wrapping around to address 0.
+ *  - The Profiled instantiation also counts every executed address and every access to
+ *    M in the attached profile; the other compiles to the plain loop.
+ */
+template <bool Profiled>
+uint64_t Machine::runInterpreter(uint64_t maxCycles){
+    if(stopped){
+        return 0;
+    }
+    const uint16_t* code = rom.data();
+    uint16_t* memory = ram.data();
+    uint16_t pc = programCounter;
+    uint16_t a = registerA;
+    uint16_t d = registerD;
+
+    const size_t end = programLength;
+
+    uint64_t executed = 0;
+    while(executed < maxCycles){
+        if(pc >= end){
+            stopped = true;
+            break;
+        }
+        uint16_t instruction = code[pc];
+        executed++;
+        if constexpr(Profiled){
+            profile->executions[pc]++;
+        }
+        if(!(instruction & 0x8000)){
+            a = instruction;
+            pc = (pc + 1) & 0x7FFF;
+            continue;
+        }
+
+        uint16_t address = a & 0x7FFF;
+        uint16_t y = (instruction & 0x1000) ? memory[address] : a;
+        if constexpr(Profiled){
+            profile->reads[address] += (instruction >> 12) & 1;
+            profile->writes[address] += (instruction >> 3) & 1;
+        }
+        uint16_t out = hackAlu(d, y, (instruction >> 6) & 0x3F);
+        if((instruction & 0x0008) && address < KBD){
+            memory[address] = out;
+        }
+        uint16_t next = (pc + 1) & 0x7FFF;
+        if(hackJump(out, instruction & 0x7)){
+            if(address + 1 == pc && code[address] == address && !(instruction & 0x0038)
+               && !((instruction & 0x1000) && address == KBD)){
+                pc = address;
+                stopped = true;
+                break;
+            }
+            next = address;
+        }
+        if(instruction & 0x0020){
+            a = out;
+        }
+        if(instruction & 0x0010){
+            d = out;
+        }
+        pc = next;
+    }
+
+    programCounter = pc;
+    registerA = a;
+    registerD = d;
+    cycleCount += executed;
+    return executed;
+}
+
+bool Machine::step(){
+    run(1);
+    return !stopped;
+}
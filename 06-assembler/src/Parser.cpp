@@ -8,193 +8,625 @@
  * 
  * Key Components:
  * - Two-pass parsing algorithm
- * - Symbol table management
+ * - Per-assembly state (symbol table, RAM allocator, diagnostics) in the `Assembler` class
  * - Instruction translation (A-instructions and C-instructions)
+ * - An optional peephole pass between the two passes (`Assembler::optimize`)
+ * - Optional statistics (`Assembler::setStats`), compiled into a separate copy of the
+ *   first pass so the default path carries no counters
  * 
- * The parser reads an input .asm file, processes it line by line, and outputs
- * the corresponding machine code to a .hack file.
+ * The `Assembler` class reads an input .asm file into memory once, tokenizes it into a compact
+ * instruction vector, and outputs the corresponding machine code to a .hack file.
  */
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <algorithm>
-#include <sstream>
+#include <chrono>
+#include <stdexcept>
 #include "../include/Parser.h"
 #include "../include/SymbolTables.h"
 #include "../include/BinCodes.h"
+#include "../include/HackFile.h"
+#include "../include/ThreadPool.h"
+#include "../include/Scanner.h"
 
 using namespace std;
 
 /**
- * @brief Trims (removes) leading and trailing whitespace from a string.
- * 
- * This function eliminates extra spaces at the beginning and end of a line to ensure
- * consistent parsing and tokenization. Internal spaces are preserved to ensure tokens 
- * are not altered.
+ * @brief Reads the whole assembly file into memory with a single bulk read.
  * 
  * Key Components:
- * - `size_t`: A type used for non-negative indexing. It is commonly used for array indices
- *   and is an unsigned integer type that can vary depending on the system.
- * - `npos`: A constant representing "no position." It is returned when a search function
- *   (like `find_first_not_of`) does not find the specified character, signifying no match.
- * 
- * @param line The input string to be trimmed.
- * @return string A new string with leading and trailing whitespace removed.
- */
-string trim(string line){
-    size_t first = line.find_first_not_of(' ');
-    if(first == string::npos) return "";  // If the string is all spaces, return an empty string
-    size_t last = line.find_last_not_of(' ');
-    return line.substr(first, last - first + 1);  // Extract and return the substring from first to last non-space
+ * - `ios::binary`: Prevents any newline translation, so offsets match the bytes on disk.
+ * - `seekg(0, ios::end)` + `tellg()`: Measures the file so the buffer is sized once.
+ * - `read()`: Copies the complete file in one call instead of line-by-line `getline`.
+ * 
+ * @param filename The name of the input assembly file (.asm).
+ * @return string The complete file contents.
+ */
+string loadSource(const string& filename){
+    ifstream file(filename, ios::binary);
+    if(!file.is_open()){
+        throw runtime_error("Error opening file: " + filename);
+    }
+
+    file.seekg(0, ios::end);
+    streamoff size = file.tellg();
+    file.seekg(0, ios::beg);
+
+    string source(static_cast<size_t>(size), '\0');
+    if(size > 0 && !file.read(&source[0], size)){
+        throw runtime_error("Error reading file: " + filename);
+    }
+    return source;
 }
 
 /**
- * @brief Parses the assembly file line-by-line, processing labels and translating instructions.
+ * @brief Reads the source of the program from a file.
  * 
- * This function executes a two-pass process:
+ * @param filename The name of the input assembly file (.asm).
+ */
+void Assembler::loadFile(const string& filename){
+    if(!statistics){
+        setSource(loadSource(filename), filename);
+        return;
+    }
+    auto start = chrono::steady_clock::now();
+    setSource(loadSource(filename), filename);
+    statistics->loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Uses an in-memory string as the source of the program.
  * 
- * - First Pass: 
- *   1. Reads each line of the input file.
- *   2. Identifies and processes labels (e.g., `(LOOP)`).
- *   3. Stores labels in the symbol table with their corresponding ROM address.
+ * Any state left over from a previous program is discarded, so one `Assembler`
+ * can be reused for many programs in a long-lived process.
  * 
- * - Second Pass:
- *   1. Rereads the file from the beginning.
- *   2. Processes A-instructions and C-instructions.
- *   3. Translates instructions into binary format.
- *   4. Handles variable symbols, assigning them to available RAM addresses.
- *   5. Writes the translated binary code to the output file.
+ * @param text The complete assembly source.
+ * @param name The name used in diagnostics.
+ */
+void Assembler::setSource(string text, string name){
+    source = move(text);
+    sourceName = move(name);
+    program.clear();
+    symbolTable = SymbolTable();
+    nextAvailableRamAddress = 16;
+    words.clear();
+    objectCode = ObjectFile();
+    messages.clear();
+}
+
+/**
+ * @brief Records an error for the given source line.
  * 
- * Key Components:
- * - `ifstream`: Input file stream for reading the assembly file.
- * - `ofstream`: Output file stream for writing the machine code.
- * - `getline()`: Reads the file line-by-line.
- * - `seekg()`: Repositions the file pointer for the second pass.
+ * @param line The 1-based source line.
+ * @param message What went wrong.
+ */
+void Assembler::error(uint32_t line, const string& message){
+    messages.push_back(diagnostic(line, message));
+}
+
+/**
+ * @brief Formats a diagnostic as "file:line: message".
  * 
- * @param filename The name of the input assembly file (.asm).
+ * @param line The 1-based source line.
+ * @param message What went wrong.
+ * @return string The formatted diagnostic.
  */
-void parse(string filename){
-    string line;  // Holds each line of code from the file
-    ifstream file(filename);  // Open the input file for reading
-    string outputFilename = filename.substr(0, filename.find_last_of(".")) + ".hack";
-    ofstream output(outputFilename);  // Open the output file for writing
+string Assembler::diagnostic(uint32_t line, const string& message) const{
+    return sourceName + ":" + to_string(line) + ": " + message;
+}
 
-    // Check if the input file opened successfully
-    if(!file.is_open()){
-        cerr<<"Error opening file: "<<filename<<endl;
-        return;
+/**
+ * @brief First pass: tokenize the buffer and add labels to the symbol table.
+ * 
+ * This pass identifies labels within parentheses (e.g., `(LOOP)`). Labels represent 
+ * memory addresses in the ROM, so each label is assigned the ROM address where it is 
+ * encountered. Every other statement is an instruction and is recorded as an
+ * `Instruction` (offset + length) into the source buffer, so the second pass never
+ * has to strip comments or trim whitespace again.
+ * 
+ * - `LineScanner` yields the statements with comments and blanks (spaces, tabs, the '\r'
+ *   of CRLF line endings) already removed, using SIMD to classify 64 bytes at a time.
+ * - The ROM address of a label is simply the number of instructions recorded so far.
+ * - A label that is already defined (or is a predefined symbol) is reported as an error.
+ * - With statistics enabled, the counting copy of the loop (`scanSource<true>`) runs instead.
+ */
+void Assembler::firstPass(){
+    if(statistics){
+        scanSource<true>();
+    }else{
+        scanSource<false>();
     }
+}
+
+/**
+ * @brief The loop of the first pass, instantiated with and without counters.
+ * 
+ * The counters live in locals while the loop runs and are stored in `statistics` once at
+ * the end; `if constexpr` removes them entirely from the `Counting = false` copy.
+ * 
+ * @tparam Counting Whether to count labels and instructions for `AssemblyStats`.
+ */
+template<bool Counting>
+void Assembler::scanSource(){
+    LineScanner scanner(source);
+    Statement statement;
+    size_t labels = 0, aInstructions = 0, symbolReferences = 0;
+    while(scanner.next(statement)){
+        string_view text = statement.text;
 
-    /** 
-     * First Pass: Add labels to the symbol table with ROM addresses.
-     * 
-     * This pass identifies labels within parentheses (e.g., `(LOOP)`). Labels represent 
-     * memory addresses in the ROM, so each label is assigned the ROM address where it is 
-     * encountered.
-     * 
-     * - `romAddress` represents the current position in ROM (line number of actual instructions).
-     * - If a line is a label, we add it to `symbolTable` with the current `romAddress` and
-     *   do not increment `romAddress`.
-     */
-    int romAddress = 0;  // Initialize the ROM address counter
-    while(getline(file, line)){  // Read each line of the file
-        size_t commentPosition = line.find("//");  // Find the start of any inline comment
-        if(commentPosition != string::npos){
-            line = line.substr(0, commentPosition);  // Remove comments by taking only the text before "//"
+        // Label Detection: A label is enclosed in parentheses, e.g., "(LOOP)"
+        if(text.front() == '(' && text.back() == ')'){
+            // Labels don't take up ROM, so the next instruction's index is the label's address
+            string_view label = text.substr(1, text.size() - 2);
+            if(label.empty()){
+                error(statement.line, "Empty label '()'");
+            }else if(!symbolTable.addSymbol(label, static_cast<int>(program.size()), SymbolKind::Label)){
+                error(statement.line, "Duplicate label '" + string(label) + "'");
+            }
+            if constexpr(Counting){
+                labels++;
+            }
+        }else{
+            program.push_back({statement.offset, static_cast<uint32_t>(text.size()), statement.line});
+            if constexpr(Counting){
+                if(text[0] == '@'){
+                    aInstructions++;
+                    symbolReferences += text.size() > 1 && !isdigit(static_cast<unsigned char>(text[1]));
+                }
+            }
         }
+    }
 
-        line = trim(line);  // Trim whitespace from the line
+    if constexpr(Counting){
+        statistics->bytes = source.size();
+        statistics->lines = static_cast<size_t>(count(source.begin(), source.end(), '\n'))
+                          + (!source.empty() && source.back() != '\n');
+        statistics->labels = labels;
+        statistics->aInstructions = aInstructions;
+        statistics->cInstructions = program.size() - aInstructions;
+        statistics->symbolReferences = symbolReferences;
+    }
+}
 
-        if(line.empty()){
-            continue;  // Skip empty lines
+/**
+ * @brief Peephole optimization between the two passes: removes instructions that do
+ *        not change what the program computes, then moves the labels accordingly.
+ * 
+ * The instructions are walked in order while tracking what the A register is known to
+ * hold; every label ends that knowledge, since it may be entered by a jump. Each walk
+ * removes:
+ * - A reload `@X` while A already holds X (constants, predefined symbols and variables
+ *   are compared by address, labels by identity).
+ * - A load `@X` directly followed by another A-instruction, which overwrites it unused.
+ * - A jump without a destination (e.g. `0;JMP` or `D;JEQ`) whose target, a label just
+ *   loaded into A, is the next instruction anyway.
+ * - `D=M` directly after `M=D`: D already holds that value.
+ * - Unreachable instructions between an unconditional jump and the next label.
+ * 
+ * Removals can enable each other (e.g. a removed jump leaves its `@LABEL` dead), so the
+ * walk is repeated until nothing changes. Then every label gets the number of remaining
+ * instructions before its old address.
+ * 
+ * - Variables are allocated first, in order of first use in the unoptimized program,
+ *   so removing a use never moves a variable.
+ * - Instructions that would be reported as errors are never removed, and nothing is
+ *   done if the first pass found errors.
+ * - Removing instructions shifts ROM addresses, which is only safe if code addresses come
+ *   from labels. If any jump targets a numeric address (`@100` then `0;JMP`), the
+ *   program is left unchanged.
+ * 
+ * @return size_t The number of instructions removed.
+ */
+size_t Assembler::optimize(){
+    removed = 0;
+    if(program.empty() || hasErrors()){
+        return 0;
+    }
+    allocateVariables();
+
+    // A-instructions are keyed by value; labels by their original address plus LABEL_KEY
+    const int64_t UNKNOWN = -1, LABEL_KEY = int64_t(1) << 32;
+    enum Kind : uint8_t { A, C, INVALID };
+    size_t count = program.size();
+    vector<Kind> kinds(count);
+    vector<int64_t> keys(count, UNKNOWN);
+    vector<uint8_t> isLabel(count + 1, 0);  // A label names this index
+    vector<SymbolEntry> labels = symbolTable.entries(SymbolKind::Label);
+    SymbolTable labelTable;  // Name -> address, labels only
+    for(const SymbolEntry& label : labels){
+        isLabel[static_cast<size_t>(label.address)] = 1;
+        labelTable.addSymbol(label.name, label.address, SymbolKind::Label);
+    }
+    auto text = [&](size_t i){ return string_view(source.data() + program[i].offset, program[i].length); };
+    for(size_t i = 0; i < count; i++){
+        string_view line = text(i);
+        try{
+            encodeInstruction(line, false);
+        }catch(const exception&){
+            kinds[i] = INVALID;
+            continue;
         }
+        if(line[0] != '@'){
+            kinds[i] = C;
+            continue;
+        }
+        kinds[i] = A;
+        if(isdigit(static_cast<unsigned char>(line[1]))){
+            keys[i] = translateAInstruction(line);
+            continue;
+        }
+        string_view symbol = line.substr(1);
+        int label = lookupPredefinedSymbol(symbol) < 0 ? labelTable.getSymbolAddress(symbol) : -1;
+        keys[i] = label >= 0 ? LABEL_KEY + label : symbolTable.getSymbolAddress(symbol);
+    }
 
-        // Label Detection: A label is enclosed in parentheses, e.g., "(LOOP)"
-        // If the first character of the string is '(' and the final is ')', after removing comments and whitespace, then it is a label.
-        if(line[0] == '(' && line.back() == ')'){
-            // Extract the label name by removing the parentheses
-            // `substr(1, line.size() - 2)` takes a substring starting from the second character up to the second-to-last character.
-            // This removes the outer parentheses from the label.
-            string label = line.substr(1, line.size() - 2);  
-            
-            // `addSymbol` stores the label and its associated ROM address in `symbolTable`.
-            // The label name is used as the key, and the current `romAddress` is the value. 
-            // Since labels don't represent executable instructions, the address counter is not incremented.
-            addSymbol(label, romAddress);
-        }else{
-            // `romAddress` is only incremented for actual instructions, not labels.
-            // This ensures that labels themselves don’t take up memory addresses in ROM.
-            romAddress++;
+    auto cFields = [&](size_t i, string_view& dest, string_view& jump){
+        string_view line = text(i);
+        size_t equalSign = line.find('='), semicolon = line.find(';');
+        dest = equalSign == string_view::npos ? string_view() : line.substr(0, equalSign);
+        jump = semicolon == string_view::npos ? string_view() : line.substr(semicolon + 1);
+    };
+
+    vector<uint8_t> gone(count, 0);
+    bool changed = true;
+    bool first = true;
+    while(changed){
+        changed = false;
+        int64_t a = UNKNOWN;          // What A holds, if known
+        size_t previous = SIZE_MAX;   // The previous remaining instruction, if no label lies between
+        bool reachable = true;
+        for(size_t i = 0; i < count; i++){
+            if(isLabel[i]){
+                a = UNKNOWN;
+                previous = SIZE_MAX;
+                reachable = true;
+            }
+            if(gone[i]){
+                continue;
+            }
+            if(!reachable && kinds[i] != INVALID){
+                gone[i] = 1;
+                changed = true;
+                continue;
+            }
+            if(kinds[i] == A){
+                if(keys[i] != UNKNOWN && keys[i] == a){
+                    gone[i] = 1;  // Redundant reload
+                    changed = true;
+                    continue;
+                }
+                if(previous != SIZE_MAX && kinds[previous] == A){
+                    gone[previous] = 1;  // Overwritten before use
+                    changed = true;
+                }
+                a = keys[i];
+                previous = i;
+                continue;
+            }
+            if(kinds[i] == INVALID){
+                a = UNKNOWN;
+                previous = SIZE_MAX;
+                continue;
+            }
+
+            string_view dest, jump;
+            cFields(i, dest, jump);
+            if(!jump.empty()){
+                if(first && a != UNKNOWN && a < LABEL_KEY){
+                    removed = 0;  // A jump to a numeric address: code must not move
+                    return 0;
+                }
+                if(dest.empty() && a >= LABEL_KEY){
+                    size_t target = static_cast<size_t>(a - LABEL_KEY);
+                    size_t next = i + 1;
+                    while(next < target && gone[next]){
+                        next++;
+                    }
+                    if(next == target){
+                        gone[i] = 1;  // Jump to the next instruction
+                        changed = true;
+                        continue;
+                    }
+                }
+            }
+            if(previous != SIZE_MAX && text(i) == "D=M" && text(previous) == "M=D"){
+                gone[i] = 1;  // D already holds M
+                changed = true;
+                continue;
+            }
+            if(dest.find('A') != string_view::npos){
+                a = UNKNOWN;
+            }
+            if(jump == "JMP"){
+                reachable = false;
+            }
+            previous = i;
         }
+        first = false;
     }
 
-    /**
-     * File Handling for the Second Pass:
-     * - The file has an "internal pointer" that tracks where reading is occurring. 
-     *   Once the first pass completes, this pointer is at the end of the file.
-     * 
-     * - `seekg(0, ios::beg)`: The `seekg` function moves the file pointer back to a 
-     *   specific position. The arguments here, `0` and `ios::beg`, tell the file to 
-     *   start reading again from the beginning.
-     *     - `ios::beg` represents the beginning of the file, allowing a full re-read.
-     * 
-     * - `clear()`: This function clears any flags that were set during the first read 
-     *   (like the end-of-file flag, which would prevent further reading).
-     */
-    file.clear();
-    file.seekg(0, ios::beg);  // Reset file position for the second pass
-
-    /**
-     * Second Pass: Process A-instructions and C-instructions, resolve symbols, and translate.
-     * 
-     * - `nextAvailableRamAddress` starts at 16 because the Hack assembly reserves
-     *   addresses 0–15 for predefined symbols. User-defined symbols start at RAM[16].
-     * - 'anotherInstruction' Tracks if there's another instruction; newline control.
-     */
-    int nextAvailableRamAddress = 16;
-    bool anotherInstruction = true;
-
-    while(getline(file, line)){  // Read each line again from the beginning
-        size_t commentPosition = line.find("//");  // Find the start of any comment
-        if(commentPosition != string::npos){
-            line = line.substr(0, commentPosition);  // Strip the comment
+    // Compact the instructions; `before[k]` is the number that remain before old index k
+    vector<uint32_t> before(count + 1, 0);
+    size_t kept = 0;
+    for(size_t i = 0; i < count; i++){
+        before[i] = static_cast<uint32_t>(kept);
+        if(!gone[i]){
+            program[kept++] = program[i];
         }
+    }
+    before[count] = static_cast<uint32_t>(kept);
+    removed = count - kept;
+    program.resize(kept);
+    if(removed == 0){
+        return 0;
+    }
 
-        line = trim(line);  // Remove leading/trailing spaces
+    SymbolTable moved;
+    for(const SymbolEntry& label : labels){
+        moved.addSymbol(label.name, static_cast<int>(before[static_cast<size_t>(label.address)]), SymbolKind::Label);
+    }
+    for(const SymbolEntry& variable : symbolTable.entries(SymbolKind::Variable)){
+        moved.addSymbol(variable.name, variable.address, SymbolKind::Variable);
+    }
+    symbolTable = move(moved);
+    return removed;
+}
 
-        // Skip empty lines and labels (labels were processed in the first pass)
-        if(line.empty() || (line[0] == '(' && line.back() == ')')){
-            continue;
+/**
+ * @brief Encodes one instruction from the instruction vector.
+ * 
+ * - C-instructions, and A-instructions with a decimal value or a predefined symbol, are
+ *   encoded directly by `encodeFixedInstruction`.
+ * - A-instructions with a user symbol use the symbol's address. An unknown symbol is a new
+ *   variable: with `allocate` it gets the next available RAM address, otherwise the
+ *   variables must already have been allocated by `allocateVariables`.
+ * 
+ * @param line The instruction text, without comments or surrounding blanks.
+ * @param allocate Whether unknown symbols may be allocated as variables.
+ * @return uint16_t The encoded instruction.
+ * @throws std::runtime_error If the instruction cannot be encoded.
+ */
+uint16_t Assembler::encodeInstruction(string_view line, bool allocate){
+    // C-instructions, constants and predefined symbols (e.g., "D=M+1", "@2" or "@SCREEN")
+    if(!isUserSymbol(line)){
+        return encodeFixedInstruction(line);
+    }
+    // Otherwise, it's a user-defined symbol (e.g., "@LOOP")
+    string_view symbol = line.substr(1);  // View of the symbol after '@', no copy
+    if(allocate){
+        // Look the symbol up and, if it is new, give it the next available RAM address in one probe
+        auto [address, added] = symbolTable.insert(symbol, nextAvailableRamAddress);
+        if(added){
+            nextAvailableRamAddress++;
         }
+        return encodeAInstruction(address);
+    }
+    int address = symbolTable.getSymbolAddress(symbol);
+    if(address == -1){
+        throw logic_error("Variable '" + string(symbol) + "' was not allocated");
+    }
+    return encodeAInstruction(address);
+}
+
+/**
+ * @brief Second pass: process A-instructions and C-instructions, resolve symbols, and translate.
+ * 
+ * - `nextAvailableRamAddress` starts at 16 because the Hack assembly reserves
+ *   addresses 0–15 for predefined symbols. User-defined symbols start at RAM[16].
+ * - `words` receives one encoded instruction per entry; it is sized up front because
+ *   the first pass already counted the instructions.
+ * - An instruction that cannot be encoded is reported and encoded as 0, so that all
+ *   errors of a program are collected in one run.
+ */
+void Assembler::secondPass(){
+    words.clear();
+    words.reserve(program.size());
+
+    for(const Instruction& instruction : program){
+        string_view line(source.data() + instruction.offset, instruction.length);
 
-        // For each instruction after the first, add a newline before writing
-        if(!anotherInstruction){
-            output<<endl;
+        uint16_t word = 0;
+        try{
+            word = encodeInstruction(line, true);
+        }catch(const exception& e){
+            error(instruction.line, e.what());
         }
-        anotherInstruction = false; // After first line, subsequent lines will start with a newline
-
-        // Process A-instructions (e.g., "@2" or "@LOOP")
-        if(line[0] == '@'){
-            string symbol = line.substr(1);  // Extract the symbol after '@'
-            int address;
-            if(isdigit(symbol[0])){  // If the symbol is a number, directly convert to an integer
-                address = stoi(symbol);  // Convert numeric address to integer
-            }else{  // Otherwise, it's a user-defined symbol or predefined variable
-                address = getSymbolAddress(symbol);  // Look up the symbol in the symbol table
-                if(address == -1){  // If symbol is not found in the table
-                    address = nextAvailableRamAddress++;  // Assign it the next available RAM address
-                    addSymbol(symbol, address);  // Add the new symbol to the symbol table
-                }
+
+        words.push_back(word);
+    }
+}
+
+/**
+ * @brief Assigns RAM addresses to all variables, in order of first use.
+ * 
+ * This is the only order-dependent part of the second pass. Scanning the A-instructions
+ * once, in program order, gives every variable exactly the address the serial second
+ * pass would give it; afterwards the symbol table is only read.
+ */
+void Assembler::allocateVariables(){
+    for(const Instruction& instruction : program){
+        const char* text = source.data() + instruction.offset;
+        if(text[0] != '@' || instruction.length < 2 || isdigit(static_cast<unsigned char>(text[1]))){
+            continue;  // Not a symbolic A-instruction
+        }
+        if(symbolTable.insert(string_view(text + 1, instruction.length - 1), nextAvailableRamAddress).second){
+            nextAvailableRamAddress++;
+        }
+    }
+}
+
+/**
+ * @brief Second pass spread over a thread pool.
+ * 
+ * After `allocateVariables` the symbol table is read-only, so every instruction can be
+ * encoded independently. The instruction vector is cut into ranges; each range is
+ * encoded by one task straight into its slice of the preallocated `words`. Errors are
+ * collected per range and merged in range order, so diagnostics also match the serial pass.
+ * 
+ * @param pool The pool that encodes the ranges.
+ */
+void Assembler::secondPass(ThreadPool& pool){
+    if(program.size() < PARALLEL_MIN_INSTRUCTIONS || pool.size() < 2){
+        secondPass();
+        return;
+    }
+
+    allocateVariables();
+    words.assign(program.size(), 0);
+
+    // A few ranges per worker lets work stealing even out uneven ranges
+    size_t chunkSize = max<size_t>(PARALLEL_MIN_INSTRUCTIONS / 4, program.size() / (4 * pool.size()) + 1);
+    vector<vector<string>> rangeErrors((program.size() + chunkSize - 1) / chunkSize);
+
+    pool.parallelFor(program.size(), chunkSize, [&](size_t begin, size_t end){
+        vector<string>& errors = rangeErrors[begin / chunkSize];
+        for(size_t i = begin; i < end; i++){
+            const Instruction& instruction = program[i];
+            try{
+                words[i] = encodeInstruction(string_view(source.data() + instruction.offset, instruction.length), false);
+            }catch(const exception& e){
+                errors.push_back(diagnostic(instruction.line, e.what()));
+            }
+        }
+    });
+
+    for(const vector<string>& errors : rangeErrors){
+        messages.insert(messages.end(), errors.begin(), errors.end());
+    }
+}
+
+/**
+ * @brief Runs both passes over the loaded source.
+ * 
+ * @param pool If given, the second pass is spread over this pool.
+ * @param optimized Run `optimize()` between the passes.
+ * @return bool true if the program assembled without errors.
+ */
+bool Assembler::assemble(ThreadPool* pool, bool optimized){
+    // The clock is only read when statistics are collected
+    auto lap = [this, last = chrono::steady_clock::time_point()](double AssemblyStats::*phase) mutable {
+        if(statistics){
+            auto now = chrono::steady_clock::now();
+            if(phase){
+                statistics->*phase = chrono::duration<double>(now - last).count();
             }
-            output<<translateAInstruction("@" + to_string(address));  // Translate A-instruction
+            last = now;
+        }
+    };
 
-        }else{
-            // Process C-instructions (e.g., "D=M+1")
-            output<<translateCInstruction(line);  // Translate C-instruction
+    lap(nullptr);
+    firstPass();
+    lap(&AssemblyStats::firstPassSeconds);
+    if(optimized){
+        optimize();
+        lap(&AssemblyStats::optimizeSeconds);
+    }
+    if(pool != nullptr){
+        secondPass(*pool);
+    }else{
+        secondPass();
+    }
+    lap(&AssemblyStats::secondPassSeconds);
+
+    if(statistics){
+        statistics->variables = static_cast<size_t>(nextAvailableRamAddress - 16);
+        statistics->highestVariable = nextAvailableRamAddress > 16 ? nextAvailableRamAddress - 1 : -1;
+        statistics->words = words.size();
+        statistics->removed = removed;
+    }
+    return !hasErrors();
+}
+
+/**
+ * @brief Assembles the source into a relocatable module.
+ * 
+ * - The labels found by the first pass are exported with their module-relative address.
+ * - `@LABEL` of one of those labels is encoded with the relative address and recorded as
+ *   a relocation; predefined symbols and constants are final and encoded directly.
+ * - Any other symbol becomes an external, numbered in order of first use, and its
+ *   instructions are recorded as references (encoded as 0 until linked). Numbering in
+ *   first-use order lets the linker allocate variables in exactly the order `assemble()`
+ *   would for the concatenated program.
+ * 
+ * @return bool true if the module assembled without errors.
+ */
+bool Assembler::compile(){
+    firstPass();
+    objectCode = ObjectFile();
+    for(const SymbolEntry& label : symbolTable.entries(SymbolKind::Label)){
+        objectCode.labels.push_back({string(label.name), static_cast<uint32_t>(label.address)});
+    }
+
+    SymbolTable externals;  // External name -> index into objectCode.externals
+    vector<uint16_t>& code = objectCode.words;
+    code.assign(program.size(), 0);
+    for(size_t i = 0; i < program.size(); i++){
+        const Instruction& instruction = program[i];
+        string_view line(source.data() + instruction.offset, instruction.length);
+        try{
+            if(!isUserSymbol(line)){
+                code[i] = encodeFixedInstruction(line);
+                continue;
+            }
+            string_view symbol = line.substr(1);
+            int address = symbolTable.getSymbolAddress(symbol);
+            if(address >= 0){
+                code[i] = encodeAInstruction(address);
+                objectCode.relocations.push_back(static_cast<uint32_t>(i));
+                continue;
+            }
+            auto [index, added] = externals.insert(symbol, static_cast<int>(objectCode.externals.size()));
+            if(added){
+                objectCode.externals.emplace_back(symbol);
+            }
+            objectCode.references.push_back({static_cast<uint32_t>(i), static_cast<uint32_t>(index)});
+        }catch(const exception& e){
+            error(instruction.line, e.what());
+        }
+    }
+    return !hasErrors();
+}
+
+/**
+ * @brief Parses the assembly file, processing labels and translating instructions.
+ * 
+ * This function executes a two-pass process on a fresh `Assembler`:
+ * 
+ * - First Pass (`Assembler::firstPass`):
+ *   1. Splits the in-memory source into lines.
+ *   2. Identifies and processes labels (e.g., `(LOOP)`).
+ *   3. Records the position of every instruction in a compact vector.
+ * 
+ * - Optionally, the peephole pass (`Assembler::optimize`) removes instructions and
+ *   moves the labels.
+ * 
+ * - Second Pass (`Assembler::secondPass`):
+ *   1. Walks the instruction vector (no second disk read).
+ *   2. Translates instructions into binary format.
+ *   3. Handles variable symbols, assigning them to available RAM addresses.
+ * 
+ * The encoded words are then written to the output file in one go. If any error was
+ * reported, no output is written and all diagnostics are thrown together.
+ * 
+ * @param filename The name of the input assembly file (.asm).
+ * @param format The format of the .hack file to write.
+ * @param optimized Run the peephole pass between the passes.
+ */
+void parse(string filename, OutputFormat format, bool optimized){
+    Assembler assembler;
+    assembler.loadFile(filename);  // Single bulk read of the input file
+
+    if(!assembler.assemble(nullptr, optimized)){
+        string report;
+        for(const string& message : assembler.diagnostics()){
+            report += (report.empty() ? "" : "\n") + message;
         }
+        throw runtime_error(report);
     }
 
-    // Close input and output files
-    file.close();
-    output.close();
+    // The whole image is rendered in memory and written at once; text is only produced here
+    string outputFilename = filename.substr(0, filename.find_last_of(".")) + ".hack";
+    writeHackFile(outputFilename, assembler.machineCode(), format);
 }
@@ -0,0 +1,226 @@
+/**
+ * @file Profiler.cpp
+ * @brief Implementation of the profile reports.
+ *
+ * The counting itself happens in `Machine::runInterpreter<true>`; this file only sorts
+ * and formats the counters. Everything is derived from the per-address counts, so a
+ * profile can be reported in any number of ways after a single run.
+ */
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+#include "../include/Profiler.h"
+
+using namespace std;
+
+namespace {
+
+/*
+    The RAM regions of the Hack platform, as used by the VM translator and the OS.
+*/
+struct RamRegion {
+    const char* name;
+    uint16_t begin;
+    uint16_t end;
+};
+
+const RamRegion RAM_REGIONS[] = {
+    {"Registers R0-R15 (0-15)", 0, 16},
+    {"Variables (16-255)", 16, 256},
+    {"Stack (256-2047)", 256, 2048},
+    {"Heap (2048-16383)", 2048, 16384},
+    {"SCREEN (16384-24575)", 16384, 24576},
+    {"KBD (24576)", 24576, 24577}
+};
+
+const char* const REGISTER_NAMES[16] = {
+    "R0/SP", "R1/LCL", "R2/ARG", "R3/THIS", "R4/THAT", "R5", "R6", "R7",
+    "R8", "R9", "R10", "R11", "R12", "R13", "R14", "R15"
+};
+
+string percent(uint64_t count, uint64_t total){
+    ostringstream text;
+    text<<fixed<<setprecision(2)<<(total ? 100.0 * count / total : 0.0)<<'%';
+    return text.str();
+}
+
+// The range containing `address`; ranges are sorted and cover the program
+const LabelRange* rangeOf(const vector<LabelRange>& labels, uint16_t address){
+    auto it = upper_bound(labels.begin(), labels.end(), address,
+                          [](uint16_t value, const LabelRange& range){ return value < range.begin; });
+    if(it == labels.begin()){
+        return nullptr;
+    }
+    --it;
+    return address < it->end ? &*it : nullptr;
+}
+
+string location(const vector<LabelRange>& labels, uint16_t address){
+    const LabelRange* range = rangeOf(labels, address);
+    if(range == nullptr){
+        return "<outside>";
+    }
+    return address == range->begin ? range->name : range->name + "+" + to_string(address - range->begin);
+}
+
+string ramName(const SymbolTable& symbols, uint16_t address){
+    if(address < 16){
+        return REGISTER_NAMES[address];
+    }
+    if(address == Machine::KBD){
+        return "KBD";
+    }
+    if(address >= Machine::SCREEN && address < Machine::KBD){
+        return "SCREEN+" + to_string(address - Machine::SCREEN);
+    }
+    string names;
+    for(const SymbolEntry& entry : symbols.entries(SymbolKind::Variable)){
+        if(entry.address == address){
+            names += (names.empty() ? "" : "/") + string(entry.name);
+        }
+    }
+    return names;
+}
+
+// Frame names must not contain the separators of the collapsed format
+string frame(string name){
+    replace(name.begin(), name.end(), ';', '_');
+    replace(name.begin(), name.end(), ' ', '_');
+    return name;
+}
+
+} // namespace
+
+/*
+ * Function: labelRanges
+ * ---------------------
+ * Logic:
+ *  - Labels are taken in address order; labels that share an address share a range.
+ *  - Labels at or past the end of the program (e.g. a final `(END)` with no code after
+ *    it) cover no instructions and are dropped.
+ */
+vector<LabelRange> labelRanges(const SymbolTable& symbols, size_t programSize){
+    vector<LabelRange> ranges;
+    uint16_t end = static_cast<uint16_t>(min<size_t>(programSize, Machine::ROM_SIZE));
+    for(const SymbolEntry& entry : symbols.entries(SymbolKind::Label)){
+        if(entry.address >= end){
+            break;
+        }
+        uint16_t address = static_cast<uint16_t>(entry.address);
+        if(!ranges.empty() && ranges.back().begin == address){
+            ranges.back().name += "/" + string(entry.name);
+            continue;
+        }
+        if(ranges.empty() && address > 0){
+            ranges.push_back({"<start>", 0, address});
+        }
+        if(!ranges.empty()){
+            ranges.back().end = address;
+        }
+        ranges.push_back({string(entry.name), address, end});
+    }
+    if(ranges.empty() && end > 0){
+        ranges.push_back({"<start>", 0, end});
+    }
+    return ranges;
+}
+
+/*
+ * Function: writeProfileReport
+ * ----------------------------
+ * Logic:
+ *  - Labels are listed by the instructions executed in their range, hottest first;
+ *    labels that never ran are left out.
+ *  - Ties are broken by address, so the report of a given run is deterministic.
+ */
+void writeProfileReport(ostream& out, const string& program, const ExecutionProfile& profile,
+                        const vector<LabelRange>& labels, const SymbolTable& symbols, size_t top){
+    uint64_t total = accumulate(profile.executions.begin(), profile.executions.end(), uint64_t(0));
+    out<<"Profile of "<<program<<": "<<total<<" instructions executed.\n";
+
+    vector<pair<uint64_t, const LabelRange*>> perLabel;
+    for(const LabelRange& range : labels){
+        uint64_t count = accumulate(profile.executions.begin() + range.begin,
+                                    profile.executions.begin() + range.end, uint64_t(0));
+        if(count > 0){
+            perLabel.emplace_back(count, &range);
+        }
+    }
+    stable_sort(perLabel.begin(), perLabel.end(), [](const auto& x, const auto& y){ return x.first > y.first; });
+    out<<"\nInstructions by label:\n"
+       <<"  "<<setw(14)<<"instructions"<<"  "<<setw(7)<<"share"<<"  label (ROM addresses)\n";
+    for(const auto& [count, range] : perLabel){
+        out<<"  "<<setw(14)<<count<<"  "<<setw(7)<<percent(count, total)<<"  "<<range->name
+           <<" ("<<range->begin<<"-"<<(range->end - 1)<<")\n";
+    }
+
+    vector<uint16_t> addresses;
+    for(size_t address = 0; address < profile.executions.size(); address++){
+        if(profile.executions[address] > 0){
+            addresses.push_back(static_cast<uint16_t>(address));
+        }
+    }
+    stable_sort(addresses.begin(), addresses.end(), [&](uint16_t x, uint16_t y){
+        return profile.executions[x] > profile.executions[y];
+    });
+    if(addresses.size() > top){
+        addresses.resize(top);
+    }
+    out<<"\nHottest instructions:\n"
+       <<"  "<<setw(7)<<"address"<<"  "<<setw(14)<<"instructions"<<"  "<<setw(7)<<"share"<<"  location\n";
+    for(uint16_t address : addresses){
+        out<<"  "<<setw(7)<<address<<"  "<<setw(14)<<profile.executions[address]<<"  "
+           <<setw(7)<<percent(profile.executions[address], total)<<"  "<<location(labels, address)<<'\n';
+    }
+
+    out<<"\nRAM accesses by region:\n"
+       <<"  "<<left<<setw(26)<<"region"<<right<<"  "<<setw(14)<<"reads"<<"  "<<setw(14)<<"writes"<<'\n';
+    for(const RamRegion& region : RAM_REGIONS){
+        uint64_t reads = accumulate(profile.reads.begin() + region.begin, profile.reads.begin() + region.end, uint64_t(0));
+        uint64_t writes = accumulate(profile.writes.begin() + region.begin, profile.writes.begin() + region.end, uint64_t(0));
+        out<<"  "<<left<<setw(26)<<region.name<<right<<"  "<<setw(14)<<reads<<"  "<<setw(14)<<writes<<'\n';
+    }
+
+    vector<uint16_t> words;
+    for(size_t address = 0; address < profile.reads.size(); address++){
+        if(profile.reads[address] + profile.writes[address] > 0){
+            words.push_back(static_cast<uint16_t>(address));
+        }
+    }
+    stable_sort(words.begin(), words.end(), [&](uint16_t x, uint16_t y){
+        return profile.reads[x] + profile.writes[x] > profile.reads[y] + profile.writes[y];
+    });
+    if(words.size() > top){
+        words.resize(top);
+    }
+    out<<"\nHottest RAM words:\n"
+       <<"  "<<setw(7)<<"address"<<"  "<<setw(14)<<"reads"<<"  "<<setw(14)<<"writes"<<"  name\n";
+    for(uint16_t address : words){
+        out<<"  "<<setw(7)<<address<<"  "<<setw(14)<<profile.reads[address]<<"  "<<setw(14)<<profile.writes[address]
+           <<"  "<<ramName(symbols, address)<<'\n';
+    }
+}
+
+void writeCollapsedStacks(ostream& out, const string& program, const ExecutionProfile& profile,
+                          const vector<LabelRange>& labels){
+    string root = frame(program);
+    for(size_t address = 0; address < profile.executions.size(); address++){
+        uint64_t count = profile.executions[address];
+        if(count == 0){
+            continue;
+        }
+        const LabelRange* range = rangeOf(labels, static_cast<uint16_t>(address));
+        string stack = root;
+        if(range == nullptr){
+            stack += ";<outside>";
+        }else{
+            size_t dollar = range->name.find('$');
+            if(dollar != string::npos && dollar > 0){
+                stack += ";" + frame(range->name.substr(0, dollar));
+            }
+            stack += ";" + frame(range->name);
+        }
+        out<<stack<<";ROM["<<address<<"] "<<count<<'\n';
+    }
+}
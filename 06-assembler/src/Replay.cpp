@@ -0,0 +1,187 @@
+/**
+ * @file Replay.cpp
+ * @brief Checkpoint files, key logs and keyboard replay.
+ *
+ * A checkpoint is the `MachineState` of Machine.h in the little-endian format described
+ * in Replay.h, read and written with one I/O call each. Saving and restoring copy the
+ * 48 KiB of RAM that can hold data, so a checkpoint costs far less than running even a
+ * few thousand instructions.
+ *
+ * Replay runs the machine in slices that end exactly at the next event's cycle. Both
+ * engines stop precisely at their budget, so the key is set between the same two
+ * instructions as when it was recorded.
+ */
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../include/HackFile.h"
+#include "../include/Replay.h"
+
+using namespace std;
+
+namespace {
+
+const char CHECKPOINT_MAGIC[4] = {'H', 'S', 'N', 'P'};
+const uint16_t CHECKPOINT_VERSION = 1;
+const size_t CHECKPOINT_HEADER_SIZE = 28;
+const size_t CHECKPOINT_WORDS = Machine::KBD + 1;   // RAM[0] to RAM[KBD]
+
+} // namespace
+
+/**
+ * @brief Computes a 32-bit FNV-1a hash of the loaded program's words.
+ *
+ * @param machine The machine whose program is hashed.
+ * @return uint32_t The fingerprint.
+ */
+uint32_t programFingerprint(const Machine& machine){
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < machine.programSize(); i++){
+        uint16_t word = machine.program()[i];
+        hash = (hash ^ (word & 0xFF)) * 16777619u;
+        hash = (hash ^ (word >> 8)) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Saves the machine's state in a checkpoint file.
+ *
+ * @param filename The file to write.
+ * @param machine The machine to save.
+ */
+void writeCheckpoint(const string& filename, const Machine& machine){
+    MachineState state;
+    machine.saveState(state);
+
+    string image(CHECKPOINT_HEADER_SIZE + 2 * CHECKPOINT_WORDS, '\0');
+    image.replace(0, 4, CHECKPOINT_MAGIC, 4);
+    putLittleEndian(image, 4, CHECKPOINT_VERSION, 2);
+    putLittleEndian(image, 6, state.halted ? 1 : 0, 2);
+    putLittleEndian(image, 8, programFingerprint(machine), 4);
+    putLittleEndian(image, 12, state.cycles, 8);
+    putLittleEndian(image, 20, state.pc, 2);
+    putLittleEndian(image, 22, state.a, 2);
+    putLittleEndian(image, 24, state.d, 2);
+    for(size_t i = 0; i < CHECKPOINT_WORDS; i++){
+        putLittleEndian(image, CHECKPOINT_HEADER_SIZE + 2 * i, state.ram[i], 2);
+    }
+    writeFile(filename, image);
+}
+
+/**
+ * @brief Restores a machine from a checkpoint file.
+ *
+ * The whole file is validated before the machine is touched, so a failed restore
+ * leaves it unchanged.
+ *
+ * @param filename The file to read.
+ * @param machine A machine with the checkpoint's program loaded.
+ */
+void readCheckpoint(const string& filename, Machine& machine){
+    string image = readFile(filename);
+    if(image.size() != CHECKPOINT_HEADER_SIZE + 2 * CHECKPOINT_WORDS || image.compare(0, 4, CHECKPOINT_MAGIC, 4) != 0
+       || getLittleEndian(image, 4, 2) != CHECKPOINT_VERSION){
+        throw runtime_error("Malformed checkpoint file: " + filename);
+    }
+    if(getLittleEndian(image, 8, 4) != programFingerprint(machine)){
+        throw runtime_error("Checkpoint " + filename + " was saved from a different program");
+    }
+
+    MachineState state;
+    state.halted = getLittleEndian(image, 6, 2) & 1;
+    state.cycles = getLittleEndian(image, 12, 8);
+    state.pc = static_cast<uint16_t>(getLittleEndian(image, 20, 2));
+    state.a = static_cast<uint16_t>(getLittleEndian(image, 22, 2));
+    state.d = static_cast<uint16_t>(getLittleEndian(image, 24, 2));
+    for(size_t i = 0; i < CHECKPOINT_WORDS; i++){
+        state.ram[i] = static_cast<uint16_t>(getLittleEndian(image, CHECKPOINT_HEADER_SIZE + 2 * i, 2));
+    }
+    machine.restoreState(state);
+}
+
+/**
+ * @brief Writes key events as a key log, one `cycle key` line each.
+ *
+ * @param filename The file to write.
+ * @param events The events in cycle order.
+ */
+void writeKeyLog(const string& filename, const vector<KeyEvent>& events){
+    string text = "// cycle key\n";
+    for(const KeyEvent& event : events){
+        text += to_string(event.cycle) + " " + to_string(event.key) + "\n";
+    }
+    writeFile(filename, text);
+}
+
+/**
+ * @brief Reads a key log.
+ *
+ * @param filename The file to read.
+ * @return vector<KeyEvent> The events in cycle order.
+ */
+vector<KeyEvent> readKeyLog(const string& filename){
+    istringstream input(readFile(filename));
+    vector<KeyEvent> events;
+    string line;
+    size_t lineNumber = 0;
+    while(getline(input, line)){
+        lineNumber++;
+        size_t comment = line.find("//");
+        if(comment != string::npos){
+            line.erase(comment);
+        }
+        istringstream fields(line);
+        string cycle, key, extra;
+        if(!(fields>>cycle)){
+            continue;
+        }
+        auto isNumber = [](const string& text, size_t digits){
+            return !text.empty() && text.size() <= digits && text.find_first_not_of("0123456789") == string::npos;
+        };
+        if(!(fields>>key) || (fields>>extra) || !isNumber(cycle, 19) || !isNumber(key, 5) || stoul(key) > 65535){
+            throw runtime_error(filename + ":" + to_string(lineNumber) + ": expected a cycle and a key code");
+        }
+        KeyEvent event{stoull(cycle), static_cast<uint16_t>(stoul(key))};
+        if(!events.empty() && event.cycle < events.back().cycle){
+            throw runtime_error(filename + ":" + to_string(lineNumber) + ": cycles must not decrease");
+        }
+        events.push_back(event);
+    }
+    return events;
+}
+
+/**
+ * @brief Runs a machine like `Machine::run`, setting the keyboard as the events say.
+ *
+ * @param machine The machine to run.
+ * @param events The key events in cycle order.
+ * @param maxCycles The most instructions to execute.
+ * @return uint64_t The number of instructions executed by this call.
+ */
+uint64_t runWithKeys(Machine& machine, const vector<KeyEvent>& events, uint64_t maxCycles){
+    auto next = lower_bound(events.begin(), events.end(), machine.cycles(),
+                            [](const KeyEvent& event, uint64_t cycle){ return event.cycle < cycle; });
+    uint64_t executed = 0;
+    for(;;){
+        while(next != events.end() && next->cycle == machine.cycles()){
+            machine.setKeyboard(next->key);
+            ++next;
+        }
+        if(executed == maxCycles || machine.halted()){
+            break;
+        }
+        uint64_t slice = maxCycles - executed;
+        if(next != events.end()){
+            slice = min(slice, next->cycle - machine.cycles());
+        }
+        uint64_t ran = machine.run(slice);
+        executed += ran;
+        if(ran < slice){
+            break;
+        }
+    }
+    return executed;
+}
@@ -0,0 +1,298 @@
+/**
+ * @file Scanner.cpp
+ * @brief Implementation of the SIMD line scanner.
+ * 
+ * The source is processed in 64-byte blocks. For every block, `classify` produces three
+ * 64-bit masks (one bit per byte): newlines, slashes and non-blank characters. A block is
+ * classified with 2 AVX2 or 4 SSE2 loads and a handful of compares, so the per-byte work
+ * is done 32 or 16 bytes at a time. `LineScanner::next` then walks the masks with
+ * count-trailing-zeros / count-leading-zeros to find, for each line:
+ * - the first non-blank character (start of the statement),
+ * - the first "//" (start of the comment),
+ * - the last non-blank character before the comment or newline (end of the statement).
+ * 
+ * Key Concepts:
+ * - Bitmasks: `mask & (mask - 1)`-style operations and `__builtin_ctzll` locate the next
+ *   interesting byte without looking at the bytes in between.
+ * - Runtime dispatch: On x86 the AVX2 classifier is compiled with a target attribute and
+ *   selected with `__builtin_cpu_supports`, so one binary uses AVX2 where available and
+ *   SSE2 (always present on x86-64) elsewhere. Other targets use the portable scalar code.
+ */
+#include <algorithm>
+#include <cstring>
+#include "../include/Scanner.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCANNER_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+const size_t BLOCK_SIZE = 64;
+
+struct BlockMasks {
+    uint64_t newlines;
+    uint64_t slashes;
+    uint64_t nonBlanks;
+};
+
+inline bool isBlank(char c){
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline unsigned lowestBit(uint64_t mask){
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+}
+
+inline unsigned highestBit(uint64_t mask){
+    return 63u - static_cast<unsigned>(__builtin_clzll(mask));
+}
+
+/*
+    Portable classifier: one byte at a time. Used on non-x86 targets.
+*/
+BlockMasks classifyScalar(const char* block){
+    BlockMasks masks{0, 0, 0};
+    for(size_t i = 0; i < BLOCK_SIZE; i++){
+        char c = block[i];
+        uint64_t bit = uint64_t(1) << i;
+        if(c == '\n'){
+            masks.newlines |= bit;
+        }else if(!isBlank(c)){
+            masks.nonBlanks |= bit;
+            if(c == '/'){
+                masks.slashes |= bit;
+            }
+        }
+    }
+    return masks;
+}
+
+#ifdef SCANNER_X86
+
+/*
+    SSE2 classifier: four 16-byte loads; `_mm_movemask_epi8` turns each compare result into
+    16 mask bits.
+*/
+__attribute__((target("sse2")))
+BlockMasks classifySse2(const char* block){
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i slash = _mm_set1_epi8('/');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+
+    BlockMasks masks{0, 0, 0};
+    for(size_t i = 0; i < BLOCK_SIZE; i += 16){
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+        __m128i isNewline = _mm_cmpeq_epi8(bytes, newline);
+        __m128i isBlankOrNewline = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, space), _mm_cmpeq_epi8(bytes, tab)),
+                                                _mm_or_si128(_mm_cmpeq_epi8(bytes, carriageReturn), isNewline));
+        masks.newlines |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(isNewline))) << i;
+        masks.slashes |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, slash)))) << i;
+        masks.nonBlanks |= uint64_t(static_cast<uint16_t>(~_mm_movemask_epi8(isBlankOrNewline))) << i;
+    }
+    return masks;
+}
+
+/*
+    AVX2 classifier: two 32-byte loads, otherwise the same as the SSE2 version.
+*/
+__attribute__((target("avx2")))
+BlockMasks classifyAvx2(const char* block){
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i slash = _mm256_set1_epi8('/');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i carriageReturn = _mm256_set1_epi8('\r');
+
+    BlockMasks masks{0, 0, 0};
+    for(size_t i = 0; i < BLOCK_SIZE; i += 32){
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+        __m256i isNewline = _mm256_cmpeq_epi8(bytes, newline);
+        __m256i isBlankOrNewline = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, space), _mm256_cmpeq_epi8(bytes, tab)),
+                                                   _mm256_or_si256(_mm256_cmpeq_epi8(bytes, carriageReturn), isNewline));
+        masks.newlines |= uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(isNewline))) << i;
+        masks.slashes |= uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, slash)))) << i;
+        masks.nonBlanks |= uint64_t(static_cast<uint32_t>(~_mm256_movemask_epi8(isBlankOrNewline))) << i;
+    }
+    return masks;
+}
+
+#endif  // SCANNER_X86
+
+using Classifier = BlockMasks (*)(const char*);
+
+struct ClassifierChoice {
+    Classifier classify;
+    const char* name;
+};
+
+/*
+    Picks the best classifier once per process; C++11 guarantees the static is initialized
+    exactly once even when several threads scan at the same time.
+*/
+const ClassifierChoice& bestClassifier(){
+    static const ClassifierChoice choice = []() -> ClassifierChoice {
+#ifdef SCANNER_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")){
+            return {classifyAvx2, "avx2"};
+        }
+        if(__builtin_cpu_supports("sse2")){
+            return {classifySse2, "sse2"};
+        }
+#endif
+        return {classifyScalar, "scalar"};
+    }();
+    return choice;
+}
+
+}  // namespace
+
+/**
+ * @brief Prepares to scan the given buffer.
+ * 
+ * @param text The complete assembly source.
+ */
+LineScanner::LineScanner(string_view text) : source(text){
+}
+
+/**
+ * @brief Names the block classifier selected for this machine.
+ * 
+ * @return const char* "avx2", "sse2" or "scalar".
+ */
+const char* LineScanner::implementation(){
+    return bestClassifier().name;
+}
+
+/**
+ * @brief Classifies the next 64-byte block.
+ * 
+ * The last, partial block is copied into a buffer padded with spaces, which are blank
+ * and therefore never become part of a statement. A "//" split across two blocks is
+ * caught by carrying the previous block's last slash into bit 0.
+ */
+void LineScanner::loadBlock(){
+    blockBase = nextBlock;
+    nextBlock += BLOCK_SIZE;
+
+    BlockMasks masks;
+    if(blockBase + BLOCK_SIZE <= source.size()){
+        masks = bestClassifier().classify(source.data() + blockBase);
+    }else{
+        char padded[BLOCK_SIZE];
+        memset(padded, ' ', BLOCK_SIZE);
+        memcpy(padded, source.data() + blockBase, source.size() - blockBase);
+        masks = bestClassifier().classify(padded);
+    }
+
+    newlines = masks.newlines;
+    nonBlanks = masks.nonBlanks;
+    commentMarks = masks.slashes & ((masks.slashes << 1) | (previousSlash ? 1 : 0));
+    previousSlash = (masks.slashes >> 63) != 0;
+    position = 0;
+}
+
+/**
+ * @brief Finishes the current line, producing its statement if it had one.
+ * 
+ * @param statement Receives the statement.
+ * @return bool true if the line held a statement.
+ */
+bool LineScanner::endLine(Statement& statement){
+    bool found = tokenStart != SIZE_MAX;
+    if(found){
+        statement.text = source.substr(tokenStart, tokenEnd - tokenStart);
+        statement.offset = static_cast<uint32_t>(tokenStart);
+        statement.line = line;
+    }
+    tokenStart = SIZE_MAX;
+    inComment = false;
+    line++;
+    return found;
+}
+
+/**
+ * @brief Finds the next statement, skipping blank and comment-only lines.
+ * 
+ * Within a block the scanner jumps from event to event: the next newline ends the line,
+ * the next comment mark switches to skipping until the newline, and the non-blank
+ * characters in between only extend the statement's start and end.
+ * 
+ * @param statement Receives the statement.
+ * @return bool false once the end of the source has been reached.
+ */
+bool LineScanner::next(Statement& statement){
+    while(true){
+        if(position >= BLOCK_SIZE){
+            if(nextBlock >= source.size()){
+                // The last line may not end with a newline
+                if(finished){
+                    return false;
+                }
+                finished = true;
+                return endLine(statement);
+            }
+            loadBlock();
+        }
+
+        uint64_t live = ~uint64_t(0) << position;  // Bits not examined yet
+        uint64_t lineEnds = newlines & live;
+        unsigned newlineBit = lineEnds ? lowestBit(lineEnds) : 64;
+
+        if(inComment){
+            if(newlineBit == 64){
+                position = 64;
+                continue;
+            }
+            position = newlineBit + 1;
+            if(endLine(statement)){
+                return true;
+            }
+            continue;
+        }
+
+        uint64_t marks = commentMarks & live;
+        unsigned commentBit = marks ? lowestBit(marks) : 64;
+        unsigned stop = min(newlineBit, commentBit);
+
+        // Non-blank characters of this line up to the newline or comment
+        uint64_t segment = stop == 64 ? live : live & ((uint64_t(1) << stop) - 1);
+        uint64_t characters = nonBlanks & segment;
+        if(characters){
+            if(tokenStart == SIZE_MAX){
+                tokenStart = blockBase + lowestBit(characters);
+            }
+            tokenEnd = blockBase + highestBit(characters) + 1;
+        }
+
+        if(stop == 64){
+            position = 64;  // The line continues in the next block
+        }else if(commentBit < newlineBit){
+            // The comment starts at the first '/', which may even be in the previous block
+            size_t commentStart = blockBase + commentBit - 1;
+            if(tokenStart != SIZE_MAX){
+                if(tokenStart >= commentStart){
+                    tokenStart = SIZE_MAX;  // Nothing but the comment on this line
+                }else{
+                    tokenEnd = min(tokenEnd, commentStart);
+                    while(tokenEnd > tokenStart && isBlank(source[tokenEnd - 1])){
+                        tokenEnd--;
+                    }
+                }
+            }
+            inComment = true;
+            position = commentBit + 1;
+        }else{
+            position = newlineBit + 1;
+            if(endLine(statement)){
+                return true;
+            }
+        }
+    }
+}
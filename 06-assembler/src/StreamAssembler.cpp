@@ -0,0 +1,414 @@
+/**
+ * @file StreamAssembler.cpp
+ * @brief Implementation of the single-pass streaming assembler.
+ *
+ * The two-pass assembler needs the whole program because a label may be used before it
+ * is defined. Here every such use is written as a placeholder and backpatched instead:
+ * 1. Each chunk of input is split at its last newline and the complete lines are
+ *    tokenized by `LineScanner`; the partial last line is carried into the next chunk.
+ * 2. Every instruction is encoded on the spot. A symbol that is not (yet) a label gets a
+ *    fixup; defining the label patches its fixups and frees them.
+ * 3. At the end of the input the symbols that never became labels are variables. They
+ *    get their RAM addresses in order of first use and their fixups are patched.
+ *
+ * Words are buffered in memory and written in blocks. A word that is patched after it
+ * was written is rewritten in place with a seek, which is why a pipe (no seeking) has
+ * to hold back every word from the oldest placeholder on.
+ */
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../include/StreamAssembler.h"
+#include "../include/BinCodes.h"
+#include "../include/Scanner.h"
+
+using namespace std;
+
+/**
+ * @brief Prepares the output; the binary header is written with a word count of 0 and
+ *        updated at the end.
+ *
+ * @param out Where the machine code is written.
+ * @param format The output format.
+ * @param name The name used in diagnostics.
+ */
+StreamAssembler::StreamAssembler(ostream& out, OutputFormat format, string name)
+    : out(out), format(format), sourceName(move(name)){
+    streampos position = out.tellp();
+    seekable = position != streampos(-1);
+    origin = seekable ? static_cast<streamoff>(position) : 0;
+    if(format == OutputFormat::Binary){
+        if(!seekable){
+            throw invalid_argument("Binary output needs a seekable stream, not a pipe");
+        }
+        string header = renderHack({}, OutputFormat::Binary);
+        out.write(header.data(), static_cast<streamsize>(header.size()));
+        end = header.size();
+    }
+}
+
+/**
+ * @brief Reads and assembles the whole input.
+ *
+ * - The input is read `CHUNK_SIZE` bytes at a time; only the current chunk and the
+ *   partial line carried over from the previous one are in memory.
+ * - Once the input ends, the remaining symbols are allocated as variables, every word
+ *   is written and, for binary output, the header gets the final word count.
+ *
+ * @param in The assembly source.
+ * @return bool true if the program assembled without errors.
+ */
+bool StreamAssembler::assemble(istream& in){
+    string chunk;
+    uint64_t line = 1;
+    while(true){
+        size_t carried = chunk.size();
+        chunk.resize(carried + CHUNK_SIZE);
+        in.read(&chunk[carried], CHUNK_SIZE);
+        chunk.resize(carried + static_cast<size_t>(in.gcount()));
+        if(in.bad()){
+            throw runtime_error("Error reading input: " + sourceName);
+        }
+        if(!in){
+            scan(chunk, line);
+            break;
+        }
+        size_t cut = chunk.rfind('\n');
+        if(cut == string::npos){
+            continue;  // A line longer than a chunk; keep reading
+        }
+        string_view lines(chunk.data(), cut + 1);
+        scan(lines, line);
+        line += count(lines.begin(), lines.end(), '\n');
+        chunk.erase(0, cut + 1);
+    }
+
+    // Whatever was used but never defined as a label is a variable
+    vector<pair<uint64_t, uint16_t>> patches;
+    int nextAvailableRamAddress = 16;
+    for(uint32_t id : unresolved){
+        Symbol& symbol = symbols[id];
+        if(symbol.label){
+            continue;
+        }
+        symbol.address = nextAvailableRamAddress++;
+        for(const Fixup& fixup : symbol.fixups){
+            try{
+                patches.push_back({fixup.word, encodeAInstruction(symbol.address)});
+            }catch(const exception& e){
+                error(fixup.line, e.what());
+                patches.push_back({fixup.word, 0});
+            }
+        }
+        vector<Fixup>().swap(symbol.fixups);
+    }
+    pending = 0;
+    sort(patches.begin(), patches.end());  // Ascending positions, for the written ones
+    for(const auto& [index, word] : patches){
+        patch(index, word);
+    }
+    flush(true);
+
+    if(format == OutputFormat::Binary){
+        if(wordCount > UINT32_MAX){
+            throw runtime_error("Program too large for the binary format: " + to_string(wordCount) + " words");
+        }
+        char count[4];
+        for(int i = 0; i < 4; i++){
+            count[i] = static_cast<char>((wordCount >> (8 * i)) & 0xFF);
+        }
+        writeAt(8, count, 4);
+    }
+    out.flush();
+    if(!out){
+        throw runtime_error("Error writing output");
+    }
+    return !hasErrors();
+}
+
+/**
+ * @brief Error messages, formatted as "name:line: message", in line order.
+ *
+ * Errors in label uses are only found when the label is defined or the input ends,
+ * so they are sorted here.
+ *
+ * @return vector<string> The messages.
+ */
+vector<string> StreamAssembler::diagnostics() const{
+    vector<pair<uint64_t, string>> sorted = messages;
+    stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b){ return a.first < b.first; });
+    vector<string> result;
+    result.reserve(sorted.size());
+    for(auto& message : sorted){
+        result.push_back(move(message.second));
+    }
+    return result;
+}
+
+/**
+ * @brief Assembles the statements of a block of complete lines.
+ *
+ * @param text The lines.
+ * @param firstLine The source line number of the first of them.
+ */
+void StreamAssembler::scan(string_view text, uint64_t firstLine){
+    LineScanner scanner(text);
+    Statement statement;
+    while(scanner.next(statement)){
+        this->statement(statement.text, firstLine + statement.line - 1);
+    }
+}
+
+/**
+ * @brief Assembles one statement.
+ *
+ * - A label gets the address of the next word and resolves the uses seen so far.
+ *   Redefining a label or a predefined symbol is an error, as in `Assembler::firstPass`.
+ * - A use of a label that is already defined is encoded directly; any other user symbol
+ *   is written as a placeholder and recorded as a fixup.
+ * - Everything else is encoded directly. A word that fails to encode is written as 0.
+ *
+ * @param text The statement, without comments or blanks.
+ * @param line The source line.
+ */
+void StreamAssembler::statement(string_view text, uint64_t line){
+    if(text.front() == '(' && text.back() == ')'){
+        string_view name = text.substr(1, text.size() - 2);
+        if(name.empty()){
+            error(line, "Empty label '()'");
+            return;
+        }
+        if(lookupPredefinedSymbol(name) >= 0){
+            error(line, "Duplicate label '" + string(name) + "'");
+            return;
+        }
+        Symbol& symbol = symbols[symbolId(name)];
+        if(symbol.label){
+            error(line, "Duplicate label '" + string(name) + "'");
+            return;
+        }
+        symbol.label = true;
+        symbol.address = static_cast<int>(min<uint64_t>(wordCount, INT_MAX));
+        resolve(symbol);
+        return;
+    }
+
+    uint16_t word = 0;
+    if(isUserSymbol(text)){
+        uint32_t id = symbolId(text.substr(1));
+        Symbol& symbol = symbols[id];
+        if(!symbol.label){
+            if(!symbol.listed){
+                symbol.listed = true;
+                unresolved.push_back(id);
+            }
+            symbol.fixups.push_back({wordCount, line});
+            peakPending = max(peakPending, ++pending);
+            emit(0, false);
+            return;
+        }
+        try{
+            word = encodeAInstruction(symbol.address);
+        }catch(const exception& e){
+            error(line, e.what());
+        }
+    }else{
+        try{
+            word = encodeFixedInstruction(text);
+        }catch(const exception& e){
+            error(line, e.what());
+        }
+    }
+    emit(word, true);
+}
+
+/**
+ * @brief Returns the index of a user symbol in `symbols`, adding it on first sight.
+ *
+ * @param name The symbol.
+ * @return uint32_t The index.
+ */
+uint32_t StreamAssembler::symbolId(string_view name){
+    auto [id, added] = ids.insert(name, static_cast<int>(symbols.size()));
+    if(added){
+        symbols.emplace_back();
+    }
+    return static_cast<uint32_t>(id);
+}
+
+/**
+ * @brief Patches every recorded use of a symbol whose address is now known and frees
+ *        the fixups.
+ *
+ * @param symbol The symbol; `address` must be set.
+ */
+void StreamAssembler::resolve(Symbol& symbol){
+    vector<Fixup> fixups;
+    fixups.swap(symbol.fixups);
+    pending -= fixups.size();
+    for(const Fixup& fixup : fixups){
+        uint16_t word = 0;
+        try{
+            word = encodeAInstruction(symbol.address);
+        }catch(const exception& e){
+            error(fixup.line, e.what());
+        }
+        patch(fixup.word, word);
+    }
+}
+
+/**
+ * @brief Appends a word to the output.
+ *
+ * @param word The encoded word, or a placeholder.
+ * @param ready false for a placeholder that will be patched.
+ */
+void StreamAssembler::emit(uint16_t word, bool ready){
+    buffer.push_back(word);
+    this->ready.push_back(ready);
+    wordCount++;
+    peakBuffered = max(peakBuffered, buffer.size() - head);
+    if(seekable){
+        if(buffer.size() - head >= FLUSH_WORDS){
+            flush(false);
+        }
+    }else if(ready && firstWaiting == buffer.size() - 1){
+        firstWaiting++;
+        if(firstWaiting - head >= FLUSH_WORDS){
+            flush(false);
+        }
+    }
+}
+
+/**
+ * @brief Gives a word its final value, in memory if it is still buffered, otherwise
+ *        in place in the output.
+ *
+ * @param index The word's ROM address.
+ * @param word The final value.
+ */
+void StreamAssembler::patch(uint64_t index, uint16_t word){
+    if(index < bufferStart){
+        // Only a seekable output writes words before they are ready
+        if(format == OutputFormat::Binary){
+            char bytes[2] = {static_cast<char>(word & 0xFF), static_cast<char>(word >> 8)};
+            writeAt(12 + 2 * index, bytes, 2);
+        }else{
+            char bytes[16];
+            formatBinary(word, bytes);
+            writeAt(17 * index, bytes, 16);
+        }
+        return;
+    }
+    size_t position = head + static_cast<size_t>(index - bufferStart);
+    buffer[position] = word;
+    ready[position] = 1;
+    if(!seekable && position == firstWaiting){
+        while(firstWaiting < buffer.size() && ready[firstWaiting]){
+            firstWaiting++;
+        }
+        if(firstWaiting - head >= FLUSH_WORDS){
+            flush(false);
+        }
+    }
+}
+
+/**
+ * @brief Writes buffered words to the output.
+ *
+ * - A seekable output writes everything; placeholders are patched in place later.
+ * - A pipe writes only the words before the oldest placeholder, unless `all` is set.
+ * - The written words are dropped from the front of the buffer. The buffer is only
+ *   compacted once at least half of it is written, so this is amortized constant time
+ *   per word even while a pipe holds back a long run of words.
+ *
+ * @param all Write every buffered word.
+ */
+void StreamAssembler::flush(bool all){
+    size_t count = (all || seekable ? buffer.size() : firstWaiting) - head;
+    write(buffer.data() + head, count, bufferStart);
+    bufferStart += count;
+    head += count;
+    if(head == buffer.size()){
+        buffer.clear();
+        ready.clear();
+        head = 0;
+    }else if(head >= buffer.size() / 2){
+        buffer.erase(buffer.begin(), buffer.begin() + head);
+        ready.erase(ready.begin(), ready.begin() + head);
+        head = 0;
+    }
+    firstWaiting = head;
+    while(firstWaiting < buffer.size() && ready[firstWaiting]){
+        firstWaiting++;
+    }
+}
+
+/**
+ * @brief Renders words in the output format and appends them to the output.
+ *
+ * @param words The words.
+ * @param count How many.
+ * @param first The ROM address of the first one; every word but word 0 is preceded by a
+ *        newline in the text format.
+ */
+void StreamAssembler::write(const uint16_t* words, size_t count, uint64_t first){
+    if(count == 0){
+        return;
+    }
+    if(!atEnd){
+        out.seekp(origin + static_cast<streamoff>(end));
+        atEnd = true;
+    }
+    string bytes;
+    if(format == OutputFormat::Binary){
+        bytes.resize(2 * count);
+        for(size_t i = 0; i < count; i++){
+            bytes[2 * i] = static_cast<char>(words[i] & 0xFF);
+            bytes[2 * i + 1] = static_cast<char>(words[i] >> 8);
+        }
+    }else{
+        size_t skip = first == 0 ? 1 : 0;  // No newline before the first instruction
+        bytes.assign(17 * count - skip, '\n');
+        for(size_t i = 0; i < count; i++){
+            formatBinary(words[i], &bytes[17 * i + 1 - skip]);
+        }
+    }
+    out.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+    end += bytes.size();
+    if(!out){
+        throw runtime_error("Error writing output");
+    }
+}
+
+/**
+ * @brief Overwrites bytes that were already written.
+ *
+ * The stream is left where the bytes end and only returns to the end of the output for
+ * the next `write`, so a run of patches in ascending order costs one seek each.
+ *
+ * @param position The offset of the first byte, relative to the start of the output.
+ * @param bytes The new bytes.
+ * @param length How many.
+ */
+void StreamAssembler::writeAt(uint64_t position, const char* bytes, size_t length){
+    out.seekp(origin + static_cast<streamoff>(position));
+    out.write(bytes, static_cast<streamsize>(length));
+    atEnd = false;
+    if(!out){
+        throw runtime_error("Error writing output");
+    }
+}
+
+/**
+ * @brief Records an error at a source line.
+ *
+ * @param line The 1-based source line.
+ * @param message What went wrong.
+ */
+void StreamAssembler::error(uint64_t line, const string& message){
+    messages.push_back({line, sourceName + ":" + to_string(line) + ": " + message});
+}
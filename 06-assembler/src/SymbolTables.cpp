@@ -4,107 +4,346 @@
  *  It handles both predefined symbols (e.g., "R0", "SCREEN") and user-defined symbols (e.g., labels and variables).
  *   
  *  Overview:
- *  - `symbolTable` is a global unordered map storing symbol names as keys and memory addresses as values.
- *  - `addSymbol` function allows adding new symbols with associated addresses to the map.
- *  - `getSymbolAddress` function retrieves the address for a given symbol.
+ *  - `SymbolTable` is a flat open-addressing hash table mapping symbol names to memory addresses.
+ *    Every assembly owns its own table, so symbols never leak from one program into the next.
+ *  - `SymbolTable::addSymbol` / `SymbolTable::insert` add new symbols with associated addresses.
+ *  - `SymbolTable::getSymbolAddress` retrieves the address for a given symbol.
+ *  - The predefined symbols and the opcode tables are `constexpr` data with perfect-hash lookups
+ *    built at compile time; `lookupComputation`, `lookupDestination` and `lookupJump` map
+ *    C-instruction fields to their bits.
  *  
  *  Key Concepts:
- *  - `unordered_map`: A hash table-based data structure that provides fast lookup times. 
- *                     Each symbol maps to a unique memory address.
- *  - `auto`: A keyword used for automatic type deduction, especially useful for iterators.
+ *  - Open addressing: All entries live in one array of slots. A name hashes to a slot and, on a
+ *    collision, the following slots are probed in order. There is no per-entry heap node as in
+ *    `unordered_map`, so a lookup usually touches a single cache line.
+ *  - Arena: The names themselves are copied once into one growing character buffer and are
+ *    referenced by offset, so adding a symbol does not allocate a `std::string`.
+ *  - `string_view`: Lookups take a view of the characters in the source buffer, so looking up
+ *    `@LOOP` does not build a temporary string.
  */
 #include "../include/SymbolTables.h"
-#include <iostream>
+#include <algorithm>
 #include <string>
-#include <unordered_map>
+#include <array>
+#include <string_view>
+#include <utility>
 
 using namespace std;
 
 /*
-    `unordered_map<string, int> symbolTable`
-    This unordered map acts as a symbol table, where each symbol (string) maps to an address (int).
-    
-    - Predefined symbols (e.g., "SP", "LCL", "ARG") are initialized with fixed addresses.
-    - This map uses hashing for quick lookup, making it efficient for frequent additions and retrievals.
-    
-    Symbols are initialized here to ensure that the assembler can reference standard symbols immediately.
-    New symbols (like labels or variables) can be added dynamically during parsing.
+    Opcode tables for C-instruction fields.
+
+    Each table is a `constexpr` array of (mnemonic, bits) pairs, so it lives in read-only
+    memory and can be shared by any number of assemblies without synchronization.
+    - `computationMap` holds the 7 bits `a c1..c6`. The canonical spelling of every
+      computation comes first; the commutative aliases (e.g. "M+D" for "D+M") follow.
+    - `destinationMap` and `jumpMap` hold the 3 `d` and `j` bits, with "" meaning "none".
+*/
+constexpr array<Mnemonic, 34> computationMap = {{
+    {"0"  , 0b0101010}, {"1"  , 0b0111111}, {"-1" , 0b0111010},
+    {"D"  , 0b0001100}, {"A"  , 0b0110000}, {"M"  , 0b1110000},
+    {"!D" , 0b0001101}, {"!A" , 0b0110001}, {"!M" , 0b1110001},
+    {"-D" , 0b0001111}, {"-A" , 0b0110011}, {"-M" , 0b1110011},
+    {"D+1", 0b0011111}, {"A+1", 0b0110111}, {"M+1", 0b1110111},
+    {"D-1", 0b0001110}, {"A-1", 0b0110010}, {"M-1", 0b1110010},
+    {"D+A", 0b0000010}, {"D+M", 0b1000010}, {"D-A", 0b0010011},
+    {"D-M", 0b1010011}, {"A-D", 0b0000111}, {"M-D", 0b1000111},
+    {"D&A", 0b0000000}, {"D&M", 0b1000000}, {"D|A", 0b0010101},
+    {"D|M", 0b1010101},
+    {"A+D", 0b0000010}, {"M+D", 0b1000010}, {"A&D", 0b0000000},
+    {"M&D", 0b1000000}, {"A|D", 0b0010101}, {"M|D", 0b1010101}
+}};
+
+constexpr array<Mnemonic, 8> destinationMap = {{
+    {"" , 0b000}, {"M" , 0b001}, {"D" , 0b010}, {"MD" , 0b011},
+    {"A", 0b100}, {"AM", 0b101}, {"AD", 0b110}, {"AMD", 0b111}
+}};
+
+constexpr array<Mnemonic, 8> jumpMap = {{
+    {""   , 0b000}, {"JGT", 0b001}, {"JEQ", 0b010}, {"JGE", 0b011},
+    {"JLT", 0b100}, {"JNE", 0b101}, {"JLE", 0b110}, {"JMP", 0b111}
+}};
+
+/*
+    Compile-time perfect hashing of the fixed tables.
+
+    Every mnemonic and predefined symbol is at most 7 characters long, so it is packed into one
+    64-bit key (the characters in the low bytes, the length in the top byte). A multiply-shift hash
+    maps keys to a power-of-two slot array, and `buildPerfectHash` searches for a multiplier
+    that gives every name its own slot. The search runs entirely at compile time, so at
+    run time a lookup is one multiplication, one load and one comparison, with no hashing
+    of `std::string`s and no heap allocation.
+
+    Unknown names (including anything longer than 7 characters) return -1 instead of
+    being silently inserted the way `unordered_map::operator[]` would.
+*/
+namespace {
+
+/*
+    `PREDEFINED_SYMBOLS`
+    The symbols every Hack program can use without declaring them, with their fixed addresses.
+    They are looked up through `predefinedHash` before the per-program table is consulted, so
+    a new `SymbolTable` starts out empty and costs nothing to create.
 */
-unordered_map<string, int>symbolTable={
+struct PredefinedSymbol {
+    string_view name;
+    uint16_t address;
+};
+
+constexpr array<PredefinedSymbol, 23> PREDEFINED_SYMBOLS = {{
     {"SP", 0}, {"LCL", 1}, {"ARG", 2}, {"THIS", 3}, {"THAT", 4},
     {"R0", 0}, {"R1", 1}, {"R2", 2}, {"R3", 3}, {"R4", 4}, {"R5", 5},
     {"R6", 6}, {"R7", 7}, {"R8", 8}, {"R9", 9}, {"R10", 10}, {"R11", 11},
     {"R12", 12}, {"R13", 13}, {"R14", 14}, {"R15", 15},
     {"SCREEN", 16384}, {"KBD", 24576}
-};
+}};
 
-// Predefined mappings for C-instruction fields
-unordered_map<string, string>computationMap={
-    {"0"  , "0101010"}, {"1"  , "0111111"}, {"-1" , "0111010"},
-    {"D"  , "0001100"}, {"A"  , "0110000"}, {"M"  , "1110000"},
-    {"!D" , "0001101"}, {"!A" , "0110001"}, {"!M" , "1110001"},
-    {"-D" , "0001111"}, {"-A" , "0110011"}, {"-M" , "1110011"},
-    {"D+1", "0011111"}, {"A+1", "0110111"}, {"M+1", "1110111"},
-    {"D-1", "0001110"}, {"A-1", "0110010"}, {"M-1", "1110010"},
-    {"D+A", "0000010"}, {"D+M", "1000010"}, {"D-A", "0010011"},
-    {"D-M", "1010011"}, {"A-D", "0000111"}, {"M-D", "1000111"},
-    {"D&A", "0000000"}, {"D&M", "1000000"}, {"D|A", "0010101"},
-    {"D|M", "1010101"}
-};
+constexpr uint64_t INVALID_KEY = ~uint64_t(0);
 
-unordered_map<string, string>destinationMap={
-    {"" , "000"}, {"M" , "001"}, {"D" , "010"}, {"MD" , "011"},
-    {"A", "100"}, {"AM", "101"}, {"AD", "110"}, {"AMD", "111"}
-};
+constexpr uint64_t packName(string_view name){
+    if(name.size() > 7){
+        return INVALID_KEY;
+    }
+    uint64_t key = static_cast<uint64_t>(name.size()) << 56;
+    for(size_t i = 0; i < name.size(); i++){
+        key |= static_cast<uint64_t>(static_cast<unsigned char>(name[i])) << (8 * i);
+    }
+    return key;
+}
+
+constexpr int entryValue(const Mnemonic& entry){ return entry.bits; }
+constexpr int entryValue(const PredefinedSymbol& entry){ return entry.address; }
 
-unordered_map<string, string>jumpMap={
-    {""   , "000"}, {"JGT", "001"}, {"JEQ", "010"}, {"JGE", "011"},
-    {"JLT", "100"}, {"JNE", "101"}, {"JLE", "110"}, {"JMP", "111"}
+template<unsigned Bits>
+struct PerfectHash {
+    static constexpr size_t SLOTS = size_t(1) << Bits;
+    uint64_t multiplier = 0;
+    uint64_t keys[SLOTS] = {};
+    int16_t values[SLOTS] = {};
+
+    constexpr size_t slotOf(uint64_t key) const {
+        return static_cast<size_t>((key * multiplier) >> (64 - Bits));
+    }
+
+    constexpr int find(string_view name) const {
+        uint64_t key = packName(name);
+        size_t slot = slotOf(key);
+        return keys[slot] == key ? values[slot] : -1;
+    }
 };
 
+template<unsigned Bits, typename Entry, size_t N>
+constexpr PerfectHash<Bits> buildPerfectHash(const array<Entry, N>& table){
+    PerfectHash<Bits> hash{};
+    // Candidate multipliers are drawn from a 64-bit LCG (forced odd) until one has no collisions
+    for(uint64_t candidate = 0x9E3779B97F4A7C15ull; ; candidate = candidate * 6364136223846793005ull + 1442695040888963407ull){
+        hash.multiplier = candidate | 1;
+        for(size_t slot = 0; slot < hash.SLOTS; slot++){
+            hash.keys[slot] = INVALID_KEY;
+            hash.values[slot] = -1;
+        }
+
+        bool collision = false;
+        for(size_t i = 0; i < N && !collision; i++){
+            uint64_t key = packName(table[i].name);
+            size_t slot = hash.slotOf(key);
+            if(hash.keys[slot] == INVALID_KEY){
+                hash.keys[slot] = key;
+                hash.values[slot] = static_cast<int16_t>(entryValue(table[i]));
+            }else{
+                collision = true;
+            }
+        }
+        if(!collision){
+            return hash;
+        }
+    }
+}
+
+constexpr PerfectHash<8> computationHash = buildPerfectHash<8>(computationMap);
+constexpr PerfectHash<5> destinationHash = buildPerfectHash<5>(destinationMap);
+constexpr PerfectHash<5> jumpHash = buildPerfectHash<5>(jumpMap);
+constexpr PerfectHash<7> predefinedHash = buildPerfectHash<7>(PREDEFINED_SYMBOLS);
+
+static_assert(computationHash.find("D+M") == 0b1000010, "comp table lookup");
+static_assert(computationHash.find("M+D") == 0b1000010, "comp alias lookup");
+static_assert(computationHash.find("D+") == -1, "unknown comp must not match");
+static_assert(destinationHash.find("") == 0b000 && destinationHash.find("AMD") == 0b111, "dest table lookup");
+static_assert(jumpHash.find("JMP") == 0b111 && jumpHash.find("JMPX") == -1, "jump table lookup");
+static_assert(predefinedHash.find("SCREEN") == 16384 && predefinedHash.find("R15") == 15, "predefined lookup");
+static_assert(predefinedHash.find("R16") == -1 && predefinedHash.find("") == -1, "unknown symbol must not match");
+
+/*
+    hashName(string_view name)
+    FNV-1a hash of a symbol name for the per-program table. Symbol names are short, so a simple
+    byte-at-a-time hash is cheaper than anything that needs setup work.
+*/
+uint32_t hashName(string_view name){
+    uint32_t hash = 2166136261u;
+    for(char c : name){
+        hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+}  // namespace
+
+int lookupComputation(string_view mnemonic){
+    return computationHash.find(mnemonic);
+}
+
+int lookupDestination(string_view mnemonic){
+    return destinationHash.find(mnemonic);
+}
+
+int lookupJump(string_view mnemonic){
+    return jumpHash.find(mnemonic);
+}
+
+int lookupPredefinedSymbol(string_view symbol){
+    return predefinedHash.find(symbol);
+}
+
+/*
+    SymbolTable()
+    Creates a table that holds only the predefined symbols. Those live in the compile-time
+    `predefinedHash`, so the per-program slot array starts small and empty.
+*/
+SymbolTable::SymbolTable() : slots(INITIAL_CAPACITY){
+}
+
+/*
+    SymbolTable::findSlot(string_view symbol, uint32_t hash)
+    Linear probing: starting at the slot picked by the hash, walk forward (wrapping around) until
+    the symbol or an empty slot is found. The stored hash is compared before the name, so most
+    non-matching slots are skipped without touching the arena.
+
+    Returns:
+    - `size_t`: The index of the slot holding the symbol, or of the empty slot where it belongs.
+*/
+size_t SymbolTable::findSlot(string_view symbol, uint32_t hash) const{
+    size_t mask = slots.size() - 1;
+    for(size_t index = hash & mask; ; index = (index + 1) & mask){
+        const Slot& slot = slots[index];
+        if(slot.address < 0){
+            return index;
+        }
+        if(slot.hash == hash && slot.nameLength == symbol.size() &&
+           arena.compare(slot.nameOffset, slot.nameLength, symbol) == 0){
+            return index;
+        }
+    }
+}
+
 /*
-    addSymbol(string& symbol, int address)
-    Adds a new symbol with its associated address to the `symbolTable` if the symbol does not already exist.
+    SymbolTable::grow()
+    Doubles the slot array and re-inserts every entry. The stored hashes are reused, so names
+    are never re-hashed, and the arena is left untouched.
+*/
+void SymbolTable::grow(){
+    vector<Slot> old(slots.size() * 2);
+    old.swap(slots);
+    size_t mask = slots.size() - 1;
+    for(const Slot& slot : old){
+        if(slot.address < 0){
+            continue;
+        }
+        size_t index = slot.hash & mask;
+        while(slots[index].address >= 0){
+            index = (index + 1) & mask;
+        }
+        slots[index] = slot;
+    }
+}
+
+/*
+    SymbolTable::insert(string_view symbol, int address, SymbolKind kind)
+    Adds a symbol unless it already exists, with a single probe sequence for both the check and
+    the insert (the old code hashed twice: once in `find`, once in `operator[]`).
+
+    Returns:
+    - `pair<int, bool>`: The symbol's address, and whether it was newly inserted. For an existing
+      or predefined symbol the address is the one already stored and the table is unchanged.
+*/
+pair<int, bool> SymbolTable::insert(string_view symbol, int address, SymbolKind kind){
+    int predefined = lookupPredefinedSymbol(symbol);
+    if(predefined >= 0){
+        return {predefined, false};
+    }
+
+    uint32_t hash = hashName(symbol);
+    size_t index = findSlot(symbol, hash);
+    if(slots[index].address >= 0){
+        return {slots[index].address, false};
+    }
+
+    // Keep the load factor at or below 1/2 so probe sequences stay short
+    if(2 * (count + 1) > slots.size()){
+        grow();
+        index = findSlot(symbol, hash);
+    }
+    slots[index] = {hash, static_cast<uint32_t>(arena.size()), static_cast<uint32_t>(symbol.size()), address, kind};
+    arena.append(symbol);
+    count++;
+    return {address, true};
+}
+
+/*
+    SymbolTable::addSymbol(string_view symbol, int address, SymbolKind kind)
+    Adds a new symbol with its associated address to the table if the symbol does not already exist.
     
     Parameters:
-    - `symbol`: A reference to the string representing the symbol's name.
+    - `symbol`: A view of the characters of the symbol's name.
     - `address`: An integer representing the memory address to associate with the symbol.
-    
-    Logic:
-    - `symbolTable.find(symbol)`: Checks if the symbol already exists in the table.
-    - If not found, the symbol and its address are added to the map.
-    
-    Concept Note:
-    - `unordered_map::find` returns an iterator pointing to the element if found, or to `unordered_map::end` if not.
-    - Passing `symbol` by reference (`string&`) improves efficiency by avoiding copying.
+    - `kind`: `SymbolKind::Label` for a ROM address, `SymbolKind::Variable` for a RAM address.
+
+    Returns:
+    - `bool`: true if the symbol was added, false if it was already defined.
 */
-void addSymbol(const string& symbol, int address){
-    if(symbolTable.find(symbol) == symbolTable.end()){
-        symbolTable[symbol] = address;
-    }
+bool SymbolTable::addSymbol(string_view symbol, int address, SymbolKind kind){
+    return insert(symbol, address, kind).second;
 }
 
 /*
-    getSymbolAddress(string& symbol)
+    SymbolTable::getSymbolAddress(string_view symbol)
     Retrieves the memory address associated with a given symbol. 
-    Returns -1 if the symbol is not found in `symbolTable`.
+    Returns -1 if the symbol is not found in the table.
     
     Parameters:
-    - `symbol`: A reference to the string representing the symbol's name.
+    - `symbol`: A view of the characters of the symbol's name.
 
     Returns:
     - `int`: The address associated with the symbol if found; otherwise, returns -1.
     
     Logic:
-    - `auto it = symbolTable.find(symbol)`: Uses `auto` to deduce the type of `it`, which is an iterator for `unordered_map`.
-    - `it->second`: If found, `it->second` provides the address (value) mapped to the symbol (key).
-    - If `it` is at the end of the map (`unordered_map::end`), the symbol was not found, so return -1.
+    - Predefined symbols are answered by the compile-time perfect hash.
+    - Everything else is one probe sequence in the slot array; an empty slot means "not found".
+*/
+int SymbolTable::getSymbolAddress(string_view symbol) const{
+    int predefined = lookupPredefinedSymbol(symbol);
+    if(predefined >= 0){
+        return predefined;
+    }
+    return slots[findSlot(symbol, hashName(symbol))].address;  // -1 for an empty slot
+}
+
+/*
+    SymbolTable::entries(SymbolKind kind)
+    Lists the labels or the variables, e.g. for the emulator's profiler.
+
+    Returns:
+    - `vector<SymbolEntry>`: The matching symbols sorted by address, then by name. The names
+      are views into the arena.
 */
-int getSymbolAddress(const string& symbol){
-    auto it = symbolTable.find(symbol);  // `auto` deduces type `unordered_map<string, int>::iterator`
-    if(it != symbolTable.end()){
-        return it->second;  // Access the mapped address if the symbol exists
-    }else{
-        return -1;  // Symbol not found
+vector<SymbolEntry> SymbolTable::entries(SymbolKind kind) const{
+    vector<SymbolEntry> result;
+    for(const Slot& slot : slots){
+        if(slot.address >= 0 && slot.kind == kind){
+            result.push_back({string_view(arena).substr(slot.nameOffset, slot.nameLength), slot.address, kind});
+        }
     }
+    sort(result.begin(), result.end(), [](const SymbolEntry& x, const SymbolEntry& y){
+        return x.address != y.address ? x.address < y.address : x.name < y.name;
+    });
+    return result;
 }
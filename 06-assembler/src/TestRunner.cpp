@@ -0,0 +1,206 @@
+/**
+ * @file TestRunner.cpp
+ * @brief Main entry point for the headless test script runner.
+ *
+ * This file contains the command-line front end of `runTestScript`: it collects the
+ * .tst scripts to run, runs them in parallel on a `ThreadPool` (one `Machine` per
+ * script) and reports the results in input order.
+ *
+ * Key Components:
+ * - Inputs: .tst files, or directories searched recursively for .tst files.
+ * - Report: one PASS/FAIL/SKIP/ERROR line per script, the first mismatching line of a
+ *   failing script, and a summary with the total time.
+ * - Exit status: 0 if no script failed, 1 if any failed or could not run, 2 for usage errors.
+ */
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../include/CommandLine.h"
+#include "../include/TestScript.h"
+#include "../include/ThreadPool.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+/**
+ * @brief Settings collected from the command line.
+ */
+struct Options {
+    vector<string> inputs;
+    unsigned jobs = 0;            // 0 = one worker per hardware thread
+    Engine engine = Engine::Threaded;
+    bool writeOutput = false;     // Write the .out files named by `output-file`
+};
+
+/**
+ * @brief Prints the command-line help.
+ */
+static void printUsage(){
+    cout<<"Usage: TestRunner [options] inputs...\n"
+        <<"\n"
+        <<"Runs CPU emulator test scripts (.tst) on the native emulator and compares their\n"
+        <<"output with the .cmp files they name. Inputs may be .tst files or directories,\n"
+        <<"which are searched recursively.\n"
+        <<"\n"
+        <<"Options:\n"
+        <<"  -j, --jobs N          Number of worker threads (default: all cores)\n"
+        <<"  --engine NAME         \"threaded\" (the default) or \"interpreter\"\n"
+        <<"  --write-out           Write the output of each script to its output-file\n"
+        <<"  -h, --help            Show this help\n";
+}
+
+/**
+ * @brief Reads the options and inputs from the command line.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Command-line arguments.
+ * @param options Receives the parsed settings.
+ * @return bool false if the program should exit (after `--help`).
+ * @throws std::invalid_argument For unknown options, bad values or no inputs.
+ */
+static bool parseArguments(int argc, char* argv[], Options& options){
+    for(int i = 1; i < argc; i++){
+        string argument = argv[i];
+        auto value = [&]() -> string {
+            if(i + 1 >= argc){
+                throw invalid_argument("Missing value for " + argument);
+            }
+            return argv[++i];
+        };
+
+        if(argument == "-h" || argument == "--help"){
+            printUsage();
+            return false;
+        }else if(argument == "-j" || argument == "--jobs"){
+            options.jobs = static_cast<unsigned>(parseNumber(value(), 1024));
+        }else if(argument == "--engine"){
+            string name = value();
+            if(name == "threaded"){
+                options.engine = Engine::Threaded;
+            }else if(name == "interpreter"){
+                options.engine = Engine::Interpreter;
+            }else{
+                throw invalid_argument("Unknown engine: " + name);
+            }
+        }else if(argument == "--write-out"){
+            options.writeOutput = true;
+        }else if(argument.size() > 1 && argument[0] == '-'){
+            throw invalid_argument("Unknown option: " + argument);
+        }else{
+            options.inputs.push_back(argument);
+        }
+    }
+    if(options.inputs.empty()){
+        throw invalid_argument("No test scripts given");
+    }
+    return true;
+}
+
+/**
+ * @brief Expands the inputs into a list of scripts; directories contribute every .tst
+ *        file below them, in sorted order.
+ */
+static vector<string> expandInputs(const vector<string>& inputs){
+    vector<string> files;
+    for(const string& input : inputs){
+        if(fs::is_directory(input)){
+            vector<string> matches;
+            for(const auto& entry : fs::recursive_directory_iterator(input)){
+                if(entry.is_regular_file() && entry.path().extension() == ".tst"){
+                    matches.push_back(entry.path().string());
+                }
+            }
+            sort(matches.begin(), matches.end());
+            files.insert(files.end(), matches.begin(), matches.end());
+        }else{
+            files.push_back(input);
+        }
+    }
+    return files;
+}
+
+/**
+ * @brief Main function for the TestRunner program
+ *
+ * Process Flow:
+ * 1. Parse the command-line options and expand the inputs.
+ * 2. Run every script on the thread pool.
+ * 3. Print the results in input order, then a summary.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Command-line arguments.
+ * @return int 0 if no script failed, 1 otherwise, 2 on usage errors.
+ */
+int main(int argc, char* argv[]){
+    Options options;
+    vector<string> scripts;
+    try{
+        if(!parseArguments(argc, argv, options)){
+            return 0;
+        }
+        scripts = expandInputs(options.inputs);
+    }catch(const invalid_argument& e){
+        cerr<<e.what()<<endl;
+        printUsage();
+        return 2;
+    }catch(const exception& e){
+        cerr<<"Error: "<<e.what()<<endl;
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<TestResult> results(scripts.size());
+    {
+        ThreadPool pool(options.jobs);
+        pool.parallelFor(scripts.size(), 1, [&](size_t begin, size_t end){
+            for(size_t i = begin; i < end; i++){
+                results[i] = runTestScript(scripts[i], options.engine);
+            }
+        });
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t passed = 0, failed = 0, skipped = 0;
+    for(size_t i = 0; i < scripts.size(); i++){
+        const TestResult& result = results[i];
+        switch(result.status){
+        case TestResult::Status::Passed:
+            passed++;
+            cout<<"PASS  "<<scripts[i]<<" ("<<result.lines<<" lines, "<<result.cycles<<" cycles)\n";
+            break;
+        case TestResult::Status::Skipped:
+            skipped++;
+            cout<<"SKIP  "<<scripts[i]<<": "<<result.message<<"\n";
+            break;
+        case TestResult::Status::Failed:
+            failed++;
+            cout<<"FAIL  "<<scripts[i]<<": "<<result.message<<"\n";
+            break;
+        case TestResult::Status::Error:
+            failed++;
+            cout<<"ERROR "<<scripts[i]<<": "<<result.message<<"\n";
+            break;
+        }
+        if(options.writeOutput && !result.outputFile.empty()){
+            ofstream out(result.outputFile, ios::binary);
+            out<<result.output;
+            if(!out){
+                cerr<<"Cannot write "<<result.outputFile<<'\n';
+            }
+        }
+    }
+    cout<<"Passed "<<passed<<" of "<<scripts.size()<<" script(s)";
+    if(skipped > 0){
+        cout<<", "<<skipped<<" skipped";
+    }
+    if(failed > 0){
+        cout<<", "<<failed<<" failed";
+    }
+    cout<<" in "<<seconds<<" s."<<endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,547 @@
+/**
+ * @file TestScript.cpp
+ * @brief Implementation of the test script parser and executor.
+ *
+ * Scripts are tokenized and parsed into a command tree once, then executed on a
+ * `Machine`. The output lines are produced in the format of the Java tools and checked
+ * against the .cmp file one by one, so a failing script stops at its first wrong line.
+ *
+ * Key Concepts:
+ * - Timing: `ticktock` executes one instruction. A `repeat` whose body only ticks is run
+ *   as a single `Machine::run` call, so `repeat 1000000 { ticktock; }` costs about a
+ *   millisecond instead of a million dispatches.
+ * - Halted programs: the machine stops at the end loop of a program, but the Java
+ *   emulator keeps executing it. `advance` accounts for the rest of the cycles without
+ *   running them, leaving PC, A and D exactly where the emulator would.
+ */
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <stdexcept>
+#include "../include/TestScript.h"
+#include "../include/Parser.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+/*
+    Script tokenizer: words (anything up to whitespace or punctuation, so
+    `RAM[0]%D2.6.2` is one token), quoted strings and the punctuation , ; ! { }.
+*/
+struct Token {
+    enum Kind { Word, String, Symbol, End } kind;
+    string text;
+    unsigned line;
+};
+
+vector<Token> tokenize(const string& text, const string& file){
+    vector<Token> tokens;
+    unsigned line = 1;
+    size_t i = 0;
+    while(i < text.size()){
+        char c = text[i];
+        if(c == '\n'){
+            line++;
+            i++;
+        }else if(isspace(static_cast<unsigned char>(c))){
+            i++;
+        }else if(text.compare(i, 2, "//") == 0){
+            while(i < text.size() && text[i] != '\n') i++;
+        }else if(text.compare(i, 2, "/*") == 0){
+            size_t end = text.find("*/", i + 2);
+            if(end == string::npos){
+                throw runtime_error(file + ":" + to_string(line) + ": Unterminated comment");
+            }
+            line += static_cast<unsigned>(count(text.begin() + i, text.begin() + end, '\n'));
+            i = end + 2;
+        }else if(c == '"'){
+            size_t end = text.find('"', i + 1);
+            if(end == string::npos || text.find('\n', i) < end){
+                throw runtime_error(file + ":" + to_string(line) + ": Unterminated string");
+            }
+            tokens.push_back({Token::String, text.substr(i + 1, end - i - 1), line});
+            i = end + 1;
+        }else if(string(",;!{}").find(c) != string::npos){
+            tokens.push_back({Token::Symbol, string(1, c), line});
+            i++;
+        }else{
+            size_t start = i;
+            while(i < text.size() && !isspace(static_cast<unsigned char>(text[i]))
+                  && string(",;!{}\"").find(text[i]) == string::npos && text.compare(i, 2, "//") != 0){
+                i++;
+            }
+            tokens.push_back({Token::Word, text.substr(start, i - start), line});
+        }
+    }
+    tokens.push_back({Token::End, "", line});
+    return tokens;
+}
+
+/*
+    Recursive-descent parser over the token list.
+*/
+class ScriptParser {
+public:
+    ScriptParser(const string& text, const string& file) : tokens(tokenize(text, file)), file(file) {}
+
+    TestScript parse(){
+        TestScript script;
+        script.file = file;
+        script.commands = block(script);
+        if(peek().kind != Token::End){
+            fail("Unexpected '" + peek().text + "'");
+        }
+        return script;
+    }
+
+private:
+    const Token& peek() const { return tokens[position]; }
+
+    [[noreturn]] void fail(const string& message) const {
+        throw runtime_error(file + ":" + to_string(peek().line) + ": " + message);
+    }
+
+    bool accept(const string& text){
+        if(peek().kind != Token::End && peek().kind != Token::String && peek().text == text){
+            position++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(const string& text){
+        if(!accept(text)){
+            fail("Expected '" + text + "' but found '" + peek().text + "'");
+        }
+    }
+
+    string word(const string& what){
+        if(peek().kind != Token::Word){
+            fail("Expected " + what + " but found '" + peek().text + "'");
+        }
+        return tokens[position++].text;
+    }
+
+    // Commands end with ',' (more to come), ';' (end of a simulation step) or '!' (breakpoint stop)
+    void terminator(){
+        if(!accept(",") && !accept(";") && !accept("!")){
+            fail("Expected ',' or ';' but found '" + peek().text + "'");
+        }
+    }
+
+    vector<ScriptCommand> block(TestScript& script){
+        vector<ScriptCommand> commands;
+        while(peek().kind != Token::End && peek().text != "}"){
+            commands.push_back(command(script));
+        }
+        return commands;
+    }
+
+    ScriptCommand command(TestScript& script){
+        ScriptCommand command;
+        command.line = peek().line;
+        string name = word("a command");
+        if(name == "load"){
+            command.kind = ScriptCommand::Load;
+            command.argument = peek().kind == Token::Word ? word("a file name") : "";
+            terminator();
+        }else if(name == "output-file" || name == "compare-to"){
+            command.kind = name == "output-file" ? ScriptCommand::OutputFile : ScriptCommand::CompareTo;
+            command.argument = word("a file name");
+            terminator();
+        }else if(name == "output-list"){
+            command.kind = ScriptCommand::OutputList;
+            while(peek().kind == Token::Word){
+                command.columns.push_back(column(word("a variable")));
+            }
+            terminator();
+        }else if(name == "set"){
+            command.kind = ScriptCommand::Set;
+            command.variable = variable(word("a variable"));
+            command.value = number(word("a value"));
+            terminator();
+        }else if(name == "output"){
+            command.kind = ScriptCommand::Output;
+            terminator();
+        }else if(name == "ticktock"){
+            command.kind = ScriptCommand::TickTock;
+            terminator();
+        }else if(name == "tick" || name == "tock"){
+            fail("'" + name + "' only applies to chips; the CPU emulator uses 'ticktock'");
+        }else if(name == "repeat"){
+            command.kind = ScriptCommand::Repeat;
+            if(peek().kind == Token::Word){
+                string digits = word("a count");
+                if(digits.empty() || digits.size() > 18 || digits.find_first_not_of("0123456789") != string::npos){
+                    fail("Invalid repeat count '" + digits + "'");
+                }
+                command.count = stoull(digits);
+            }else{
+                script.interactive = true;   // Runs until the user stops it
+            }
+            loop(command, script);
+        }else if(name == "while"){
+            command.kind = ScriptCommand::While;
+            command.variable = variable(word("a variable"));
+            command.comparison = word("a comparison");
+            if(command.comparison != "=" && command.comparison != "<>" && command.comparison != "<"
+               && command.comparison != ">" && command.comparison != "<=" && command.comparison != ">="){
+                fail("Unknown comparison '" + command.comparison + "'");
+            }
+            command.value = number(word("a value"));
+            loop(command, script);
+        }else if(name == "echo"){
+            command.kind = ScriptCommand::Echo;
+            if(peek().kind != Token::String){
+                fail("Expected a quoted message after echo");
+            }
+            command.argument = tokens[position++].text;
+            terminator();
+        }else if(name == "clear-echo"){
+            command.kind = ScriptCommand::Echo;
+            terminator();
+        }else{
+            fail("Unknown command '" + name + "'");
+        }
+        return command;
+    }
+
+    void loop(ScriptCommand& command, TestScript& script){
+        expect("{");
+        command.body = block(script);
+        expect("}");
+    }
+
+    /*
+        Values are decimal, or prefixed with %D, %X (hex) or %B (binary).
+    */
+    int number(const string& text){
+        int base = 10;
+        string digits = text;
+        if(text.size() > 2 && text[0] == '%'){
+            char prefix = static_cast<char>(toupper(static_cast<unsigned char>(text[1])));
+            base = prefix == 'X' ? 16 : prefix == 'B' ? 2 : prefix == 'D' ? 10 : 0;
+            digits = text.substr(2);
+        }
+        size_t used = 0;
+        long value = 0;
+        try{
+            value = base == 0 ? 0 : stol(digits, &used, base);
+        }catch(const exception&){
+            used = 0;
+        }
+        if(base == 0 || used != digits.size() || value < -32768 || value > 65535){
+            fail("Invalid value '" + text + "'");
+        }
+        return static_cast<int>(value);
+    }
+
+    ScriptVariable variable(const string& text){
+        ScriptVariable variable;
+        variable.name = text;
+        if(text == "A" || text == "ARegister"){
+            variable.kind = ScriptVariable::A;
+        }else if(text == "D" || text == "DRegister"){
+            variable.kind = ScriptVariable::D;
+        }else if(text == "PC"){
+            variable.kind = ScriptVariable::PC;
+        }else if(text == "time"){
+            variable.kind = ScriptVariable::Time;
+        }else if(text.size() > 5 && text.compare(0, 4, "RAM[") == 0 && text.back() == ']'){
+            string index = text.substr(4, text.size() - 5);
+            if(index.empty() || index.size() > 5 || index.find_first_not_of("0123456789") != string::npos
+               || stoul(index) >= Machine::RAM_SIZE){
+                fail("Invalid RAM address in '" + text + "'");
+            }
+            variable.kind = ScriptVariable::Ram;
+            variable.address = static_cast<uint16_t>(stoul(index));
+        }else{
+            fail("Unknown variable '" + text + "'");
+        }
+        return variable;
+    }
+
+    // NAME%Fl.w.r, e.g. RAM[0]%D2.6.2; without a format, %B1.16.1 as in the Java tools
+    OutputColumn column(const string& text){
+        OutputColumn column;
+        size_t percent = text.find('%');
+        column.variable = variable(text.substr(0, percent));
+        if(percent == string::npos){
+            return column;
+        }
+        string format = text.substr(percent + 1);
+        size_t dot1 = format.find('.');
+        size_t dot2 = dot1 == string::npos ? string::npos : format.find('.', dot1 + 1);
+        auto field = [&](size_t begin, size_t end) -> unsigned {
+            string digits = format.substr(begin, end - begin);
+            if(digits.empty() || digits.size() > 3 || digits.find_first_not_of("0123456789") != string::npos){
+                fail("Invalid output format '" + text + "'");
+            }
+            return static_cast<unsigned>(stoul(digits));
+        };
+        if(format.empty() || string("BDXS").find(format[0]) == string::npos || dot2 == string::npos){
+            fail("Invalid output format '" + text + "'");
+        }
+        column.format = format[0];
+        column.padLeft = field(1, dot1);
+        column.length = field(dot1 + 1, dot2);
+        column.padRight = field(dot2 + 1, format.size());
+        return column;
+    }
+
+    vector<Token> tokens;
+    size_t position = 0;
+    string file;
+};
+
+/*
+    Thrown when an output line differs from the .cmp file.
+*/
+struct ComparisonFailure : runtime_error {
+    using runtime_error::runtime_error;
+};
+
+class ScriptRunner {
+public:
+    ScriptRunner(const TestScript& script, Engine engine, TestResult& result)
+        : script(script), directory(fs::path(script.file).parent_path()), result(result) {
+        machine.setEngine(engine);
+    }
+
+    void run(){
+        execute(script.commands);
+    }
+
+private:
+    [[noreturn]] void fail(const ScriptCommand& command, const string& message) const {
+        throw runtime_error(script.file + ":" + to_string(command.line) + ": " + message);
+    }
+
+    string resolve(const string& name) const {
+        return (directory / name).string();
+    }
+
+    void execute(const vector<ScriptCommand>& commands){
+        for(const ScriptCommand& command : commands){
+            switch(command.kind){
+            case ScriptCommand::Load:
+                if(command.argument.empty()){
+                    fail(command, "'load' needs the program to load");
+                }
+                try{
+                    machine.loadFile(resolve(command.argument));
+                }catch(const exception& e){
+                    fail(command, "Cannot load " + command.argument + ": " + e.what());
+                }
+                break;
+            case ScriptCommand::OutputFile:
+                result.outputFile = resolve(command.argument);
+                break;
+            case ScriptCommand::Echo:
+                break;
+            case ScriptCommand::CompareTo:
+                try{
+                    expected = splitLines(loadSource(resolve(command.argument)));
+                }catch(const exception& e){
+                    fail(command, string("Cannot read the compare file: ") + e.what());
+                }
+                comparing = true;
+                break;
+            case ScriptCommand::OutputList:
+                columns = command.columns;
+                emit(header(), command);
+                break;
+            case ScriptCommand::Set:
+                write(command.variable, command.value, command);
+                break;
+            case ScriptCommand::Output:
+                emit(values(), command);
+                break;
+            case ScriptCommand::TickTock:
+                advance(1);
+                break;
+            case ScriptCommand::Repeat: {
+                bool onlyTicks = all_of(command.body.begin(), command.body.end(),
+                                        [](const ScriptCommand& c){ return c.kind == ScriptCommand::TickTock; });
+                if(onlyTicks){
+                    advance(command.count * command.body.size());
+                }else{
+                    for(uint64_t i = 0; i < command.count; i++) execute(command.body);
+                }
+                break;
+            }
+            case ScriptCommand::While:
+                while(holds(command)) execute(command.body);
+                break;
+            }
+        }
+    }
+
+    /*
+     * Function: advance
+     * -----------------
+     * Executes `cycles` instructions as the Java emulator would.
+     *
+     * Logic:
+     *  - A machine halted in a two-instruction end loop alternates between the two
+     *    instructions without changing anything else, so only the parity of the
+     *    remaining cycles matters for PC.
+     *  - A machine halted past the end of its program would execute the empty ROM,
+     *    i.e. `@0` instructions, up to address 32767 and then wrap around to 0 and
+     *    start the program again.
+     */
+    void advance(uint64_t cycles){
+        result.cycles += cycles;
+        while(cycles > 0){
+            cycles -= machine.run(cycles);
+            if(cycles == 0 || !machine.halted()){
+                break;
+            }
+            uint16_t pc = machine.pc();
+            if(pc < machine.programSize()){
+                if(cycles % 2){
+                    machine.setPC(static_cast<uint16_t>(pc + 1));
+                }
+                break;
+            }
+            uint64_t skipped = min<uint64_t>(cycles, Machine::ROM_SIZE - pc);
+            machine.setA(0);
+            machine.setPC(static_cast<uint16_t>(pc + skipped));
+            cycles -= skipped;
+        }
+    }
+
+    int read(const ScriptVariable& variable) const {
+        switch(variable.kind){
+        case ScriptVariable::A: return static_cast<int16_t>(machine.a());
+        case ScriptVariable::D: return static_cast<int16_t>(machine.d());
+        case ScriptVariable::PC: return machine.pc();
+        case ScriptVariable::Time: return static_cast<int>(min<uint64_t>(result.cycles, INT32_MAX));
+        case ScriptVariable::Ram: return static_cast<int16_t>(machine.peek(variable.address));
+        }
+        return 0;
+    }
+
+    void write(const ScriptVariable& variable, int value, const ScriptCommand& command){
+        uint16_t word = static_cast<uint16_t>(value);
+        switch(variable.kind){
+        case ScriptVariable::A: machine.setA(word); break;
+        case ScriptVariable::D: machine.setD(word); break;
+        case ScriptVariable::PC: machine.setPC(word); break;
+        case ScriptVariable::Ram: machine.poke(variable.address, word); break;
+        case ScriptVariable::Time: fail(command, "'time' cannot be set");
+        }
+    }
+
+    bool holds(const ScriptCommand& command) const {
+        int left = read(command.variable);
+        int right = static_cast<int16_t>(command.value);
+        const string& op = command.comparison;
+        return op == "=" ? left == right : op == "<>" ? left != right : op == "<" ? left < right
+             : op == ">" ? left > right : op == "<=" ? left <= right : left >= right;
+    }
+
+    // Each header is centered in its column and cut to the column width
+    string header() const {
+        string line = "|";
+        for(const OutputColumn& column : columns){
+            size_t width = column.padLeft + column.length + column.padRight;
+            string name = column.variable.name.substr(0, width);
+            size_t left = (width - name.size()) / 2;
+            line += string(left, ' ') + name + string(width - name.size() - left, ' ') + "|";
+        }
+        return line;
+    }
+
+    // Values keep their rightmost `length` characters; strings are left-aligned, numbers right-aligned
+    string values() const {
+        static const char hex[] = "0123456789ABCDEF";
+        string line = "|";
+        for(const OutputColumn& column : columns){
+            int value = read(column.variable);
+            uint16_t word = static_cast<uint16_t>(value);
+            string text;
+            if(column.format == 'B'){
+                for(int bit = 15; bit >= 0; bit--) text += ((word >> bit) & 1) ? '1' : '0';
+            }else if(column.format == 'X'){
+                for(int shift = 12; shift >= 0; shift -= 4) text += hex[(word >> shift) & 0xF];
+            }else{
+                text = to_string(value);
+            }
+            if(text.size() > column.length){
+                text = text.substr(text.size() - column.length);
+            }
+            string fill(column.length - text.size(), ' ');
+            text = column.format == 'S' ? text + fill : fill + text;
+            line += string(column.padLeft, ' ') + text + string(column.padRight, ' ') + "|";
+        }
+        return line;
+    }
+
+    void emit(const string& line, const ScriptCommand& command){
+        result.output += line + "\n";
+        result.lines++;
+        if(!comparing){
+            return;
+        }
+        size_t index = result.lines - 1;
+        if(index >= expected.size() || expected[index] != line){
+            string wanted = index < expected.size() ? expected[index] : "<end of file>";
+            throw ComparisonFailure("Comparison failure at line " + to_string(result.lines) + " (script line "
+                                    + to_string(command.line) + ")\n  expected: " + wanted + "\n  actual:   " + line);
+        }
+    }
+
+    static vector<string> splitLines(const string& text){
+        vector<string> lines;
+        size_t start = 0;
+        while(start < text.size()){
+            size_t end = text.find('\n', start);
+            if(end == string::npos) end = text.size();
+            string line = text.substr(start, end - start);
+            while(!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')){
+                line.pop_back();
+            }
+            lines.push_back(line);
+            start = end + 1;
+        }
+        return lines;
+    }
+
+    const TestScript& script;
+    fs::path directory;
+    TestResult& result;
+    Machine machine;
+    vector<OutputColumn> columns;
+    vector<string> expected;
+    bool comparing = false;
+};
+
+} // namespace
+
+TestScript parseTestScript(const string& text, const string& file){
+    return ScriptParser(text, file).parse();
+}
+
+TestResult runTestScript(const string& filename, Engine engine){
+    TestResult result;
+    try{
+        TestScript script = parseTestScript(loadSource(filename), filename);
+        if(script.interactive){
+            result.status = TestResult::Status::Skipped;
+            result.message = "Interactive script (repeat without a count)";
+            return result;
+        }
+        ScriptRunner runner(script, engine, result);
+        runner.run();
+    }catch(const ComparisonFailure& e){
+        result.status = TestResult::Status::Failed;
+        result.message = e.what();
+    }catch(const exception& e){
+        result.status = TestResult::Status::Error;
+        result.message = e.what();
+    }
+    return result;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file ThreadPool.cpp
+ * @brief Implementation of the work-stealing thread pool.
+ * 
+ * Key Concepts:
+ * - Every worker owns a `Queue` (a mutex-protected deque). Keeping one lock per queue means
+ *   workers almost never contend: they only touch another worker's lock while stealing.
+ * - `queued` counts tasks that are sitting in some queue. A worker first reserves one of them
+ *   under `stateMutex` and only then searches the queues, so it never spins on empty queues
+ *   and sleeps on `workAvailable` when there is nothing to do.
+ * - `thread_local` variables remember which pool and queue the current thread belongs to, so
+ *   tasks spawned by a task stay on the same worker unless another worker steals them.
+ */
+#include <algorithm>
+#include "../include/ThreadPool.h"
+
+using namespace std;
+
+namespace {
+
+thread_local const ThreadPool* currentPool = nullptr;  // Pool the current thread works for, if any
+thread_local size_t currentQueue = 0;                  // Index of that worker's own queue
+
+}  // namespace
+
+/**
+ * @brief Starts the worker threads.
+ * 
+ * @param threadCount Number of workers; 0 selects one per hardware thread.
+ */
+ThreadPool::ThreadPool(unsigned threadCount){
+    if(threadCount == 0){
+        threadCount = max(1u, thread::hardware_concurrency());
+    }
+    for(unsigned i = 0; i < threadCount; i++){
+        queues.push_back(make_unique<Queue>());
+    }
+    for(unsigned i = 0; i < threadCount; i++){
+        workers.emplace_back([this, i]{ run(i); });
+    }
+}
+
+/**
+ * @brief Finishes all queued tasks, then stops and joins the workers.
+ */
+ThreadPool::~ThreadPool(){
+    {
+        lock_guard<mutex> lock(stateMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for(thread& worker : workers){
+        worker.join();
+    }
+}
+
+/**
+ * @brief Queues a task, on the caller's own queue when called from a worker.
+ * 
+ * @param task The work to run.
+ */
+void ThreadPool::submit(function<void()> task){
+    size_t target = (currentPool == this) ? currentQueue : nextQueue++ % queues.size();
+    {
+        lock_guard<mutex> lock(queues[target]->mutex);
+        queues[target]->tasks.push_back(move(task));
+    }
+    {
+        lock_guard<mutex> lock(stateMutex);
+        queued++;
+        unfinished++;
+    }
+    workAvailable.notify_one();
+}
+
+/**
+ * @brief Takes one task: from the back of our own queue, otherwise from the front of another.
+ * 
+ * @param self Index of the queue to try first.
+ * @param task Receives the task.
+ * @return bool true if a task was found.
+ */
+bool ThreadPool::takeTask(size_t self, function<void()>& task){
+    {
+        Queue& own = *queues[self];
+        lock_guard<mutex> lock(own.mutex);
+        if(!own.tasks.empty()){
+            task = move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for(size_t i = 1; i < queues.size(); i++){
+        Queue& victim = *queues[(self + i) % queues.size()];
+        lock_guard<mutex> lock(victim.mutex);
+        if(!victim.tasks.empty()){
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Main loop of worker `self`: reserve a task, find it, run it, repeat.
+ * 
+ * @param self Index of this worker and of its queue.
+ */
+void ThreadPool::run(size_t self){
+    currentPool = this;
+    currentQueue = self;
+
+    while(true){
+        {
+            unique_lock<mutex> lock(stateMutex);
+            workAvailable.wait(lock, [this]{ return stopping || queued > 0; });
+            if(queued == 0){
+                return;  // Stopping and nothing left to do
+            }
+            queued--;  // Reserve one task; it is guaranteed to be in some queue
+        }
+
+        runReserved(self);
+    }
+}
+
+/**
+ * @brief Finds, runs and retires a task that the caller has already reserved.
+ * 
+ * @param self Index of the queue to search first.
+ */
+void ThreadPool::runReserved(size_t self){
+    function<void()> task;
+    while(!takeTask(self, task)){
+        this_thread::yield();  // The reserved task is still being pushed by `submit`
+    }
+    task();
+
+    lock_guard<mutex> lock(stateMutex);
+    if(--unfinished == 0){
+        allDone.notify_all();
+    }
+}
+
+/**
+ * @brief Blocks until every task submitted so far has finished.
+ * 
+ * Must not be called from inside a task; use `parallelFor` for nested parallelism.
+ */
+void ThreadPool::wait(){
+    unique_lock<mutex> lock(stateMutex);
+    allDone.wait(lock, [this]{ return unfinished == 0; });
+}
+
+/**
+ * @brief Runs `body(begin, end)` over consecutive chunks of [0, count) and waits for them.
+ * 
+ * The calling thread does not just block: while chunks are outstanding it runs queued
+ * tasks itself. This makes `parallelFor` safe to call from inside a task, and lets the
+ * caller contribute a core when it is not a worker.
+ * 
+ * @param count Size of the index range.
+ * @param chunkSize Maximum number of indices per task.
+ * @param body Called once per chunk with a half-open index range.
+ */
+void ThreadPool::parallelFor(size_t count, size_t chunkSize, const function<void(size_t, size_t)>& body){
+    chunkSize = max<size_t>(1, chunkSize);
+    auto remaining = make_shared<atomic<size_t>>((count + chunkSize - 1) / chunkSize);
+    for(size_t begin = 0; begin < count; begin += chunkSize){
+        size_t end = min(count, begin + chunkSize);
+        submit([&body, begin, end, remaining]{
+            body(begin, end);
+            remaining->fetch_sub(1);
+        });
+    }
+
+    size_t self = (currentPool == this) ? currentQueue : 0;
+    while(remaining->load() > 0){
+        bool reserved = false;
+        {
+            lock_guard<mutex> lock(stateMutex);
+            if(queued > 0){
+                queued--;
+                reserved = true;
+            }
+        }
+        if(reserved){
+            runReserved(self);
+        }else{
+            this_thread::yield();  // Our remaining chunks are running on other workers
+        }
+    }
+}
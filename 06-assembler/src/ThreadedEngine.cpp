@@ -0,0 +1,410 @@
+/**
+ * @file ThreadedEngine.cpp
+ * @brief Implementation of the pre-decoded, threaded-code engine of the Hack emulator.
+ *
+ * The ROM never changes while a program runs, so the fields of every word are decoded
+ * once, when the program is loaded, into a `MicroOp`: a handler number, the dest and
+ * jump bits, and the value of A-instructions. Executing a micro-op is then a single
+ * indirect jump to its handler, and every handler ends with its own copy of the dispatch
+ * code (threaded code with GCC/Clang computed gotos; other compilers use a `switch`).
+ *
+ * Key Components:
+ * - Computation handlers: one per canonical entry of `computationMap`, in table order,
+ *   so e.g. "D+M" is a single add instead of a pass through the general ALU. Aliases
+ *   such as "M+D" share the bits of their canonical entry and map to the same handler.
+ * - Writeback tails: one per combination of dest bits and "may jump", so storing the
+ *   result takes no tests on the instruction at run time.
+ * - Fused micro-ops: `@X` followed by `D=M`, `M=D`, `D=A`, `0;JMP` or `D;Jxx` executes
+ *   as one micro-op that counts as two instructions. The second word keeps its own
+ *   micro-op, so jumps straight to it still work.
+ *
+ * The engine matches `Machine::runInterpreter` exactly: the same state after every
+ * instruction count, the same halting rules and the same cycle counts.
+ */
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include "../include/Machine.h"
+#include "../include/SymbolTables.h"
+
+using namespace std;
+
+// Define HACK_NO_COMPUTED_GOTO to build the portable switch-based dispatch with GCC or Clang too
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(HACK_NO_COMPUTED_GOTO)
+#define HACK_COMPUTED_GOTO 1
+#endif
+
+namespace {
+
+// Micro-op handlers. The first 28 implement the canonical computations of `computationMap`, in table order
+enum Handler : uint8_t {
+    COMP_ZERO, COMP_ONE, COMP_MINUS_ONE,
+    COMP_D, COMP_A, COMP_M,
+    COMP_NOT_D, COMP_NOT_A, COMP_NOT_M,
+    COMP_NEG_D, COMP_NEG_A, COMP_NEG_M,
+    COMP_D_PLUS_1, COMP_A_PLUS_1, COMP_M_PLUS_1,
+    COMP_D_MINUS_1, COMP_A_MINUS_1, COMP_M_MINUS_1,
+    COMP_D_PLUS_A, COMP_D_PLUS_M, COMP_D_MINUS_A, COMP_D_MINUS_M, COMP_A_MINUS_D, COMP_M_MINUS_D,
+    COMP_D_AND_A, COMP_D_AND_M, COMP_D_OR_A, COMP_D_OR_M,
+    COMP_GENERIC,       // Any other `a c1..c6` pattern, evaluated with hackAlu()
+    LOAD_A,             // @X
+    LOAD_D_FROM_M,      // @X, D=M
+    STORE_D,            // @X, M=D
+    LOAD_D_CONSTANT,    // @X, D=A
+    GOTO,               // @X, 0;JMP
+    BRANCH_ON_D,        // @X, D;Jxx
+    END_OF_PROGRAM,     // PC left the loaded program
+    WRAP,               // PC ran past the last ROM word and wraps to 0
+    HANDLER_COUNT
+};
+
+// The mnemonic each computation handler implements, checked against `computationMap`
+constexpr array<string_view, COMP_GENERIC> HANDLED_COMPUTATIONS = {{
+    "0", "1", "-1", "D", "A", "M", "!D", "!A", "!M", "-D", "-A", "-M",
+    "D+1", "A+1", "M+1", "D-1", "A-1", "M-1",
+    "D+A", "D+M", "D-A", "D-M", "A-D", "M-D", "D&A", "D&M", "D|A", "D|M"
+}};
+
+// Fields of a C-instruction the fusion patterns look at: `a c1..c6`, dest and jump
+constexpr uint16_t COMP_BITS_0 = 0b0101010;
+constexpr uint16_t COMP_BITS_D = 0b0001100;
+constexpr uint16_t COMP_BITS_A = 0b0110000;
+constexpr uint16_t COMP_BITS_M = 0b1110000;
+constexpr uint8_t DEST_M = 0b001;
+constexpr uint8_t DEST_D = 0b010;
+constexpr uint8_t JUMP_ALWAYS = 0b111;
+
+/*
+ * Function: computationHandlers
+ * -----------------------------
+ * Maps all 128 `a c1..c6` bit patterns to their computation handler.
+ *
+ * Returns:
+ *  - A table indexed by the comp bits of a C-instruction.
+ *
+ * Logic:
+ *  - The canonical entries of `computationMap` give the patterns that have a specialized
+ *    handler; every other pattern falls back to COMP_GENERIC.
+ *  - The handler order is fixed in code, so the table names are checked against it once;
+ *    a reordered `computationMap` is reported instead of silently running the wrong code.
+ */
+const array<uint8_t, 128>& computationHandlers(){
+    static const array<uint8_t, 128> table = []{
+        array<uint8_t, 128> handlers;
+        handlers.fill(COMP_GENERIC);
+        for(size_t i = 0; i < HANDLED_COMPUTATIONS.size(); i++){
+            if(computationMap[i].name != HANDLED_COMPUTATIONS[i]){
+                throw logic_error("computationMap entry " + to_string(i) + " is \""
+                                  + string(computationMap[i].name) + "\", expected \""
+                                  + string(HANDLED_COMPUTATIONS[i]) + "\"");
+            }
+            handlers[computationMap[i].bits] = static_cast<uint8_t>(i);
+        }
+        return handlers;
+    }();
+    return table;
+}
+
+} // namespace
+
+/*
+ * Function: predecode
+ * -------------------
+ * Translates the ROM into micro-ops for the threaded engine.
+ *
+ * Logic:
+ *  - A-instructions become LOAD_A, or a fused micro-op if the next word of the program
+ *    is one of the supported C-instructions.
+ *  - C-instructions get the handler of their computation and a writeback tail built
+ *    from their dest bits and whether they can jump.
+ *  - Every address past the program is END_OF_PROGRAM, and one extra entry after the
+ *    last ROM word wraps PC back to 0.
+ */
+void Machine::predecode(){
+    const array<uint8_t, 128>& handlers = computationHandlers();
+    microOps.assign(ROM_SIZE + 1, MicroOp{});
+
+    for(size_t pc = 0; pc < ROM_SIZE; pc++){
+        MicroOp& op = microOps[pc];
+        if(pc >= programLength){
+            op.handler = END_OF_PROGRAM;
+            continue;
+        }
+
+        uint16_t word = rom[pc];
+        if(!(word & 0x8000)){
+            op.handler = LOAD_A;
+            op.operand = word;
+            if(pc + 1 < programLength && (rom[pc + 1] & 0x8000)){
+                uint16_t next = rom[pc + 1];
+                uint16_t comp = (next >> 6) & 0x7F;
+                uint8_t dest = (next >> 3) & 0x7;
+                uint8_t jump = next & 0x7;
+                if(comp == COMP_BITS_M && dest == DEST_D && jump == 0){
+                    op.handler = LOAD_D_FROM_M;
+                }else if(comp == COMP_BITS_D && dest == DEST_M && jump == 0){
+                    op.handler = STORE_D;
+                }else if(comp == COMP_BITS_A && dest == DEST_D && jump == 0){
+                    op.handler = LOAD_D_CONSTANT;
+                }else if(comp == COMP_BITS_0 && dest == 0 && jump == JUMP_ALWAYS){
+                    op.handler = GOTO;
+                }else if(comp == COMP_BITS_D && dest == 0 && jump != 0){
+                    op.handler = BRANCH_ON_D;
+                    op.jump = jump;
+                }
+            }
+        }else{
+            uint8_t comp = (word >> 6) & 0x7F;
+            uint8_t dest = (word >> 3) & 0x7;
+            op.handler = handlers[comp];
+            op.jump = word & 0x7;
+            op.tail = dest | (op.jump != 0 ? 8 : 0);
+            op.control = comp;
+        }
+    }
+    microOps[ROM_SIZE].handler = WRAP;
+}
+
+/*
+    Dispatch macros. With computed gotos every handler ends in its own copy of DISPATCH(),
+    so the branch predictor sees one indirect jump per handler instead of a single shared
+    one. Without them the handlers are the cases of one switch and DISPATCH() loops back.
+*/
+#ifdef HACK_COMPUTED_GOTO
+#define HANDLER(name) name:
+#define DISPATCH() do { if(remaining == 0) goto done; op = &ops[pc]; goto *handlerLabels[op->handler]; } while(0)
+#define WRITEBACK() goto *tailLabels[op->tail]
+#else
+#define HANDLER(name) case name:
+#define DISPATCH() goto dispatch
+#define WRITEBACK() goto writeback
+#endif
+
+// Computes `out` for a C-instruction and continues with its writeback tail
+#define COMPUTE(expression) do { address = a & 0x7FFF; out = static_cast<uint16_t>(expression); WRITEBACK(); } while(0)
+
+// Stores `out` as selected by `tail` (dest bits, plus 8 if the instruction can jump) and advances PC
+#define WRITEBACK_BODY(tail) \
+    do { \
+        if(((tail) & DEST_M) && address < KBD){ \
+            memory[address] = out; \
+        } \
+        uint32_t next = pc + 1; \
+        if(((tail) & 8) && hackJump(out, op->jump)){ \
+            if(((tail) & 7) == 0 && address + 1u == pc && code[address] == address \
+               && !((op->control & 0x40) && address == KBD)){ \
+                pc = address; \
+                remaining--; \
+                stopped = true; \
+                goto done; \
+            } \
+            next = address; \
+        } \
+        if((tail) & 4){ \
+            a = out; \
+        } \
+        if((tail) & DEST_D){ \
+            d = out; \
+        } \
+        pc = next; \
+        remaining--; \
+    } while(0)
+
+#define TAIL(n) TAIL_##n: WRITEBACK_BODY(n); DISPATCH();
+
+/*
+ * Function: runThreaded
+ * ---------------------
+ * Executes the pre-decoded micro-ops.
+ *
+ * Parameters:
+ *  - maxCycles: The most instructions to execute.
+ *
+ * Returns:
+ *  - The number of instructions executed.
+ *
+ * Logic:
+ *  - `remaining` counts down the budget; a fused micro-op needs two cycles, so with one
+ *    cycle left it executes only its A-instruction, exactly like the interpreter would.
+ *  - A fused `@X` + jump to its own address is the end-of-program loop and halts.
+ */
+uint64_t Machine::runThreaded(uint64_t maxCycles){
+    if(stopped){
+        return 0;
+    }
+    const MicroOp* ops = microOps.data();
+    const uint16_t* code = rom.data();
+    uint16_t* memory = ram.data();
+    uint32_t pc = programCounter;
+    uint16_t a = registerA;
+    uint16_t d = registerD;
+    uint16_t out = 0;
+    uint16_t address = 0;
+    uint64_t remaining = maxCycles;
+    const MicroOp* op = nullptr;
+
+#ifdef HACK_COMPUTED_GOTO
+    static const void* const handlerLabels[] = {
+        &&COMP_ZERO, &&COMP_ONE, &&COMP_MINUS_ONE,
+        &&COMP_D, &&COMP_A, &&COMP_M,
+        &&COMP_NOT_D, &&COMP_NOT_A, &&COMP_NOT_M,
+        &&COMP_NEG_D, &&COMP_NEG_A, &&COMP_NEG_M,
+        &&COMP_D_PLUS_1, &&COMP_A_PLUS_1, &&COMP_M_PLUS_1,
+        &&COMP_D_MINUS_1, &&COMP_A_MINUS_1, &&COMP_M_MINUS_1,
+        &&COMP_D_PLUS_A, &&COMP_D_PLUS_M, &&COMP_D_MINUS_A, &&COMP_D_MINUS_M, &&COMP_A_MINUS_D, &&COMP_M_MINUS_D,
+        &&COMP_D_AND_A, &&COMP_D_AND_M, &&COMP_D_OR_A, &&COMP_D_OR_M,
+        &&COMP_GENERIC,
+        &&LOAD_A, &&LOAD_D_FROM_M, &&STORE_D, &&LOAD_D_CONSTANT, &&GOTO, &&BRANCH_ON_D,
+        &&END_OF_PROGRAM, &&WRAP
+    };
+    static_assert(sizeof(handlerLabels) / sizeof(handlerLabels[0]) == HANDLER_COUNT, "one label per handler");
+    static const void* const tailLabels[16] = {
+        &&TAIL_0, &&TAIL_1, &&TAIL_2, &&TAIL_3, &&TAIL_4, &&TAIL_5, &&TAIL_6, &&TAIL_7,
+        &&TAIL_8, &&TAIL_9, &&TAIL_10, &&TAIL_11, &&TAIL_12, &&TAIL_13, &&TAIL_14, &&TAIL_15
+    };
+
+    DISPATCH();
+#else
+dispatch:
+    if(remaining == 0){
+        goto done;
+    }
+    op = &ops[pc];
+    switch(op->handler){
+#endif
+
+    HANDLER(COMP_ZERO)       COMPUTE(0);
+    HANDLER(COMP_ONE)        COMPUTE(1);
+    HANDLER(COMP_MINUS_ONE)  COMPUTE(0xFFFF);
+    HANDLER(COMP_D)          COMPUTE(d);
+    HANDLER(COMP_A)          COMPUTE(a);
+    HANDLER(COMP_M)          COMPUTE(memory[address]);
+    HANDLER(COMP_NOT_D)      COMPUTE(~d);
+    HANDLER(COMP_NOT_A)      COMPUTE(~a);
+    HANDLER(COMP_NOT_M)      COMPUTE(~memory[address]);
+    HANDLER(COMP_NEG_D)      COMPUTE(-d);
+    HANDLER(COMP_NEG_A)      COMPUTE(-a);
+    HANDLER(COMP_NEG_M)      COMPUTE(-memory[address]);
+    HANDLER(COMP_D_PLUS_1)   COMPUTE(d + 1);
+    HANDLER(COMP_A_PLUS_1)   COMPUTE(a + 1);
+    HANDLER(COMP_M_PLUS_1)   COMPUTE(memory[address] + 1);
+    HANDLER(COMP_D_MINUS_1)  COMPUTE(d - 1);
+    HANDLER(COMP_A_MINUS_1)  COMPUTE(a - 1);
+    HANDLER(COMP_M_MINUS_1)  COMPUTE(memory[address] - 1);
+    HANDLER(COMP_D_PLUS_A)   COMPUTE(d + a);
+    HANDLER(COMP_D_PLUS_M)   COMPUTE(d + memory[address]);
+    HANDLER(COMP_D_MINUS_A)  COMPUTE(d - a);
+    HANDLER(COMP_D_MINUS_M)  COMPUTE(d - memory[address]);
+    HANDLER(COMP_A_MINUS_D)  COMPUTE(a - d);
+    HANDLER(COMP_M_MINUS_D)  COMPUTE(memory[address] - d);
+    HANDLER(COMP_D_AND_A)    COMPUTE(d & a);
+    HANDLER(COMP_D_AND_M)    COMPUTE(d & memory[address]);
+    HANDLER(COMP_D_OR_A)     COMPUTE(d | a);
+    HANDLER(COMP_D_OR_M)     COMPUTE(d | memory[address]);
+    HANDLER(COMP_GENERIC)    COMPUTE(hackAlu(d, (op->control & 0x40) ? memory[address] : a, op->control & 0x3F));
+
+    HANDLER(LOAD_A)
+    loadOnlyA:
+        a = op->operand;
+        pc++;
+        remaining--;
+        DISPATCH();
+
+    HANDLER(LOAD_D_FROM_M)
+        if(remaining < 2){
+            goto loadOnlyA;
+        }
+        a = op->operand;
+        d = memory[a];
+        pc += 2;
+        remaining -= 2;
+        DISPATCH();
+
+    HANDLER(STORE_D)
+        if(remaining < 2){
+            goto loadOnlyA;
+        }
+        a = op->operand;
+        if(a < KBD){
+            memory[a] = d;
+        }
+        pc += 2;
+        remaining -= 2;
+        DISPATCH();
+
+    HANDLER(LOAD_D_CONSTANT)
+        if(remaining < 2){
+            goto loadOnlyA;
+        }
+        a = op->operand;
+        d = a;
+        pc += 2;
+        remaining -= 2;
+        DISPATCH();
+
+    HANDLER(GOTO)
+        if(remaining < 2){
+            goto loadOnlyA;
+        }
+        a = op->operand;
+        remaining -= 2;
+        if(a == pc){
+            stopped = true;
+            goto done;
+        }
+        pc = a;
+        DISPATCH();
+
+    HANDLER(BRANCH_ON_D)
+        if(remaining < 2){
+            goto loadOnlyA;
+        }
+        a = op->operand;
+        remaining -= 2;
+        if(hackJump(d, op->jump)){
+            if(a == pc){
+                stopped = true;
+                goto done;
+            }
+            pc = a;
+        }else{
+            pc += 2;
+        }
+        DISPATCH();
+
+    HANDLER(END_OF_PROGRAM)
+        stopped = true;
+        goto done;
+
+    HANDLER(WRAP)
+        pc = 0;
+        DISPATCH();
+
+#ifdef HACK_COMPUTED_GOTO
+    TAIL(0) TAIL(1) TAIL(2) TAIL(3) TAIL(4) TAIL(5) TAIL(6) TAIL(7)
+    TAIL(8) TAIL(9) TAIL(10) TAIL(11) TAIL(12) TAIL(13) TAIL(14) TAIL(15)
+#else
+    default:
+        goto done;
+    }
+writeback:
+    WRITEBACK_BODY(op->tail);
+    goto dispatch;
+#endif
+
+done:
+    programCounter = pc & 0x7FFF;
+    registerA = a;
+    registerD = d;
+    uint64_t executed = maxCycles - remaining;
+    cycleCount += executed;
+    return executed;
+}
+
+#undef HANDLER
+#undef DISPATCH
+#undef WRITEBACK
+#undef COMPUTE
+#undef WRITEBACK_BODY
+#undef TAIL
@@ -6,11 +6,15 @@
 @PADDLE   // Paddle position variable
 M=0       // Initialize paddle position at 0
 
+@512      // Initialize ball X at the center of the screen
+D=A
 @BALL_X   // Ball X-position variable
-M=512     // Initialize ball X at the center of the screen
+M=D
 
+@256      // Initialize ball Y at the center of the screen
+D=A
 @BALL_Y   // Ball Y-position variable
-M=256     // Initialize ball Y at the center of the screen
+M=D
 
 @DIR_X    // Ball X-direction variable
 M=1       // Initialize ball moving to the right